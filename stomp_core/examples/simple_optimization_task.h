@@ -28,6 +28,7 @@
 #define EXAMPLES_SIMPLE_OPTIMIZATION_TASK_H_
 
 #include <stomp_core/task.h>
+#include <stomp_core/random_stream.h>
 
 namespace stomp_core_examples
 {
@@ -48,13 +49,13 @@ public:
             const std::vector<double>& std_dev):
               parameters_bias_(parameters_bias),
               bias_thresholds_(bias_thresholds),
-              std_dev_(std_dev)
+              std_dev_(std_dev),
+              random_seed_(0)
   {
 
     // generate smoothing matrix
     int num_timesteps = parameters_bias.cols();
     stomp_core::generateSmoothingMatrix(num_timesteps,1.0,smoothing_M_);
-    srand(time(0));
 
   }
 
@@ -78,13 +79,14 @@ public:
                                Eigen::MatrixXd& parameters_noise,
                                Eigen::MatrixXd& noise) override
   {
+    // each rollout has its own stream so the noise does not depend on the order in which the rollouts are generated
+    stomp_core::RandomStream stream(random_seed_,iteration_number,rollout_number);
     double rand_noise;
     for(std::size_t d = 0; d < parameters.rows(); d++)
     {
       for(std::size_t t = 0; t < parameters.cols(); t++)
       {
-        rand_noise = static_cast<double>(rand()%RAND_MAX)/static_cast<double>(RAND_MAX - 1); // 0 to 1
-        rand_noise = 2*(0.5 - rand_noise);
+        rand_noise = 2*(0.5 - stream.uniform()); // -1 to 1
         noise(d,t) =  rand_noise*std_dev_[d];
       }
     }
@@ -94,6 +96,15 @@ public:
     return true;
   }
 
+  /**
+   * @brief Stores the master seed of the noise
+   * @param seed The master seed
+   */
+  void setRandomSeed(std::uint64_t seed) override
+  {
+    random_seed_ = seed;
+  }
+
   /**
    * @brief computes the state costs as a function of the distance from the bias parameters
    * @param parameters        A matrix [num_dimensions][num_parameters] of the policy parameters to execute
@@ -209,6 +220,7 @@ protected:
   std::vector<double> bias_thresholds_; /**< Threshold to determine whether two trajectories are equal */
   std::vector<double> std_dev_;         /**< Standard deviation used for generating noisy parameters */
   Eigen::MatrixXd smoothing_M_;         /**< Matrix used for smoothing the trajectory */
+  std::uint64_t random_seed_;           /**< Master seed of the noise */
 };
 
 }
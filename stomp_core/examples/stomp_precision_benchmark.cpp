@@ -0,0 +1,188 @@
+/**
+ * @file stomp_precision_benchmark.cpp
+ * @brief This compares the speed and the quality of the single and double precision STOMP kernels
+ *
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <Eigen/Dense>
+#include "stomp_core/random_stream.h"
+#include "stomp_core/rollout_arrays.h"
+#include "stomp_core/stomp.h"
+#include "simple_optimization_task.h"
+
+using Trajectory = Eigen::MatrixXd;                              /**< Assign Type Trajectory to Eigen::MatrixXd Type */
+
+static const std::size_t NUM_DIMENSIONS = 3;                            /**< Number of parameters to optimize */
+static const std::size_t NUM_TIMESTEPS = 20;                            /**< Number of timesteps */
+static const double DELTA_T = 0.1;                                      /**< Timestep in seconds */
+static const std::vector<double> START_POS = {1.4, 1.4, 0.5};           /**< Trajectory starting position */
+static const std::vector<double> END_POS = {-1.25, 1.0, -0.26};         /**< Trajectory ending posiiton */
+static const std::vector<double> BIAS_THRESHOLD = {0.050,0.050,0.050};  /**< Threshold to determine whether two trajectories are equal */
+static const std::vector<double> STD_DEV = {1.0, 1.0, 1.0};             /**< Standard deviation used for generating noisy parameters */
+static const int NUM_SEEDS = 20;                                        /**< Number of seeded solves per precision */
+static const int KERNEL_DIMENSIONS = 7;                                 /**< Dimensions of the kernel benchmark */
+static const int KERNEL_TIMESTEPS = 100;                                /**< Timesteps of the kernel benchmark */
+static const int KERNEL_REPETITIONS = 200;                              /**< Kernel evaluations per measurement */
+static const std::vector<int> KERNEL_ROLLOUTS = {20, 100, 500, 2000};   /**< Rollout counts of the kernel benchmark */
+static const char* PRECISION_NAMES[] = {"double", "float"};             /**< Printable names of the kernel precisions */
+
+/**
+ * @brief Measures the probability and update kernels for a number of rollouts
+ * @param precision     The kernel precision
+ * @param num_rollouts  The number of rollouts
+ * @param updates       The updates computed by the last evaluation [dimensions][timesteps]
+ * @return The average time of one evaluation in microseconds
+ */
+double benchmarkKernels(int precision,int num_rollouts,Eigen::MatrixXd& updates)
+{
+  using namespace stomp_core;
+
+  RolloutArraysPtr arrays = RolloutArrays::create(precision,KERNEL_DIMENSIONS);
+  arrays->resize(KERNEL_DIMENSIONS * KERNEL_TIMESTEPS,num_rollouts);
+
+  // the same pseudo random rollouts for both precisions
+  Eigen::MatrixXd control_costs(KERNEL_DIMENSIONS,KERNEL_TIMESTEPS);
+  Eigen::VectorXd state_costs(KERNEL_TIMESTEPS);
+  Eigen::MatrixXd noise(KERNEL_DIMENSIONS,KERNEL_TIMESTEPS);
+  for(int r = 0; r < num_rollouts; r++)
+  {
+    RandomStream stream(0,0,r);
+    for(int t = 0; t < KERNEL_TIMESTEPS; t++)
+    {
+      state_costs(t) = 10.0 * stream.uniform();
+      for(int d = 0; d < KERNEL_DIMENSIONS; d++)
+      {
+        control_costs(d,t) = stream.uniform();
+        noise(d,t) = stream.normal();
+      }
+    }
+    arrays->setRolloutCosts(r,control_costs,state_costs,1.0);
+    arrays->setRolloutNoise(r,noise);
+  }
+
+  updates.resize(KERNEL_DIMENSIONS,KERNEL_TIMESTEPS);
+  auto start = std::chrono::steady_clock::now();
+  for(int i = 0; i < KERNEL_REPETITIONS; i++)
+  {
+    arrays->computeProbabilities(num_rollouts,10.0);
+    arrays->computeUpdates(num_rollouts,updates);
+  }
+  std::chrono::duration<double,std::micro> elapsed = std::chrono::steady_clock::now() - start;
+
+  return elapsed.count() / KERNEL_REPETITIONS;
+}
+
+/**
+ * @brief Solves the example task with a series of seeds
+ * @param precision The kernel precision
+ * @param num_rollouts  The number of rollouts per iteration
+ * @param num_solved    The number of solutions within the expected thresholds
+ * @param max_error     The largest distance between a solution and the bias
+ * @return The average time of one solve in milliseconds
+ */
+double benchmarkSolve(int precision,int num_rollouts,int& num_solved,double& max_error)
+{
+  using namespace stomp_core;
+  using namespace stomp_core_examples;
+
+  Trajectory trajectory_bias(NUM_DIMENSIONS,NUM_TIMESTEPS);
+  for(auto d = 0u; d < NUM_DIMENSIONS; d++)
+  {
+    trajectory_bias.row(d) = Eigen::RowVectorXd::LinSpaced(NUM_TIMESTEPS,START_POS[d],END_POS[d]);
+  }
+
+  // moving the middle of the bias away from the initial linear interpolation
+  for(auto t = 0u; t < NUM_TIMESTEPS; t++)
+  {
+    trajectory_bias.col(t).array() += 0.2*std::sin(M_PI*t/(NUM_TIMESTEPS - 1));
+  }
+
+  StompConfiguration config;
+  config.num_timesteps = NUM_TIMESTEPS;
+  config.num_iterations = 200;
+  config.num_dimensions = NUM_DIMENSIONS;
+  config.delta_t = DELTA_T;
+  config.control_cost_weight = 0.0;
+  config.initialization_method = TrajectoryInitializations::LINEAR_INTERPOLATION;
+  config.num_iterations_after_valid = 5;
+  config.num_rollouts = num_rollouts;
+  config.max_rollouts = 2*num_rollouts;
+  config.kernel_precision = precision;
+
+  num_solved = 0;
+  max_error = 0.0;
+  std::chrono::duration<double,std::milli> elapsed(0);
+  for(int s = 0; s < NUM_SEEDS; s++)
+  {
+    config.random_seed = s;
+    TaskPtr task(new SimpleOptimizationTask(trajectory_bias,BIAS_THRESHOLD,STD_DEV));
+    Stomp stomp(config,task);
+
+    Trajectory optimized;
+    auto start = std::chrono::steady_clock::now();
+    bool solved = stomp.solve(START_POS,END_POS,optimized);
+    elapsed += std::chrono::steady_clock::now() - start;
+
+    double error = (optimized - trajectory_bias).cwiseAbs().maxCoeff();
+    max_error = std::max(max_error,error);
+    num_solved += (solved && error <= BIAS_THRESHOLD.front()) ? 1 : 0;
+  }
+
+  return elapsed.count() / NUM_SEEDS;
+}
+
+int main(int argc,char** argv)
+{
+  using namespace stomp_core;
+
+  std::cout<<std::fixed<<std::setprecision(3);
+  std::cout<<"Kernels ("<<KERNEL_DIMENSIONS<<" dimensions x "<<KERNEL_TIMESTEPS<<" timesteps)"<<std::endl;
+  std::cout<<"rollouts  double[us]  float[us]  speedup  max update difference"<<std::endl;
+  for(int num_rollouts : KERNEL_ROLLOUTS)
+  {
+    Eigen::MatrixXd double_updates, float_updates;
+    double double_time = benchmarkKernels(KernelPrecisions::DOUBLE,num_rollouts,double_updates);
+    double float_time = benchmarkKernels(KernelPrecisions::FLOAT,num_rollouts,float_updates);
+    std::cout<<std::setw(8)<<num_rollouts<<std::setw(12)<<double_time<<std::setw(11)<<float_time
+        <<std::setw(9)<<double_time/float_time<<"  "<<std::scientific
+        <<(double_updates - float_updates).cwiseAbs().maxCoeff()<<std::fixed<<std::endl;
+  }
+
+  std::cout<<std::endl<<"Solves ("<<NUM_SEEDS<<" seeds)"<<std::endl;
+  std::cout<<"rollouts  precision  solved  max error  time[ms]"<<std::endl;
+  for(int num_rollouts : {10, 20, 50})
+  {
+    for(int precision : {KernelPrecisions::DOUBLE, KernelPrecisions::FLOAT})
+    {
+      int num_solved;
+      double max_error;
+      double time = benchmarkSolve(precision,num_rollouts,num_solved,max_error);
+      std::cout<<std::setw(8)<<num_rollouts<<std::setw(11)<<PRECISION_NAMES[precision]<<std::setw(8)<<num_solved
+          <<std::setw(11)<<max_error<<std::setw(10)<<time<<std::endl;
+    }
+  }
+
+  return 0;
+}
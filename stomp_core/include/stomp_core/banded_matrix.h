@@ -0,0 +1,203 @@
+/**
+ * @file banded_matrix.h
+ * @brief This defines a symmetric banded matrix used to store the stomp control cost matrices
+ *
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_BANDED_MATRIX_H_
+#define INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_BANDED_MATRIX_H_
+
+#include <algorithm>
+#include <Eigen/Core>
+
+namespace stomp_core
+{
+
+/**
+ * @brief A symmetric matrix whose non-zero entries lie within 'bandwidth' diagonals of the main diagonal.
+ *
+ * Only the lower band is stored, so memory and the cost of products grow linearly with the matrix size.  The matrix
+ * can be factorized in place (LDL^T) in order to solve linear systems and recover the diagonal of its inverse without
+ * ever forming a dense inverse.
+ */
+class SymmetricBandedMatrix
+{
+public:
+
+  SymmetricBandedMatrix();
+
+  /**
+   * @brief Creates a zero matrix
+   * @param size      The number of rows and columns
+   * @param bandwidth The number of sub-diagonals that may hold non-zero entries
+   */
+  SymmetricBandedMatrix(int size,int bandwidth);
+
+  /**
+   * @brief Resizes and zeros the matrix, any previous factorization is discarded.
+   * @param size      The number of rows and columns
+   * @param bandwidth The number of sub-diagonals that may hold non-zero entries
+   */
+  void resize(int size,int bandwidth);
+
+  /** @brief The number of rows and columns */
+  int size() const
+  {
+    return size_;
+  }
+
+  /** @brief The number of sub-diagonals that may hold non-zero entries */
+  int bandwidth() const
+  {
+    return bandwidth_;
+  }
+
+  /**
+   * @brief Returns the entry at (row,col), zero when it lies outside of the band.
+   * @param row The row index
+   * @param col The column index
+   * @return The matrix entry
+   */
+  double coeff(int row,int col) const;
+
+  /**
+   * @brief Returns a reference to the entry at (row,col) and its symmetric counterpart.
+   * @param row The row index, must be within 'bandwidth' of col
+   * @param col The column index
+   * @return A reference to the matrix entry
+   */
+  double& coeffRef(int row,int col);
+
+  /**
+   * @brief Extracts a square block centered on the main diagonal.
+   * @param start The first row and column of the block
+   * @param size  The number of rows and columns of the block
+   * @return The block as a banded matrix with the same bandwidth.
+   */
+  SymmetricBandedMatrix block(int start,int size) const;
+
+  /**
+   * @brief Multiplies all the entries by a scalar, the factorization is preserved and scaled accordingly.
+   * @param s The scale factor
+   */
+  void scale(double s);
+
+  /**
+   * @brief Computes x^T * M * x
+   * @param x A row vector of size size(), usually a row of the parameters matrix
+   * @return The value of the quadratic form.
+   */
+  double quadraticForm(const Eigen::Ref<const Eigen::RowVectorXd,0,Eigen::InnerStride<> >& x) const;
+
+  /**
+   * @brief Computes x.row(d) * M * x.row(d)^T for every row of x in a single pass over its columns.  Use the number of
+   * rows as the template argument when it is known at compile time so that the accumulators stay in registers, the
+   * Eigen::Dynamic version accumulates directly into the output.
+   * @param x     A matrix [rows][size()], usually the parameters matrix
+   * @param forms The value of the quadratic form of each row, must already have x.rows() entries.
+   */
+  template <int Rows>
+  void quadraticForms(const Eigen::MatrixXd& x,Eigen::Ref<Eigen::VectorXd> forms) const
+  {
+    accumulateQuadraticForms(Eigen::Map<const Eigen::Matrix<double,Rows,Eigen::Dynamic> >(x.data(),x.rows(),x.cols()),
+                             forms);
+  }
+
+  /**
+   * @brief Computes the LDL^T factorization in place.
+   * @return False if the matrix is not positive definite, otherwise true.
+   */
+  bool factorize();
+
+  /** @brief Whether factorize() has succeeded since the last modification */
+  bool isFactorized() const
+  {
+    return factorized_;
+  }
+
+  /**
+   * @brief Solves M * x = b using the factorization.
+   * @param x On input the right hand side 'b', on output the solution 'x'.
+   */
+  void solveInPlace(Eigen::Ref<Eigen::VectorXd> x) const;
+
+  /**
+   * @brief Computes the diagonal of the inverse matrix using the factorization. For a symmetric positive definite
+   * matrix this also contains the largest entry of the inverse.
+   * @param diagonal The diagonal of the inverse matrix
+   */
+  void inverseDiagonal(Eigen::VectorXd& diagonal) const;
+
+  /**
+   * @brief Creates the dense representation of this matrix
+   * @return The dense matrix
+   */
+  Eigen::MatrixXd toDense() const;
+
+protected:
+
+  template <int Rows>
+  void accumulateQuadraticForms(const Eigen::Map<const Eigen::Matrix<double,Rows,Eigen::Dynamic> >& x,
+                                Eigen::Ref<Eigen::VectorXd> forms) const
+  {
+    Eigen::Matrix<double,Rows,1> accumulator = Eigen::Matrix<double,Rows,1>::Zero();
+    addQuadraticTerms(x,accumulator);
+    forms = accumulator;
+  }
+
+  void accumulateQuadraticForms(const Eigen::Map<const Eigen::MatrixXd>& x,Eigen::Ref<Eigen::VectorXd> forms) const
+  {
+    forms.setZero();
+    addQuadraticTerms(x,forms);
+  }
+
+  /**
+   * @brief Adds the terms of the quadratic forms of every row of x, one column at a time.
+   * @param x           A matrix [rows][size()]
+   * @param accumulator The sums [rows]
+   */
+  template <typename Columns,typename Accumulator>
+  void addQuadraticTerms(const Columns& x,Accumulator& accumulator) const
+  {
+    for(int j = 0; j < size_; j++)
+    {
+      accumulator += bands_(0,j) * x.col(j).cwiseAbs2();
+
+      int last = std::min(bandwidth_,size_ - 1 - j);
+      for(int k = 1; k <= last; k++)
+      {
+        accumulator += (2 * bands_(k,j)) * x.col(j + k).cwiseProduct(x.col(j));
+      }
+    }
+  }
+
+protected:
+
+  int size_;                    /**< @brief The number of rows and columns */
+  int bandwidth_;               /**< @brief The number of stored sub-diagonals */
+  Eigen::MatrixXd bands_;       /**< @brief A matrix [bandwidth + 1][size] where bands_(k,j) = M(j + k,j) */
+  Eigen::MatrixXd factor_L_;    /**< @brief The unit lower triangular factor stored with the same layout as bands_ */
+  Eigen::VectorXd factor_D_;    /**< @brief The diagonal factor */
+  bool factorized_;             /**< @brief Whether the factors are up to date */
+};
+
+} /* namespace stomp_core */
+
+#endif /* INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_BANDED_MATRIX_H_ */
@@ -0,0 +1,153 @@
+/**
+ * @file matrix_cache.h
+ * @brief This defines a process wide cache of the constant matrices used by stomp
+ *
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_MATRIX_CACHE_H_
+#define INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_MATRIX_CACHE_H_
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <Eigen/Core>
+#include "stomp_core/banded_matrix.h"
+#include "stomp_core/utils.h"
+
+namespace stomp_core
+{
+
+/**
+ * @brief The control cost matrices used by Stomp, both scaled such that max(R^-1) == 1.
+ */
+struct ControlCostMatrices
+{
+  SymmetricBandedMatrix R_padded;   /**< @brief The control cost matrix [timesteps + 2*(FINITE_DIFF_RULE_LENGTH - 1)] */
+  SymmetricBandedMatrix R;          /**< @brief The factorized control cost matrix [timesteps][timesteps] */
+};
+
+/**
+ * @brief The covariance used to sample smooth noise, (A^T * A)^-1 where A is the unpadded five point acceleration
+ * stencil, scaled such that its largest entry is 1.
+ */
+struct SamplingCovariance
+{
+  Eigen::MatrixXd covariance;       /**< @brief The covariance matrix [timesteps][timesteps] */
+  Eigen::MatrixXd cholesky;         /**< @brief The lower triangular Cholesky factor L of the covariance (LL^T) */
+};
+
+typedef std::shared_ptr<const Eigen::MatrixXd> MatrixConstPtr;                            /**< @brief Immutable cached matrix */
+typedef std::shared_ptr<const ControlCostMatrices> ControlCostMatricesConstPtr;          /**< @brief Immutable cached control costs */
+typedef std::shared_ptr<const SamplingCovariance> SamplingCovarianceConstPtr;            /**< @brief Immutable cached covariance */
+
+/**
+ * @brief A process wide cache of the matrices that only depend on the number of timesteps, the timestep and the
+ * derivative order.
+ *
+ * All the methods are thread safe.  The entries are immutable and handed out as shared pointers, so they remain valid
+ * after being evicted from the cache.  Each get method builds the entry on the first request and returns the same
+ * instance on every subsequent request with the same arguments.
+ */
+class MatrixCache
+{
+public:
+
+  /**
+   * @brief The shared instance
+   * @return A reference to the process wide cache
+   */
+  static MatrixCache& instance();
+
+  /**
+   * @brief Gets the finite difference matrix, see generateFiniteDifferenceMatrix(...)
+   * @param num_timesteps The number of timesteps
+   * @param order         The differentiation order
+   * @param dt            The timestep in seconds
+   * @return The finite difference matrix [timesteps][timesteps]
+   */
+  MatrixConstPtr getFiniteDifferenceMatrix(int num_timesteps,DerivativeOrders::DerivativeOrder order,double dt);
+
+  /**
+   * @brief Gets the padded and the factorized control cost matrices used by Stomp
+   * @param num_timesteps The number of unpadded timesteps
+   * @param dt            The timestep in seconds
+   * @return The control cost matrices, nullptr when the control cost matrix could not be factorized.
+   */
+  ControlCostMatricesConstPtr getControlCostMatrices(int num_timesteps,double dt);
+
+  /**
+   * @brief Gets the smoothing matrix M, see generateSmoothingMatrix(...)
+   * @param num_timesteps The number of timesteps
+   * @param dt            The timestep in seconds
+   * @return The smoothing matrix [timesteps][timesteps]
+   */
+  MatrixConstPtr getSmoothingMatrix(int num_timesteps,double dt);
+
+  /**
+   * @brief Gets the covariance used by the multivariate gaussian noise generators along with its Cholesky factor
+   * @param num_timesteps The number of timesteps
+   * @return The sampling covariance
+   */
+  SamplingCovarianceConstPtr getSamplingCovariance(int num_timesteps);
+
+  /**
+   * @brief Removes all the entries, pointers previously returned remain valid.
+   */
+  void clear();
+
+  /**
+   * @brief The number of cached entries
+   * @return The number of entries.
+   */
+  std::size_t size() const;
+
+protected:
+
+  /** @brief The cache key: number of timesteps, derivative order and timestep */
+  typedef std::tuple<int,int,double> Key;
+
+  MatrixCache();
+  MatrixCache(const MatrixCache&) = delete;
+  MatrixCache& operator=(const MatrixCache&) = delete;
+
+  /**
+   * @brief Looks up an entry and builds it if missing.  The lock is released while building so that lookups of other
+   * entries are not blocked, if two threads build the same entry the first one inserted is kept.
+   * @param entries The map of entries of the requested type
+   * @param key     The key of the requested entry
+   * @param build   Builds the entry, may return nullptr on failure in which case nothing is cached.
+   * @return The cached entry
+   */
+  template <typename T,typename Builder>
+  std::shared_ptr<const T> getOrBuild(std::map<Key,std::shared_ptr<const T> >& entries,const Key& key,Builder build);
+
+protected:
+
+  mutable std::mutex mutex_;                                                  /**< @brief Protects the maps */
+  std::map<Key,MatrixConstPtr> finite_difference_matrices_;                  /**< @brief Finite difference matrices */
+  std::map<Key,ControlCostMatricesConstPtr> control_cost_matrices_;          /**< @brief Control cost matrices */
+  std::map<Key,MatrixConstPtr> smoothing_matrices_;                          /**< @brief Smoothing matrices */
+  std::map<Key,SamplingCovarianceConstPtr> sampling_covariances_;            /**< @brief Noise sampling covariances */
+};
+
+} /* namespace stomp_core */
+
+#endif /* INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_MATRIX_CACHE_H_ */
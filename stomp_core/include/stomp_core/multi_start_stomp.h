@@ -0,0 +1,172 @@
+/**
+ * @file multi_start_stomp.h
+ * @brief This defines a multi-start solver that runs several stomp optimizations concurrently
+ *
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_MULTI_START_STOMP_H_
+#define INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_MULTI_START_STOMP_H_
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "stomp_core/stomp.h"
+#include "stomp_core/thread_pool.h"
+
+namespace stomp_core
+{
+
+namespace MultiStartPolicies
+{
+/** @brief Available policies for selecting the result of a multi-start solve */
+enum MultiStartPolicy
+{
+  FIRST_VALID = 1,  /**< Return the first valid solution and cancel the remaining starts */
+  LOWEST_COST       /**< Wait for all the starts and return the valid solution with the lowest cost */
+};
+}
+
+/**
+ * @brief Runs several independent Stomp optimizations from different initial trajectories concurrently.
+ *
+ * Each start owns a Stomp instance and a Task, the tasks must not share state since the starts run on separate
+ * threads.  The starts run serially on their own thread regardless of the configured 'num_threads', the
+ * concurrency comes from running the starts on the thread pool instead.
+ */
+class MultiStartStomp
+{
+public:
+
+  /**
+   * @brief Constructor
+   * @param config      The configuration used by every start
+   * @param tasks       One task per start
+   * @param thread_pool The pool on which the starts run, it may be shared but its jobs must not call parallelFor on it.
+   *                    When null a pool with one worker per start is created.
+   */
+  MultiStartStomp(const StompConfiguration& config,const std::vector<TaskPtr>& tasks,
+                  ThreadPoolPtr thread_pool = nullptr);
+
+  /**
+   * @brief Finds a solution between a start and end state.  The starts cycle through the available trajectory
+   * initializations, once those are exhausted the remaining starts use randomly perturbed linear interpolations.
+   * @param first                 Start state for the task
+   * @param last                  Final state for the task
+   * @param parameters_optimized  Selected solution [parameters][timesteps]
+   * @return True if a valid solution was found, otherwise false.
+   */
+  bool solve(const std::vector<double>& first,const std::vector<double>& last,
+             Eigen::MatrixXd& parameters_optimized);
+
+  /**
+   * @brief Finds a solution from user supplied seeds.  Start 'k' uses seed 'k' and, if there are fewer seeds than
+   * starts, the remaining starts use randomly perturbed copies of the seeds.
+   * @param initial_parameters    The seeds, each a matrix [parameters][timesteps]
+   * @param parameters_optimized  Selected solution [parameters][timesteps]
+   * @return True if a valid solution was found, otherwise false.
+   */
+  bool solve(const std::vector<Eigen::MatrixXd>& initial_parameters,
+             Eigen::MatrixXd& parameters_optimized);
+
+  /**
+   * @brief Sets the configuration of all the starts
+   * @param config Stomp Configuration struct
+   */
+  void setConfig(const StompConfiguration& config);
+
+  /**
+   * @brief Sets how the result is selected, FIRST_VALID by default.
+   * @param policy The selection policy
+   */
+  void setPolicy(MultiStartPolicies::MultiStartPolicy policy);
+
+  /**
+   * @brief Sets the amplitude of the random perturbations applied to the seeds of the extra starts.
+   * @param amplitude The standard deviation of the perturbation at the middle of the trajectory.
+   */
+  void setSeedPerturbation(double amplitude);
+
+  /**
+   * @brief Sets a wall clock deadline on all the starts. (Thread-Safe)
+   * @param deadline The time at which the optimization must stop
+   */
+  void setDeadline(const std::chrono::steady_clock::time_point& deadline);
+
+  /**
+   * @brief Removes the deadline. (Thread-Safe)
+   */
+  void clearDeadline();
+
+  /**
+   * @brief Cancel all the starts in progress. (Thread-Safe)
+   * @return True if sucessful, otherwise false.
+   */
+  bool cancel();
+
+  /**
+   * @brief The number of starts
+   * @return The number of starts
+   */
+  int getNumStarts() const;
+
+  /**
+   * @brief The start that produced the result of the last solve
+   * @return The start index or -1 if no valid solution was found.
+   */
+  int getSelectedStart() const;
+
+protected:
+
+  /**
+   * @brief Solves a single start given its index and Stomp instance, returns true if the solution is valid.
+   */
+  typedef std::function<bool (int start,Stomp& stomp,Eigen::MatrixXd& parameters)> StartFunction;
+
+  /**
+   * @brief Runs all the starts on the thread pool and selects the result.
+   * @param start_function        Solves a single start
+   * @param parameters_optimized  The selected solution
+   * @return True if a valid solution was found, otherwise false.
+   */
+  bool runStarts(const StartFunction& start_function,Eigen::MatrixXd& parameters_optimized);
+
+  /**
+   * @brief Adds a smooth random perturbation that leaves the first and last timesteps unchanged.
+   * @param start       The start index, used along with the master seed to seed the random stream
+   * @param parameters  The trajectory to perturb [parameters][timesteps]
+   */
+  void perturb(int start,Eigen::MatrixXd& parameters) const;
+
+protected:
+
+  StompConfiguration config_;                          /**< @brief The configuration of every start */
+  std::vector<std::shared_ptr<Stomp> > stomps_;        /**< @brief One Stomp instance per start */
+  ThreadPoolPtr thread_pool_;                          /**< @brief Runs the starts */
+  MultiStartPolicies::MultiStartPolicy policy_;        /**< @brief How the result is selected */
+  double seed_perturbation_;                           /**< @brief Amplitude of the perturbation applied to the extra seeds */
+  std::atomic<bool> proceed_;                          /**< @brief Cleared once the result is known or on cancellation */
+  std::atomic<int> selected_start_;                    /**< @brief The start that produced the result, -1 if none */
+};
+
+} /* namespace stomp_core */
+
+#endif /* INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_MULTI_START_STOMP_H_ */
@@ -0,0 +1,174 @@
+/**
+ * @file profiler.h
+ * @brief This defines the timers and call counters used to profile the phases of a solve
+ *
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_PROFILER_H_
+#define INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_PROFILER_H_
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace stomp_core
+{
+
+/** @brief The accumulated time and number of calls of a profiled section */
+struct ProfileEntry
+{
+  std::string name;               /**< @brief The name of the section */
+  unsigned long calls = 0;        /**< @brief The number of times the section ran */
+  double total_time = 0.0;        /**< @brief The accumulated time in seconds */
+};
+
+/** @brief A snapshot of the profiled sections */
+struct ProfileReport
+{
+  std::vector<ProfileEntry> entries;    /**< @brief The profiled sections */
+
+  /**
+   * @brief Finds an entry by name
+   * @param name  The section name
+   * @return A pointer to the entry or null if it does not exist
+   */
+  const ProfileEntry* find(const std::string& name) const;
+
+  /**
+   * @brief The header of the csv line, two columns '<name>.calls,<name>.time' per entry
+   * @return The comma separated column names
+   */
+  std::string toCsvHeader() const;
+
+  /**
+   * @brief Formats the entries as a single csv line matching toCsvHeader()
+   * @return The comma separated values, times are in seconds
+   */
+  std::string toCsv() const;
+
+  /**
+   * @brief Formats the entries as a single line json object {"<name>":{"calls":<calls>,"time":<seconds>},...}
+   * @return The json string
+   */
+  std::string toJson() const;
+};
+
+/**
+ * @brief Accumulates steady clock time and call counts for a fixed set of named sections.
+ *
+ * The sections are registered up front with addCounter(), afterwards record() is lock free and allocation free so it
+ * can be called concurrently from the rollout threads.
+ */
+class Profiler
+{
+public:
+
+  typedef std::chrono::steady_clock Clock;
+
+  /**
+   * @brief Measures the lifetime of the object and records it into a counter when it goes out of scope.
+   */
+  class ScopedTimer
+  {
+  public:
+    /**
+     * @brief Starts the timer
+     * @param profiler  The profiler to record into
+     * @param counter   The counter index returned by Profiler::addCounter()
+     */
+    ScopedTimer(Profiler& profiler,int counter):
+      profiler_(profiler),
+      counter_(counter),
+      start_(Clock::now())
+    {
+
+    }
+
+    ~ScopedTimer()
+    {
+      profiler_.record(counter_,Clock::now() - start_);
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+  protected:
+    Profiler& profiler_;
+    int counter_;
+    Clock::time_point start_;
+  };
+
+  /**
+   * @brief Registers a section, this is not thread safe and should happen before any call to record().
+   * @param name  The section name
+   * @return The counter index
+   */
+  int addCounter(const std::string& name);
+
+  /**
+   * @brief The number of registered sections
+   * @return The number of counters
+   */
+  int size() const;
+
+  /**
+   * @brief Adds a call to a section (Thread-Safe)
+   * @param counter The counter index
+   * @param elapsed The duration of the call
+   */
+  void record(int counter,Clock::duration elapsed);
+
+  /**
+   * @brief Zeros the time and the calls of every section
+   */
+  void reset();
+
+  /**
+   * @brief Appends an entry for each section to the report
+   * @param report  The report
+   */
+  void getReport(ProfileReport& report) const;
+
+protected:
+
+  /** @brief The counters of a section */
+  struct Counter
+  {
+    explicit Counter(const std::string& name):
+      name(name),
+      total_time(0),
+      calls(0)
+    {
+
+    }
+
+    std::string name;                           /**< @brief The section name */
+    std::atomic<Clock::rep> total_time;         /**< @brief The accumulated time in clock ticks */
+    std::atomic<unsigned long> calls;           /**< @brief The number of calls */
+  };
+
+  std::deque<Counter> counters_;                /**< @brief The sections, a deque since the counters cannot be moved */
+};
+
+} /* namespace stomp_core */
+
+#endif /* INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_PROFILER_H_ */
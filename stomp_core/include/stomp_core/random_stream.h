@@ -0,0 +1,99 @@
+/**
+ * @file random_stream.h
+ * @brief This defines a seedable random number stream that is reproducible for every (iteration, rollout) pair
+ *
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_RANDOM_STREAM_H_
+#define INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_RANDOM_STREAM_H_
+
+#include <cstdint>
+
+namespace stomp_core
+{
+
+/**
+ * @brief A counter based random number generator whose sequence only depends on a seed, an iteration and a rollout number.
+ *
+ * Creating a stream for each rollout instead of sharing a generator makes the noise independent of the order in which
+ * the rollouts are processed, so a serial and a parallel solve with the same seed produce identical trajectories.  The
+ * stream is a splitmix64 generator, it holds no heap memory and is cheap to construct.  It satisfies the standard
+ * UniformRandomBitGenerator requirements so it can be used with the std and boost distributions.
+ */
+class RandomStream
+{
+public:
+
+  typedef std::uint64_t result_type;
+
+  /**
+   * @brief Constructor
+   * @param seed      The master seed, see StompConfiguration::random_seed
+   * @param iteration The iteration number
+   * @param rollout   The rollout number
+   */
+  explicit RandomStream(std::uint64_t seed = 0,std::uint64_t iteration = 0,std::uint64_t rollout = 0);
+
+  /**
+   * @brief Restarts the stream at the beginning of the sequence of the (seed, iteration, rollout) triplet.
+   * @param seed      The master seed
+   * @param iteration The iteration number
+   * @param rollout   The rollout number
+   */
+  void reset(std::uint64_t seed,std::uint64_t iteration = 0,std::uint64_t rollout = 0);
+
+  static constexpr result_type min()
+  {
+    return 0;
+  }
+
+  static constexpr result_type max()
+  {
+    return ~result_type(0);
+  }
+
+  /**
+   * @brief Draws the next 64 bit number of the sequence
+   * @return A uniformly distributed integer
+   */
+  result_type operator()();
+
+  /**
+   * @brief Draws a uniformly distributed number
+   * @return A number in [0,1)
+   */
+  double uniform();
+
+  /**
+   * @brief Draws a normally distributed number
+   * @return A sample from the standard normal distribution
+   */
+  double normal();
+
+protected:
+
+  std::uint64_t state_;         /**< @brief The generator state */
+  bool has_spare_normal_;       /**< @brief True when the second sample of the last normal pair has not been used */
+  double spare_normal_;         /**< @brief The second sample of the last normal pair */
+};
+
+} /* namespace stomp_core */
+
+#endif /* INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_RANDOM_STREAM_H_ */
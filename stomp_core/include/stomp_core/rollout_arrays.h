@@ -0,0 +1,111 @@
+/**
+ * @file rollout_arrays.h
+ * @brief This defines the rollout arrays used to compute the probabilities and the parameter updates in single or double precision
+ *
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_ROLLOUT_ARRAYS_H_
+#define INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_ROLLOUT_ARRAYS_H_
+
+#include <memory>
+#include <Eigen/Core>
+#include <stomp_core/utils.h>
+
+namespace stomp_core
+{
+
+class RolloutArrays;
+typedef std::shared_ptr<RolloutArrays> RolloutArraysPtr; /**< Defines a shared ptr for type RolloutArrays */
+
+/**
+ * @brief Holds the noise and the costs of the rollouts in arrays [dimensions x timesteps][max_rollouts] and runs the
+ * probability and update kernels over them.
+ *
+ * Column 'r' holds the column-major [dimensions][timesteps] data of rollout 'r', so entry (d,t) is found at row
+ * d + t*dimensions and each kernel is a single array expression over contiguous memory.  The arrays are stored with the
+ * precision selected by StompConfiguration::kernel_precision while the rollouts and the Task interface remain in double
+ * precision, the values are converted when they are copied in and out.  All the methods are allocation free once
+ * resize() has been called.  The total costs are gathered with fixed size columns when the number of dimensions
+ * is 6 or 7.
+ */
+class RolloutArrays
+{
+public:
+
+  /**
+   * @brief Creates the arrays for the requested precision
+   * @param precision       See KernelPrecisions::KernelPrecision
+   * @param num_dimensions  The number of dimensions, 6 and 7 use a specialized implementation.
+   * @return The arrays or null if the precision is not supported.
+   */
+  static RolloutArraysPtr create(int precision,int num_dimensions);
+
+  virtual ~RolloutArrays(){}
+
+  /**
+   * @brief Allocates the arrays
+   * @param num_entries   The number of dimensions times the number of timesteps
+   * @param max_rollouts  The maximum number of rollouts
+   */
+  virtual void resize(int num_entries,int max_rollouts) = 0;
+
+  /**
+   * @brief Stores the total cost (state + control) of a rollout at every dimension and timestep.
+   * @param rollout_index     The column of the rollout
+   * @param control_costs     The control costs [dimensions][timesteps]
+   * @param state_costs       The state costs [timesteps]
+   * @param importance_weight The importance sampling weight of the rollout
+   */
+  virtual void setRolloutCosts(int rollout_index,const Eigen::MatrixXd& control_costs,const Eigen::VectorXd& state_costs,
+                               double importance_weight) = 0;
+
+  /**
+   * @brief Stores the noise of a rollout
+   * @param rollout_index The column of the rollout
+   * @param noise         The noise [dimensions][timesteps]
+   */
+  virtual void setRolloutNoise(int rollout_index,const Eigen::MatrixXd& noise) = 0;
+
+  /**
+   * @brief Computes the probability of each rollout at every dimension and timestep from the exponentiated costs.
+   * @param num_rollouts  The number of rollouts, starting at the first column
+   * @param sensitivity   The exponentiated cost sensitivity
+   */
+  virtual void computeProbabilities(int num_rollouts,double sensitivity) = 0;
+
+  /**
+   * @brief Computes the updates as the probability weighted sum of the rollouts noise.
+   * @param num_rollouts  The number of rollouts, starting at the first column
+   * @param updates       The updates [dimensions][timesteps], must already have the right size.
+   */
+  virtual void computeUpdates(int num_rollouts,Eigen::MatrixXd& updates) const = 0;
+
+  /**
+   * @brief The probability of a rollout at an entry
+   * @param entry         The entry index d + t*dimensions
+   * @param rollout_index The column of the rollout
+   * @return The probability
+   */
+  virtual double getProbability(int entry,int rollout_index) const = 0;
+};
+
+} /* namespace stomp_core */
+
+#endif /* INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_ROLLOUT_ARRAYS_H_ */
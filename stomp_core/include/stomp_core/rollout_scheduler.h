@@ -0,0 +1,99 @@
+/**
+ * @file rollout_scheduler.h
+ * @brief This defines the scheduler that adapts the number of rollouts and the noise magnitude during the optimization
+ *
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_ROLLOUT_SCHEDULER_H_
+#define INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_ROLLOUT_SCHEDULER_H_
+
+#include "stomp_core/utils.h"
+
+namespace stomp_core
+{
+
+/**
+ * @brief Adapts the number of new rollouts per iteration and the noise scale from the progress of the optimization.
+ *
+ * The number of rollouts starts at StompConfiguration::num_rollouts.  It shrinks towards StompConfiguration::min_rollouts
+ * while the iterations keep lowering the cost and the rollout costs agree with each other.  It grows back when an
+ * iteration fails to lower the cost.  The noise scale starts at 1.  It decays by StompConfiguration::noise_decay every
+ * time the relative cost improvement falls below StompConfiguration::noise_decay_improvement, and it recovers when an
+ * iteration fails to lower the cost.
+ */
+class RolloutScheduler
+{
+public:
+
+  RolloutScheduler();
+
+  /**
+   * @brief Sets the bounds and the rates from the configuration and resets the schedule.
+   * @param config The Stomp configuration
+   */
+  void configure(const StompConfiguration& config);
+
+  /**
+   * @brief Restarts the schedule from the maximum number of rollouts and a unit noise scale.
+   */
+  void reset();
+
+  /**
+   * @brief Computes the schedule of the next iteration.
+   * @param previous_cost         The lowest cost before the iteration
+   * @param cost                  The lowest cost after the iteration
+   * @param rollouts_cost_mean    The mean of the total costs of the new rollouts
+   * @param rollouts_cost_stddev  The standard deviation of the total costs of the new rollouts
+   */
+  void update(double previous_cost,double cost,double rollouts_cost_mean,double rollouts_cost_stddev);
+
+  /**
+   * @brief The number of new rollouts to generate in the next iteration.
+   * @return The number of rollouts
+   */
+  int getNumRollouts() const
+  {
+    return num_rollouts_;
+  }
+
+  /**
+   * @brief The factor to apply to the noise magnitude in the next iteration.
+   * @return The noise scale in [min_noise_scale, 1]
+   */
+  double getNoiseScale() const
+  {
+    return noise_scale_;
+  }
+
+protected:
+
+  int min_rollouts_;                /**< @brief The lower bound of the number of rollouts */
+  int max_rollouts_;                /**< @brief The upper bound of the number of rollouts */
+  double noise_decay_;              /**< @brief The factor applied to the noise scale while the cost converges */
+  double noise_decay_improvement_;  /**< @brief The relative cost improvement below which the cost is considered to be converging */
+  double min_noise_scale_;          /**< @brief The lower bound of the noise scale */
+
+  int num_rollouts_;                /**< @brief The current number of rollouts */
+  double noise_scale_;              /**< @brief The current noise scale */
+};
+
+} /* namespace stomp_core */
+
+#endif /* INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_ROLLOUT_SCHEDULER_H_ */
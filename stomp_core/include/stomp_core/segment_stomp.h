@@ -0,0 +1,263 @@
+/**
+ * @file segment_stomp.h
+ * @brief This defines a solver that optimizes overlapping segments of a long trajectory concurrently
+ *
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_SEGMENT_STOMP_H_
+#define INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_SEGMENT_STOMP_H_
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include "stomp_core/stomp.h"
+#include "stomp_core/thread_pool.h"
+
+namespace stomp_core
+{
+
+class SegmentTask;
+typedef std::shared_ptr<SegmentTask> SegmentTaskPtr; /**< Defines a shared ptr for type SegmentTask */
+
+/**
+ * @brief Presents a segment of a trajectory to Stomp as a complete trajectory while the wrapped task keeps seeing the
+ * whole trajectory.
+ *
+ * The parameters passed by Stomp are written into the segment of a copy of the whole trajectory before being passed
+ * to the wrapped task, the timesteps outside of the segment keep the values given to setSegment().  The first and last
+ * timesteps of the segment are its boundary conditions, the noise and the updates are zeroed there.  The costs of the
+ * noisy parameters are requested through Task::computeChangedNoisyCosts() with the timesteps that differ from the last
+ * optimized parameters so that tasks which evaluate incrementally only evaluate the segment.  The validity reported
+ * covers the whole trajectory.
+ */
+class SegmentTask: public Task
+{
+public:
+
+  /**
+   * @brief Constructor
+   * @param task  The wrapped task, set up for the whole trajectory
+   */
+  explicit SegmentTask(TaskPtr task);
+
+  /**
+   * @brief Sets the segment presented to Stomp
+   * @param parameters      The whole trajectory [dimensions][timesteps]
+   * @param start_timestep  The first timestep of the segment
+   * @param num_timesteps   The number of timesteps in the segment
+   */
+  void setSegment(const Eigen::MatrixXd& parameters,int start_timestep,int num_timesteps);
+
+  /**
+   * @brief The wrapped task
+   * @return The wrapped task
+   */
+  TaskPtr getTask() const;
+
+  void setNoiseScale(double scale) override;
+
+  void setRandomSeed(std::uint64_t seed) override;
+
+  void setNoiseCovariance(const Eigen::MatrixXd& covariance) override;
+
+  bool generateNoisyParameters(const Eigen::MatrixXd& parameters,
+                               std::size_t start_timestep,
+                               std::size_t num_timesteps,
+                               int iteration_number,
+                               int rollout_number,
+                               Eigen::MatrixXd& parameters_noise,
+                               Eigen::MatrixXd& noise) override;
+
+  bool computeNoisyCosts(const Eigen::MatrixXd& parameters,
+                         std::size_t start_timestep,
+                         std::size_t num_timesteps,
+                         int iteration_number,
+                         int rollout_number,
+                         Eigen::VectorXd& costs,
+                         bool& validity) override;
+
+  bool computeCosts(const Eigen::MatrixXd& parameters,
+                    std::size_t start_timestep,
+                    std::size_t num_timesteps,
+                    int iteration_number,
+                    Eigen::VectorXd& costs,
+                    bool& validity) override;
+
+  bool filterNoisyParameters(std::size_t start_timestep,
+                             std::size_t num_timesteps,
+                             int iteration_number,
+                             int rollout_number,
+                             Eigen::MatrixXd& parameters,
+                             bool& filtered) override;
+
+  bool filterParameterUpdates(std::size_t start_timestep,
+                              std::size_t num_timesteps,
+                              int iteration_number,
+                              const Eigen::MatrixXd& parameters,
+                              Eigen::MatrixXd& updates) override;
+
+protected:
+
+  /**
+   * @brief Computes the costs of the whole trajectory held in parameters_, incrementally when the costs of the last
+   * optimized parameters are available.
+   * @param iteration_number  The current iteration count in the optimization loop
+   * @param rollout_number    The index of the noisy trajectory, -1 for the optimized parameters
+   * @param validity          Whether or not the whole trajectory is valid
+   * @return True if succeeded, otherwise false.
+   */
+  bool computeTrajectoryCosts(int iteration_number,int rollout_number,bool& validity);
+
+protected:
+
+  TaskPtr task_;                          /**< @brief The wrapped task */
+  int start_timestep_;                    /**< @brief The first timestep of the segment */
+  int num_timesteps_;                     /**< @brief The number of timesteps in the segment */
+  Eigen::MatrixXd parameters_;            /**< @brief The whole trajectory holding the parameters being evaluated */
+  Eigen::MatrixXd scratch_;               /**< @brief The whole trajectory passed to the filters and the noise generation */
+  Eigen::MatrixXd noise_;                 /**< @brief The noise of the whole trajectory */
+  Eigen::VectorXd costs_;                 /**< @brief The costs of the whole trajectory */
+  bool optimized_costs_available_;        /**< @brief Whether or not the costs of the last optimized parameters are available */
+  Eigen::MatrixXd optimized_parameters_;  /**< @brief The whole trajectory holding the last optimized parameters */
+  Eigen::VectorXd optimized_costs_;       /**< @brief The costs of the last optimized parameters */
+  TimestepMask changed_timesteps_;        /**< @brief The timesteps that differ from the last optimized parameters */
+};
+
+/**
+ * @brief Optimizes a long trajectory as a set of overlapping segments that run concurrently.
+ *
+ * Each segment is optimized by its own Stomp instance with the configured number of iterations while the rest of the
+ * trajectory stays fixed, the end points of a segment are its boundary conditions.  Once all the segments of a sweep
+ * are done they are blended across the overlaps with weights that fall to zero at the boundaries of each segment.  The
+ * sweeps are repeated from the blended trajectory until it is valid or the maximum number of sweeps is reached.
+ *
+ * There is one worker per task, the tasks must not share state since the segments run on separate threads and each
+ * task must accept the whole trajectory.  The segments run serially on their own thread regardless of the configured
+ * 'num_threads'.
+ */
+class SegmentStomp
+{
+public:
+
+  /**
+   * @brief Constructor
+   * @param config      The configuration of the whole trajectory
+   * @param tasks       One task per worker
+   * @param thread_pool The pool on which the segments run, it must not have more workers than there are tasks and its
+   *                    jobs must not call parallelFor on it.  When null a pool with one worker per task is created.
+   */
+  SegmentStomp(const StompConfiguration& config,const std::vector<TaskPtr>& tasks,ThreadPoolPtr thread_pool = nullptr);
+
+  /**
+   * @brief Finds a solution between a start and end state starting from a linear interpolation.
+   * @param first                 Start state for the task
+   * @param last                  Final state for the task
+   * @param parameters_optimized  The optimized solution [parameters][timesteps]
+   * @return True if a valid solution was found, otherwise false.
+   */
+  bool solve(const std::vector<double>& first,const std::vector<double>& last,
+             Eigen::MatrixXd& parameters_optimized);
+
+  /**
+   * @brief Finds a solution from an initial trajectory, its first and last timesteps are kept.
+   * @param initial_parameters    The initial trajectory [parameters][timesteps]
+   * @param parameters_optimized  The optimized solution [parameters][timesteps]
+   * @return True if a valid solution was found, otherwise false.
+   */
+  bool solve(const Eigen::MatrixXd& initial_parameters,Eigen::MatrixXd& parameters_optimized);
+
+  /**
+   * @brief Sets the configuration of the whole trajectory
+   * @param config Stomp Configuration struct
+   */
+  void setConfig(const StompConfiguration& config);
+
+  /**
+   * @brief Sets the size of the segments
+   * @param segment_timesteps The number of timesteps of each segment
+   * @param overlap           The minimum number of timesteps shared by consecutive segments, at least 2 and less than
+   *                          segment_timesteps.  The segments are spread evenly so the actual overlap may be larger.
+   * @return True if the sizes are valid, otherwise false and the previous sizes are kept.
+   */
+  bool setSegments(int segment_timesteps,int overlap);
+
+  /**
+   * @brief Sets the maximum number of sweeps over the segments
+   * @param max_sweeps  The maximum number of sweeps, at least 1
+   */
+  void setMaxSweeps(int max_sweeps);
+
+  /**
+   * @brief Sets a wall clock deadline on all the segments. (Thread-Safe)
+   * @param deadline The time at which the optimization must stop
+   */
+  void setDeadline(const std::chrono::steady_clock::time_point& deadline);
+
+  /**
+   * @brief Removes the deadline. (Thread-Safe)
+   */
+  void clearDeadline();
+
+  /**
+   * @brief Cancel all the segments in progress. (Thread-Safe)
+   * @return True if sucessful, otherwise false.
+   */
+  bool cancel();
+
+  /**
+   * @brief Computes the first timestep of each segment for the configured number of timesteps
+   * @param starts  The first timestep of each segment in increasing order
+   */
+  void getSegments(std::vector<int>& starts) const;
+
+  /**
+   * @brief The number of sweeps run by the last solve
+   * @return The number of sweeps
+   */
+  int getNumSweeps() const;
+
+protected:
+
+  /**
+   * @brief Blends the optimized segments into the whole trajectory
+   * @param starts      The first timestep of each segment
+   * @param segments    The optimized parameters of each segment
+   * @param parameters  The whole trajectory, its end points are kept
+   */
+  void blendSegments(const std::vector<int>& starts,const std::vector<Eigen::MatrixXd>& segments,
+                     Eigen::MatrixXd& parameters) const;
+
+protected:
+
+  StompConfiguration config_;                          /**< @brief The configuration of the whole trajectory */
+  std::vector<SegmentTaskPtr> segment_tasks_;          /**< @brief One segment adaptor per worker */
+  std::vector<std::shared_ptr<Stomp> > stomps_;        /**< @brief One Stomp instance per worker */
+  ThreadPoolPtr thread_pool_;                          /**< @brief Runs the segments */
+  int segment_timesteps_;                              /**< @brief The number of timesteps of each segment */
+  int overlap_;                                        /**< @brief The minimum overlap between consecutive segments */
+  int max_sweeps_;                                     /**< @brief The maximum number of sweeps */
+  int num_sweeps_;                                     /**< @brief The number of sweeps run by the last solve */
+  std::atomic<bool> proceed_;                          /**< @brief Cleared on cancellation */
+};
+
+} /* namespace stomp_core */
+
+#endif /* INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_SEGMENT_STOMP_H_ */
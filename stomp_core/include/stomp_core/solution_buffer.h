@@ -0,0 +1,101 @@
+/**
+ * @file solution_buffer.h
+ * @brief This defines a lock-free buffer used to publish the best stomp solution to another thread
+ *
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_SOLUTION_BUFFER_H_
+#define INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_SOLUTION_BUFFER_H_
+
+#include <atomic>
+#include <Eigen/Core>
+
+namespace stomp_core
+{
+
+/** @brief A solution published while the optimization is running */
+struct Solution
+{
+  Eigen::MatrixXd parameters;   /**< @brief A matrix [num_dimensions][num_timesteps] of the solution parameters */
+  double cost;                  /**< @brief The total cost of the solution */
+  int iteration;                /**< @brief The iteration at which the solution was found */
+  bool valid;                   /**< @brief False until a valid solution has been published by the current solve */
+};
+
+/**
+ * @brief A lock-free triple buffer that passes the latest solution from a single producer thread to a single consumer
+ * thread.
+ *
+ * The producer fills the buffer returned by writeBuffer() and then calls publish(), the consumer calls readBuffer() to
+ * get the most recently published solution.  Neither side ever waits on the other and, once resized, no memory is
+ * allocated.
+ */
+class SolutionBuffer
+{
+public:
+
+  SolutionBuffer();
+
+  SolutionBuffer(const SolutionBuffer&) = delete;
+  SolutionBuffer& operator=(const SolutionBuffer&) = delete;
+
+  /**
+   * @brief Resizes the parameters of all the buffers and marks them invalid.  Not thread safe, neither the producer
+   * nor the consumer may be using the buffer.
+   * @param num_dimensions  The number of rows of the parameters
+   * @param num_timesteps   The number of columns of the parameters
+   */
+  void resize(int num_dimensions,int num_timesteps);
+
+  /**
+   * @brief The buffer owned by the producer, only the producer thread may call this method.
+   * @return The solution to fill before calling publish()
+   */
+  Solution& writeBuffer()
+  {
+    return buffers_[back_];
+  }
+
+  /**
+   * @brief Makes the content of writeBuffer() available to the consumer, only the producer thread may call this method.
+   */
+  void publish();
+
+  /**
+   * @brief The most recently published solution, only the consumer thread may call this method.  The returned
+   * solution is not modified until the next call to readBuffer().
+   * @return The latest published solution
+   */
+  const Solution& readBuffer();
+
+protected:
+
+  static const unsigned int INDEX_MASK = 0x3;   /**< @brief Masks the buffer index in middle_ */
+  static const unsigned int DIRTY = 0x4;        /**< @brief Set in middle_ when it holds a solution not yet read */
+
+  Solution buffers_[3];                         /**< @brief The buffers */
+  int back_;                                    /**< @brief The index of the buffer owned by the producer */
+  int front_;                                   /**< @brief The index of the buffer owned by the consumer */
+  std::atomic<unsigned int> middle_;            /**< @brief The index of the exchanged buffer along with the DIRTY flag */
+};
+
+} /* namespace stomp_core */
+
+#endif /* INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_SOLUTION_BUFFER_H_ */
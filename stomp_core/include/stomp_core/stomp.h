@@ -27,13 +27,62 @@
 #define INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_STOMP_H_
 
 #include <atomic>
+#include <chrono>
+#include <functional>
 #include <stomp_core/utils.h>
+#include <stomp_core/matrix_cache.h>
 #include <XmlRpc.h>
+#include "stomp_core/profiler.h"
+#include "stomp_core/rollout_arrays.h"
+#include "stomp_core/rollout_scheduler.h"
+#include "stomp_core/solution_buffer.h"
 #include "stomp_core/task.h"
+#include "stomp_core/thread_pool.h"
 
 namespace stomp_core
 {
 
+namespace SolvePhases
+{
+/** @brief The phases of a solve timed by Stomp, see Stomp::getProfile() */
+enum SolvePhase
+{
+  ITERATION = 0,              /**< A complete iteration */
+  GENERATE_NOISY_ROLLOUTS,    /**< Generating the noisy rollouts */
+  COMPUTE_STATE_COSTS,        /**< Computing the state costs of the noisy rollouts */
+  COMPUTE_CONTROL_COSTS,      /**< Computing the control costs of the noisy rollouts */
+  FILTER_NOISY_ROLLOUTS,      /**< Filtering the noisy rollouts */
+  COMPUTE_PROBABILITIES,      /**< Computing the probabilities of the rollouts */
+  UPDATE_PARAMETERS,          /**< Computing, filtering and applying the parameter updates */
+  COMPUTE_OPTIMIZED_COST,     /**< Computing the cost of the updated parameters */
+  NUM_SOLVE_PHASES
+};
+}
+
+namespace StopReasons
+{
+/** @brief The reasons for which a solve stops iterating, see Stomp::getStopReason() */
+enum StopReason
+{
+  NONE = 0,                   /**< No solve has run */
+  MAX_ITERATIONS,             /**< The maximum number of iterations was reached */
+  VALID_ITERATIONS,           /**< The parameters stayed valid for num_iterations_after_valid iterations */
+  COST_CONVERGED,             /**< The relative cost improvement over convergence_window fell below convergence_cost_tolerance */
+  UPDATE_CONVERGED,           /**< The parameter updates fell below convergence_update_tolerance */
+  STAGNATED,                  /**< The cost did not decrease for max_stagnant_iterations iterations */
+  CANCELLED,                  /**< The solve was cancelled */
+  DEADLINE,                   /**< The deadline passed */
+  FAILED                      /**< One of the optimization steps failed */
+};
+}
+
+/**
+ * @brief Gets the name of a stop reason
+ * @param reason  The stop reason
+ * @return The name of the stop reason, i.e. "cost_converged".
+ */
+const char* toString(StopReasons::StopReason reason);
+
 /** @brief The Stomp class */
 class Stomp
 {
@@ -74,6 +123,16 @@ public:
   bool solve(const Eigen::MatrixXd& initial_parameters,
              Eigen::MatrixXd& parameters_optimized);
 
+  /**
+   * @brief Re-optimizes starting from the state left by the last solve, intended for replanning after the task has
+   * changed slightly. The optimized parameters and the stored rollouts are kept, their costs are recomputed against
+   * the current task and at most max_iterations iterations are run.  A cancellation of the previous solve is cleared.
+   * @param max_iterations        The maximum number of iterations
+   * @param parameters_optimized  The optimized solution [Parameters][timesteps]
+   * @return True if solution was found, otherwise false.  Also false when there is no previous solve to start from.
+   */
+  bool solveWarmStart(unsigned int max_iterations,Eigen::MatrixXd& parameters_optimized);
+
   /**
    * @brief Sets the configuration and resets all internal variables
    * @param config Stomp Configuration struct
@@ -93,6 +152,59 @@ public:
    */
   bool clear();
 
+  /**
+   * @brief Sets a wall clock deadline for the solve methods. (Thread-Safe)
+   * The deadline is checked before processing each rollout, once it has passed the optimization stops and the best
+   * valid solution found so far is returned.  The deadline remains in effect until it is changed or cleared.
+   * @param deadline The time at which the optimization must stop
+   */
+  void setDeadline(const std::chrono::steady_clock::time_point& deadline);
+
+  /**
+   * @brief Removes the deadline. (Thread-Safe)
+   */
+  void clearDeadline();
+
+  /**
+   * @brief Gets the best valid solution found so far by the current solve.
+   * This method is lock-free and may be called from one other thread while the optimization is running.  The solutions
+   * of the coarse levels of a coarse-to-fine solve are not reported.
+   * @param parameters  The best valid parameters [Parameters][timesteps]
+   * @param cost        The total cost of the best valid parameters
+   * @return True if a valid solution has been found, otherwise false.
+   */
+  bool getBestSolution(Eigen::MatrixXd& parameters,double& cost);
+
+  /**
+   * @brief Gets the time and the number of calls of each phase of the last solve followed by the entries added by
+   * the task, see SolvePhases::SolvePhase and Task::getProfile().
+   * @param report  The profile, any previous entries are discarded
+   */
+  void getProfile(ProfileReport& report) const;
+
+  /**
+   * @brief Gets the reason for which the last solve stopped iterating
+   * @return The stop reason, StopReasons::NONE when no solve has run.
+   */
+  StopReasons::StopReason getStopReason() const;
+
+  /**
+   * @brief The signature of the control costs computation
+   * @param parameters            The parameters [dimensions][timesteps]
+   * @param dt                    The timestep in seconds
+   * @param control_cost_weight   The control cost weight
+   * @param control_cost_matrix_R The control cost matrix
+   * @param control_costs         The control costs [dimensions][timesteps]
+   */
+  typedef void (*ControlCostsFunction)(const Eigen::MatrixXd& parameters,double dt,double control_cost_weight,
+                                       const SymmetricBandedMatrix& control_cost_matrix_R,Eigen::MatrixXd& control_costs);
+
+  /**
+   * @brief Selects the control costs computation specialized for the number of dimensions
+   * @param num_dimensions  The number of dimensions
+   * @return The function specialized for 6 and 7 dimensions, otherwise the generic one.
+   */
+  static ControlCostsFunction selectControlCostsFunction(int num_dimensions);
 
 protected:
 
@@ -111,7 +223,37 @@ protected:
    */
   bool computeInitialTrajectory(const std::vector<double>& first,const std::vector<double>& last);
 
+  /**
+   * @brief Optimizes each level of StompConfiguration::coarse_timesteps in turn starting from the initial parameters and
+   * leaves the upsampled parameters at the full resolution.
+   * @return True if sucessful, otherwise false.  The task is set back to the full resolution in either case.
+   */
+  bool runCoarseLevels();
+
+  /**
+   * @brief Passes a resolution to the task and resizes all internal variables for it, the iteration count is kept.
+   * @param config      The configuration of the resolution
+   * @param parameters  The parameters at this resolution [Parameters][timesteps]
+   * @return True if sucessful, otherwise false.
+   */
+  bool setResolution(const StompConfiguration& config,const Eigen::MatrixXd& parameters);
+
   // optimization steps
+  /**
+   * @brief Runs iterations from the current state until a valid solution is found, the optimization is cancelled or
+   * max_iterations have run, then returns the solution and notifies the task.
+   * @param max_iterations        The maximum number of iterations
+   * @param parameters_optimized  The optimized solution [Parameters][timesteps]
+   * @return True if solution was found, otherwise false.
+   */
+  bool runIterations(unsigned int max_iterations,Eigen::MatrixXd& parameters_optimized);
+
+  /**
+   * @brief Runs iterations from the current state until one of the stop rules is met and sets the stop reason.
+   * @param max_iterations  The maximum number of iterations
+   */
+  void iterate(unsigned int max_iterations);
+
   /**
    * @brief Run a single iteration of the stomp algorithm
    * @return True if it was able to succesfully perform a single iteration. False
@@ -125,6 +267,14 @@ protected:
    */
   bool generateNoisyRollouts();
 
+  /**
+   * @brief Computes the importance sampling weight of a rollout reused from a previous iteration, this is the ratio of
+   * the density of its noise around the current parameters to the density it was sampled with.
+   * @param rollout The reused rollout, its noise must be relative to the current parameters
+   * @return The weight in (0,1], 1 when the task does not provide the noise density.
+   */
+  double computeImportanceWeight(const Rollout& rollout) const;
+
   /**
    * @brief Applies the optimization task's filter methods to the noisy trajectories.
    * @return True if sucessful, otherwise false.
@@ -143,6 +293,18 @@ protected:
    */
   bool computeRolloutsStateCosts();
 
+  /**
+   * @brief Computes the cost at every timestep of the new noisy rollouts with a single call to the task.
+   * @return True if sucessful, otherwise false.
+   */
+  bool computeRolloutsStateCostsBatch();
+
+  /**
+   * @brief Recomputes the state and total costs of the rollouts stored from the previous iteration.
+   * @return True if sucessful, otherwise false.
+   */
+  bool computeStoredRolloutsCosts();
+
   /**
    * @brief Compute the control cost for each noisy rollout.
    * This is the sum of the acceleration squared, then each
@@ -158,6 +320,21 @@ protected:
    */
   bool computeProbabilities();
 
+  /**
+   * @brief Moves the covariance of the noise towards the probability weighted covariance of the noisy rollouts when
+   * StompConfiguration::covariance_adaptation_rate is positive.
+   * @return True if sucessful, otherwise false.
+   */
+  bool adaptNoiseCovariance();
+
+  /**
+   * @brief Computes the covariance of the noise of the noisy rollouts averaged over the timesteps.
+   * @param weighted    Whether to weight the rollouts by their probabilities or uniformly
+   * @param covariance  The lower triangle of the covariance [dimensions][dimensions]
+   * @return False if the rollouts carry no weight, otherwise true.
+   */
+  bool computeNoiseCovariance(bool weighted,Eigen::MatrixXd& covariance);
+
   /**
    * @brief Computes update from probabilities using convex combination
    * @return True if sucessful, otherwise false.
@@ -167,11 +344,50 @@ protected:
   /**
    * @brief Computes the optimized trajectory cost [Control Cost + State Cost]
    * If the current cost is not less than the previous cost the
-   * parameters are reset to the previous iteration's parameters.
-   * @return
+   * parameters and their costs are reset to the previous iteration's values.  Once the costs are current only the
+   * timesteps changed by the update are passed to the task for evaluation.
+   * @return True if sucessful, otherwise false.
    */
   bool computeOptimizedCost();
 
+  /**
+   * @brief Adapts the number of rollouts and the noise scale of the next iteration.
+   * @param previous_lowest_cost The lowest cost before the current iteration
+   */
+  void updateRolloutSchedule(double previous_lowest_cost);
+
+  /**
+   * @brief Evaluates the convergence rules after an iteration and sets the stop reason when one of them is met.
+   * @param completed_iterations  The number of iterations completed by the current call to runIterations()
+   * @param stagnant_iterations   The number of consecutive iterations that did not lower the cost
+   * @return True if the solve should stop, otherwise false.
+   */
+  bool checkConvergence(unsigned int completed_iterations,unsigned int stagnant_iterations);
+
+  /**
+   * @brief Marks the best valid solution as not found and publishes that state.
+   */
+  void resetBestSolution();
+
+  /**
+   * @brief Records and publishes the optimized parameters if they are valid and have the lowest cost so far.
+   */
+  void updateBestSolution();
+
+  /**
+   * @brief Checks the deadline
+   * @return True if a deadline is set and it has passed, otherwise false.
+   */
+  bool deadlineExpired() const;
+
+  /**
+   * @brief Calls a function for each rollout index in [0, num_rollouts), concurrently when a thread pool is available.
+   * @param num_rollouts  The number of rollouts to process
+   * @param func          The function to call with the rollout index, returns false on failure.
+   * @return False if the function failed for any of the rollouts, otherwise true.
+   */
+  bool runRollouts(int num_rollouts,const std::function<bool (int)>& func);
+
 protected:
 
   // process control
@@ -179,8 +395,14 @@ protected:
   TaskPtr task_;                                   /**< @brief The task to be optimized. */
   StompConfiguration config_;                      /**< @brief Configuration parameters. */
   unsigned int current_iteration_;                 /**< @brief Current iteration for the optimization. */
+  ThreadPoolPtr thread_pool_;                      /**< @brief Processes the rollouts concurrently, null when running serially. */
+  std::atomic<std::chrono::steady_clock::rep> deadline_;  /**< @brief The deadline as steady clock ticks since its epoch, max() when not set. */
+  StopReasons::StopReason stop_reason_;            /**< @brief The reason for which the last solve stopped iterating */
+  bool coarse_level_;                              /**< @brief Whether or not a coarse level is being optimized, its solutions are not published */
+  std::vector<double> cost_history_;               /**< @brief Ring buffer [convergence_window + 1] of the lowest cost after each iteration */
 
   // optimized parameters
+  bool parameters_initialized_;                    /**< @brief whether or not a solve has set the optimized parameters */
   bool parameters_valid_;                          /**< @brief whether or not the optimized parameters are valid */
   double parameters_total_cost_;                   /**< @brief Total cost of the optimized parameters */
   double current_lowest_cost_;                     /**< @brief Hold the lowest cost of the optimized parameters */
@@ -189,19 +411,54 @@ protected:
   Eigen::VectorXd parameters_state_costs_;         /**< @brief A vector [timesteps] of the parameters state costs */
   Eigen::MatrixXd parameters_control_costs_;       /**< @brief A matrix [dimensions][timesteps] of the parameters control costs*/
 
+  // covariance adaptation
+  bool noise_covariance_initialized_;              /**< @brief whether or not the noise covariance was estimated by the current solve */
+  Eigen::MatrixXd noise_covariance_;               /**< @brief A matrix [dimensions][dimensions] of the noise covariance passed to the task */
+  Eigen::MatrixXd sample_covariance_;              /**< @brief A matrix [dimensions][dimensions] of the weighted covariance of the rollouts */
+  Eigen::VectorXd min_noise_variances_;            /**< @brief A vector [dimensions] of the lower bounds of the noise variances */
+  Eigen::VectorXd probability_sums_;               /**< @brief A vector [dimensions] of the probability sums of the noisy rollouts */
+  TimestepMask parameters_changed_timesteps_;      /**< @brief A mask [timesteps] of the timesteps changed by the last update */
+  bool parameters_costs_current_;                  /**< @brief whether or not the state costs were computed for the optimized parameters
+                                                        by the current solve, otherwise the next evaluation covers all the timesteps */
+
+  // optimized parameters before the last update, restored when the update does not lower the cost
+  bool previous_parameters_valid_;                 /**< @brief whether or not the previous parameters are valid */
+  double previous_parameters_total_cost_;          /**< @brief Total cost of the previous parameters */
+  Eigen::MatrixXd previous_parameters_;            /**< @brief A matrix [dimensions][timesteps] of the previous parameters */
+  Eigen::VectorXd previous_state_costs_;           /**< @brief A vector [timesteps] of the previous parameters state costs */
+  Eigen::MatrixXd previous_control_costs_;         /**< @brief A matrix [dimensions][timesteps] of the previous parameters control costs*/
+
+  // best valid solution
+  bool best_parameters_valid_;                     /**< @brief whether or not a valid solution has been found by the current solve */
+  double best_parameters_cost_;                    /**< @brief Total cost of the best valid parameters */
+  Eigen::MatrixXd best_parameters_;                /**< @brief A matrix [dimensions][timesteps] of the best valid parameters */
+  SolutionBuffer best_solution_buffer_;            /**< @brief Publishes the best valid parameters to a reader thread */
+
   // rollouts
   std::vector<Rollout> noisy_rollouts_;            /**< @brief Holds the noisy rollouts */
   std::vector<Rollout> reused_rollouts_;           /**< @brief Used for reordering arrays based on cost */
+  std::vector< std::pair<double,int> > rollout_cost_sorter_;  /**< @brief Used to sort noisy trajectories in ascending order wrt their total cost */
   int num_active_rollouts_;                        /**< @brief Number of active rollouts */
+  int num_new_rollouts_;                           /**< @brief Number of rollouts generated by the current iteration */
+
+  /*
+   * Batched cost evaluation: the buffers of the new rollouts are swapped in and out of these vectors around each call
+   * to Task::computeNoisyCostsBatch(), in between the vectors only hold empty buffers.
+   */
+  std::vector<Eigen::MatrixXd> batch_parameters_;             /**< @brief The parameters of each rollout in the batch */
+  std::vector<TimestepMask> batch_changed_timesteps_;         /**< @brief The changed timesteps of each rollout in the batch */
+  std::vector<Eigen::VectorXd> batch_costs_;                  /**< @brief The state costs of each rollout in the batch */
+  std::vector<bool> batch_validity_;                          /**< @brief The validity of each rollout in the batch */
+  RolloutScheduler rollout_scheduler_;             /**< @brief Adapts the number of new rollouts and the noise scale */
+  Profiler profiler_;                              /**< @brief Times the solve phases, one counter per SolvePhases::SolvePhase */
+
+  RolloutArraysPtr rollout_arrays_;                /**< @brief The noise, costs and probabilities of the rollouts in the kernel precision */
 
   // finite difference and optimization matrices
   int num_timesteps_padded_;                       /**< @brief The number of timesteps to pad the optimization with: timesteps + 2*(FINITE_DIFF_RULE_LENGTH - 1) */
   int start_index_padded_;                         /**< @brief The index corresponding to the start of the non-paded section in the padded arrays */
-  Eigen::MatrixXd finite_diff_matrix_A_padded_;    /**< @brief The finite difference matrix including padding */
-  Eigen::MatrixXd control_cost_matrix_R_padded_;   /**< @brief The control cost matrix including padding */
-  Eigen::MatrixXd control_cost_matrix_R_;          /**< @brief A matrix [timesteps][timesteps], Referred to as 'R = A x A_transpose' in the literature */
-  Eigen::MatrixXd inv_control_cost_matrix_R_;      /**< @brief A matrix [timesteps][timesteps], R^-1 ' matrix */
-
+  ControlCostsFunction control_costs_function_;    /**< @brief Computes the control costs, specialized for the number of dimensions */
+  ControlCostMatricesConstPtr control_cost_matrices_;   /**< @brief The padded and the factorized control cost matrices, referred to as 'R = A x A_transpose' in the literature */
 
 };
 
@@ -29,6 +29,7 @@
 #include <XmlRpcValue.h>
 #include <boost/shared_ptr.hpp>
 #include <Eigen/Core>
+#include "stomp_core/profiler.h"
 #include "stomp_core/utils.h"
 
 namespace stomp_core
@@ -37,7 +38,17 @@ namespace stomp_core
 class Task;
 typedef std::shared_ptr<Task> TaskPtr; /**< Defines a boost shared ptr for type Task */
 
-/** @brief Defines the STOMP improvement policy */
+/**
+ * @brief Defines the STOMP improvement policy
+ *
+ * @par Thread safety
+ * By default Stomp invokes all the methods of the Task sequentially from the thread that called Stomp::solve.  When
+ * StompConfiguration::num_threads is greater than 1 and supportsConcurrentRollouts() returns true then
+ * generateNoisyParameters(), filterNoisyParameters(), computeNoisyCosts() and computeChangedNoisyCosts() may be called
+ * concurrently, each concurrent
+ * call receiving a distinct 'rollout_number' in the range [0, num_rollouts).  Any scratch data used by these methods
+ * should therefore be indexed by 'rollout_number'.  All other methods are always invoked sequentially.
+ */
 class Task
 {
 
@@ -45,6 +56,101 @@ public:
 
     Task(){}
 
+    virtual ~Task(){}
+
+    /**
+     * @brief Whether or not generateNoisyParameters(), filterNoisyParameters() and computeNoisyCosts() can be called
+     * concurrently for different rollouts.
+     * @return True if concurrent calls are safe, otherwise false.
+     */
+    virtual bool supportsConcurrentRollouts() const
+    {
+      return false;
+    }
+
+    /**
+     * @brief Whether or not Stomp should evaluate the new rollouts of each iteration with a single call to
+     * computeNoisyCostsBatch() instead of calling computeChangedNoisyCosts() once per rollout.
+     * @return True if the batched evaluation is preferred, otherwise false.
+     */
+    virtual bool supportsBatchedCosts() const
+    {
+      return false;
+    }
+
+    /**
+     * @brief Called by Stomp before generating the noisy rollouts of each iteration with the factor to apply to the
+     * magnitude of the noise, it decays as the cost converges.  See StompConfiguration::noise_decay.
+     * @param scale The noise scale in (0,1]
+     */
+    virtual void setNoiseScale(double scale){}
+
+    /**
+     * @brief Called by Stomp at the beginning of each solve with the master seed of StompConfiguration::random_seed.  Tasks
+     * that need reproducible noise should draw it from a stomp_core::RandomStream constructed from this seed, the iteration
+     * number and the rollout number rather than from a generator shared by all the rollouts.
+     * @param seed The master seed
+     */
+    virtual void setRandomSeed(std::uint64_t seed){}
+
+    /**
+     * @brief Called by Stomp before generating the noisy rollouts of each iteration when the covariance adaptation is
+     * enabled, see StompConfiguration::covariance_adaptation_rate.  The noise at every timestep should then be drawn with
+     * this joint space covariance while keeping the correlation between timesteps of the task, the noise scale still
+     * applies on top of it.
+     * @param covariance  A matrix [num_dimensions][num_dimensions] of the covariance of the unscaled noise averaged over
+     * the timesteps, empty at the beginning of each solve to restore the noise of the task.
+     */
+    virtual void setNoiseCovariance(const Eigen::MatrixXd& covariance){}
+
+    /**
+     * @brief Computes the log density of the noise under the distribution that generateNoisyParameters() currently
+     * samples from, including the noise scale.  Stomp uses it to weight the rollouts reused from previous iterations by
+     * the ratio of their current density to the density they were sampled with.  The density may omit any constant
+     * term that does not change during a solve.  It is called concurrently for different rollouts under the same
+     * conditions as generateNoisyParameters().
+     * @param noise       The noise [num_dimensions][num_timesteps]
+     * @param log_density The log density of the noise
+     * @return True if the density was computed, false if the task does not know it in which case the reused rollouts
+     * are weighted as fresh ones.
+     */
+    virtual bool computeNoiseLogDensity(const Eigen::MatrixXd& noise,double& log_density) const
+    {
+      return false;
+    }
+
+    /**
+     * @brief Whether or not the task can be optimized at fewer timesteps than the ones it was set up for, which the
+     * coarse-to-fine solve enabled by StompConfiguration::coarse_timesteps requires.
+     * @return True if setResolution() is supported, otherwise false.
+     */
+    virtual bool supportsMultiResolution() const
+    {
+      return false;
+    }
+
+    /**
+     * @brief Called by Stomp during a coarse-to-fine solve before optimizing each level and once more with the
+     * configuration of the solve before refining at the full resolution.
+     * @param config  The configuration of the level, only num_timesteps and delta_t differ from the solve configuration
+     * @return True if succeeded, otherwise false.
+     */
+    virtual bool setResolution(const StompConfiguration& config)
+    {
+      return true;
+    }
+
+    /**
+     * @brief Called by Stomp at the beginning of each solve so that the task can zero its own timers.
+     */
+    virtual void resetProfile(){}
+
+    /**
+     * @brief Appends the timers of the task, for instance one per plugin, to the profile returned by Stomp::getProfile().
+     * @param report The report to append to
+     */
+    virtual void getProfile(ProfileReport& report) const {}
+
     /**
      * @brief Generates a noisy trajectory from the parameters.
      * @param parameters        A matrix [num_dimensions][num_parameters] of the current optimized parameters
@@ -83,6 +189,69 @@ public:
                          Eigen::VectorXd& costs,
                          bool& validity) = 0 ;
 
+    /**
+     * @brief computes the state costs of noisy parameters that only differ from the optimized parameters at some of the
+     * timesteps.  On entry 'costs' and 'validity' hold the values last computed for the optimized parameters so an
+     * implementation may only re-evaluate the timesteps flagged in 'changed_timesteps'.  The default implementation
+     * ignores the mask and calls computeNoisyCosts().
+     * @param parameters        A matrix [num_dimensions][num_parameters] of the policy parameters to execute
+     * @param start_timestep    The start index into the 'parameters' array, usually 0.
+     * @param num_timesteps     The number of elements to use from 'parameters' starting from 'start_timestep'
+     * @param iteration_number  The current iteration count in the optimization loop
+     * @param rollout_number    The index of the noisy trajectory whose cost is being evaluated.
+     * @param changed_timesteps A mask [num_parameters] of the timesteps at which 'parameters' differs from the optimized parameters
+     * @param costs vector      A vector containing the state costs per timestep.
+     * @param validity          Whether or not the trajectory is valid
+     * @return True if cost were properly computed, otherwise false
+     */
+    virtual bool computeChangedNoisyCosts(const Eigen::MatrixXd& parameters,
+                         std::size_t start_timestep,
+                         std::size_t num_timesteps,
+                         int iteration_number,
+                         int rollout_number,
+                         const TimestepMask& changed_timesteps,
+                         Eigen::VectorXd& costs,
+                         bool& validity)
+    {
+      return computeNoisyCosts(parameters,start_timestep,num_timesteps,iteration_number,rollout_number,costs,validity);
+    }
+
+    /**
+     * @brief computes the state costs of several noisy trajectories in one call so that an implementation can share its
+     * setup work among them.  Only called when supportsBatchedCosts() returns true.  Entry 'r' of each vector belongs to
+     * the rollout number 'r' and, as in computeChangedNoisyCosts(), on entry 'costs[r]' and 'validity[r]' hold the values
+     * computed for the optimized parameters.  The default implementation calls computeChangedNoisyCosts() for each rollout.
+     * @param parameters        The [num_dimensions][num_parameters] policy parameters of each rollout
+     * @param start_timestep    The start index into the 'parameters' arrays, usually 0.
+     * @param num_timesteps     The number of elements to use from 'parameters' starting from 'start_timestep'
+     * @param iteration_number  The current iteration count in the optimization loop
+     * @param changed_timesteps The mask [num_parameters] of the timesteps at which each rollout differs from the optimized parameters
+     * @param costs             The vector of the state costs per timestep of each rollout
+     * @param validity          Whether or not each trajectory is valid
+     * @return True if cost were properly computed, otherwise false
+     */
+    virtual bool computeNoisyCostsBatch(const std::vector<Eigen::MatrixXd>& parameters,
+                         std::size_t start_timestep,
+                         std::size_t num_timesteps,
+                         int iteration_number,
+                         const std::vector<TimestepMask>& changed_timesteps,
+                         std::vector<Eigen::VectorXd>& costs,
+                         std::vector<bool>& validity)
+    {
+      for(auto r = 0u; r < parameters.size(); r++)
+      {
+        bool valid = validity[r];
+        if(!computeChangedNoisyCosts(parameters[r],start_timestep,num_timesteps,iteration_number,r,changed_timesteps[r],
+                                     costs[r],valid))
+        {
+          return false;
+        }
+        validity[r] = valid;
+      }
+
+      return true;
+    }
+
     /**
      * @brief computes the state costs as a function of the optimized parameters for each time step.
      * @param parameters        A matrix [num_dimensions][num_parameters] of the policy parameters to execute
@@ -100,6 +269,31 @@ public:
                          Eigen::VectorXd& costs,
                          bool& validity) = 0 ;
 
+    /**
+     * @brief computes the state costs of the optimized parameters after an update that only changed some of the timesteps.
+     * On entry 'costs' and 'validity' hold the values computed for the optimized parameters before the update so an
+     * implementation may only re-evaluate the timesteps flagged in 'changed_timesteps'.  The default implementation
+     * ignores the mask and calls computeCosts().
+     * @param parameters        A matrix [num_dimensions][num_parameters] of the policy parameters to execute
+     * @param start_timestep    The start index into the 'parameters' array, usually 0.
+     * @param num_timesteps     The number of elements to use from 'parameters' starting from 'start_timestep'
+     * @param iteration_number  The current iteration count in the optimization loop
+     * @param changed_timesteps A mask [num_parameters] of the timesteps changed by the update
+     * @param costs             A vector containing the state costs per timestep.
+     * @param validity          Whether or not the trajectory is valid
+     * @return True if cost were properly computed, otherwise false
+     */
+    virtual bool computeChangedCosts(const Eigen::MatrixXd& parameters,
+                         std::size_t start_timestep,
+                         std::size_t num_timesteps,
+                         int iteration_number,
+                         const TimestepMask& changed_timesteps,
+                         Eigen::VectorXd& costs,
+                         bool& validity)
+    {
+      return computeCosts(parameters,start_timestep,num_timesteps,iteration_number,costs,validity);
+    }
+
     /**
      * @brief Filters the given noisy parameters which is applied after noisy trajectory generation. It could be used for clipping
      * of joint limits or projecting into the null space of the Jacobian.
@@ -0,0 +1,115 @@
+/**
+ * @file thread_pool.h
+ * @brief This defines a fixed size thread pool used to process the stomp rollouts concurrently
+ *
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_THREAD_POOL_H_
+#define INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace stomp_core
+{
+
+class ThreadPool;
+typedef std::shared_ptr<ThreadPool> ThreadPoolPtr; /**< Defines a shared ptr for type ThreadPool */
+
+/**
+ * @brief A fixed size pool of worker threads that executes indexed jobs.
+ *
+ * The thread calling parallelFor() participates in the job as worker 0, therefore a pool of size N
+ * only spawns N - 1 threads.
+ */
+class ThreadPool
+{
+public:
+
+  /**
+   * @brief The job signature
+   * @param index   The job index in the range [0, count)
+   * @param worker  The index of the worker executing the job in the range [0, size())
+   */
+  typedef std::function<void (int index, int worker)> Job;
+
+  /**
+   * @brief Constructor
+   * @param num_threads The total number of workers including the calling thread.
+   */
+  explicit ThreadPool(int num_threads);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /**
+   * @brief The number of workers including the calling thread
+   * @return The number of workers.
+   */
+  int size() const;
+
+  /**
+   * @brief Runs job(i,worker) for every i in [0,count) and blocks until all jobs have completed.
+   * If a job throws, the first exception is rethrown in the calling thread once all workers are idle.
+   * @param count The number of jobs
+   * @param job   The function to execute
+   */
+  void parallelFor(int count, const Job& job);
+
+protected:
+
+  /**
+   * @brief Loop executed by each of the spawned threads
+   * @param worker  The worker index
+   */
+  void workerLoop(int worker);
+
+  /**
+   * @brief Pulls jobs from the active batch until it is exhausted
+   * @param worker  The worker index
+   */
+  void runJobs(int worker);
+
+protected:
+
+  std::vector<std::thread> threads_;          /**< @brief The spawned worker threads */
+  std::mutex submit_mutex_;                   /**< @brief Serializes calls to parallelFor */
+  std::mutex mutex_;                          /**< @brief Protects the batch state */
+  std::condition_variable work_condition_;    /**< @brief Signals the workers that a new batch is available */
+  std::condition_variable done_condition_;    /**< @brief Signals the caller that all workers are done */
+  const Job* job_;                            /**< @brief The job of the active batch */
+  int count_;                                 /**< @brief The number of jobs in the active batch */
+  std::atomic<int> next_index_;               /**< @brief The next job index to be executed */
+  int pending_workers_;                       /**< @brief The number of spawned workers still processing the active batch */
+  unsigned long batch_id_;                    /**< @brief Incremented every time a new batch is submitted */
+  bool stop_;                                 /**< @brief Requests the workers to exit */
+  std::exception_ptr exception_;              /**< @brief The first exception thrown by a job in the active batch */
+};
+
+} /* namespace stomp_core */
+
+#endif /* INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_THREAD_POOL_H_ */
@@ -26,33 +26,59 @@
 #ifndef INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_STOMP_UTILS_H_
 #define INDUSTRIAL_MOVEIT_STOMP_CORE_INCLUDE_STOMP_CORE_STOMP_UTILS_H_
 
+#include <cstdint>
+#include <utility>
 #include <string>
 #include <vector>
 #include <Eigen/Core>
+#include <stomp_core/banded_matrix.h>
 
 namespace stomp_core
 {
 
+/** @brief A boolean array [num_time_steps] where true flags a timestep whose parameters have changed */
+typedef Eigen::Array<bool,Eigen::Dynamic,1> TimestepMask;
+
 /** @brief The data structure used to store information about a single rollout. */
 struct Rollout
 {
   Eigen::MatrixXd noise;                   /**< @brief A matrix [num_dimensions][num_time_steps] of random noise applied to the parameters*/
   Eigen::MatrixXd parameters_noise;        /**< @brief A matrix [num_dimensions][num_time_steps] of the sum of parameters + noise */
+  TimestepMask changed_timesteps;          /**< @brief A mask [num_time_steps] of the timesteps where parameters_noise differs from the optimized parameters */
 
   Eigen::VectorXd state_costs;             /**< @brief A vector [num_time_steps] of the cost at each timestep */
   Eigen::MatrixXd control_costs;           /**< @brief A matrix [num_dimensions][num_time_steps] of the control cost for each parameter at every timestep */
-  Eigen::MatrixXd total_costs;             /**< @brief A matrix [num_dimensions][num_time_steps] of the total cost, where total_cost[d] = state_costs_ + control_costs_[d]*/
-  Eigen::MatrixXd probabilities;           /**< @brief A matrix [num_dimensions][num_time_steps] of the probability for each parameter at every timestep */
 
   std::vector<double> full_probabilities; /**< @brief A vector [num_dimensions] of the probabilities for the full trajectory */
   std::vector<double> full_costs;         /**< @brief A vector [num_dimensions] of the full coss, state_cost + control_cost for each joint over the entire trajectory
                                                full_costs_[d] = state_cost.sum() + control_cost[d].sum() */
 
   double importance_weight;               /**< @brief importance sampling weight */
+  double log_sampling_density;            /**< @brief log density of the noise under the distribution it was sampled from,
+                                               NaN when unknown.  See Task::computeNoiseLogDensity() */
   double total_cost;                      /**< @brief combined state + control cost over the entire trajectory for all joints */
 
 };
 
+/**
+ * @brief Exchanges the content of two rollouts without copying or allocating any of their buffers
+ * @param lhs The first rollout
+ * @param rhs The second rollout
+ */
+inline void swap(Rollout& lhs,Rollout& rhs)
+{
+  lhs.noise.swap(rhs.noise);
+  lhs.parameters_noise.swap(rhs.parameters_noise);
+  lhs.changed_timesteps.swap(rhs.changed_timesteps);
+  lhs.state_costs.swap(rhs.state_costs);
+  lhs.control_costs.swap(rhs.control_costs);
+  lhs.full_probabilities.swap(rhs.full_probabilities);
+  lhs.full_costs.swap(rhs.full_costs);
+  std::swap(lhs.importance_weight,rhs.importance_weight);
+  std::swap(lhs.log_sampling_density,rhs.log_sampling_density);
+  std::swap(lhs.total_cost,rhs.total_cost);
+}
+
 
 namespace DerivativeOrders
 {
@@ -77,6 +103,16 @@ enum TrajectoryInitialization
 };
 }
 
+namespace KernelPrecisions
+{
+/** @brief Available precisions of the probability and update kernels */
+enum KernelPrecision
+{
+  DOUBLE = 0,   /**< Computes the probabilities and the updates in double precision */
+  FLOAT         /**< Computes the probabilities and the updates in single precision */
+};
+}
+
 /** @brief The data structure used to store STOMP configuration parameters. */
 struct StompConfiguration
 {
@@ -97,6 +133,47 @@ struct StompConfiguration
 
   // Cost calculation
   double control_cost_weight;            /**< @brief Percentage of the trajectory accelerations cost to be applied in the total cost calculation >*/
+
+  // Execution
+  int kernel_precision = KernelPrecisions::DOUBLE; /**< @brief KernelPrecisions::KernelPrecision of the probability and update kernels,
+                                                        single precision halves the memory traffic for large rollout counts */
+  int num_threads = 1;                   /**< @brief Number of threads used to generate, filter and evaluate the noisy rollouts. Values greater
+                                              than 1 only take effect when the Task supports concurrent rollouts */
+
+  // Adaptive schedule
+  int min_rollouts = 0;                  /**< @brief When positive and less than num_rollouts the number of new rollouts per iteration
+                                              adapts between min_rollouts and num_rollouts, otherwise it stays at num_rollouts */
+  double noise_decay = 1.0;              /**< @brief Factor in (0,1] applied to the noise scale passed to Task::setNoiseScale() every time
+                                              the cost improves by less than noise_decay_improvement, 1 keeps the noise scale constant */
+  double noise_decay_improvement = 0.01; /**< @brief Relative cost improvement below which the cost is considered to be converging */
+  double min_noise_scale = 0.1;          /**< @brief Lower bound of the noise scale */
+  double covariance_adaptation_rate = 0.0; /**< @brief When positive the joint space covariance of the noise passed to
+                                                Task::setNoiseCovariance() moves by this fraction in (0,1] towards the
+                                                probability weighted covariance of the rollouts every iteration, 0 keeps the
+                                                noise of the task */
+  bool adapt_cross_covariance = false;   /**< @brief Whether or not the covariance between joints is adapted, otherwise only the
+                                              variance of each joint is */
+
+  // Convergence, each rule is disabled by default and stops the solve whether or not the parameters are valid
+  int convergence_window = 0;            /**< @brief When positive the solve stops once the lowest cost improved by less than
+                                              convergence_cost_tolerance, relative to its value this many iterations earlier */
+  double convergence_cost_tolerance = 1e-3; /**< @brief Relative cost improvement over convergence_window below which the cost
+                                                 is considered converged */
+  double convergence_update_tolerance = 0.0; /**< @brief When positive the solve stops once the largest absolute parameter
+                                                  update of an iteration falls below this value */
+  int max_stagnant_iterations = 0;       /**< @brief When positive the solve stops after this many consecutive iterations that
+                                              did not lower the cost */
+
+  // Coarse-to-fine
+  std::vector<int> coarse_timesteps;     /**< @brief The number of timesteps of each coarse level in increasing order, optimized before
+                                              the full resolution when the task supports it, empty by default */
+  std::vector<int> coarse_iterations;    /**< @brief The maximum number of iterations of each coarse level, the full resolution runs
+                                              for the iterations left from num_iterations */
+
+  // Reproducibility
+  std::uint64_t random_seed = 0;         /**< @brief The master seed passed to Task::setRandomSeed(), tasks that draw their noise from
+                                              a RandomStream of (seed, iteration, rollout) produce the same solution regardless of the
+                                              number of threads */
 };
 
 /** @brief The number of columns in the finite differentiation rule */
@@ -128,6 +205,24 @@ static const double FINITE_FORWARD_DIFF_COEFFS[FINITE_DIFF_RULE_LENGTH][FINITE_D
 void generateFiniteDifferenceMatrix(int num_time_steps, DerivativeOrders::DerivativeOrder order, double dt,
                                     Eigen::MatrixXd& diff_matrix);
 
+/**
+ * @brief Generate the control cost matrix R = dt * A_transpose * A, where A is the acceleration finite difference
+ * matrix, directly in banded form.
+ * @param num_time_steps      The number of timesteps
+ * @param dt                  The timestep in seconds
+ * @param control_cost_matrix The generated control cost matrix with a bandwidth of FINITE_DIFF_RULE_LENGTH - 1
+ */
+void generateControlCostMatrix(int num_time_steps, double dt, SymmetricBandedMatrix& control_cost_matrix);
+
+/**
+ * @brief Resamples each row of the parameters at a different number of evenly spaced timesteps with a natural cubic
+ * spline, the first and last timesteps are preserved.
+ * @param parameters    The parameters [dimensions][timesteps]
+ * @param num_timesteps The number of timesteps of the resampled parameters
+ * @param resampled     The resampled parameters [dimensions][num_timesteps]
+ */
+void resampleCubic(const Eigen::MatrixXd& parameters,int num_timesteps,Eigen::MatrixXd& resampled);
+
 /**
  * @brief Differentiates the input parameters based on the DerivativeOrder.
  * @param parameters  The parameters to be differentiated
@@ -139,13 +234,24 @@ void differentiate(const Eigen::VectorXd& parameters, DerivativeOrders::Derivati
                           double dt, Eigen::VectorXd& derivatives );
 
 /**
- * @brief Generate a smoothing matrix M
+ * @brief Generate a smoothing matrix M, the matrix is copied from the MatrixCache so it is only computed once for
+ * each (num_time_steps,dt) pair.
  * @param num_time_steps       The number of timesteps
  * @param dt                   The timestep in seconds
  * @param projection_matrix_M  The smoothing matrix
  */
 void generateSmoothingMatrix(int num_time_steps, double dt, Eigen::MatrixXd& projection_matrix_M);
 
+/**
+ * @brief Flags the timesteps (columns) at which the parameters differ from the reference parameters
+ * @param parameters        The parameters [num_dimensions][num_time_steps]
+ * @param reference         The reference parameters with the same size as 'parameters'
+ * @param changed_timesteps The mask [num_time_steps] of the changed timesteps, it must already have the right size
+ * @return The number of changed timesteps
+ */
+int computeChangedTimesteps(const Eigen::MatrixXd& parameters,const Eigen::MatrixXd& reference,
+                            TimestepMask& changed_timesteps);
+
 /**
  * @brief Convert a Eigen::MatrixXd to a std::vector<Eigen::VectorXd>
  * Each element in the std::vector represents a row in the Eigen::MatrixXd
@@ -0,0 +1,235 @@
+/**
+ * @file banded_matrix.cpp
+ * @brief This defines a symmetric banded matrix used to store the stomp control cost matrices
+ *
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+#include "stomp_core/banded_matrix.h"
+
+namespace stomp_core
+{
+
+SymmetricBandedMatrix::SymmetricBandedMatrix():
+    size_(0),
+    bandwidth_(0),
+    factorized_(false)
+{
+
+}
+
+SymmetricBandedMatrix::SymmetricBandedMatrix(int size,int bandwidth)
+{
+  resize(size,bandwidth);
+}
+
+void SymmetricBandedMatrix::resize(int size,int bandwidth)
+{
+  size_ = size;
+  bandwidth_ = std::min(bandwidth,std::max(size - 1,0));
+  bands_.setZero(bandwidth_ + 1,size_);
+  factor_L_.resize(0,0);
+  factor_D_.resize(0);
+  factorized_ = false;
+}
+
+double SymmetricBandedMatrix::coeff(int row,int col) const
+{
+  if(row < col)
+  {
+    std::swap(row,col);
+  }
+
+  return (row - col) > bandwidth_ ? 0.0 : bands_(row - col,col);
+}
+
+double& SymmetricBandedMatrix::coeffRef(int row,int col)
+{
+  if(row < col)
+  {
+    std::swap(row,col);
+  }
+
+  factorized_ = false;
+  return bands_(row - col,col);
+}
+
+SymmetricBandedMatrix SymmetricBandedMatrix::block(int start,int size) const
+{
+  SymmetricBandedMatrix m(size,bandwidth_);
+  m.bands_ = bands_.block(0,start,m.bandwidth_ + 1,size);
+
+  // entries that reach beyond the end of the block are not part of it
+  for(int k = 1; k <= m.bandwidth_; k++)
+  {
+    m.bands_.row(k).tail(k).setZero();
+  }
+
+  return m;
+}
+
+void SymmetricBandedMatrix::scale(double s)
+{
+  bands_ *= s;
+  if(factorized_)
+  {
+    factor_D_ *= s;
+  }
+}
+
+double SymmetricBandedMatrix::quadraticForm(const Eigen::Ref<const Eigen::RowVectorXd,0,Eigen::InnerStride<> >& x) const
+{
+  double diagonal = 0;
+  double off_diagonal = 0;
+  for(int j = 0; j < size_; j++)
+  {
+    diagonal += bands_(0,j) * x(j) * x(j);
+
+    int last = std::min(bandwidth_,size_ - 1 - j);
+    for(int k = 1; k <= last; k++)
+    {
+      off_diagonal += bands_(k,j) * x(j + k) * x(j);
+    }
+  }
+
+  return diagonal + 2*off_diagonal;
+}
+
+bool SymmetricBandedMatrix::factorize()
+{
+  factor_L_.setZero(bandwidth_ + 1,size_);
+  factor_D_.setZero(size_);
+
+  for(int j = 0; j < size_; j++)
+  {
+    int first = std::max(0,j - bandwidth_);
+
+    // diagonal factor
+    double d = bands_(0,j);
+    for(int k = first; k < j; k++)
+    {
+      double l = factor_L_(j - k,k);
+      d -= l * l * factor_D_(k);
+    }
+
+    if(d <= 0)
+    {
+      factorized_ = false;
+      return false;
+    }
+    factor_D_(j) = d;
+    factor_L_(0,j) = 1.0;
+
+    // column 'j' of the lower factor
+    int last = std::min(size_ - 1,j + bandwidth_);
+    for(int i = j + 1; i <= last; i++)
+    {
+      double v = bands_(i - j,j);
+      for(int k = std::max(0,i - bandwidth_); k < j; k++)
+      {
+        v -= factor_L_(i - k,k) * factor_L_(j - k,k) * factor_D_(k);
+      }
+      factor_L_(i - j,j) = v/d;
+    }
+  }
+
+  factorized_ = true;
+  return true;
+}
+
+void SymmetricBandedMatrix::solveInPlace(Eigen::Ref<Eigen::VectorXd> x) const
+{
+  // forward substitution L * y = b
+  for(int i = 0; i < size_; i++)
+  {
+    for(int k = std::max(0,i - bandwidth_); k < i; k++)
+    {
+      x(i) -= factor_L_(i - k,k) * x(k);
+    }
+  }
+
+  // diagonal
+  x.array() /= factor_D_.array();
+
+  // backward substitution L^T * x = z
+  for(int i = size_ - 1; i >= 0; i--)
+  {
+    int last = std::min(size_ - 1,i + bandwidth_);
+    for(int k = i + 1; k <= last; k++)
+    {
+      x(i) -= factor_L_(k - i,i) * x(k);
+    }
+  }
+}
+
+void SymmetricBandedMatrix::inverseDiagonal(Eigen::VectorXd& diagonal) const
+{
+  /*
+   * Takahashi recurrence: only the entries of the inverse Z that lie within the band are computed, starting from the
+   * bottom right corner.
+   *   Z(i,j) = - sum_k Z(i,k)*L(k,j)            for j < i
+   *   Z(j,j) = 1/D(j) - sum_k L(k,j)*Z(k,j)
+   */
+  Eigen::MatrixXd z = Eigen::MatrixXd::Zero(bandwidth_ + 1,size_);
+  auto z_coeff = [&](int row,int col) -> double
+  {
+    return row >= col ? z(row - col,col) : z(col - row,row);
+  };
+
+  for(int j = size_ - 1; j >= 0; j--)
+  {
+    int last = std::min(size_ - 1,j + bandwidth_);
+    for(int i = last; i > j; i--)
+    {
+      double v = 0;
+      for(int k = j + 1; k <= last; k++)
+      {
+        v -= z_coeff(i,k) * factor_L_(k - j,j);
+      }
+      z(i - j,j) = v;
+    }
+
+    double v = 1.0/factor_D_(j);
+    for(int k = j + 1; k <= last; k++)
+    {
+      v -= factor_L_(k - j,j) * z(k - j,j);
+    }
+    z(0,j) = v;
+  }
+
+  diagonal = z.row(0).transpose();
+}
+
+Eigen::MatrixXd SymmetricBandedMatrix::toDense() const
+{
+  Eigen::MatrixXd m = Eigen::MatrixXd::Zero(size_,size_);
+  for(int k = 0; k <= bandwidth_; k++)
+  {
+    for(int j = 0; j + k < size_; j++)
+    {
+      m(j + k,j) = bands_(k,j);
+      m(j,j + k) = bands_(k,j);
+    }
+  }
+
+  return m;
+}
+
+} /* namespace stomp_core */
@@ -0,0 +1,217 @@
+/**
+ * @file matrix_cache.cpp
+ * @brief This defines a process wide cache of the constant matrices used by stomp
+ *
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <Eigen/Cholesky>
+#include <Eigen/LU>
+#include "stomp_core/matrix_cache.h"
+
+static const std::size_t MAX_CACHED_ENTRIES = 32;  /**< Maximum number of entries of each type, the map is flushed when exceeded */
+
+namespace stomp_core
+{
+
+/**
+ * @brief Computes the inverse of a symmetric positive definite banded matrix one column at a time.
+ * @param m         The factorized banded matrix
+ * @param inverse   The dense inverse
+ */
+static void computeFactorizedInverse(const SymmetricBandedMatrix& m,Eigen::MatrixXd& inverse)
+{
+  inverse = Eigen::MatrixXd::Identity(m.size(),m.size());
+  for(int t = 0; t < m.size(); t++)
+  {
+    m.solveInPlace(inverse.col(t));
+  }
+}
+
+/**
+ * @brief Computes the inverse of a banded matrix, falls back to a dense decomposition when the matrix is not positive
+ * definite enough to be factorized.
+ * @param m         The banded matrix
+ * @param inverse   The dense inverse
+ */
+static void computeInverse(SymmetricBandedMatrix& m,Eigen::MatrixXd& inverse)
+{
+  if(m.factorize())
+  {
+    computeFactorizedInverse(m,inverse);
+  }
+  else
+  {
+    inverse = m.toDense().fullPivLu().inverse();
+  }
+}
+
+static ControlCostMatricesConstPtr buildControlCostMatrices(int num_timesteps,double dt)
+{
+  int start_index_padded = FINITE_DIFF_RULE_LENGTH-1;
+  int num_timesteps_padded = num_timesteps + 2*(FINITE_DIFF_RULE_LENGTH-1);
+
+  /* control cost matrix (R = A_transpose * A):
+   * Note: Original code multiplies the A product by the time interval.  However this is not
+   * what was described in the literature.
+   */
+  std::shared_ptr<ControlCostMatrices> m(new ControlCostMatrices());
+  generateControlCostMatrix(num_timesteps_padded,dt,m->R_padded);
+  m->R = m->R_padded.block(start_index_padded,num_timesteps);
+  if(!m->R.factorize())
+  {
+    return nullptr;
+  }
+
+  /*
+   * Applying scale factor to ensure that max(R^-1)==1, the largest entry of the inverse of a
+   * symmetric positive definite matrix lies on its diagonal
+   */
+  Eigen::VectorXd inv_diagonal;
+  m->R.inverseDiagonal(inv_diagonal);
+  double maxVal = std::abs(inv_diagonal.maxCoeff());
+  m->R_padded.scale(maxVal);
+  m->R.scale(maxVal);
+
+  return m;
+}
+
+static MatrixConstPtr buildSmoothingMatrix(int num_timesteps,double dt)
+{
+  // the inverse of the unpadded control cost matrix
+  SymmetricBandedMatrix R;
+  generateControlCostMatrix(num_timesteps + 2*(FINITE_DIFF_RULE_LENGTH-1),dt,R);
+  R = R.block(FINITE_DIFF_RULE_LENGTH-1,num_timesteps);
+
+  std::shared_ptr<Eigen::MatrixXd> projection_matrix_M(new Eigen::MatrixXd());
+  computeInverse(R,*projection_matrix_M);
+
+  for(int t = 0; t < num_timesteps; t++)
+  {
+    double max = (*projection_matrix_M)(t,t);
+    projection_matrix_M->col(t)*= (1.0/(num_timesteps*max)); // scaling such that the maximum value is 1/num_timesteps
+  }
+
+  return projection_matrix_M;
+}
+
+static SamplingCovarianceConstPtr buildSamplingCovariance(int num_timesteps)
+{
+  // A^T * A for the unpadded acceleration matrix, the timestep is irrelevant since the covariance gets normalized
+  SymmetricBandedMatrix precision;
+  generateControlCostMatrix(num_timesteps,1.0,precision);
+
+  std::shared_ptr<SamplingCovariance> c(new SamplingCovariance());
+  computeInverse(precision,c->covariance);
+  c->covariance /= c->covariance.cwiseAbs().maxCoeff();
+  c->cholesky = c->covariance.llt().matrixL();
+
+  return c;
+}
+
+MatrixCache& MatrixCache::instance()
+{
+  static MatrixCache cache;
+  return cache;
+}
+
+MatrixCache::MatrixCache()
+{
+
+}
+
+template <typename T,typename Builder>
+std::shared_ptr<const T> MatrixCache::getOrBuild(std::map<Key,std::shared_ptr<const T> >& entries,const Key& key,
+                                                 Builder build)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries.find(key);
+    if(it != entries.end())
+    {
+      return it->second;
+    }
+  }
+
+  std::shared_ptr<const T> entry = build();
+  if(!entry)
+  {
+    return entry;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if(entries.size() >= MAX_CACHED_ENTRIES && entries.count(key) == 0)
+  {
+    entries.clear();
+  }
+
+  return entries.emplace(key,entry).first->second;
+}
+
+MatrixConstPtr MatrixCache::getFiniteDifferenceMatrix(int num_timesteps,DerivativeOrders::DerivativeOrder order,double dt)
+{
+  return getOrBuild(finite_difference_matrices_,Key(num_timesteps,order,dt),[&]()
+  {
+    std::shared_ptr<Eigen::MatrixXd> m(new Eigen::MatrixXd());
+    generateFiniteDifferenceMatrix(num_timesteps,order,dt,*m);
+    return MatrixConstPtr(m);
+  });
+}
+
+ControlCostMatricesConstPtr MatrixCache::getControlCostMatrices(int num_timesteps,double dt)
+{
+  return getOrBuild(control_cost_matrices_,Key(num_timesteps,DerivativeOrders::STOMP_ACCELERATION,dt),[&]()
+  {
+    return buildControlCostMatrices(num_timesteps,dt);
+  });
+}
+
+MatrixConstPtr MatrixCache::getSmoothingMatrix(int num_timesteps,double dt)
+{
+  return getOrBuild(smoothing_matrices_,Key(num_timesteps,DerivativeOrders::STOMP_ACCELERATION,dt),[&]()
+  {
+    return buildSmoothingMatrix(num_timesteps,dt);
+  });
+}
+
+SamplingCovarianceConstPtr MatrixCache::getSamplingCovariance(int num_timesteps)
+{
+  return getOrBuild(sampling_covariances_,Key(num_timesteps,DerivativeOrders::STOMP_ACCELERATION,0.0),[&]()
+  {
+    return buildSamplingCovariance(num_timesteps);
+  });
+}
+
+void MatrixCache::clear()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  finite_difference_matrices_.clear();
+  control_cost_matrices_.clear();
+  smoothing_matrices_.clear();
+  sampling_covariances_.clear();
+}
+
+std::size_t MatrixCache::size() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return finite_difference_matrices_.size() + control_cost_matrices_.size() + smoothing_matrices_.size() +
+      sampling_covariances_.size();
+}
+
+} /* namespace stomp_core */
@@ -0,0 +1,260 @@
+/**
+ * @file multi_start_stomp.cpp
+ * @brief This defines a multi-start solver that runs several stomp optimizations concurrently
+ *
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <ros/console.h>
+#include <cmath>
+#include <limits>
+#include "stomp_core/multi_start_stomp.h"
+#include "stomp_core/random_stream.h"
+
+static const double DEFAULT_SEED_PERTURBATION = 0.1;  /**< Default amplitude of the perturbation applied to the extra seeds */
+
+/** @brief The initialization methods the starts cycle through */
+static const stomp_core::TrajectoryInitializations::TrajectoryInitialization INITIALIZATION_METHODS[] = {
+    stomp_core::TrajectoryInitializations::CUBIC_POLYNOMIAL_INTERPOLATION,
+    stomp_core::TrajectoryInitializations::LINEAR_INTERPOLATION,
+    stomp_core::TrajectoryInitializations::MININUM_CONTROL_COST};
+static const int NUM_INITIALIZATION_METHODS = 3;
+
+namespace stomp_core
+{
+
+MultiStartStomp::MultiStartStomp(const StompConfiguration& config,const std::vector<TaskPtr>& tasks,
+                                 ThreadPoolPtr thread_pool):
+    config_(config),
+    thread_pool_(thread_pool),
+    policy_(MultiStartPolicies::FIRST_VALID),
+    seed_perturbation_(DEFAULT_SEED_PERTURBATION),
+    proceed_(true),
+    selected_start_(-1)
+{
+  // each start runs serially, the concurrency comes from running the starts on the pool
+  config_.num_threads = 1;
+  for(auto& task : tasks)
+  {
+    stomps_.emplace_back(new Stomp(config_,task));
+  }
+
+  if(!thread_pool_)
+  {
+    thread_pool_.reset(new ThreadPool(tasks.size()));
+  }
+}
+
+bool MultiStartStomp::solve(const std::vector<double>& first,const std::vector<double>& last,
+                            Eigen::MatrixXd& parameters_optimized)
+{
+  return runStarts([&](int start,Stomp& stomp,Eigen::MatrixXd& parameters) -> bool
+  {
+    if(start < NUM_INITIALIZATION_METHODS)
+    {
+      return stomp.solve(first,last,parameters);
+    }
+
+    // linear interpolation with a random perturbation
+    Eigen::MatrixXd initial_parameters(config_.num_dimensions,config_.num_timesteps);
+    for(int d = 0; d < config_.num_dimensions; d++)
+    {
+      initial_parameters.row(d) = Eigen::RowVectorXd::LinSpaced(config_.num_timesteps,first[d],last[d]);
+    }
+    perturb(start,initial_parameters);
+    return stomp.solve(initial_parameters,parameters);
+  },parameters_optimized);
+}
+
+bool MultiStartStomp::solve(const std::vector<Eigen::MatrixXd>& initial_parameters,
+                            Eigen::MatrixXd& parameters_optimized)
+{
+  if(initial_parameters.empty())
+  {
+    ROS_ERROR("Multi-start STOMP requires at least one seed");
+    return false;
+  }
+
+  return runStarts([&](int start,Stomp& stomp,Eigen::MatrixXd& parameters) -> bool
+  {
+    Eigen::MatrixXd seed = initial_parameters[start % initial_parameters.size()];
+    if(start >= static_cast<int>(initial_parameters.size()))
+    {
+      perturb(start,seed);
+    }
+    return stomp.solve(seed,parameters);
+  },parameters_optimized);
+}
+
+void MultiStartStomp::setConfig(const StompConfiguration& config)
+{
+  config_ = config;
+  config_.num_threads = 1;
+}
+
+void MultiStartStomp::setPolicy(MultiStartPolicies::MultiStartPolicy policy)
+{
+  policy_ = policy;
+}
+
+void MultiStartStomp::setSeedPerturbation(double amplitude)
+{
+  seed_perturbation_ = amplitude;
+}
+
+void MultiStartStomp::setDeadline(const std::chrono::steady_clock::time_point& deadline)
+{
+  for(auto& stomp : stomps_)
+  {
+    stomp->setDeadline(deadline);
+  }
+}
+
+void MultiStartStomp::clearDeadline()
+{
+  for(auto& stomp : stomps_)
+  {
+    stomp->clearDeadline();
+  }
+}
+
+bool MultiStartStomp::cancel()
+{
+  proceed_ = false;
+  for(auto& stomp : stomps_)
+  {
+    stomp->cancel();
+  }
+  return true;
+}
+
+int MultiStartStomp::getNumStarts() const
+{
+  return stomps_.size();
+}
+
+int MultiStartStomp::getSelectedStart() const
+{
+  return selected_start_;
+}
+
+bool MultiStartStomp::runStarts(const StartFunction& start_function,Eigen::MatrixXd& parameters_optimized)
+{
+  int num_starts = stomps_.size();
+  if(num_starts == 0)
+  {
+    ROS_ERROR("Multi-start STOMP has no starts");
+    return false;
+  }
+
+  /*
+   * resetting every start before any of them runs, this also clears the cancellation of the previous solve.  The
+   * starts cycle through the initialization methods, which only matter when solving from a start and end state, and
+   * each start gets its own seed derived from the master seed so that the starts explore different noise.
+   */
+  RandomStream seeds(config_.random_seed);
+  for(int s = 0; s < num_starts; s++)
+  {
+    StompConfiguration config = config_;
+    config.initialization_method = INITIALIZATION_METHODS[s % NUM_INITIALIZATION_METHODS];
+    config.random_seed = seeds();
+    stomps_[s]->setConfig(config);
+  }
+  proceed_ = true;
+  selected_start_ = -1;
+
+  std::vector<Eigen::MatrixXd> solutions(num_starts);
+  std::vector<double> costs(num_starts,std::numeric_limits<double>::max());
+  std::vector<char> valid(num_starts,false);
+
+  thread_pool_->parallelFor(num_starts,[&](int start,int /*worker*/)
+  {
+    if(!proceed_)
+    {
+      return;
+    }
+
+    Stomp& stomp = *stomps_[start];
+    if(!start_function(start,stomp,solutions[start]))
+    {
+      return;
+    }
+
+    valid[start] = stomp.getBestSolution(solutions[start],costs[start]);
+    if(!valid[start] || policy_ != MultiStartPolicies::FIRST_VALID)
+    {
+      return;
+    }
+
+    // the first valid start wins and cancels the others
+    int none = -1;
+    if(selected_start_.compare_exchange_strong(none,start))
+    {
+      proceed_ = false;
+      for(int s = 0; s < num_starts; s++)
+      {
+        if(s != start)
+        {
+          stomps_[s]->cancel();
+        }
+      }
+    }
+  });
+
+  if(policy_ == MultiStartPolicies::LOWEST_COST)
+  {
+    for(int s = 0; s < num_starts; s++)
+    {
+      if(valid[s] && (selected_start_ < 0 || costs[s] < costs[selected_start_]))
+      {
+        selected_start_ = s;
+      }
+    }
+  }
+
+  if(selected_start_ < 0)
+  {
+    ROS_ERROR("Multi-start STOMP failed to find a valid solution in %i starts",num_starts);
+    parameters_optimized = solutions.front();
+    return false;
+  }
+
+  ROS_INFO("Multi-start STOMP selected start %i with cost %f",int(selected_start_),costs[selected_start_]);
+  parameters_optimized = solutions[selected_start_];
+  return true;
+}
+
+void MultiStartStomp::perturb(int start,Eigen::MatrixXd& parameters) const
+{
+  // a half sine bump with a random amplitude on each dimension
+  RandomStream stream(config_.random_seed,0,start);
+  int num_timesteps = parameters.cols();
+  Eigen::RowVectorXd bump(num_timesteps);
+  for(int t = 0; t < num_timesteps; t++)
+  {
+    bump(t) = std::sin(M_PI * t / (num_timesteps - 1));
+  }
+
+  for(auto d = 0u; d < parameters.rows(); d++)
+  {
+    parameters.row(d) += seed_perturbation_ * stream.normal() * bump;
+  }
+}
+
+} /* namespace stomp_core */
@@ -0,0 +1,119 @@
+/**
+ * @file profiler.cpp
+ * @brief This defines the timers and call counters used to profile the phases of a solve
+ *
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <sstream>
+#include "stomp_core/profiler.h"
+
+namespace stomp_core
+{
+
+const ProfileEntry* ProfileReport::find(const std::string& name) const
+{
+  for(const auto& e : entries)
+  {
+    if(e.name == name)
+    {
+      return &e;
+    }
+  }
+
+  return nullptr;
+}
+
+std::string ProfileReport::toCsvHeader() const
+{
+  std::stringstream ss;
+  for(auto i = 0u; i < entries.size(); i++)
+  {
+    ss<<(i > 0 ? "," : "")<<entries[i].name<<".calls,"<<entries[i].name<<".time";
+  }
+
+  return ss.str();
+}
+
+std::string ProfileReport::toCsv() const
+{
+  std::stringstream ss;
+  for(auto i = 0u; i < entries.size(); i++)
+  {
+    ss<<(i > 0 ? "," : "")<<entries[i].calls<<","<<entries[i].total_time;
+  }
+
+  return ss.str();
+}
+
+std::string ProfileReport::toJson() const
+{
+  std::stringstream ss;
+  ss<<"{";
+  for(auto i = 0u; i < entries.size(); i++)
+  {
+    ss<<(i > 0 ? "," : "")<<"\""<<entries[i].name<<"\":{\"calls\":"<<entries[i].calls<<",\"time\":"
+        <<entries[i].total_time<<"}";
+  }
+  ss<<"}";
+
+  return ss.str();
+}
+
+int Profiler::addCounter(const std::string& name)
+{
+  counters_.emplace_back(name);
+  return counters_.size() - 1;
+}
+
+int Profiler::size() const
+{
+  return counters_.size();
+}
+
+void Profiler::record(int counter,Clock::duration elapsed)
+{
+  Counter& c = counters_[counter];
+  c.total_time.fetch_add(elapsed.count(),std::memory_order_relaxed);
+  c.calls.fetch_add(1,std::memory_order_relaxed);
+}
+
+void Profiler::reset()
+{
+  for(auto& c : counters_)
+  {
+    c.total_time = 0;
+    c.calls = 0;
+  }
+}
+
+void Profiler::getReport(ProfileReport& report) const
+{
+  using namespace std::chrono;
+  for(const auto& c : counters_)
+  {
+    ProfileEntry entry;
+    entry.name = c.name;
+    entry.calls = c.calls;
+    entry.total_time = duration_cast<duration<double> >(Clock::duration(c.total_time)).count();
+    report.entries.push_back(entry);
+  }
+}
+
+} /* namespace stomp_core */
@@ -0,0 +1,95 @@
+/**
+ * @file random_stream.cpp
+ * @brief This defines a seedable random number stream that is reproducible for every (iteration, rollout) pair
+ *
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cmath>
+#include "stomp_core/random_stream.h"
+
+static const std::uint64_t GOLDEN_GAMMA = 0x9e3779b97f4a7c15ULL;
+static const double UNIFORM_RESOLUTION = 1.0/9007199254740992.0; /**< @brief 2^-53, the spacing of the doubles in [0,1) */
+
+/**
+ * @brief The splitmix64 output function, a bijection that scatters neighboring inputs across the whole 64 bit range
+ * @param z The input
+ * @return  The mixed value
+ */
+static std::uint64_t mix(std::uint64_t z)
+{
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+namespace stomp_core
+{
+
+RandomStream::RandomStream(std::uint64_t seed,std::uint64_t iteration,std::uint64_t rollout)
+{
+  reset(seed,iteration,rollout);
+}
+
+void RandomStream::reset(std::uint64_t seed,std::uint64_t iteration,std::uint64_t rollout)
+{
+  // mixing after each index so that consecutive iterations and rollouts start far apart in the sequence
+  state_ = mix(seed + GOLDEN_GAMMA);
+  state_ = mix(state_ + (iteration + 1) * GOLDEN_GAMMA);
+  state_ = mix(state_ + (rollout + 1) * GOLDEN_GAMMA);
+  has_spare_normal_ = false;
+  spare_normal_ = 0.0;
+}
+
+RandomStream::result_type RandomStream::operator()()
+{
+  state_ += GOLDEN_GAMMA;
+  return mix(state_);
+}
+
+double RandomStream::uniform()
+{
+  return ((*this)() >> 11) * UNIFORM_RESOLUTION;
+}
+
+double RandomStream::normal()
+{
+  if(has_spare_normal_)
+  {
+    has_spare_normal_ = false;
+    return spare_normal_;
+  }
+
+  // marsaglia polar method, each accepted pair yields two samples
+  double u, v, s;
+  do
+  {
+    u = 2.0 * uniform() - 1.0;
+    v = 2.0 * uniform() - 1.0;
+    s = u * u + v * v;
+  }
+  while(s >= 1.0 || s == 0.0);
+
+  double factor = std::sqrt(-2.0 * std::log(s) / s);
+  spare_normal_ = v * factor;
+  has_spare_normal_ = true;
+  return u * factor;
+}
+
+} /* namespace stomp_core */
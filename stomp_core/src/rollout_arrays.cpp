@@ -0,0 +1,152 @@
+/**
+ * @file rollout_arrays.cpp
+ * @brief This defines the rollout arrays used to compute the probabilities and the parameter updates in single or double precision
+ *
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <ros/console.h>
+#include "stomp_core/rollout_arrays.h"
+
+static const double MIN_COST_DIFFERENCE = 1e-8; /**< Minimum cost difference allowed during probability calculation */
+
+namespace stomp_core
+{
+
+/**
+ * @brief The rollout arrays stored with a given scalar type
+ * @tparam Scalar     The scalar type of the arrays
+ * @tparam Dimensions The number of dimensions if known at compile time, otherwise Eigen::Dynamic
+ */
+template <typename Scalar,int Dimensions>
+class RolloutArraysImpl: public RolloutArrays
+{
+public:
+
+  typedef Eigen::Matrix<Scalar,Eigen::Dynamic,Eigen::Dynamic> Matrix;
+  typedef Eigen::Matrix<Scalar,Eigen::Dynamic,1> Vector;
+
+  void resize(int num_entries,int max_rollouts) override
+  {
+    noise_.setZero(num_entries,max_rollouts);
+    total_costs_.setZero(num_entries,max_rollouts);
+    probabilities_.setZero(num_entries,max_rollouts);
+    importance_weights_.setOnes(max_rollouts);
+    min_costs_.setZero(num_entries);
+    cost_ranges_.setZero(num_entries);
+    probability_sums_.setZero(num_entries);
+  }
+
+  void setRolloutCosts(int rollout_index,const Eigen::MatrixXd& control_costs,const Eigen::VectorXd& state_costs,
+                       double importance_weight) override
+  {
+    Eigen::Map<const Eigen::Matrix<double,Dimensions,Eigen::Dynamic> > rollout_control_costs(
+        control_costs.data(),control_costs.rows(),control_costs.cols());
+    Eigen::Map<Eigen::Matrix<Scalar,Dimensions,Eigen::Dynamic> > total_costs(
+        total_costs_.col(rollout_index).data(),control_costs.rows(),control_costs.cols());
+    total_costs = (rollout_control_costs.rowwise() + state_costs.transpose()).template cast<Scalar>();
+    importance_weights_(rollout_index) = static_cast<Scalar>(importance_weight);
+  }
+
+  void setRolloutNoise(int rollout_index,const Eigen::MatrixXd& noise) override
+  {
+    noise_.col(rollout_index) = Eigen::Map<const Eigen::VectorXd>(noise.data(),noise.size()).template cast<Scalar>();
+  }
+
+  void computeProbabilities(int num_rollouts,double sensitivity) override
+  {
+    const Scalar h = static_cast<Scalar>(sensitivity);
+    auto costs = total_costs_.leftCols(num_rollouts);
+    auto probabilities = probabilities_.leftCols(num_rollouts);
+
+    // find min and max cost over all rollouts for every dimension and timestep, preventing division by zero
+    min_costs_.noalias() = costs.rowwise().minCoeff();
+    cost_ranges_.noalias() = costs.rowwise().maxCoeff();
+    cost_ranges_ = (cost_ranges_ - min_costs_).cwiseMax(static_cast<Scalar>(MIN_COST_DIFFERENCE));
+
+    // this is the exponential term in the probability calculation described in the literature
+    probabilities.array() = ((costs.colwise() - min_costs_).array().colwise() / cost_ranges_.array() * -h).exp();
+    probabilities.array().rowwise() *= importance_weights_.head(num_rollouts).transpose().array();
+
+    // scaling each probability value by the sum of all probabilities corresponding to all rollouts at time "t"
+    probability_sums_.noalias() = probabilities.rowwise().sum();
+    probabilities.array().colwise() /= probability_sums_.array();
+  }
+
+  void computeUpdates(int num_rollouts,Eigen::MatrixXd& updates) const override
+  {
+    Eigen::Map<Eigen::VectorXd>(updates.data(),updates.size()).noalias() =
+        (noise_.leftCols(num_rollouts).array() * probabilities_.leftCols(num_rollouts).array()).rowwise().sum()
+        .matrix().template cast<double>();
+  }
+
+  double getProbability(int entry,int rollout_index) const override
+  {
+    return probabilities_(entry,rollout_index);
+  }
+
+protected:
+
+  Matrix noise_;                  /**< @brief The noise of each rollout */
+  Matrix total_costs_;            /**< @brief The total cost (state + control) of each rollout at every dimension and timestep */
+  Matrix probabilities_;          /**< @brief The probability of each rollout at every dimension and timestep */
+  Vector importance_weights_;     /**< @brief A vector [max_rollouts] of the rollouts importance sampling weights */
+  Vector min_costs_;              /**< @brief A vector [dimensions x timesteps] of the min cost among the rollouts */
+  Vector cost_ranges_;            /**< @brief A vector [dimensions x timesteps] of the max - min cost among the rollouts */
+  Vector probability_sums_;       /**< @brief A vector [dimensions x timesteps] of the sum of the rollouts probabilities */
+};
+
+/**
+ * @brief Creates the arrays specialized for the number of dimensions
+ * @param num_dimensions  The number of dimensions
+ * @return The arrays
+ */
+template <typename Scalar>
+static RolloutArraysPtr createForDimensions(int num_dimensions)
+{
+  switch(num_dimensions)
+  {
+    case 6:
+      return RolloutArraysPtr(new RolloutArraysImpl<Scalar,6>());
+
+    case 7:
+      return RolloutArraysPtr(new RolloutArraysImpl<Scalar,7>());
+
+    default:
+      return RolloutArraysPtr(new RolloutArraysImpl<Scalar,Eigen::Dynamic>());
+  }
+}
+
+RolloutArraysPtr RolloutArrays::create(int precision,int num_dimensions)
+{
+  switch(precision)
+  {
+    case KernelPrecisions::DOUBLE:
+      return createForDimensions<double>(num_dimensions);
+
+    case KernelPrecisions::FLOAT:
+      return createForDimensions<float>(num_dimensions);
+
+    default:
+      ROS_ERROR("Kernel precision %i is not supported",precision);
+      return nullptr;
+  }
+}
+
+} /* namespace stomp_core */
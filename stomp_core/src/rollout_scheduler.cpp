@@ -0,0 +1,106 @@
+/**
+ * @file rollout_scheduler.cpp
+ * @brief This defines the scheduler that adapts the number of rollouts and the noise magnitude during the optimization
+ *
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "stomp_core/rollout_scheduler.h"
+
+static const double ROLLOUTS_GROWTH_RATE = 0.5;      /**< @brief Fraction of rollouts added after an iteration that did not lower the cost */
+static const double ROLLOUTS_SHRINK_RATE = 0.25;     /**< @brief Fraction of rollouts removed after an iteration that lowered the cost */
+static const double MAX_COST_VARIATION = 0.5;        /**< @brief The rollouts are only removed when their cost stddev/mean is below this value */
+static const double MIN_COST_MAGNITUDE = 1e-8;       /**< @brief Prevents dividing by a zero cost */
+
+namespace stomp_core
+{
+
+RolloutScheduler::RolloutScheduler():
+    min_rollouts_(1),
+    max_rollouts_(1),
+    noise_decay_(1.0),
+    noise_decay_improvement_(0.0),
+    min_noise_scale_(1.0),
+    num_rollouts_(1),
+    noise_scale_(1.0)
+{
+
+}
+
+void RolloutScheduler::configure(const StompConfiguration& config)
+{
+  max_rollouts_ = config.num_rollouts;
+  min_rollouts_ = (config.min_rollouts > 0 && config.min_rollouts < max_rollouts_) ? config.min_rollouts : max_rollouts_;
+  noise_decay_ = std::min(std::max(config.noise_decay,0.0),1.0);
+  noise_decay_improvement_ = config.noise_decay_improvement;
+  min_noise_scale_ = std::min(std::max(config.min_noise_scale,0.0),1.0);
+
+  reset();
+}
+
+void RolloutScheduler::reset()
+{
+  num_rollouts_ = max_rollouts_;
+  noise_scale_ = 1.0;
+}
+
+void RolloutScheduler::update(double previous_cost,double cost,double rollouts_cost_mean,double rollouts_cost_stddev)
+{
+  bool improved = cost < previous_cost;
+
+  // the first improvement over an unknown cost counts as a large one
+  double relative_improvement = 1.0;
+  if(improved && previous_cost < std::numeric_limits<double>::max())
+  {
+    relative_improvement = (previous_cost - cost)/std::max(std::abs(previous_cost),MIN_COST_MAGNITUDE);
+  }
+
+  // number of rollouts
+  if(min_rollouts_ < max_rollouts_)
+  {
+    if(!improved)
+    {
+      int growth = std::max(1,static_cast<int>(num_rollouts_ * ROLLOUTS_GROWTH_RATE));
+      num_rollouts_ = std::min(max_rollouts_,num_rollouts_ + growth);
+    }
+    else if(rollouts_cost_stddev <= MAX_COST_VARIATION * std::abs(rollouts_cost_mean))
+    {
+      int shrink = std::max(1,static_cast<int>(num_rollouts_ * ROLLOUTS_SHRINK_RATE));
+      num_rollouts_ = std::max(min_rollouts_,num_rollouts_ - shrink);
+    }
+  }
+
+  // noise scale
+  if(noise_decay_ > 0.0 && noise_decay_ < 1.0)
+  {
+    if(!improved)
+    {
+      noise_scale_ = std::min(1.0,noise_scale_/noise_decay_);
+    }
+    else if(relative_improvement < noise_decay_improvement_)
+    {
+      noise_scale_ = std::max(min_noise_scale_,noise_scale_*noise_decay_);
+    }
+  }
+}
+
+} /* namespace stomp_core */
@@ -0,0 +1,411 @@
+/**
+ * @file segment_stomp.cpp
+ * @brief This defines a solver that optimizes overlapping segments of a long trajectory concurrently
+ *
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <ros/console.h>
+#include <cmath>
+#include <limits>
+#include "stomp_core/segment_stomp.h"
+#include "stomp_core/random_stream.h"
+
+static const int DEFAULT_SEGMENT_TIMESTEPS = 50;  /**< Default number of timesteps of each segment */
+static const int DEFAULT_SEGMENT_OVERLAP = 10;    /**< Default minimum overlap between consecutive segments */
+static const int DEFAULT_MAX_SWEEPS = 3;          /**< Default maximum number of sweeps */
+
+namespace stomp_core
+{
+
+SegmentTask::SegmentTask(TaskPtr task):
+    task_(task),
+    start_timestep_(0),
+    num_timesteps_(0),
+    optimized_costs_available_(false)
+{
+
+}
+
+void SegmentTask::setSegment(const Eigen::MatrixXd& parameters,int start_timestep,int num_timesteps)
+{
+  start_timestep_ = start_timestep;
+  num_timesteps_ = num_timesteps;
+  parameters_ = parameters;
+  scratch_ = parameters;
+  noise_.setZero(parameters.rows(),parameters.cols());
+  costs_.setZero(parameters.cols());
+  optimized_parameters_ = parameters;
+  optimized_costs_.setZero(parameters.cols());
+  optimized_costs_available_ = false;
+  changed_timesteps_.setConstant(parameters.cols(),false);
+}
+
+TaskPtr SegmentTask::getTask() const
+{
+  return task_;
+}
+
+void SegmentTask::setNoiseScale(double scale)
+{
+  task_->setNoiseScale(scale);
+}
+
+void SegmentTask::setRandomSeed(std::uint64_t seed)
+{
+  task_->setRandomSeed(seed);
+}
+
+void SegmentTask::setNoiseCovariance(const Eigen::MatrixXd& covariance)
+{
+  task_->setNoiseCovariance(covariance);
+}
+
+bool SegmentTask::generateNoisyParameters(const Eigen::MatrixXd& parameters,
+                                          std::size_t /*start_timestep*/,
+                                          std::size_t /*num_timesteps*/,
+                                          int iteration_number,
+                                          int rollout_number,
+                                          Eigen::MatrixXd& parameters_noise,
+                                          Eigen::MatrixXd& noise)
+{
+  parameters_.middleCols(start_timestep_,num_timesteps_) = parameters;
+  if(!task_->generateNoisyParameters(parameters_,0,parameters_.cols(),iteration_number,rollout_number,scratch_,noise_))
+  {
+    return false;
+  }
+
+  // the boundary conditions are not perturbed
+  noise = noise_.middleCols(start_timestep_,num_timesteps_);
+  noise.col(0).setZero();
+  noise.col(num_timesteps_ - 1).setZero();
+  parameters_noise = parameters + noise;
+  return true;
+}
+
+bool SegmentTask::computeNoisyCosts(const Eigen::MatrixXd& parameters,
+                                    std::size_t /*start_timestep*/,
+                                    std::size_t /*num_timesteps*/,
+                                    int iteration_number,
+                                    int rollout_number,
+                                    Eigen::VectorXd& costs,
+                                    bool& validity)
+{
+  parameters_.middleCols(start_timestep_,num_timesteps_) = parameters;
+  if(!computeTrajectoryCosts(iteration_number,rollout_number,validity))
+  {
+    return false;
+  }
+
+  costs = costs_.segment(start_timestep_,num_timesteps_);
+  return true;
+}
+
+bool SegmentTask::computeCosts(const Eigen::MatrixXd& parameters,
+                               std::size_t /*start_timestep*/,
+                               std::size_t /*num_timesteps*/,
+                               int iteration_number,
+                               Eigen::VectorXd& costs,
+                               bool& validity)
+{
+  parameters_.middleCols(start_timestep_,num_timesteps_) = parameters;
+  if(!computeTrajectoryCosts(iteration_number,-1,validity))
+  {
+    optimized_costs_available_ = false;
+    return false;
+  }
+
+  optimized_parameters_ = parameters_;
+  optimized_costs_ = costs_;
+  optimized_costs_available_ = true;
+
+  costs = costs_.segment(start_timestep_,num_timesteps_);
+  return true;
+}
+
+bool SegmentTask::computeTrajectoryCosts(int iteration_number,int rollout_number,bool& validity)
+{
+  if(!optimized_costs_available_)
+  {
+    return rollout_number < 0 ?
+        task_->computeCosts(parameters_,0,parameters_.cols(),iteration_number,costs_,validity) :
+        task_->computeNoisyCosts(parameters_,0,parameters_.cols(),iteration_number,rollout_number,costs_,validity);
+  }
+
+  // only the timesteps of the segment can differ from the last optimized parameters
+  costs_ = optimized_costs_;
+  computeChangedTimesteps(parameters_,optimized_parameters_,changed_timesteps_);
+  return rollout_number < 0 ?
+      task_->computeChangedCosts(parameters_,0,parameters_.cols(),iteration_number,changed_timesteps_,costs_,
+                                 validity) :
+      task_->computeChangedNoisyCosts(parameters_,0,parameters_.cols(),iteration_number,rollout_number,
+                                      changed_timesteps_,costs_,validity);
+}
+
+bool SegmentTask::filterNoisyParameters(std::size_t /*start_timestep*/,
+                                        std::size_t /*num_timesteps*/,
+                                        int iteration_number,
+                                        int rollout_number,
+                                        Eigen::MatrixXd& parameters,
+                                        bool& filtered)
+{
+  scratch_ = optimized_parameters_;
+  scratch_.middleCols(start_timestep_,num_timesteps_) = parameters;
+  if(!task_->filterNoisyParameters(0,scratch_.cols(),iteration_number,rollout_number,scratch_,filtered))
+  {
+    return false;
+  }
+
+  // the boundary conditions are kept
+  parameters.middleCols(1,num_timesteps_ - 2) = scratch_.middleCols(start_timestep_ + 1,num_timesteps_ - 2);
+  return true;
+}
+
+bool SegmentTask::filterParameterUpdates(std::size_t /*start_timestep*/,
+                                         std::size_t /*num_timesteps*/,
+                                         int iteration_number,
+                                         const Eigen::MatrixXd& parameters,
+                                         Eigen::MatrixXd& updates)
+{
+  parameters_.middleCols(start_timestep_,num_timesteps_) = parameters;
+  noise_.setZero();
+  noise_.middleCols(start_timestep_,num_timesteps_) = updates;
+  if(!task_->filterParameterUpdates(0,parameters_.cols(),iteration_number,parameters_,noise_))
+  {
+    return false;
+  }
+
+  // the boundary conditions are not updated
+  updates = noise_.middleCols(start_timestep_,num_timesteps_);
+  updates.col(0).setZero();
+  updates.col(num_timesteps_ - 1).setZero();
+  return true;
+}
+
+SegmentStomp::SegmentStomp(const StompConfiguration& config,const std::vector<TaskPtr>& tasks,
+                           ThreadPoolPtr thread_pool):
+    config_(config),
+    thread_pool_(thread_pool),
+    segment_timesteps_(DEFAULT_SEGMENT_TIMESTEPS),
+    overlap_(DEFAULT_SEGMENT_OVERLAP),
+    max_sweeps_(DEFAULT_MAX_SWEEPS),
+    num_sweeps_(0),
+    proceed_(true)
+{
+  // each segment runs serially, the concurrency comes from running the segments on the pool
+  StompConfiguration segment_config = config_;
+  segment_config.num_threads = 1;
+  for(auto& task : tasks)
+  {
+    segment_tasks_.emplace_back(new SegmentTask(task));
+    stomps_.emplace_back(new Stomp(segment_config,segment_tasks_.back()));
+  }
+
+  if(!thread_pool_)
+  {
+    thread_pool_.reset(new ThreadPool(tasks.size()));
+  }
+}
+
+bool SegmentStomp::solve(const std::vector<double>& first,const std::vector<double>& last,
+                         Eigen::MatrixXd& parameters_optimized)
+{
+  Eigen::MatrixXd initial_parameters(config_.num_dimensions,config_.num_timesteps);
+  for(int d = 0; d < config_.num_dimensions; d++)
+  {
+    initial_parameters.row(d) = Eigen::RowVectorXd::LinSpaced(config_.num_timesteps,first[d],last[d]);
+  }
+
+  return solve(initial_parameters,parameters_optimized);
+}
+
+bool SegmentStomp::solve(const Eigen::MatrixXd& initial_parameters,Eigen::MatrixXd& parameters_optimized)
+{
+  if(stomps_.empty())
+  {
+    ROS_ERROR("Segment STOMP has no tasks");
+    return false;
+  }
+
+  if(initial_parameters.rows() != config_.num_dimensions || initial_parameters.cols() != config_.num_timesteps)
+  {
+    ROS_ERROR("Initial trajectory dimensions is incorrect");
+    return false;
+  }
+
+  std::vector<int> starts;
+  getSegments(starts);
+  int num_segments = starts.size();
+  int segment_timesteps = std::min(segment_timesteps_,config_.num_timesteps);
+  std::vector<Eigen::MatrixXd> segments(num_segments);
+
+  proceed_ = true;
+  num_sweeps_ = 0;
+  parameters_optimized = initial_parameters;
+  bool valid = false;
+  Eigen::VectorXd costs;
+  while(!valid && proceed_ && num_sweeps_ < max_sweeps_)
+  {
+    num_sweeps_++;
+    thread_pool_->parallelFor(num_segments,[&](int segment,int worker)
+    {
+      if(!proceed_)
+      {
+        return;
+      }
+
+      // every segment of every sweep explores different noise
+      StompConfiguration config = config_;
+      config.num_timesteps = segment_timesteps;
+      config.num_threads = 1;
+      config.random_seed = RandomStream(config_.random_seed,num_sweeps_,segment)();
+
+      segment_tasks_[worker]->setSegment(parameters_optimized,starts[segment],segment_timesteps);
+      stomps_[worker]->setConfig(config);
+      stomps_[worker]->solve(parameters_optimized.middleCols(starts[segment],segment_timesteps),segments[segment]);
+    });
+
+    if(!proceed_)
+    {
+      break;
+    }
+
+    blendSegments(starts,segments,parameters_optimized);
+    if(!segment_tasks_.front()->getTask()->computeCosts(parameters_optimized,0,config_.num_timesteps,0,costs,valid))
+    {
+      ROS_ERROR("Segment STOMP failed to compute the cost of the blended trajectory");
+      return false;
+    }
+
+    ROS_DEBUG("Segment STOMP sweep %i over %i segments produced a%s trajectory with cost %f",num_sweeps_,num_segments,
+              valid ? " valid" : "n invalid",costs.sum());
+  }
+
+  if(!valid)
+  {
+    ROS_ERROR("Segment STOMP failed to find a valid solution after %i sweeps",num_sweeps_);
+  }
+
+  return valid;
+}
+
+void SegmentStomp::setConfig(const StompConfiguration& config)
+{
+  config_ = config;
+}
+
+bool SegmentStomp::setSegments(int segment_timesteps,int overlap)
+{
+  if(overlap < 2 || overlap >= segment_timesteps)
+  {
+    ROS_ERROR("Segment STOMP overlap must be at least 2 and less than the segment timesteps");
+    return false;
+  }
+
+  segment_timesteps_ = segment_timesteps;
+  overlap_ = overlap;
+  return true;
+}
+
+void SegmentStomp::setMaxSweeps(int max_sweeps)
+{
+  max_sweeps_ = std::max(max_sweeps,1);
+}
+
+void SegmentStomp::setDeadline(const std::chrono::steady_clock::time_point& deadline)
+{
+  for(auto& stomp : stomps_)
+  {
+    stomp->setDeadline(deadline);
+  }
+}
+
+void SegmentStomp::clearDeadline()
+{
+  for(auto& stomp : stomps_)
+  {
+    stomp->clearDeadline();
+  }
+}
+
+bool SegmentStomp::cancel()
+{
+  proceed_ = false;
+  for(auto& stomp : stomps_)
+  {
+    stomp->cancel();
+  }
+  return true;
+}
+
+void SegmentStomp::getSegments(std::vector<int>& starts) const
+{
+  int num_timesteps = config_.num_timesteps;
+  starts.clear();
+  if(num_timesteps <= segment_timesteps_)
+  {
+    starts.push_back(0);
+    return;
+  }
+
+  // the fewest segments that keep the minimum overlap, spread evenly over the trajectory
+  int stride = segment_timesteps_ - overlap_;
+  int num_segments = (num_timesteps - overlap_ + stride - 1)/stride;
+  double spacing = static_cast<double>(num_timesteps - segment_timesteps_)/(num_segments - 1);
+  for(int s = 0; s < num_segments; s++)
+  {
+    starts.push_back(static_cast<int>(std::round(s * spacing)));
+  }
+}
+
+int SegmentStomp::getNumSweeps() const
+{
+  return num_sweeps_;
+}
+
+void SegmentStomp::blendSegments(const std::vector<int>& starts,const std::vector<Eigen::MatrixXd>& segments,
+                                 Eigen::MatrixXd& parameters) const
+{
+  /*
+   * Each segment is weighted by the distance to its closest boundary, so the weights vanish where a segment was held
+   * fixed and the blend is continuous.  Every timestep other than the end points of the trajectory lies inside at
+   * least one segment since consecutive segments overlap by two or more timesteps.
+   */
+  int num_timesteps = parameters.cols();
+  for(int t = 1; t < num_timesteps - 1; t++)
+  {
+    double weights = 0.0;
+    parameters.col(t).setZero();
+    for(std::size_t s = 0; s < starts.size(); s++)
+    {
+      int last = starts[s] + segments[s].cols() - 1;
+      if(t <= starts[s] || t >= last)
+      {
+        continue;
+      }
+
+      double w = std::min(t - starts[s],last - t);
+      parameters.col(t) += w * segments[s].col(t - starts[s]);
+      weights += w;
+    }
+    parameters.col(t) /= weights;
+  }
+}
+
+} /* namespace stomp_core */
@@ -0,0 +1,64 @@
+/**
+ * @file solution_buffer.cpp
+ * @brief This defines a lock-free buffer used to publish the best stomp solution to another thread
+ *
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <limits>
+#include "stomp_core/solution_buffer.h"
+
+namespace stomp_core
+{
+
+SolutionBuffer::SolutionBuffer():
+    back_(0),
+    front_(1),
+    middle_(2)
+{
+  resize(0,0);
+}
+
+void SolutionBuffer::resize(int num_dimensions,int num_timesteps)
+{
+  for(auto& s : buffers_)
+  {
+    s.parameters.setZero(num_dimensions,num_timesteps);
+    s.cost = std::numeric_limits<double>::max();
+    s.iteration = 0;
+    s.valid = false;
+  }
+}
+
+void SolutionBuffer::publish()
+{
+  back_ = middle_.exchange(back_ | DIRTY,std::memory_order_acq_rel) & INDEX_MASK;
+}
+
+const Solution& SolutionBuffer::readBuffer()
+{
+  if(middle_.load(std::memory_order_relaxed) & DIRTY)
+  {
+    front_ = middle_.exchange(front_,std::memory_order_acq_rel) & INDEX_MASK;
+  }
+
+  return buffers_[front_];
+}
+
+} /* namespace stomp_core */
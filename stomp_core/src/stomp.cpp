@@ -25,8 +25,9 @@
  */
 
 #include <ros/console.h>
+#include <algorithm>
+#include <cmath>
 #include <limits.h>
-#include <Eigen/LU>
 #include <Eigen/Cholesky>
 #include <math.h>
 #include <stomp_core/utils.h>
@@ -34,8 +35,14 @@
 #include "stomp_core/stomp.h"
 
 static const double DEFAULT_NOISY_COST_IMPORTANCE_WEIGHT = 1.0; /**< Default noisy cost importance weight */
+static const double MAX_IMPORTANCE_WEIGHT = 1.0; /**< A reused rollout never weighs more than a fresh one */
 static const double MIN_COST_DIFFERENCE = 1e-8; /**< Minimum cost difference allowed during probability calculation */
 static const double MIN_CONTROL_COST_WEIGHT = 1e-8; /**< Minimum control cost weight allowed */
+static const char* SOLVE_PHASE_NAMES[] = {"iteration","generate_noisy_rollouts","compute_state_costs",
+                                          "compute_control_costs","filter_noisy_rollouts","compute_probabilities",
+                                          "update_parameters","compute_optimized_cost"}; /**< Names of the profiled phases */
+static const char* STOP_REASON_NAMES[] = {"none","max_iterations","valid_iterations","cost_converged","update_converged",
+                                          "stagnated","cancelled","deadline","failed"}; /**< Names of the stop reasons */
 
 /**
  * @brief Compute a linear interpolated trajectory given a start and end state
@@ -93,44 +100,48 @@ static void computeCubicInterpolation(const std::vector<double>& first,const std
  * @param first                        The start position
  * @param last                         The final position
  * @param control_cost_matrix_R_padded The control cost matrix with padding
- * @param inv_control_cost_matrix_R    The inverse constrol cost matrix
+ * @param control_cost_matrix_R        The factorized control cost matrix
  * @param trajectory_joints            The returned minimum cost trajectory
  * @return True if successful, otherwise false
  */
 bool computeMinCostTrajectory(const std::vector<double>& first,
                               const std::vector<double>& last,
-                              const Eigen::MatrixXd& control_cost_matrix_R_padded,
-                              const Eigen::MatrixXd& inv_control_cost_matrix_R,
+                              const stomp_core::SymmetricBandedMatrix& control_cost_matrix_R_padded,
+                              const stomp_core::SymmetricBandedMatrix& control_cost_matrix_R,
                               Eigen::MatrixXd& trajectory_joints)
 {
   using namespace stomp_core;
 
-  if(control_cost_matrix_R_padded.rows() != control_cost_matrix_R_padded.cols())
+  if(!control_cost_matrix_R.isFactorized())
   {
-    ROS_ERROR("Control Cost Matrix is not square");
+    ROS_ERROR("Control Cost Matrix has not been factorized");
     return false;
   }
 
-
-  int timesteps = control_cost_matrix_R_padded.rows() - 2*(FINITE_DIFF_RULE_LENGTH - 1);
+  int timesteps = control_cost_matrix_R_padded.size() - 2*(FINITE_DIFF_RULE_LENGTH - 1);
   int start_index_padded = FINITE_DIFF_RULE_LENGTH - 1;
   int end_index_padded = start_index_padded + timesteps-1;
-  std::vector<Eigen::VectorXd> linear_control_cost(first.size(),Eigen::VectorXd::Zero(timesteps));
+  Eigen::VectorXd start_control_cost = Eigen::VectorXd::Zero(timesteps);
+  Eigen::VectorXd end_control_cost = Eigen::VectorXd::Zero(timesteps);
+  Eigen::VectorXd linear_control_cost = Eigen::VectorXd::Zero(timesteps);
   trajectory_joints.setZero(first.size(),timesteps);
 
+  // sum of the padded rows coupling the fixed start and end states with each timestep
+  for(int t = 0; t < timesteps; t++)
+  {
+    for(int i = 0; i < FINITE_DIFF_RULE_LENGTH - 1; i++)
+    {
+      start_control_cost(t) += control_cost_matrix_R_padded.coeff(i,start_index_padded + t);
+      end_control_cost(t) += control_cost_matrix_R_padded.coeff(end_index_padded + 1 + i,start_index_padded + t);
+    }
+  }
 
   for(unsigned int d = 0; d < first.size(); d++)
   {
-    linear_control_cost[d].transpose() = first[d] * Eigen::VectorXd::Ones(FINITE_DIFF_RULE_LENGTH - 1).transpose() *
-        control_cost_matrix_R_padded.block(0,start_index_padded,FINITE_DIFF_RULE_LENGTH - 1,timesteps);
-
-    linear_control_cost[d].transpose() += last[d] * Eigen::VectorXd::Ones(FINITE_DIFF_RULE_LENGTH - 1).transpose() *
-        control_cost_matrix_R_padded.block(end_index_padded + 1,start_index_padded,FINITE_DIFF_RULE_LENGTH - 1,
-                                    timesteps);
-
-    linear_control_cost[d] *=2;
+    linear_control_cost = 2*(first[d] * start_control_cost + last[d] * end_control_cost);
 
-    trajectory_joints.row(d) = -0.5*inv_control_cost_matrix_R*linear_control_cost[d];
+    control_cost_matrix_R.solveInPlace(linear_control_cost);
+    trajectory_joints.row(d) = -0.5*linear_control_cost;
     trajectory_joints(d,0) = first[d];
     trajectory_joints(d,timesteps - 1) = last[d];
   }
@@ -140,24 +151,25 @@ bool computeMinCostTrajectory(const std::vector<double>& first,
 
 /**
  * @brief Compute the parameters control costs
+ * @tparam Dimensions           The number of dimensions if known at compile time, otherwise Eigen::Dynamic
  * @param parameters            The parameters used to compute the control cost
  * @param dt                    The timestep in seconds
  * @param control_cost_weight   The control cost weight
  * @param control_cost_matrix_R The control cost matrix
  * @param control_costs returns The parameters control costs
  */
+template <int Dimensions>
 void computeParametersControlCosts(const Eigen::MatrixXd& parameters,
                                           double dt,
                                           double control_cost_weight,
-                                          const Eigen::MatrixXd& control_cost_matrix_R,
+                                          const stomp_core::SymmetricBandedMatrix& control_cost_matrix_R,
                                           Eigen::MatrixXd& control_costs)
 {
-  std::size_t num_timesteps = parameters.cols();
-  double cost = 0;
+  // the cost of each dimension is first accumulated in the first column
+  control_cost_matrix_R.quadraticForms<Dimensions>(parameters,control_costs.col(0));
   for(auto d = 0u; d < parameters.rows(); d++)
   {
-    cost = double(parameters.row(d)*(control_cost_matrix_R*parameters.row(d).transpose()));
-    control_costs.row(d).setConstant( 0.5*(1/dt)*cost );
+    control_costs.row(d).setConstant( 0.5*(1/dt)*control_costs(d,0) );
   }
 
   double max_coeff = control_costs.maxCoeff();
@@ -168,11 +180,40 @@ void computeParametersControlCosts(const Eigen::MatrixXd& parameters,
 
 namespace stomp_core {
 
+Stomp::ControlCostsFunction Stomp::selectControlCostsFunction(int num_dimensions)
+{
+  // the common manipulator sizes use fixed size columns, any other size takes the generic path
+  switch(num_dimensions)
+  {
+    case 6:
+      return &computeParametersControlCosts<6>;
+
+    case 7:
+      return &computeParametersControlCosts<7>;
+
+    default:
+      return &computeParametersControlCosts<Eigen::Dynamic>;
+  }
+}
+
+
+const char* toString(StopReasons::StopReason reason)
+{
+  return STOP_REASON_NAMES[reason];
+}
 
 Stomp::Stomp(const StompConfiguration& config,TaskPtr task):
+    proceed_(true),
     config_(config),
-    task_(task)
+    task_(task),
+    deadline_(std::chrono::steady_clock::duration::max().count()),
+    stop_reason_(StopReasons::NONE),
+    coarse_level_(false)
 {
+  for(int p = 0; p < SolvePhases::NUM_SOLVE_PHASES; p++)
+  {
+    profiler_.addCounter(SOLVE_PHASE_NAMES[p]);
+  }
 
   resetVariables();
 
@@ -180,12 +221,14 @@ Stomp::Stomp(const StompConfiguration& config,TaskPtr task):
 
 bool Stomp::clear()
 {
+  proceed_ = true;
   return resetVariables();
 }
 
 void Stomp::setConfig(const StompConfiguration& config)
 {
   config_ = config;
+  proceed_ = true;
   resetVariables();
 }
 
@@ -217,11 +260,6 @@ bool Stomp::solve(const Eigen::VectorXd& first,const Eigen::VectorXd& last,
 bool Stomp::solve(const Eigen::MatrixXd& initial_parameters,
                   Eigen::MatrixXd& parameters_optimized)
 {
-  if(parameters_optimized_.isZero())
-  {
-    parameters_optimized_ = initial_parameters;
-  }
-
   // check initial trajectory size
   if(initial_parameters.rows() != config_.num_dimensions || initial_parameters.cols() != config_.num_timesteps)
   {
@@ -237,9 +275,35 @@ bool Stomp::solve(const Eigen::MatrixXd& initial_parameters,
     }
   }
 
+  // cold start, the rollouts from a previous solve are discarded
+  parameters_optimized_ = initial_parameters;
+  parameters_initialized_ = true;
+  parameters_costs_current_ = false;
+  num_active_rollouts_ = 0;
+
   current_iteration_ = 1;
-  unsigned int valid_iterations = 0;
   current_lowest_cost_ = std::numeric_limits<double>::max();
+  resetBestSolution();
+  rollout_scheduler_.reset();
+  task_->setRandomSeed(config_.random_seed);
+  profiler_.reset();
+  task_->resetProfile();
+
+  // optimizing the coarse levels first, the full resolution gets the remaining iterations
+  unsigned int max_iterations = config_.num_iterations;
+  if(!config_.coarse_timesteps.empty() && task_->supportsMultiResolution())
+  {
+    if(!runCoarseLevels())
+    {
+      ROS_ERROR("STOMP failed to optimize the coarse levels");
+      return false;
+    }
+    max_iterations = std::max(config_.num_iterations - static_cast<int>(current_iteration_) + 1,1);
+  }
+  else if(!config_.coarse_timesteps.empty())
+  {
+    ROS_WARN("STOMP task does not support multiple resolutions, the coarse levels are skipped");
+  }
 
   // computing initialial trajectory cost
   if(!computeOptimizedCost())
@@ -248,8 +312,191 @@ bool Stomp::solve(const Eigen::MatrixXd& initial_parameters,
     return false;
   }
 
-  while(current_iteration_ <= config_.num_iterations && runSingleIteration())
+  return runIterations(max_iterations,parameters_optimized);
+}
+
+bool Stomp::runCoarseLevels()
+{
+  const StompConfiguration config = config_;
+  if(config.coarse_iterations.size() != config.coarse_timesteps.size())
+  {
+    ROS_ERROR("STOMP 'coarse_iterations' must have as many entries as 'coarse_timesteps'");
+    return false;
+  }
+
+  for(std::size_t l = 0; l < config.coarse_timesteps.size(); l++)
+  {
+    int min_timesteps = l == 0 ? 2 : config.coarse_timesteps[l - 1];
+    if(config.coarse_timesteps[l] <= min_timesteps || config.coarse_timesteps[l] >= config.num_timesteps)
+    {
+      ROS_ERROR("STOMP 'coarse_timesteps' must increase from more than 2 to less than %i",config.num_timesteps);
+      return false;
+    }
+  }
+
+  bool succeeded = true;
+  Eigen::MatrixXd parameters;
+  coarse_level_ = true;
+  for(std::size_t l = 0; l < config.coarse_timesteps.size() && succeeded; l++)
+  {
+    // the duration of the trajectory is preserved
+    StompConfiguration level_config = config;
+    level_config.num_timesteps = config.coarse_timesteps[l];
+    level_config.delta_t = config.delta_t * (config.num_timesteps - 1)/(level_config.num_timesteps - 1);
+    level_config.coarse_timesteps.clear();
+    level_config.coarse_iterations.clear();
+
+    resampleCubic(parameters_optimized_,level_config.num_timesteps,parameters);
+    if(!setResolution(level_config,parameters) || !computeOptimizedCost())
+    {
+      succeeded = false;
+      break;
+    }
+
+    ROS_DEBUG("STOMP optimizing %i timesteps for at most %i iterations",level_config.num_timesteps,
+              config.coarse_iterations[l]);
+    iterate(config.coarse_iterations[l]);
+    if(stop_reason_ == StopReasons::FAILED)
+    {
+      succeeded = false;
+    }
+    else if(stop_reason_ == StopReasons::CANCELLED || stop_reason_ == StopReasons::DEADLINE)
+    {
+      // the full resolution stops right away and returns the upsampled parameters if they are valid
+      break;
+    }
+    else if(stop_reason_ != StopReasons::MAX_ITERATIONS)
+    {
+      // the loop stopped on the last iteration it ran, the next level continues the count
+      current_iteration_++;
+    }
+  }
+
+  coarse_level_ = false;
+  resampleCubic(parameters_optimized_,config.num_timesteps,parameters);
+  return setResolution(config,parameters) && succeeded;
+}
+
+bool Stomp::setResolution(const StompConfiguration& config,const Eigen::MatrixXd& parameters)
+{
+  if(!task_->setResolution(config))
+  {
+    ROS_ERROR("STOMP task failed to change its resolution to %i timesteps",config.num_timesteps);
+    return false;
+  }
+
+  unsigned int current_iteration = current_iteration_;
+  config_ = config;
+  if(!resetVariables())
+  {
+    return false;
+  }
+
+  parameters_optimized_ = parameters;
+  parameters_initialized_ = true;
+  current_iteration_ = current_iteration;
+  current_lowest_cost_ = std::numeric_limits<double>::max();
+  resetBestSolution();
+  return true;
+}
+
+bool Stomp::solveWarmStart(unsigned int max_iterations,Eigen::MatrixXd& parameters_optimized)
+{
+  if(!parameters_initialized_)
+  {
+    ROS_ERROR("STOMP has no previous solution to warm start from");
+    return false;
+  }
+
+  // a cancellation of the previous solve does not carry over
+  proceed_ = true;
+  current_lowest_cost_ = std::numeric_limits<double>::max();
+  resetBestSolution();
+  rollout_scheduler_.reset();
+  task_->setRandomSeed(config_.random_seed);
+  profiler_.reset();
+  task_->resetProfile();
+
+  // the task may have changed since the last solve so all the stored costs are stale
+  parameters_costs_current_ = false;
+  if(!computeOptimizedCost())
+  {
+    ROS_ERROR("Failed to calculate the warm start trajectory cost");
+    return false;
+  }
+
+  if(!computeStoredRolloutsCosts())
+  {
+    ROS_ERROR("Failed to recalculate the costs of the stored rollouts");
+    return false;
+  }
+
+  // continuing the iteration count so that the noise differs from the previous solve
+  current_iteration_++;
+
+  return runIterations(max_iterations,parameters_optimized);
+}
+
+bool Stomp::runIterations(unsigned int max_iterations,Eigen::MatrixXd& parameters_optimized)
+{
+  iterate(max_iterations);
+
+  // the last parameters may not be valid even though a valid solution was found earlier, i.e. when the deadline passed
+  if(!parameters_valid_ && best_parameters_valid_ && proceed_)
+  {
+    ROS_WARN("STOMP %s, returning the best valid solution found",
+             deadlineExpired() ? "reached its deadline" : "ended on an invalid solution");
+    parameters_optimized_ = best_parameters_;
+    current_lowest_cost_ = best_parameters_cost_;
+    parameters_valid_ = true;
+    parameters_costs_current_ = false;
+  }
+
+  if(parameters_valid_)
+  {
+    ROS_INFO("STOMP found a valid solution with cost %f after %i iterations (%s)",
+             current_lowest_cost_,current_iteration_,toString(stop_reason_));
+  }
+  else
+  {
+    if (!proceed_)
+      ROS_ERROR_STREAM("Stomp was terminated");
+    else if (deadlineExpired())
+      ROS_ERROR("STOMP reached its deadline without finding a valid solution after %i iterations",current_iteration_);
+    else
+      ROS_ERROR("STOMP failed to find a valid solution after %i iterations (%s)",current_iteration_,
+                toString(stop_reason_));
+  }
+
+  parameters_optimized = parameters_optimized_;
+
+  // notifying task
+  task_->done(parameters_valid_,current_iteration_,current_lowest_cost_,parameters_optimized);
+
+  return parameters_valid_;
+}
+
+void Stomp::iterate(unsigned int max_iterations)
+{
+  unsigned int valid_iterations = 0;
+  unsigned int stagnant_iterations = 0;
+  unsigned int completed_iterations = 0;
+  unsigned int last_iteration = current_iteration_ + max_iterations - 1;
+  stop_reason_ = StopReasons::MAX_ITERATIONS;
+  if(!cost_history_.empty())
+  {
+    cost_history_[0] = current_lowest_cost_;
+  }
+
+  while(current_iteration_ <= last_iteration)
   {
+    double previous_lowest_cost = current_lowest_cost_;
+    if(!runSingleIteration())
+    {
+      stop_reason_ = !proceed_ ? StopReasons::CANCELLED :
+          (deadlineExpired() ? StopReasons::DEADLINE : StopReasons::FAILED);
+      break;
+    }
 
     ROS_DEBUG("STOMP completed iteration %i with cost %f",current_iteration_,current_lowest_cost_);
 
@@ -268,41 +515,172 @@ bool Stomp::solve(const Eigen::MatrixXd& initial_parameters,
 
     if(valid_iterations > config_.num_iterations_after_valid)
     {
+      stop_reason_ = StopReasons::VALID_ITERATIONS;
+      break;
+    }
+
+    completed_iterations++;
+    stagnant_iterations = current_lowest_cost_ < previous_lowest_cost ? 0 : stagnant_iterations + 1;
+    if(checkConvergence(completed_iterations,stagnant_iterations))
+    {
+      ROS_DEBUG("STOMP stopped at iteration %i, %s",current_iteration_,toString(stop_reason_));
       break;
     }
 
     current_iteration_++;
   }
+}
 
-  if(parameters_valid_)
+void Stomp::setDeadline(const std::chrono::steady_clock::time_point& deadline)
+{
+  deadline_ = deadline.time_since_epoch().count();
+}
+
+void Stomp::clearDeadline()
+{
+  deadline_ = std::chrono::steady_clock::duration::max().count();
+}
+
+bool Stomp::deadlineExpired() const
+{
+  return std::chrono::steady_clock::now().time_since_epoch().count() >= deadline_;
+}
+
+bool Stomp::getBestSolution(Eigen::MatrixXd& parameters,double& cost)
+{
+  const Solution& solution = best_solution_buffer_.readBuffer();
+  if(!solution.valid)
   {
-    ROS_INFO("STOMP found a valid solution with cost %f after %i iterations",
-             current_lowest_cost_,current_iteration_);
+    return false;
   }
-  else
+
+  parameters = solution.parameters;
+  cost = solution.cost;
+  return true;
+}
+
+void Stomp::updateRolloutSchedule(double previous_lowest_cost)
+{
+  double mean = 0;
+  double variance = 0;
+  for(int r = 0; r < num_new_rollouts_; r++)
   {
-    if (proceed_)
-      ROS_ERROR("STOMP failed to find a valid solution after %i iterations",current_iteration_);
-    else
-      ROS_ERROR_STREAM("Stomp was terminated");
+    mean += noisy_rollouts_[r].total_cost;
   }
+  mean /= std::max(num_new_rollouts_,1);
 
-  parameters_optimized = parameters_optimized_;
+  for(int r = 0; r < num_new_rollouts_; r++)
+  {
+    variance += std::pow(noisy_rollouts_[r].total_cost - mean,2);
+  }
+  variance /= std::max(num_new_rollouts_,1);
 
-  // notifying task
-  task_->done(parameters_valid_,current_iteration_,current_lowest_cost_,parameters_optimized);
+  rollout_scheduler_.update(previous_lowest_cost,current_lowest_cost_,mean,std::sqrt(variance));
+}
 
-  return parameters_valid_;
+void Stomp::getProfile(ProfileReport& report) const
+{
+  report.entries.clear();
+  profiler_.getReport(report);
+  task_->getProfile(report);
+}
+
+StopReasons::StopReason Stomp::getStopReason() const
+{
+  return stop_reason_;
+}
+
+bool Stomp::checkConvergence(unsigned int completed_iterations,unsigned int stagnant_iterations)
+{
+  if(config_.max_stagnant_iterations > 0 && stagnant_iterations >= config_.max_stagnant_iterations)
+  {
+    stop_reason_ = StopReasons::STAGNATED;
+    return true;
+  }
+
+  if(config_.convergence_update_tolerance > 0 &&
+      parameters_updates_.cwiseAbs().maxCoeff() < config_.convergence_update_tolerance)
+  {
+    stop_reason_ = StopReasons::UPDATE_CONVERGED;
+    return true;
+  }
+
+  if(config_.convergence_window > 0)
+  {
+    // the lowest cost never increases, so the improvement over the window is the difference with its oldest entry
+    unsigned int window = config_.convergence_window;
+    cost_history_[completed_iterations % (window + 1)] = current_lowest_cost_;
+    if(completed_iterations >= window)
+    {
+      double window_cost = cost_history_[(completed_iterations - window) % (window + 1)];
+      double improvement = (window_cost - current_lowest_cost_)/std::max(std::abs(window_cost),MIN_COST_DIFFERENCE);
+      if(improvement < config_.convergence_cost_tolerance)
+      {
+        stop_reason_ = StopReasons::COST_CONVERGED;
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+void Stomp::resetBestSolution()
+{
+  best_parameters_valid_ = false;
+  best_parameters_cost_ = std::numeric_limits<double>::max();
+
+  Solution& solution = best_solution_buffer_.writeBuffer();
+  solution.valid = false;
+  solution.cost = best_parameters_cost_;
+  solution.iteration = 0;
+  best_solution_buffer_.publish();
+}
+
+void Stomp::updateBestSolution()
+{
+  if(!parameters_valid_ || parameters_total_cost_ >= best_parameters_cost_)
+  {
+    return;
+  }
+
+  best_parameters_valid_ = true;
+  best_parameters_cost_ = parameters_total_cost_;
+  best_parameters_ = parameters_optimized_;
+
+  // the solutions of the coarse levels are not at the resolution of the solve
+  if(coarse_level_)
+  {
+    return;
+  }
+
+  Solution& solution = best_solution_buffer_.writeBuffer();
+  solution.parameters = parameters_optimized_;
+  solution.cost = parameters_total_cost_;
+  solution.iteration = current_iteration_;
+  solution.valid = true;
+  best_solution_buffer_.publish();
 }
 
 bool Stomp::resetVariables()
 {
-  proceed_= true;
+  parameters_initialized_ = false;
+  parameters_costs_current_ = false;
   parameters_total_cost_ = 0;
   parameters_valid_ = false;
   num_active_rollouts_ = 0;
+  num_new_rollouts_ = 0;
   current_iteration_ = 0;
 
+  // the noise of the task is restored, the covariance is estimated again from the first iteration
+  int dimensions = config_.num_dimensions;
+  noise_covariance_initialized_ = false;
+  noise_covariance_.setZero(dimensions,dimensions);
+  sample_covariance_.setZero(dimensions,dimensions);
+  min_noise_variances_.setZero(dimensions);
+  probability_sums_.setZero(dimensions);
+  task_->setNoiseCovariance(Eigen::MatrixXd());
+
   // verifying configuration
   if(config_.max_rollouts <= config_.num_rollouts)
   {
@@ -315,6 +693,13 @@ bool Stomp::resetVariables()
   num_active_rollouts_ = 0;
   noisy_rollouts_.resize(config_.max_rollouts);
   reused_rollouts_.resize(config_.max_rollouts);
+  rollout_cost_sorter_.reserve(config_.max_rollouts);
+  batch_parameters_.reserve(config_.max_rollouts);
+  batch_changed_timesteps_.reserve(config_.max_rollouts);
+  batch_costs_.reserve(config_.max_rollouts);
+  batch_validity_.reserve(config_.max_rollouts);
+  rollout_scheduler_.configure(config_);
+  cost_history_.assign(std::max(config_.convergence_window,0) + 1,0.0);
 
   // initializing rollout
   Rollout rollout;
@@ -324,8 +709,7 @@ bool Stomp::resetVariables()
   rollout.parameters_noise.resize(d, config_.num_timesteps);
   rollout.parameters_noise.setZero();
 
-  rollout.probabilities.resize(d, config_.num_timesteps);
-  rollout.probabilities.setZero();
+  rollout.changed_timesteps.setConstant(config_.num_timesteps,true);
 
   rollout.full_probabilities.clear();
   rollout.full_probabilities.resize(d);
@@ -336,13 +720,11 @@ bool Stomp::resetVariables()
   rollout.control_costs.resize(d, config_.num_timesteps);
   rollout.control_costs.setZero();
 
-  rollout.total_costs.resize(d, config_.num_timesteps);
-  rollout.total_costs.setZero();
-
   rollout.state_costs.resize(config_.num_timesteps);
   rollout.state_costs.setZero();
 
   rollout.importance_weight = DEFAULT_NOISY_COST_IMPORTANCE_WEIGHT;
+  rollout.log_sampling_density = std::numeric_limits<double>::quiet_NaN();
 
   for(unsigned int r = 0; r < config_.max_rollouts ; r++)
   {
@@ -350,6 +732,15 @@ bool Stomp::resetVariables()
     reused_rollouts_[r] = rollout;
   }
 
+  // rollout arrays
+  rollout_arrays_ = RolloutArrays::create(config_.kernel_precision,d);
+  if(!rollout_arrays_)
+  {
+    ROS_ERROR("Failed to create the rollout arrays");
+    return false;
+  }
+  rollout_arrays_->resize(d * config_.num_timesteps,config_.max_rollouts);
+
   // parameter updates
   parameters_updates_.resize(d, config_.num_timesteps);
   parameters_updates_.setZero();
@@ -363,28 +754,57 @@ bool Stomp::resetVariables()
   parameters_optimized_.resize(config_.num_dimensions,config_.num_timesteps);
   parameters_optimized_.setZero();
 
+  parameters_changed_timesteps_.setConstant(config_.num_timesteps,true);
+
+  previous_parameters_valid_ = false;
+  previous_parameters_total_cost_ = 0;
+  previous_parameters_.setZero(config_.num_dimensions,config_.num_timesteps);
+  previous_state_costs_.setZero(config_.num_timesteps);
+  previous_control_costs_.setZero(d, config_.num_timesteps);
+
+  best_parameters_.setZero(config_.num_dimensions,config_.num_timesteps);
+  if(!coarse_level_)
+  {
+    best_solution_buffer_.resize(config_.num_dimensions,config_.num_timesteps);
+  }
+  best_parameters_valid_ = false;
+  best_parameters_cost_ = std::numeric_limits<double>::max();
+
+  // rollout workers
+  int num_threads = config_.num_threads;
+  if(num_threads > 1 && !task_->supportsConcurrentRollouts())
+  {
+    ROS_WARN("STOMP requested %i threads but the task does not support concurrent rollouts, running serially",num_threads);
+    num_threads = 1;
+  }
+
+  if(num_threads > 1)
+  {
+    if(!thread_pool_ || thread_pool_->size() != num_threads)
+    {
+      thread_pool_.reset(new ThreadPool(num_threads));
+    }
+  }
+  else
+  {
+    thread_pool_.reset();
+  }
+
   // generate finite difference matrix
   start_index_padded_ = FINITE_DIFF_RULE_LENGTH-1;
   num_timesteps_padded_ = config_.num_timesteps + 2*(FINITE_DIFF_RULE_LENGTH-1);
-  generateFiniteDifferenceMatrix(num_timesteps_padded_,DerivativeOrders::STOMP_ACCELERATION,
-                                 config_.delta_t,finite_diff_matrix_A_padded_);
 
   /* control cost matrix (R = A_transpose * A):
-   * Note: Original code multiplies the A product by the time interval.  However this is not
-   * what was described in the literature
-   */
-  control_cost_matrix_R_padded_ = config_.delta_t*finite_diff_matrix_A_padded_.transpose() * finite_diff_matrix_A_padded_;
-  control_cost_matrix_R_ = control_cost_matrix_R_padded_.block(
-      start_index_padded_,start_index_padded_,config_.num_timesteps,config_.num_timesteps);
-  inv_control_cost_matrix_R_ = control_cost_matrix_R_.fullPivLu().inverse();
-
-  /*
-   * Applying scale factor to ensure that max(R^-1)==1
+   * R is banded and scaled such that max(R^-1)==1, it only depends on the number of timesteps and
+   * delta_t so it is shared with every other Stomp instance through the matrix cache.
    */
-  double maxVal = std::abs(inv_control_cost_matrix_R_.maxCoeff());
-  control_cost_matrix_R_padded_ *= maxVal;
-  control_cost_matrix_R_ *= maxVal;
-  inv_control_cost_matrix_R_ /= maxVal; // used in computing the minimum control cost initial trajectory
+  control_cost_matrices_ = MatrixCache::instance().getControlCostMatrices(config_.num_timesteps,config_.delta_t);
+  control_costs_function_ = selectControlCostsFunction(d);
+  if(!control_cost_matrices_)
+  {
+    ROS_ERROR("Failed to factorize the control cost matrix");
+    return false;
+  }
 
   return true;
 }
@@ -405,7 +825,7 @@ bool Stomp::computeInitialTrajectory(const std::vector<double>& first,const std:
       break;
     case TrajectoryInitializations::MININUM_CONTROL_COST:
 
-      valid = computeMinCostTrajectory(first,last,control_cost_matrix_R_padded_,inv_control_cost_matrix_R_,parameters_optimized_);
+      valid = computeMinCostTrajectory(first,last,control_cost_matrices_->R_padded,control_cost_matrices_->R,parameters_optimized_);
       break;
   }
 
@@ -421,18 +841,27 @@ bool Stomp::cancel()
 
 bool Stomp::runSingleIteration()
 {
+  Profiler::ScopedTimer timer(profiler_,SolvePhases::ITERATION);
+
   if(!proceed_)
   {
     return false;
   }
 
+  double previous_lowest_cost = current_lowest_cost_;
   bool proceed = generateNoisyRollouts() &&
       computeNoisyRolloutsCosts() &&
       filterNoisyRollouts() &&
       computeProbabilities() &&
+      adaptNoiseCovariance() &&
       updateParameters() &&
       computeOptimizedCost();
 
+  if(proceed)
+  {
+    updateRolloutSchedule(previous_lowest_cost);
+  }
+
   // notifying end of iteration
   task_->postIteration(0,config_.num_timesteps,current_iteration_,current_lowest_cost_,parameters_optimized_);
 
@@ -441,15 +870,23 @@ bool Stomp::runSingleIteration()
 
 bool Stomp::generateNoisyRollouts()
 {
+  Profiler::ScopedTimer timer(profiler_,SolvePhases::GENERATE_NOISY_ROLLOUTS);
+
   // calculating number of rollouts to reuse from previous iteration
-  std::vector< std::pair<double,int> > rollout_cost_sorter; // Used to sort noisy trajectories in ascending order wrt their total cost
   double h = config_.exponentiated_cost_sensitivity;
   int rollouts_stored = num_active_rollouts_-1; // don't take the optimized rollout into account
   rollouts_stored = rollouts_stored < 0 ? 0 : rollouts_stored;
-  int rollouts_generate = config_.num_rollouts;
+  int rollouts_generate = rollout_scheduler_.getNumRollouts();
   int rollouts_total = rollouts_generate + rollouts_stored +1;
   int rollouts_reuse =  rollouts_total < config_.max_rollouts  ? rollouts_stored :  config_.max_rollouts - (rollouts_generate + 1) ; // +1 for optimized params
 
+  // the importance weights of the reused rollouts are relative to the distribution of this iteration
+  task_->setNoiseScale(rollout_scheduler_.getNoiseScale());
+  if(noise_covariance_initialized_)
+  {
+    task_->setNoiseCovariance(noise_covariance_);
+  }
+
   // selecting least costly rollouts from previous iteration
   if(rollouts_reuse > 0)
   {
@@ -472,44 +909,51 @@ bool Stomp::generateNoisyRollouts()
     // compute weighted cost on all rollouts
     double cost_prob;
     double weighted_prob;
+    rollout_cost_sorter_.clear();
     for (auto r = 0u; r<rollouts_stored; ++r)
     {
 
       // Apply noise generated on the previous iteration onto the current trajectory
       noisy_rollouts_[r].noise = noisy_rollouts_[r].parameters_noise
           - parameters_optimized_;
+      noisy_rollouts_[r].importance_weight = computeImportanceWeight(noisy_rollouts_[r]);
 
       cost_prob = exp(-h*(noisy_rollouts_[r].total_cost - min_cost)/cost_denom);
       weighted_prob = cost_prob * noisy_rollouts_[r].importance_weight;
-      rollout_cost_sorter.push_back(std::make_pair(-weighted_prob,r));
+      rollout_cost_sorter_.push_back(std::make_pair(-weighted_prob,r));
     }
 
+    std::partial_sort(rollout_cost_sorter_.begin(),rollout_cost_sorter_.begin() + rollouts_reuse,
+                      rollout_cost_sorter_.end());
 
-    std::sort(rollout_cost_sorter.begin(), rollout_cost_sorter.end());
-
-    // use the best ones: (copy them into reused_rollouts)
-    for (auto r = 0u; r<rollouts_stored; ++r)
+    /*
+     * use the best ones: the rollouts are swapped instead of copied, first into reused_rollouts_ and then back
+     * into their new position so that a destination slot is never overwritten before it has been moved out.
+     */
+    for (auto r = 0u; r<rollouts_reuse; ++r)
     {
-      int reuse_index = rollout_cost_sorter[r].second;
-      reused_rollouts_[r] = noisy_rollouts_[reuse_index];
+      int reuse_index = rollout_cost_sorter_[r].second;
+      swap(reused_rollouts_[r],noisy_rollouts_[reuse_index]);
     }
 
-    // copy them back from reused_rollouts_ into rollouts_
     for (auto r = 0u; r<rollouts_reuse; ++r)
     {
-      noisy_rollouts_[rollouts_generate + r ] = reused_rollouts_[r];
+      swap(noisy_rollouts_[rollouts_generate + r ],reused_rollouts_[r]);
     }
   }
 
   // adding optimized trajectory as the last rollout
   noisy_rollouts_[rollouts_generate + rollouts_reuse].parameters_noise = parameters_optimized_;
   noisy_rollouts_[rollouts_generate + rollouts_reuse].noise.setZero();
+  noisy_rollouts_[rollouts_generate + rollouts_reuse].importance_weight = DEFAULT_NOISY_COST_IMPORTANCE_WEIGHT;
+  noisy_rollouts_[rollouts_generate + rollouts_reuse].log_sampling_density = std::numeric_limits<double>::quiet_NaN();
   noisy_rollouts_[rollouts_generate + rollouts_reuse].state_costs = parameters_state_costs_;
   noisy_rollouts_[rollouts_generate + rollouts_reuse].control_costs = parameters_control_costs_;
 
 
   // generate new noisy rollouts
-  for(auto r = 0u; r < rollouts_generate; r++)
+  num_new_rollouts_ = rollouts_generate;
+  bool generated = runRollouts(rollouts_generate,[this](int r) -> bool
   {
     if(!task_->generateNoisyParameters(parameters_optimized_,
                                       0,config_.num_timesteps,
@@ -521,6 +965,18 @@ bool Stomp::generateNoisyRollouts()
       return false;
     }
 
+    Rollout& rollout = noisy_rollouts_[r];
+    rollout.importance_weight = DEFAULT_NOISY_COST_IMPORTANCE_WEIGHT;
+    if(!task_->computeNoiseLogDensity(rollout.noise,rollout.log_sampling_density))
+    {
+      rollout.log_sampling_density = std::numeric_limits<double>::quiet_NaN();
+    }
+    return true;
+  });
+
+  if(!generated)
+  {
+    return false;
   }
 
   // update total active rollouts
@@ -529,12 +985,25 @@ bool Stomp::generateNoisyRollouts()
   return true;
 }
 
+double Stomp::computeImportanceWeight(const Rollout& rollout) const
+{
+  double log_density;
+  if(std::isnan(rollout.log_sampling_density) || !task_->computeNoiseLogDensity(rollout.noise,log_density))
+  {
+    return DEFAULT_NOISY_COST_IMPORTANCE_WEIGHT;
+  }
+
+  return std::min(std::exp(log_density - rollout.log_sampling_density),MAX_IMPORTANCE_WEIGHT);
+}
+
 bool Stomp::filterNoisyRollouts()
 {
+  Profiler::ScopedTimer timer(profiler_,SolvePhases::FILTER_NOISY_ROLLOUTS);
+
   // apply post noise generation filters
-  bool filtered = false;
-  for(auto r = 0u ; r < config_.num_rollouts; r++)
+  return runRollouts(num_new_rollouts_,[this](int r) -> bool
   {
+    bool filtered = false;
     if(!task_->filterNoisyParameters(0,config_.num_timesteps,current_iteration_,r,noisy_rollouts_[r].parameters_noise,filtered))
     {
       ROS_ERROR_STREAM("Failed to filter noisy parameters");
@@ -543,11 +1012,13 @@ bool Stomp::filterNoisyRollouts()
 
     if(filtered)
     {
+      // the filtered noise was not drawn from the sampling distribution
       noisy_rollouts_[r].noise = noisy_rollouts_[r].parameters_noise - parameters_optimized_;
+      noisy_rollouts_[r].log_sampling_density = std::numeric_limits<double>::quiet_NaN();
     }
-  }
 
-  return true;
+    return true;
+  });
 }
 
 bool Stomp::computeNoisyRolloutsCosts()
@@ -577,11 +1048,8 @@ bool Stomp::computeNoisyRolloutsCosts()
       }
       rollout.total_cost = total_state_cost + total_control_cost;
 
-      // Compute total cost for each time step
-      for(auto d = 0u; d < config_.num_dimensions; d++)
-      {
-        rollout.total_costs.row(d) = rollout.state_costs.transpose() + rollout.control_costs.row(d);
-      }
+      // Compute total cost for each time step, stored as column 'r' of the rollout arrays
+      rollout_arrays_->setRolloutCosts(r,rollout.control_costs,rollout.state_costs,rollout.importance_weight);
     }
   }
 
@@ -590,35 +1058,126 @@ bool Stomp::computeNoisyRolloutsCosts()
 
 bool Stomp::computeRolloutsStateCosts()
 {
+  Profiler::ScopedTimer timer(profiler_,SolvePhases::COMPUTE_STATE_COSTS);
+
+  if(task_->supportsBatchedCosts())
+  {
+    return computeRolloutsStateCostsBatch();
+  }
 
-  bool all_valid = true;
-  bool proceed = true;
-  for(auto r = 0u ; r < config_.num_rollouts; r++)
+  return runRollouts(num_new_rollouts_,[this](int r) -> bool
   {
     if(!proceed_)
     {
-      proceed = false;
-      break;
+      return false;
     }
 
+    // starting from the costs of the optimized parameters, only the timesteps perturbed by the noise differ
     Rollout& rollout = noisy_rollouts_[r];
-    if(!task_->computeNoisyCosts(rollout.parameters_noise,0,
+    bool valid = parameters_valid_;
+    rollout.state_costs = parameters_state_costs_;
+    computeChangedTimesteps(rollout.parameters_noise,parameters_optimized_,rollout.changed_timesteps);
+
+    if(!task_->computeChangedNoisyCosts(rollout.parameters_noise,0,
                             config_.num_timesteps,
                             current_iteration_,r,
-                            rollout.state_costs,all_valid))
+                            rollout.changed_timesteps,
+                            rollout.state_costs,valid))
     {
       ROS_ERROR("Trajectory cost computation failed for rollout %i.",r);
-      proceed = false;
-      break;
+      return false;
     }
+
+    return true;
+  });
+}
+
+bool Stomp::computeRolloutsStateCostsBatch()
+{
+  if(!proceed_ || deadlineExpired())
+  {
+    return false;
   }
 
-  return proceed;
+  // resizing within the reserved capacity only creates empty buffers so no memory is allocated
+  batch_parameters_.resize(num_new_rollouts_);
+  batch_changed_timesteps_.resize(num_new_rollouts_);
+  batch_costs_.resize(num_new_rollouts_);
+  batch_validity_.resize(num_new_rollouts_);
+
+  // starting from the costs of the optimized parameters, only the timesteps perturbed by the noise differ
+  for(int r = 0; r < num_new_rollouts_; r++)
+  {
+    Rollout& rollout = noisy_rollouts_[r];
+    rollout.state_costs = parameters_state_costs_;
+    computeChangedTimesteps(rollout.parameters_noise,parameters_optimized_,rollout.changed_timesteps);
+
+    batch_parameters_[r].swap(rollout.parameters_noise);
+    batch_changed_timesteps_[r].swap(rollout.changed_timesteps);
+    batch_costs_[r].swap(rollout.state_costs);
+    batch_validity_[r] = parameters_valid_;
+  }
+
+  bool computed = task_->computeNoisyCostsBatch(batch_parameters_,0,config_.num_timesteps,current_iteration_,
+                                                batch_changed_timesteps_,batch_costs_,batch_validity_);
+
+  for(int r = 0; r < num_new_rollouts_; r++)
+  {
+    Rollout& rollout = noisy_rollouts_[r];
+    batch_parameters_[r].swap(rollout.parameters_noise);
+    batch_changed_timesteps_[r].swap(rollout.changed_timesteps);
+    batch_costs_[r].swap(rollout.state_costs);
+  }
+
+  if(!computed)
+  {
+    ROS_ERROR("Trajectory cost computation failed for the batch of %i rollouts.",num_new_rollouts_);
+    return false;
+  }
+
+  return true;
 }
+
+bool Stomp::computeStoredRolloutsCosts()
+{
+  // the last active rollout holds the optimized parameters, its costs are replaced on the next iteration
+  int rollouts_stored = num_active_rollouts_ - 1;
+  bool computed = runRollouts(rollouts_stored,[this](int r) -> bool
+  {
+    bool valid;
+    Rollout& rollout = noisy_rollouts_[r];
+    if(!task_->computeNoisyCosts(rollout.parameters_noise,0,
+                            config_.num_timesteps,
+                            current_iteration_,r,
+                            rollout.state_costs,valid))
+    {
+      ROS_ERROR("Trajectory cost computation failed for stored rollout %i.",r);
+      return false;
+    }
+
+    return true;
+  });
+
+  if(!computed)
+  {
+    return false;
+  }
+
+  // the total costs rank the stored rollouts for reuse
+  for(int r = 0; r < rollouts_stored; r++)
+  {
+    Rollout& rollout = noisy_rollouts_[r];
+    rollout.total_cost = rollout.state_costs.sum() + rollout.control_costs.sum();
+  }
+
+  return true;
+}
+
 bool Stomp::computeRolloutsControlCosts()
 {
-  Eigen::ArrayXXd Ax; // accelerations
-  for(auto r = 0u ; r < num_active_rollouts_; r++)
+  Profiler::ScopedTimer timer(profiler_,SolvePhases::COMPUTE_CONTROL_COSTS);
+
+  return runRollouts(num_active_rollouts_,[this](int r) -> bool
   {
     Rollout& rollout = noisy_rollouts_[r];
 
@@ -631,72 +1190,30 @@ bool Stomp::computeRolloutsControlCosts()
     }
     else
     {
-      computeParametersControlCosts(rollout.parameters_noise,
+      control_costs_function_(rollout.parameters_noise,
                                     config_.delta_t,
                                     config_.control_cost_weight,
-                                    control_cost_matrix_R_,rollout.control_costs);
+                                    control_cost_matrices_->R,rollout.control_costs);
     }
-  }
-  return true;
+    return true;
+  });
 }
 
 bool Stomp::computeProbabilities()
 {
+  Profiler::ScopedTimer timer(profiler_,SolvePhases::COMPUTE_PROBABILITIES);
 
-  double cost;
   double min_cost;
   double max_cost;
   double denom;
-  double numerator;
   double probl_sum = 0.0; // total probability sum of all rollouts for each joint
   const double h = config_.exponentiated_cost_sensitivity;
-  double exponent = 0;
+
+  // probabilities of every dimension and timestep, computed in the kernel precision
+  rollout_arrays_->computeProbabilities(num_active_rollouts_,h);
 
   for (auto d = 0u; d<config_.num_dimensions; ++d)
   {
-
-    for (auto t = 0u; t<config_.num_timesteps; t++)
-    {
-
-      // find min and max cost over all rollouts at timestep 't':
-      min_cost = noisy_rollouts_[0].total_costs(d,t);
-      max_cost = min_cost;
-      for (auto r=0u; r<num_active_rollouts_; ++r)
-      {
-          cost = noisy_rollouts_[r].total_costs(d,t);
-          if (cost < min_cost)
-              min_cost = cost;
-          if (cost > max_cost)
-              max_cost = cost;
-      }
-
-      denom = max_cost - min_cost;
-
-      // prevent division by zero:
-      if (denom < MIN_COST_DIFFERENCE)
-      {
-        denom = MIN_COST_DIFFERENCE;
-      }
-
-      probl_sum = 0.0;
-      for (auto r = 0u; r<num_active_rollouts_; ++r)
-      {
-        // this is the exponential term in the probability calculation described in the literature
-        exponent = -h*(noisy_rollouts_[r].total_costs(d,t) - min_cost)/denom;
-        noisy_rollouts_[r].probabilities(d,t) = noisy_rollouts_[r].importance_weight *
-            exp(exponent);
-
-        probl_sum += noisy_rollouts_[r].probabilities(d,t);
-      }
-
-      // scaling each probability value by the sum of all probabilities corresponding to all rollouts at time "t"
-      for (auto r = 0u; r<num_active_rollouts_; ++r)
-      {
-        noisy_rollouts_[r].probabilities(d,t) /= probl_sum;
-      }
-    }
-
-
     // computing full probabilities
     min_cost = noisy_rollouts_[0].full_costs[d];
     max_cost = min_cost;
@@ -729,21 +1246,106 @@ bool Stomp::computeProbabilities()
   return true;
 }
 
-bool Stomp::updateParameters()
+bool Stomp::adaptNoiseCovariance()
 {
-  // computing updates from probabilities using convex combination
-  parameters_updates_.setZero();
-  for(auto d = 0u; d < config_.num_dimensions ; d++)
+  if(config_.covariance_adaptation_rate <= 0.0)
+  {
+    return true;
+  }
+
+  /*
+   * The first estimate is the unweighted covariance of the noise sampled by the task, which also sets the lower bound
+   * of the variances.  The estimate then moves towards the covariance of the rollouts weighted by their probabilities.
+   */
+  if(!noise_covariance_initialized_)
+  {
+    if(!computeNoiseCovariance(false,noise_covariance_))
+    {
+      return true;
+    }
+
+    double min_scale = std::min(std::max(config_.min_noise_scale,0.0),1.0);
+    min_noise_variances_ = noise_covariance_.diagonal() * (min_scale * min_scale);
+    noise_covariance_initialized_ = true;
+  }
+
+  if(computeNoiseCovariance(true,sample_covariance_))
+  {
+    double rate = std::min(config_.covariance_adaptation_rate,1.0);
+    noise_covariance_ = (1.0 - rate) * noise_covariance_ + rate * sample_covariance_;
+  }
+
+  noise_covariance_.diagonal() = noise_covariance_.diagonal().cwiseMax(min_noise_variances_);
+  for(auto i = 0u; i < config_.num_dimensions; i++)
+  {
+    for(auto j = 0u; j < i; j++)
+    {
+      noise_covariance_(i,j) = config_.adapt_cross_covariance ? noise_covariance_(i,j) : 0.0;
+      noise_covariance_(j,i) = noise_covariance_(i,j);
+    }
+  }
+
+  return true;
+}
+
+bool Stomp::computeNoiseCovariance(bool weighted,Eigen::MatrixXd& covariance)
+{
+  // the last active rollout holds the optimized parameters which carry no noise
+  int num_rollouts = num_active_rollouts_ - 1;
+  if(num_rollouts < 1)
+  {
+    return false;
+  }
+
+  probability_sums_.setZero();
+  for(int r = 0; r < num_rollouts; r++)
   {
+    for(auto d = 0u; d < config_.num_dimensions; d++)
+    {
+      probability_sums_(d) += weighted ? noisy_rollouts_[r].full_probabilities[d] : 1.0;
+    }
+  }
 
-    for(auto r = 0u; r < num_active_rollouts_; r++)
+  if(probability_sums_.minCoeff() < MIN_COST_DIFFERENCE)
+  {
+    return false;
+  }
+
+  covariance.setZero();
+  for(int r = 0; r < num_rollouts; r++)
+  {
+    const Rollout& rollout = noisy_rollouts_[r];
+    for(auto i = 0u; i < config_.num_dimensions; i++)
     {
-      auto& rollout = noisy_rollouts_[r];
-      parameters_updates_.row(d) +=  (rollout.noise.row(d).array() * rollout.probabilities.row(d).array()).matrix();
+      double p_i = weighted ? rollout.full_probabilities[i] : 1.0;
+      for(auto j = 0u; j <= i; j++)
+      {
+        double p_j = weighted ? rollout.full_probabilities[j] : 1.0;
+        double weight = 0.5 * (p_i/probability_sums_(i) + p_j/probability_sums_(j));
+        covariance(i,j) += weight * rollout.noise.row(i).dot(rollout.noise.row(j));
+      }
     }
+  }
+
+  // the task applies the noise scale on top of the covariance
+  double scale = rollout_scheduler_.getNoiseScale();
+  covariance /= config_.num_timesteps * scale * scale;
+  return true;
+}
+
+bool Stomp::updateParameters()
+{
+  Profiler::ScopedTimer timer(profiler_,SolvePhases::UPDATE_PARAMETERS);
 
+  // gathering the noise of the active rollouts, this happens after filtering since the filters may modify it
+  for(auto r = 0u; r < num_active_rollouts_; r++)
+  {
+    rollout_arrays_->setRolloutNoise(r,noisy_rollouts_[r].noise);
   }
 
+  // computing updates from probabilities using convex combination
+  rollout_arrays_->computeUpdates(num_active_rollouts_,parameters_updates_);
+
   // filtering updates
   if(!task_->filterParameterUpdates(0,config_.num_timesteps,current_iteration_,parameters_optimized_,parameters_updates_))
   {
@@ -751,7 +1353,8 @@ bool Stomp::updateParameters()
     return false;
   }
 
-  // updating parameters
+  // updating parameters, the current ones are kept in case the update is reverted
+  previous_parameters_ = parameters_optimized_;
   parameters_optimized_ += parameters_updates_;
 
   return true;
@@ -759,15 +1362,27 @@ bool Stomp::updateParameters()
 
 bool Stomp::computeOptimizedCost()
 {
+  Profiler::ScopedTimer timer(profiler_,SolvePhases::COMPUTE_OPTIMIZED_COST);
+
+  // the costs are only kept when they correspond to the parameters before the update
+  bool incremental = parameters_costs_current_;
+  parameters_costs_current_ = false;
+  if(incremental)
+  {
+    previous_parameters_valid_ = parameters_valid_;
+    previous_parameters_total_cost_ = parameters_total_cost_;
+    previous_state_costs_ = parameters_state_costs_;
+    previous_control_costs_ = parameters_control_costs_;
+  }
 
   // control costs
   parameters_total_cost_ = 0;
   if(config_.control_cost_weight > MIN_CONTROL_COST_WEIGHT)
   {
-    computeParametersControlCosts(parameters_optimized_,
+    control_costs_function_(parameters_optimized_,
                                   config_.delta_t,
                                   config_.control_cost_weight,
-                                  control_cost_matrix_R_,
+                                  control_cost_matrices_->R,
                                   parameters_control_costs_);
 
     // adding all costs
@@ -775,30 +1390,78 @@ bool Stomp::computeOptimizedCost()
 
   }
 
-  // state costs
-  if(task_->computeCosts(parameters_optimized_,
-                         0,config_.num_timesteps,current_iteration_,parameters_state_costs_,parameters_valid_))
+  // state costs, once they are current only the timesteps changed by the update need to be evaluated again
+  bool computed;
+  if(incremental)
   {
-
-
-    parameters_total_cost_ += parameters_state_costs_.sum();
+    computeChangedTimesteps(parameters_optimized_,previous_parameters_,parameters_changed_timesteps_);
+    computed = task_->computeChangedCosts(parameters_optimized_,0,config_.num_timesteps,current_iteration_,
+                                          parameters_changed_timesteps_,parameters_state_costs_,parameters_valid_);
   }
   else
+  {
+    computed = task_->computeCosts(parameters_optimized_,0,config_.num_timesteps,current_iteration_,
+                                   parameters_state_costs_,parameters_valid_);
+  }
+
+  if(!computed)
   {
     return false;
   }
 
+  parameters_total_cost_ += parameters_state_costs_.sum();
+  parameters_costs_current_ = true;
+
+  updateBestSolution();
+
   if(current_lowest_cost_ > parameters_total_cost_)
   {
     current_lowest_cost_ = parameters_total_cost_;
   }
-  else
+  else if(incremental)
   {
-    // reverting updates as no improvement was made
-    parameters_optimized_ -= parameters_updates_;
+    // reverting updates as no improvement was made, the previous costs are restored along with the parameters
+    parameters_optimized_.swap(previous_parameters_);
+    parameters_state_costs_.swap(previous_state_costs_);
+    parameters_control_costs_.swap(previous_control_costs_);
+    parameters_valid_ = previous_parameters_valid_;
+    parameters_total_cost_ = previous_parameters_total_cost_;
   }
 
   return true;
 }
 
+bool Stomp::runRollouts(int num_rollouts,const std::function<bool (int)>& func)
+{
+  // the deadline is checked before each rollout, the remaining rollouts are skipped once it has passed
+  if(!thread_pool_)
+  {
+    for(int r = 0; r < num_rollouts; r++)
+    {
+      if(deadlineExpired() || !func(r))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  std::atomic<bool> succeeded(true);
+  auto run_rollout = [&](int r)
+  {
+    if(succeeded && (deadlineExpired() || !func(r)))
+    {
+      succeeded = false;
+    }
+  };
+
+  // capturing a single reference keeps the job within the small buffer of std::function so it is not heap allocated
+  thread_pool_->parallelFor(num_rollouts,[&run_rollout](int r, int worker)
+  {
+    run_rollout(r);
+  });
+
+  return succeeded;
+}
+
 } /* namespace stomp */
@@ -0,0 +1,154 @@
+/**
+ * @file thread_pool.cpp
+ * @brief This defines a fixed size thread pool used to process the stomp rollouts concurrently
+ *
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "stomp_core/thread_pool.h"
+
+namespace stomp_core
+{
+
+ThreadPool::ThreadPool(int num_threads):
+    job_(nullptr),
+    count_(0),
+    next_index_(0),
+    pending_workers_(0),
+    batch_id_(0),
+    stop_(false)
+{
+  for(int w = 1; w < num_threads; w++)
+  {
+    threads_.emplace_back(&ThreadPool::workerLoop,this,w);
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  work_condition_.notify_all();
+
+  for(auto& t : threads_)
+  {
+    t.join();
+  }
+}
+
+int ThreadPool::size() const
+{
+  return threads_.size() + 1;
+}
+
+void ThreadPool::parallelFor(int count, const Job& job)
+{
+  if(count <= 0)
+  {
+    return;
+  }
+
+  // nothing to distribute
+  if(threads_.empty() || count == 1)
+  {
+    for(int i = 0; i < count; i++)
+    {
+      job(i,0);
+    }
+    return;
+  }
+
+  std::lock_guard<std::mutex> submit_lock(submit_mutex_);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    job_ = &job;
+    count_ = count;
+    next_index_ = 0;
+    pending_workers_ = threads_.size();
+    exception_ = nullptr;
+    batch_id_++;
+  }
+  work_condition_.notify_all();
+
+  // the calling thread is worker 0
+  runJobs(0);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_condition_.wait(lock,[this](){ return pending_workers_ == 0; });
+  job_ = nullptr;
+
+  if(exception_)
+  {
+    std::exception_ptr e = exception_;
+    exception_ = nullptr;
+    std::rethrow_exception(e);
+  }
+}
+
+void ThreadPool::runJobs(int worker)
+{
+  int index;
+  while((index = next_index_++) < count_)
+  {
+    try
+    {
+      (*job_)(index,worker);
+    }
+    catch(...)
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if(!exception_)
+      {
+        exception_ = std::current_exception();
+      }
+    }
+  }
+}
+
+void ThreadPool::workerLoop(int worker)
+{
+  unsigned long last_batch_id = 0;
+  while(true)
+  {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      work_condition_.wait(lock,[&](){ return stop_ || batch_id_ != last_batch_id; });
+      if(stop_)
+      {
+        return;
+      }
+      last_batch_id = batch_id_;
+    }
+
+    runJobs(worker);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      pending_workers_--;
+      if(pending_workers_ == 0)
+      {
+        done_condition_.notify_one();
+      }
+    }
+  }
+}
+
+} /* namespace stomp_core */
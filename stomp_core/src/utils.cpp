@@ -24,6 +24,8 @@
  * limitations under the License.
  */
 #include <stomp_core/utils.h>
+#include <stomp_core/matrix_cache.h>
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <Eigen/Dense>
@@ -61,35 +63,80 @@ void generateFiniteDifferenceMatrix(int num_time_steps,
   }
 }
 
+void generateControlCostMatrix(int num_time_steps, double dt, SymmetricBandedMatrix& control_cost_matrix)
+{
+  const DerivativeOrders::DerivativeOrder order = DerivativeOrders::STOMP_ACCELERATION;
+  const int half_length = FINITE_DIFF_RULE_LENGTH/2;
+  double multiplier = 1.0/pow(dt,(int)order);
+
+  // R(j,k) = dt * sum_i A(i,j)*A(i,k), each row 'i' of A only spans the columns [i - half_length, i + half_length]
+  control_cost_matrix.resize(num_time_steps,FINITE_DIFF_RULE_LENGTH - 1);
+  for(int i = 0; i < num_time_steps; i++)
+  {
+    int first = std::max(0,i - half_length);
+    int last = std::min(num_time_steps - 1,i + half_length);
+    for(int j = first; j <= last; j++)
+    {
+      double a_ij = multiplier * FINITE_CENTRAL_DIFF_COEFFS[order][j - i + half_length];
+      for(int k = first; k <= j; k++)
+      {
+        double a_ik = multiplier * FINITE_CENTRAL_DIFF_COEFFS[order][k - i + half_length];
+        control_cost_matrix.coeffRef(j,k) += dt * a_ij * a_ik;
+      }
+    }
+  }
+}
+
 void generateSmoothingMatrix(int num_timesteps,double dt, Eigen::MatrixXd& projection_matrix_M)
 {
-  using namespace Eigen;
+  projection_matrix_M = *MatrixCache::instance().getSmoothingMatrix(num_timesteps,dt);
+}
+
+void resampleCubic(const Eigen::MatrixXd& parameters,int num_timesteps,Eigen::MatrixXd& resampled)
+{
+  int n = parameters.cols();
+  resampled.resize(parameters.rows(),num_timesteps);
+  if(n < 2 || num_timesteps < 2)
+  {
+    resampled.colwise() = parameters.col(0);
+    return;
+  }
+
+  // second derivatives of the spline with unit knot spacing, the tridiagonal system is solved with the Thomas algorithm
+  Eigen::MatrixXd second_derivatives = Eigen::MatrixXd::Zero(parameters.rows(),n);
+  if(n > 2)
+  {
+    Eigen::VectorXd diagonal = Eigen::VectorXd::Constant(n - 2,4.0);
+    Eigen::MatrixXd rhs = 6.0 * (parameters.rightCols(n - 2) - 2.0 * parameters.middleCols(1,n - 2) +
+        parameters.leftCols(n - 2));
+    for(int i = 1; i < n - 2; i++)
+    {
+      double w = 1.0/diagonal(i - 1);
+      diagonal(i) -= w;
+      rhs.col(i) -= w * rhs.col(i - 1);
+    }
+
+    second_derivatives.col(n - 2) = rhs.col(n - 3)/diagonal(n - 3);
+    for(int i = n - 4; i >= 0; i--)
+    {
+      second_derivatives.col(i + 1) = (rhs.col(i) - second_derivatives.col(i + 2))/diagonal(i);
+    }
+  }
 
-  // generate augmented finite differencing matrix
-  int start_index_padded = FINITE_DIFF_RULE_LENGTH-1;
-  int num_timesteps_padded = num_timesteps + 2*(FINITE_DIFF_RULE_LENGTH-1);
-  MatrixXd finite_diff_matrix_A_padded;
-  generateFiniteDifferenceMatrix(num_timesteps_padded,DerivativeOrders::STOMP_ACCELERATION,
-                                 dt,finite_diff_matrix_A_padded);
-
-
-  /* computing control cost matrix (R = A_transpose * A):
-   * Note: Original code multiplies the A product by the time interval.  However this is not
-   * what was described in the literature
-   */
-  MatrixXd control_cost_matrix_R_padded = dt*finite_diff_matrix_A_padded.transpose() * finite_diff_matrix_A_padded;
-  MatrixXd control_cost_matrix_R = control_cost_matrix_R_padded.block(
-      start_index_padded,start_index_padded,num_timesteps,num_timesteps);
-  MatrixXd inv_control_cost_matrix_R = control_cost_matrix_R.fullPivLu().inverse();
-
-  // computing projection matrix M
-  projection_matrix_M = inv_control_cost_matrix_R;
-  double max = 0;
-  for(auto t = 0u; t < num_timesteps; t++)
+  double scale = static_cast<double>(n - 1)/(num_timesteps - 1);
+  for(int j = 0; j < num_timesteps; j++)
   {
-    max = projection_matrix_M(t,t);
-    projection_matrix_M.col(t)*= (1.0/(num_timesteps*max)); // scaling such that the maximum value is 1/num_timesteps
+    double x = j * scale;
+    int i = std::min(static_cast<int>(x),n - 2);
+    double t = x - i;
+    double s = 1.0 - t;
+    resampled.col(j) = s * parameters.col(i) + t * parameters.col(i + 1) +
+        ((s*s*s - s) * second_derivatives.col(i) + (t*t*t - t) * second_derivatives.col(i + 1))/6.0;
   }
+
+  // avoiding round off at the end points
+  resampled.col(0) = parameters.col(0);
+  resampled.col(num_timesteps - 1) = parameters.col(n - 1);
 }
 
 void differentiate(const Eigen::VectorXd& parameters, DerivativeOrders::DerivativeOrder order,
@@ -140,6 +187,19 @@ void differentiate(const Eigen::VectorXd& parameters, DerivativeOrders::Derivati
   derivatives = A*parameters/std::pow(dt,2);
 }
 
+int computeChangedTimesteps(const Eigen::MatrixXd& parameters,const Eigen::MatrixXd& reference,
+                            TimestepMask& changed_timesteps)
+{
+  int num_changed = 0;
+  for(auto t = 0u; t < parameters.cols(); t++)
+  {
+    changed_timesteps(t) = (parameters.col(t).array() != reference.col(t).array()).any();
+    num_changed += changed_timesteps(t) ? 1 : 0;
+  }
+
+  return num_changed;
+}
+
 void toVector(const Eigen::MatrixXd& m,std::vector<Eigen::VectorXd>& v)
 {
   v.resize(m.rows(),Eigen::VectorXd::Zero(m.cols()));
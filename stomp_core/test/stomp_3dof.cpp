@@ -23,9 +23,18 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <atomic>
+#include <chrono>
 #include <iostream>
+#include <mutex>
+#include <random>
+#include <set>
+#include <thread>
 #include <Eigen/Dense>
 #include <gtest/gtest.h>
+#include "stomp_core/multi_start_stomp.h"
+#include "stomp_core/random_stream.h"
+#include "stomp_core/segment_stomp.h"
 #include "stomp_core/stomp.h"
 #include "stomp_core/task.h"
 
@@ -145,37 +154,652 @@ public:
     return smoothParameterUpdates(start_timestep,num_timesteps,iteration_number,updates);
   }
 
+  /**
+   * @brief Changes the trajectory used for computing the cost
+   * @param parameters_bias The new parameter bias
+   */
+  void setParametersBias(const Trajectory& parameters_bias)
+  {
+    parameters_bias_ = parameters_bias;
+  }
+
+
+protected:
+
+  /**
+   * @brief Perform a smooth update given a noisy update
+   * @param start_timestep starting timestep
+   * @param num_timesteps number of timesteps
+   * @param iteration_number number of interations allowed
+   * @param updates returned smooth update
+   * @return True if successful, otherwise false
+   */
+  bool smoothParameterUpdates(std::size_t start_timestep,
+                              std::size_t num_timesteps,
+                              int iteration_number,
+                              Eigen::MatrixXd& updates)
+  {
+
+    for(auto d = 0u; d < updates.rows(); d++)
+    {
+      updates.row(d).transpose() = smoothing_M_*(updates.row(d).transpose());
+    }
+
+    return true;
+  }
+
+protected:
+
+  Trajectory parameters_bias_;          /**< Parameter bias used for computing cost for the test */
+  std::vector<double> bias_thresholds_; /**< Threshold to determine whether two trajectories are equal */
+  std::vector<double> std_dev_;         /**< Standard deviation used for generating noisy parameters */
+  Eigen::MatrixXd smoothing_M_;         /**< Matrix used for smoothing the trajectory */
+};
+
+/** @brief A dummy task that supports generating and evaluating the rollouts concurrently */
+class ConcurrentDummyTask: public DummyTask
+{
+public:
+  /**
+   * @brief A dummy task for testing concurrent rollouts in Stomp
+   * @param parameters_bias default parameter bias used for computing cost for the test
+   * @param bias_thresholds threshold to determine whether two trajectories are equal
+   * @param std_dev standard deviation used for generating noisy parameters
+   */
+  ConcurrentDummyTask(const Trajectory& parameters_bias,
+                      const std::vector<double>& bias_thresholds,
+                      const std::vector<double>& std_dev):
+                        DummyTask(parameters_bias,bias_thresholds,std_dev)
+  {
+
+  }
+
+  bool supportsConcurrentRollouts() const override
+  {
+    return true;
+  }
+
+  /** @brief Uses a random generator seeded from the iteration and rollout instead of rand() */
+  bool generateNoisyParameters(const Eigen::MatrixXd& parameters,
+                               std::size_t start_timestep,
+                               std::size_t num_timesteps,
+                               int iteration_number,
+                               int rollout_number,
+                               Eigen::MatrixXd& parameters_noise,
+                               Eigen::MatrixXd& noise) override
+  {
+    bool concurrent;
+    {
+      std::lock_guard<std::mutex> lock(threads_mutex_);
+      threads_.insert(std::this_thread::get_id());
+      concurrent = threads_.size() > 1;
+    }
+
+    // gives the other workers time to pick up a rollout until more than one thread has been seen
+    if(!concurrent)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    std::mt19937 generator(iteration_number * 1000 + rollout_number);
+    std::uniform_real_distribution<double> distribution(-1.0,1.0);
+    for(std::size_t d = 0; d < parameters.rows(); d++)
+    {
+      for(std::size_t t = 0; t < parameters.cols(); t++)
+      {
+        noise(d,t) = distribution(generator)*std_dev_[d];
+      }
+    }
+
+    parameters_noise = parameters + noise;
+
+    return true;
+  }
+
+  /** @brief The number of distinct threads that generated noisy parameters */
+  std::size_t getNumThreadsUsed()
+  {
+    std::lock_guard<std::mutex> lock(threads_mutex_);
+    return threads_.size();
+  }
+
+protected:
+
+  std::mutex threads_mutex_;
+  std::set<std::thread::id> threads_;
+};
+
+/** @brief A dummy task that draws its noise from the random stream of the seed passed by Stomp */
+class SeededDummyTask: public ConcurrentDummyTask
+{
+public:
+  /**
+   * @brief A dummy task for testing reproducible rollouts in Stomp
+   * @param parameters_bias default parameter bias used for computing cost for the test
+   * @param bias_thresholds threshold to determine whether two trajectories are equal
+   * @param std_dev standard deviation used for generating noisy parameters
+   */
+  SeededDummyTask(const Trajectory& parameters_bias,
+                  const std::vector<double>& bias_thresholds,
+                  const std::vector<double>& std_dev):
+                    ConcurrentDummyTask(parameters_bias,bias_thresholds,std_dev),
+                    random_seed_(0)
+  {
+
+  }
+
+  void setRandomSeed(std::uint64_t seed) override
+  {
+    random_seed_ = seed;
+  }
+
+  bool generateNoisyParameters(const Eigen::MatrixXd& parameters,
+                               std::size_t start_timestep,
+                               std::size_t num_timesteps,
+                               int iteration_number,
+                               int rollout_number,
+                               Eigen::MatrixXd& parameters_noise,
+                               Eigen::MatrixXd& noise) override
+  {
+    RandomStream stream(random_seed_,iteration_number,rollout_number);
+    for(std::size_t d = 0; d < parameters.rows(); d++)
+    {
+      for(std::size_t t = 0; t < parameters.cols(); t++)
+      {
+        noise(d,t) = (2.0*stream.uniform() - 1.0)*std_dev_[d];
+      }
+    }
+
+    parameters_noise = parameters + noise;
+
+    return true;
+  }
+
+protected:
+
+  std::uint64_t random_seed_;           /**< Master seed passed by Stomp */
+};
+
+/** @brief A dummy task that draws gaussian noise and provides its density for weighting the reused rollouts */
+class GaussianDummyTask: public SeededDummyTask
+{
+public:
+  /**
+   * @brief A dummy task for testing the importance weights of the reused rollouts
+   * @param parameters_bias default parameter bias used for computing cost for the test
+   * @param bias_thresholds threshold to determine whether two trajectories are equal
+   * @param std_dev standard deviation used for generating noisy parameters
+   */
+  GaussianDummyTask(const Trajectory& parameters_bias,
+                    const std::vector<double>& bias_thresholds,
+                    const std::vector<double>& std_dev):
+                      SeededDummyTask(parameters_bias,bias_thresholds,std_dev),
+                      noise_scale_(1.0),
+                      generated_(0),
+                      densities_(0)
+  {
+
+  }
+
+  void setNoiseScale(double scale) override
+  {
+    noise_scale_ = scale;
+  }
+
+  /** @brief The noise is white in time so the covariance applies to every timestep */
+  void setNoiseCovariance(const Eigen::MatrixXd& covariance) override
+  {
+    covariance_ = covariance;
+    if(covariance.size() > 0)
+    {
+      covariance_cholesky_ = covariance.llt().matrixL();
+    }
+  }
+
+  bool generateNoisyParameters(const Eigen::MatrixXd& parameters,
+                               std::size_t start_timestep,
+                               std::size_t num_timesteps,
+                               int iteration_number,
+                               int rollout_number,
+                               Eigen::MatrixXd& parameters_noise,
+                               Eigen::MatrixXd& noise) override
+  {
+    RandomStream stream(random_seed_,iteration_number,rollout_number);
+    for(std::size_t d = 0; d < parameters.rows(); d++)
+    {
+      for(std::size_t t = 0; t < parameters.cols(); t++)
+      {
+        noise(d,t) = stream.normal()*noise_scale_*(covariance_.size() > 0 ? 1.0 : std_dev_[d]);
+      }
+    }
+
+    if(covariance_.size() > 0)
+    {
+      noise = covariance_cholesky_ * noise;
+    }
+
+    parameters_noise = parameters + noise;
+    generated_++;
+
+    return true;
+  }
+
+  bool computeNoiseLogDensity(const Eigen::MatrixXd& noise,double& log_density) const override
+  {
+    log_density = 0.0;
+    if(covariance_.size() > 0)
+    {
+      Eigen::MatrixXd whitened = covariance_cholesky_.triangularView<Eigen::Lower>().solve(noise/noise_scale_);
+      log_density = -0.5*whitened.squaredNorm() -
+          noise.cols()*(covariance_cholesky_.diagonal().array().log().sum() + noise.rows()*std::log(noise_scale_));
+    }
+    else
+    {
+      for(std::size_t d = 0; d < noise.rows(); d++)
+      {
+        double sigma = std_dev_[d]*noise_scale_;
+        log_density -= 0.5*noise.row(d).squaredNorm()/(sigma*sigma) + noise.cols()*std::log(sigma);
+      }
+    }
+
+    densities_++;
+    return true;
+  }
+
+  /** @brief The last covariance passed by Stomp */
+  const Eigen::MatrixXd& getNoiseCovariance() const
+  {
+    return covariance_;
+  }
+
+  /** @brief The number of noisy trajectories generated */
+  int getGenerated() const
+  {
+    return generated_;
+  }
+
+  /** @brief The number of densities computed, once per generated rollout and once per reused rollout */
+  int getDensities() const
+  {
+    return densities_;
+  }
+
+protected:
+
+  double noise_scale_;                  /**< The noise scale passed by Stomp */
+  Eigen::MatrixXd covariance_;          /**< The joint space covariance passed by Stomp, empty when not adapted */
+  Eigen::MatrixXd covariance_cholesky_; /**< The lower Cholesky factor of the covariance */
+  std::atomic<int> generated_;          /**< The number of noisy trajectories generated */
+  mutable std::atomic<int> densities_;  /**< The number of densities computed */
+};
+
+/** @brief A dummy task that can be optimized at fewer timesteps by resampling its bias */
+class MultiResolutionDummyTask: public SeededDummyTask
+{
+public:
+  /**
+   * @brief A dummy task for testing coarse-to-fine solves
+   * @param parameters_bias default parameter bias used for computing cost for the test
+   * @param bias_thresholds threshold to determine whether two trajectories are equal
+   * @param std_dev standard deviation used for generating noisy parameters
+   */
+  MultiResolutionDummyTask(const Trajectory& parameters_bias,
+                           const std::vector<double>& bias_thresholds,
+                           const std::vector<double>& std_dev):
+                             SeededDummyTask(parameters_bias,bias_thresholds,std_dev),
+                             full_parameters_bias_(parameters_bias)
+  {
+
+  }
+
+  bool supportsMultiResolution() const override
+  {
+    return true;
+  }
+
+  bool setResolution(const StompConfiguration& config) override
+  {
+    resampleCubic(full_parameters_bias_,config.num_timesteps,parameters_bias_);
+    generateSmoothingMatrix(config.num_timesteps,1.0,smoothing_M_);
+    resolutions.push_back(config.num_timesteps);
+    return true;
+  }
+
+  std::vector<int> resolutions;         /**< The number of timesteps passed to each call of setResolution() */
+
+protected:
+
+  Trajectory full_parameters_bias_;     /**< Parameter bias at the full resolution */
+};
+
+/** @brief A dummy task that times its cost evaluations */
+class ProfiledDummyTask: public SeededDummyTask
+{
+public:
+  /**
+   * @brief A dummy task for testing the profile of a solve
+   * @param parameters_bias default parameter bias used for computing cost for the test
+   * @param bias_thresholds threshold to determine whether two trajectories are equal
+   * @param std_dev standard deviation used for generating noisy parameters
+   */
+  ProfiledDummyTask(const Trajectory& parameters_bias,
+                    const std::vector<double>& bias_thresholds,
+                    const std::vector<double>& std_dev):
+                      SeededDummyTask(parameters_bias,bias_thresholds,std_dev)
+  {
+    cost_timer_ = profiler_.addCounter("task_costs");
+  }
+
+  bool computeNoisyCosts(const Eigen::MatrixXd& parameters,
+                         std::size_t start_timestep,
+                         std::size_t num_timesteps,
+                         int iteration_number,
+                         int rollout_number,
+                         Eigen::VectorXd& costs,
+                         bool& validity) override
+  {
+    Profiler::ScopedTimer timer(profiler_,cost_timer_);
+    return SeededDummyTask::computeNoisyCosts(parameters,start_timestep,num_timesteps,iteration_number,rollout_number,
+                                              costs,validity);
+  }
+
+  void resetProfile() override
+  {
+    profiler_.reset();
+  }
+
+  void getProfile(ProfileReport& report) const override
+  {
+    profiler_.getReport(report);
+  }
+
+protected:
+
+  Profiler profiler_;                   /**< Times the cost evaluations */
+  int cost_timer_;                      /**< Counter index of the cost evaluations */
+};
+
+/** @brief A dummy task that scales its noise as requested by Stomp and counts the cost evaluations */
+class ScheduledDummyTask: public ConcurrentDummyTask
+{
+public:
+  /**
+   * @brief A dummy task for testing the adaptive rollout schedule in Stomp
+   * @param parameters_bias default parameter bias used for computing cost for the test
+   * @param bias_thresholds threshold to determine whether two trajectories are equal
+   * @param std_dev standard deviation used for generating noisy parameters
+   */
+  ScheduledDummyTask(const Trajectory& parameters_bias,
+                     const std::vector<double>& bias_thresholds,
+                     const std::vector<double>& std_dev):
+                       ConcurrentDummyTask(parameters_bias,bias_thresholds,std_dev),
+                       noise_scale_(1.0),
+                       min_noise_scale_(1.0),
+                       num_evaluations_(0)
+  {
+
+  }
+
+  void setNoiseScale(double scale) override
+  {
+    noise_scale_ = scale;
+    min_noise_scale_ = std::min(min_noise_scale_,scale);
+  }
+
+  bool generateNoisyParameters(const Eigen::MatrixXd& parameters,
+                               std::size_t start_timestep,
+                               std::size_t num_timesteps,
+                               int iteration_number,
+                               int rollout_number,
+                               Eigen::MatrixXd& parameters_noise,
+                               Eigen::MatrixXd& noise) override
+  {
+    ConcurrentDummyTask::generateNoisyParameters(parameters,start_timestep,num_timesteps,iteration_number,
+                                                 rollout_number,parameters_noise,noise);
+    noise *= noise_scale_;
+    parameters_noise = parameters + noise;
+    return true;
+  }
+
+  bool computeNoisyCosts(const Trajectory& parameters,
+                         std::size_t start_timestep,
+                         std::size_t num_timesteps,
+                         int iteration_number,
+                         int rollout_number,
+                         Eigen::VectorXd& costs,
+                         bool& validity) override
+  {
+    num_evaluations_++;
+    return DummyTask::computeNoisyCosts(parameters,start_timestep,num_timesteps,iteration_number,rollout_number,
+                                        costs,validity);
+  }
+
+  double getMinNoiseScale() const
+  {
+    return min_noise_scale_;
+  }
+
+  int getNumEvaluations() const
+  {
+    return num_evaluations_;
+  }
+
+protected:
+
+  double noise_scale_;                  /**< Noise scale of the current iteration */
+  double min_noise_scale_;              /**< Lowest noise scale requested by Stomp */
+  std::atomic<int> num_evaluations_;    /**< Number of noisy cost evaluations */
+};
+
+/** @brief A dummy task that evaluates the rollouts in batches */
+class BatchedDummyTask: public ConcurrentDummyTask
+{
+public:
+  /**
+   * @brief A dummy task for testing the batched cost evaluation in Stomp
+   * @param parameters_bias default parameter bias used for computing cost for the test
+   * @param bias_thresholds threshold to determine whether two trajectories are equal
+   * @param std_dev standard deviation used for generating noisy parameters
+   */
+  BatchedDummyTask(const Trajectory& parameters_bias,
+                   const std::vector<double>& bias_thresholds,
+                   const std::vector<double>& std_dev):
+                     ConcurrentDummyTask(parameters_bias,bias_thresholds,std_dev),
+                     num_batches_(0),
+                     num_batched_rollouts_(0)
+  {
+
+  }
+
+  bool supportsBatchedCosts() const override
+  {
+    return true;
+  }
+
+  bool computeNoisyCostsBatch(const std::vector<Eigen::MatrixXd>& parameters,
+                              std::size_t start_timestep,
+                              std::size_t num_timesteps,
+                              int iteration_number,
+                              const std::vector<TimestepMask>& changed_timesteps,
+                              std::vector<Eigen::VectorXd>& costs,
+                              std::vector<bool>& validity) override
+  {
+    num_batches_++;
+    num_batched_rollouts_ += parameters.size();
+    return Task::computeNoisyCostsBatch(parameters,start_timestep,num_timesteps,iteration_number,changed_timesteps,
+                                        costs,validity);
+  }
+
+  int getNumBatches() const
+  {
+    return num_batches_;
+  }
+
+  int getNumBatchedRollouts() const
+  {
+    return num_batched_rollouts_;
+  }
+
+protected:
+
+  int num_batches_;                     /**< Number of batched evaluations */
+  int num_batched_rollouts_;            /**< Number of rollouts evaluated in batches */
+};
+
+/** @brief A dummy task whose cost evaluation takes a fixed amount of time */
+class DelayedDummyTask: public DummyTask
+{
+public:
+  /**
+   * @brief A dummy task for testing deadlines in Stomp
+   * @param parameters_bias default parameter bias used for computing cost for the test
+   * @param bias_thresholds threshold to determine whether two trajectories are equal
+   * @param std_dev standard deviation used for generating noisy parameters
+   * @param delay time spent on each cost evaluation
+   */
+  DelayedDummyTask(const Trajectory& parameters_bias,
+                   const std::vector<double>& bias_thresholds,
+                   const std::vector<double>& std_dev,
+                   std::chrono::milliseconds delay):
+                     DummyTask(parameters_bias,bias_thresholds,std_dev),
+                     delay_(delay)
+  {
+
+  }
+
+  bool computeNoisyCosts(const Trajectory& parameters,
+                         std::size_t start_timestep,
+                         std::size_t num_timesteps,
+                         int iteration_number,
+                         int rollout_number,
+                         Eigen::VectorXd& costs,
+                         bool& validity) override
+  {
+    std::this_thread::sleep_for(delay_);
+    return DummyTask::computeNoisyCosts(parameters,start_timestep,num_timesteps,iteration_number,rollout_number,
+                                        costs,validity);
+  }
+
+protected:
+
+  std::chrono::milliseconds delay_;     /**< Time spent on each cost evaluation */
+};
+
+/** @brief A dummy task that perturbs a window of timesteps per rollout and only re-evaluates the changed timesteps */
+class IncrementalDummyTask: public ConcurrentDummyTask
+{
+public:
+  /**
+   * @brief A dummy task for testing the incremental cost evaluation in Stomp
+   * @param parameters_bias default parameter bias used for computing cost for the test
+   * @param bias_thresholds threshold to determine whether two trajectories are equal
+   * @param std_dev standard deviation used for generating noisy parameters
+   * @param window_size number of timesteps perturbed by each rollout
+   */
+  IncrementalDummyTask(const Trajectory& parameters_bias,
+                       const std::vector<double>& bias_thresholds,
+                       const std::vector<double>& std_dev,
+                       int window_size):
+                         ConcurrentDummyTask(parameters_bias,bias_thresholds,std_dev),
+                         window_size_(window_size),
+                         evaluated_timesteps_(0),
+                         stale_timesteps_(0)
+  {
+
+  }
+
+  /** @brief Only perturbs a window of timesteps, the window is moved along the trajectory with the rollout number */
+  bool generateNoisyParameters(const Eigen::MatrixXd& parameters,
+                               std::size_t start_timestep,
+                               std::size_t num_timesteps,
+                               int iteration_number,
+                               int rollout_number,
+                               Eigen::MatrixXd& parameters_noise,
+                               Eigen::MatrixXd& noise) override
+  {
+    ConcurrentDummyTask::generateNoisyParameters(parameters,start_timestep,num_timesteps,iteration_number,
+                                                 rollout_number,parameters_noise,noise);
+
+    int window_start = 1 + (rollout_number * window_size_) % (num_timesteps - window_size_ - 1);
+    noise.leftCols(window_start).setZero();
+    noise.rightCols(num_timesteps - window_start - window_size_).setZero();
+    parameters_noise = parameters + noise;
+
+    return true;
+  }
+
+  bool computeChangedNoisyCosts(const Eigen::MatrixXd& parameters,
+                                std::size_t start_timestep,
+                                std::size_t num_timesteps,
+                                int iteration_number,
+                                int rollout_number,
+                                const TimestepMask& changed_timesteps,
+                                Eigen::VectorXd& costs,
+                                bool& validity) override
+  {
+    return updateChangedCosts(parameters,num_timesteps,changed_timesteps,costs,validity);
+  }
+
+  bool computeChangedCosts(const Eigen::MatrixXd& parameters,
+                           std::size_t start_timestep,
+                           std::size_t num_timesteps,
+                           int iteration_number,
+                           const TimestepMask& changed_timesteps,
+                           Eigen::VectorXd& costs,
+                           bool& validity) override
+  {
+    return updateChangedCosts(parameters,num_timesteps,changed_timesteps,costs,validity);
+  }
+
+  int getEvaluatedTimesteps() const
+  {
+    return evaluated_timesteps_;
+  }
+
+  int getStaleTimesteps() const
+  {
+    return stale_timesteps_;
+  }
 
 protected:
 
   /**
-   * @brief Perform a smooth update given a noisy update
-   * @param start_timestep starting timestep
-   * @param num_timesteps number of timesteps
-   * @param iteration_number number of interations allowed
-   * @param updates returned smooth update
-   * @return True if successful, otherwise false
+   * @brief Recomputes the costs of the changed timesteps and checks that the costs passed in for the other timesteps
+   * are the ones the full evaluation would produce.
    */
-  bool smoothParameterUpdates(std::size_t start_timestep,
-                              std::size_t num_timesteps,
-                              int iteration_number,
-                              Eigen::MatrixXd& updates)
+  bool updateChangedCosts(const Eigen::MatrixXd& parameters,
+                          std::size_t num_timesteps,
+                          const TimestepMask& changed_timesteps,
+                          Eigen::VectorXd& costs,
+                          bool& validity)
   {
+    Eigen::VectorXd full_costs;
+    bool full_validity;
+    DummyTask::computeNoisyCosts(parameters,0,num_timesteps,0,-1,full_costs,full_validity);
 
-    for(auto d = 0u; d < updates.rows(); d++)
+    for(std::size_t t = 0u; t < num_timesteps; t++)
     {
-      updates.row(d).transpose() = smoothing_M_*(updates.row(d).transpose());
+      if(changed_timesteps(t))
+      {
+        costs(t) = full_costs(t);
+        evaluated_timesteps_++;
+      }
+      else if(costs(t) != full_costs(t))
+      {
+        stale_timesteps_++;
+      }
     }
 
+    // a timestep only has a cost when it is away from the bias
+    validity = (costs.array() == 0).all();
     return true;
   }
 
 protected:
 
-  Trajectory parameters_bias_;          /**< Parameter bias used for computing cost for the test */
-  std::vector<double> bias_thresholds_; /**< Threshold to determine whether two trajectories are equal */
-  std::vector<double> std_dev_;         /**< Standard deviation used for generating noisy parameters */
-  Eigen::MatrixXd smoothing_M_;         /**< Matrix used for smoothing the trajectory */
+  int window_size_;                     /**< Number of timesteps perturbed by each rollout */
+  std::atomic<int> evaluated_timesteps_;/**< Number of timesteps whose cost was computed */
+  std::atomic<int> stale_timesteps_;    /**< Number of unchanged timesteps received with a wrong cost */
 };
 
 /**
@@ -440,3 +1064,528 @@ TEST(Stomp3DOF,solve_60_timesteps)
   std::cout<<"Differences"<<"\n"<<toString(diff)<<line_separator;
 }
 
+/** @brief This tests the Stomp solve method with the rollouts processed by multiple threads */
+TEST(Stomp3DOF,solve_parallel_rollouts)
+{
+  Trajectory trajectory_bias;
+  interpolate(START_POS,END_POS,NUM_TIMESTEPS,trajectory_bias);
+  std::shared_ptr<ConcurrentDummyTask> task(new ConcurrentDummyTask(trajectory_bias,BIAS_THRESHOLD,STD_DEV));
+
+  StompConfiguration config = create3DOFConfiguration();
+  config.num_threads = 4;
+  Stomp stomp(config,task);
+
+  Trajectory optimized;
+  EXPECT_TRUE(stomp.solve(START_POS,END_POS,optimized));
+  EXPECT_GT(task->getNumThreadsUsed(),1u);
+
+  EXPECT_EQ(optimized.rows(),NUM_DIMENSIONS);
+  EXPECT_EQ(optimized.cols(),NUM_TIMESTEPS);
+  EXPECT_TRUE(compareDiff(optimized,trajectory_bias,BIAS_THRESHOLD));
+}
+
+/** @brief This tests re-optimizing from a previous solution after the task has changed */
+TEST(Stomp3DOF,solve_warm_start)
+{
+  Trajectory trajectory_bias;
+  interpolate(START_POS,END_POS,NUM_TIMESTEPS,trajectory_bias);
+  std::shared_ptr<DummyTask> task(new DummyTask(trajectory_bias,BIAS_THRESHOLD,STD_DEV));
+  Stomp stomp(create3DOFConfiguration(),task);
+
+  // there is nothing to warm start from yet
+  Trajectory optimized;
+  EXPECT_FALSE(stomp.solveWarmStart(10,optimized));
+
+  EXPECT_TRUE(stomp.solve(START_POS,END_POS,optimized));
+
+  // shifting the middle of the trajectory
+  Trajectory shifted_bias = trajectory_bias;
+  shifted_bias.middleCols(NUM_TIMESTEPS/4,NUM_TIMESTEPS/2).array() += 0.04;
+  task->setParametersBias(shifted_bias);
+
+  Trajectory replanned;
+  EXPECT_TRUE(stomp.solveWarmStart(20,replanned));
+  EXPECT_EQ(replanned.rows(),NUM_DIMENSIONS);
+  EXPECT_EQ(replanned.cols(),NUM_TIMESTEPS);
+  EXPECT_TRUE(compareDiff(replanned,shifted_bias,BIAS_THRESHOLD));
+}
+
+/** @brief This tests that Stomp returns the best valid solution found when the deadline passes */
+TEST(Stomp3DOF,solve_deadline)
+{
+  using namespace std::chrono;
+
+  Trajectory trajectory_bias;
+  interpolate(START_POS,END_POS,NUM_TIMESTEPS,trajectory_bias);
+  TaskPtr task(new DelayedDummyTask(trajectory_bias,BIAS_THRESHOLD,STD_DEV,milliseconds(1)));
+
+  // keeps iterating after finding a valid solution so that only the deadline stops it
+  StompConfiguration config = create3DOFConfiguration();
+  config.num_iterations = 10000;
+  config.num_iterations_after_valid = 10000;
+  Stomp stomp(config,task);
+
+  // polling the best solution while solving
+  std::atomic<bool> solving(true);
+  std::atomic<bool> solution_read(false);
+  std::thread reader([&]()
+  {
+    Eigen::MatrixXd parameters;
+    double cost;
+    while(solving)
+    {
+      if(stomp.getBestSolution(parameters,cost) && compareDiff(parameters,trajectory_bias,BIAS_THRESHOLD))
+      {
+        solution_read = true;
+      }
+      std::this_thread::sleep_for(milliseconds(1));
+    }
+  });
+
+  Trajectory optimized;
+  milliseconds allowed_time(300);
+  steady_clock::time_point start = steady_clock::now();
+  stomp.setDeadline(start + allowed_time);
+  bool solved = stomp.solve(START_POS,END_POS,optimized);
+  steady_clock::duration elapsed = steady_clock::now() - start;
+  solving = false;
+  reader.join();
+
+  EXPECT_TRUE(solved);
+  EXPECT_LT(elapsed,allowed_time + milliseconds(100));
+  EXPECT_TRUE(solution_read);
+  EXPECT_TRUE(compareDiff(optimized,trajectory_bias,BIAS_THRESHOLD));
+
+  Eigen::MatrixXd best;
+  double best_cost;
+  ASSERT_TRUE(stomp.getBestSolution(best,best_cost));
+  EXPECT_TRUE(best.isApprox(optimized));
+
+  // the invalid initial trajectory is all there is once the deadline has passed
+  config.initialization_method = TrajectoryInitializations::CUBIC_POLYNOMIAL_INTERPOLATION;
+  stomp.setConfig(config);
+  stomp.setDeadline(steady_clock::now());
+  EXPECT_FALSE(stomp.solve(START_POS,END_POS,optimized));
+  EXPECT_FALSE(stomp.getBestSolution(best,best_cost));
+}
+
+/** @brief This tests solving from several initial trajectories concurrently */
+TEST(Stomp3DOF,solve_multi_start)
+{
+  Trajectory trajectory_bias;
+  interpolate(START_POS,END_POS,NUM_TIMESTEPS,trajectory_bias);
+
+  // more starts than initialization methods so that some use perturbed seeds
+  std::vector<TaskPtr> tasks;
+  for(int i = 0; i < 5; i++)
+  {
+    tasks.emplace_back(new ConcurrentDummyTask(trajectory_bias,BIAS_THRESHOLD,STD_DEV));
+  }
+  MultiStartStomp stomp(create3DOFConfiguration(),tasks);
+  EXPECT_EQ(stomp.getNumStarts(),5);
+
+  Trajectory optimized;
+  EXPECT_TRUE(stomp.solve(START_POS,END_POS,optimized));
+  EXPECT_GE(stomp.getSelectedStart(),0);
+  EXPECT_EQ(optimized.rows(),NUM_DIMENSIONS);
+  EXPECT_EQ(optimized.cols(),NUM_TIMESTEPS);
+  EXPECT_TRUE(compareDiff(optimized,trajectory_bias,BIAS_THRESHOLD));
+
+  stomp.setPolicy(MultiStartPolicies::LOWEST_COST);
+  EXPECT_TRUE(stomp.solve(std::vector<Eigen::MatrixXd>{trajectory_bias},optimized));
+  EXPECT_GE(stomp.getSelectedStart(),0);
+  EXPECT_TRUE(compareDiff(optimized,trajectory_bias,BIAS_THRESHOLD));
+}
+
+/** @brief This tests that the rollouts reused from previous iterations are weighted by the noise density */
+TEST(Stomp3DOF,solve_importance_weights)
+{
+  Trajectory trajectory_bias;
+  interpolate(START_POS,END_POS,NUM_TIMESTEPS,trajectory_bias);
+  for(std::size_t t = 0u; t < NUM_TIMESTEPS; t++)
+  {
+    trajectory_bias.col(t).array() += 0.2*std::sin(M_PI*t/(NUM_TIMESTEPS - 1));
+  }
+
+  // few fresh rollouts per iteration, most of them are reused
+  StompConfiguration config = create3DOFConfiguration();
+  config.num_iterations = 1000;
+  config.num_rollouts = 4;
+  config.max_rollouts = 20;
+
+  const std::vector<double> std_dev = {0.5, 0.5, 0.5};
+  auto task = std::make_shared<GaussianDummyTask>(trajectory_bias,BIAS_THRESHOLD,std_dev);
+  Stomp stomp(config,task);
+  Trajectory optimized;
+  EXPECT_TRUE(stomp.solve(START_POS,END_POS,optimized));
+  EXPECT_TRUE(compareDiff(optimized,trajectory_bias,BIAS_THRESHOLD));
+
+  // the density of the reused rollouts is computed again around the updated parameters
+  EXPECT_GT(task->getDensities(),task->getGenerated());
+}
+
+/** @brief This tests that the covariance of the noise adapts to the probability weighted rollouts */
+TEST(Stomp3DOF,solve_covariance_adaptation)
+{
+  Trajectory trajectory_bias;
+  interpolate(START_POS,END_POS,NUM_TIMESTEPS,trajectory_bias);
+  for(std::size_t t = 0u; t < NUM_TIMESTEPS; t++)
+  {
+    trajectory_bias.col(t).array() += 0.2*std::sin(M_PI*t/(NUM_TIMESTEPS - 1));
+  }
+
+  StompConfiguration config = create3DOFConfiguration();
+  config.num_iterations = 1000;
+  config.covariance_adaptation_rate = 0.2;
+
+  const std::vector<double> std_dev = {0.5, 0.5, 0.5};
+  auto task = std::make_shared<GaussianDummyTask>(trajectory_bias,BIAS_THRESHOLD,std_dev);
+  Stomp stomp(config,task);
+  Trajectory optimized;
+  EXPECT_TRUE(stomp.solve(START_POS,END_POS,optimized));
+  EXPECT_TRUE(compareDiff(optimized,trajectory_bias,BIAS_THRESHOLD));
+
+  // only the variances adapt by default, they never fall below the minimum noise scale
+  Eigen::MatrixXd covariance = task->getNoiseCovariance();
+  ASSERT_EQ(covariance.rows(),NUM_DIMENSIONS);
+  EXPECT_TRUE(covariance.isDiagonal());
+  EXPECT_GT(covariance.diagonal().minCoeff(),0.0);
+
+  config.adapt_cross_covariance = true;
+  stomp.setConfig(config);
+  EXPECT_TRUE(stomp.solve(START_POS,END_POS,optimized));
+  EXPECT_TRUE(compareDiff(optimized,trajectory_bias,BIAS_THRESHOLD));
+  covariance = task->getNoiseCovariance();
+  EXPECT_TRUE(covariance.isApprox(covariance.transpose()));
+  EXPECT_FALSE(covariance.isDiagonal());
+}
+
+/** @brief This tests that a long trajectory is optimized as overlapping segments */
+TEST(Stomp3DOF,solve_segments)
+{
+  const int num_timesteps = 120;
+  Trajectory trajectory_bias;
+  interpolate(START_POS,END_POS,num_timesteps,trajectory_bias);
+  for(int t = 0; t < num_timesteps; t++)
+  {
+    trajectory_bias.col(t).array() += 0.2*std::sin(M_PI*t/(num_timesteps - 1));
+  }
+
+  std::vector<TaskPtr> tasks;
+  for(int i = 0; i < 4; i++)
+  {
+    tasks.emplace_back(new SeededDummyTask(trajectory_bias,BIAS_THRESHOLD,STD_DEV));
+  }
+
+  StompConfiguration config = create3DOFConfiguration();
+  config.num_timesteps = num_timesteps;
+  config.num_iterations = 1000;
+  SegmentStomp stomp(config,tasks);
+  EXPECT_FALSE(stomp.setSegments(40,40));
+  EXPECT_TRUE(stomp.setSegments(40,10));
+
+  std::vector<int> starts;
+  stomp.getSegments(starts);
+  EXPECT_EQ(starts,std::vector<int>({0,27,53,80}));
+
+  Trajectory optimized;
+  EXPECT_TRUE(stomp.solve(START_POS,END_POS,optimized));
+  EXPECT_GE(stomp.getNumSweeps(),1);
+  EXPECT_EQ(optimized.cols(),num_timesteps);
+  EXPECT_TRUE(compareDiff(optimized,trajectory_bias,BIAS_THRESHOLD));
+  EXPECT_TRUE(optimized.col(0).isApprox(trajectory_bias.col(0)));
+  EXPECT_TRUE(optimized.col(num_timesteps - 1).isApprox(trajectory_bias.col(num_timesteps - 1)));
+}
+
+/** @brief This tests that only the timesteps changed by the noise and the updates are evaluated again */
+TEST(Stomp3DOF,solve_incremental_costs)
+{
+  Trajectory trajectory_bias;
+  interpolate(START_POS,END_POS,NUM_TIMESTEPS,trajectory_bias);
+
+  const int window_size = 4;
+  std::shared_ptr<IncrementalDummyTask> task(new IncrementalDummyTask(trajectory_bias,BIAS_THRESHOLD,STD_DEV,
+                                                                      window_size));
+  StompConfiguration config = create3DOFConfiguration();
+  config.num_iterations = 200;
+  Stomp stomp(config,task);
+
+  Trajectory optimized;
+  EXPECT_TRUE(stomp.solve(START_POS,END_POS,optimized));
+  EXPECT_TRUE(compareDiff(optimized,trajectory_bias,BIAS_THRESHOLD));
+  EXPECT_EQ(task->getStaleTimesteps(),0);
+
+  // each noisy rollout only changes its window, the updates may change every timestep
+  EXPECT_GT(task->getEvaluatedTimesteps(),0);
+  EXPECT_LE(task->getEvaluatedTimesteps(),config.num_iterations * (config.num_rollouts * window_size + NUM_TIMESTEPS));
+}
+
+/** @brief This tests that the adaptive schedule reduces the number of cost evaluations and decays the noise */
+TEST(Stomp3DOF,solve_adaptive_rollouts)
+{
+  // the middle of the trajectory has to move away from the initial linear interpolation
+  Trajectory trajectory_bias;
+  interpolate(START_POS,END_POS,NUM_TIMESTEPS,trajectory_bias);
+  for(std::size_t t = 0u; t < NUM_TIMESTEPS; t++)
+  {
+    trajectory_bias.col(t).array() += 0.2*std::sin(M_PI*t/(NUM_TIMESTEPS - 1));
+  }
+
+  StompConfiguration config = create3DOFConfiguration();
+  config.num_iterations = 200;
+  config.num_iterations_after_valid = 5;
+
+  std::shared_ptr<ScheduledDummyTask> fixed_task(new ScheduledDummyTask(trajectory_bias,BIAS_THRESHOLD,STD_DEV));
+  Stomp fixed_stomp(config,fixed_task);
+  Trajectory fixed_optimized;
+  EXPECT_TRUE(fixed_stomp.solve(START_POS,END_POS,fixed_optimized));
+  EXPECT_EQ(fixed_task->getMinNoiseScale(),1.0);
+
+  config.min_rollouts = 5;
+  config.noise_decay = 0.8;
+  config.noise_decay_improvement = 0.05;
+  std::shared_ptr<ScheduledDummyTask> adaptive_task(new ScheduledDummyTask(trajectory_bias,BIAS_THRESHOLD,STD_DEV));
+  Stomp adaptive_stomp(config,adaptive_task);
+  Trajectory adaptive_optimized;
+  EXPECT_TRUE(adaptive_stomp.solve(START_POS,END_POS,adaptive_optimized));
+  EXPECT_TRUE(compareDiff(adaptive_optimized,trajectory_bias,BIAS_THRESHOLD));
+
+  EXPECT_LT(adaptive_task->getNumEvaluations(),fixed_task->getNumEvaluations());
+  EXPECT_LT(adaptive_task->getMinNoiseScale(),1.0);
+  EXPECT_GE(adaptive_task->getMinNoiseScale(),config.min_noise_scale);
+}
+
+/** @brief This tests that evaluating the rollouts in batches produces the same solution as evaluating them one by one */
+TEST(Stomp3DOF,solve_batched_costs)
+{
+  Trajectory trajectory_bias;
+  interpolate(START_POS,END_POS,NUM_TIMESTEPS,trajectory_bias);
+  StompConfiguration config = create3DOFConfiguration();
+
+  TaskPtr task(new ConcurrentDummyTask(trajectory_bias,BIAS_THRESHOLD,STD_DEV));
+  Stomp stomp(config,task);
+  Trajectory optimized;
+  EXPECT_TRUE(stomp.solve(START_POS,END_POS,optimized));
+
+  std::shared_ptr<BatchedDummyTask> batched_task(new BatchedDummyTask(trajectory_bias,BIAS_THRESHOLD,STD_DEV));
+  Stomp batched_stomp(config,batched_task);
+  Trajectory batched_optimized;
+  EXPECT_TRUE(batched_stomp.solve(START_POS,END_POS,batched_optimized));
+
+  // one batch per iteration holding all the new rollouts
+  EXPECT_GT(batched_task->getNumBatches(),0);
+  EXPECT_EQ(batched_task->getNumBatchedRollouts(),batched_task->getNumBatches() * config.num_rollouts);
+  EXPECT_TRUE(batched_optimized.isApprox(optimized));
+}
+
+/** @brief This tests that the same seed produces the same solution regardless of the number of threads */
+TEST(Stomp3DOF,solve_random_seed)
+{
+  // the middle of the trajectory has to move away from the initial linear interpolation so that the noise matters
+  Trajectory trajectory_bias;
+  interpolate(START_POS,END_POS,NUM_TIMESTEPS,trajectory_bias);
+  for(std::size_t t = 0u; t < NUM_TIMESTEPS; t++)
+  {
+    trajectory_bias.col(t).array() += 0.2*std::sin(M_PI*t/(NUM_TIMESTEPS - 1));
+  }
+
+  StompConfiguration config = create3DOFConfiguration();
+  config.num_iterations = 200;
+  config.num_iterations_after_valid = 5;
+  config.random_seed = 42;
+
+  auto solve = [&](const StompConfiguration& config,Trajectory& optimized) -> bool
+  {
+    TaskPtr task(new SeededDummyTask(trajectory_bias,BIAS_THRESHOLD,STD_DEV));
+    Stomp stomp(config,task);
+    return stomp.solve(START_POS,END_POS,optimized);
+  };
+
+  Trajectory serial_optimized;
+  config.num_threads = 1;
+  EXPECT_TRUE(solve(config,serial_optimized));
+
+  Trajectory parallel_optimized;
+  config.num_threads = 4;
+  EXPECT_TRUE(solve(config,parallel_optimized));
+  EXPECT_TRUE(parallel_optimized == serial_optimized);
+  EXPECT_TRUE(compareDiff(parallel_optimized,trajectory_bias,BIAS_THRESHOLD));
+
+  // a different seed explores different noise
+  Trajectory reseeded_optimized;
+  config.random_seed = 43;
+  EXPECT_TRUE(solve(config,reseeded_optimized));
+  EXPECT_FALSE(reseeded_optimized == serial_optimized);
+}
+
+/** @brief This tests that the single precision kernels find a solution */
+TEST(Stomp3DOF,solve_float_kernels)
+{
+  Trajectory trajectory_bias;
+  interpolate(START_POS,END_POS,NUM_TIMESTEPS,trajectory_bias);
+  for(std::size_t t = 0u; t < NUM_TIMESTEPS; t++)
+  {
+    trajectory_bias.col(t).array() += 0.2*std::sin(M_PI*t/(NUM_TIMESTEPS - 1));
+  }
+
+  StompConfiguration config = create3DOFConfiguration();
+  config.num_iterations = 200;
+  config.num_iterations_after_valid = 5;
+  config.kernel_precision = KernelPrecisions::FLOAT;
+
+  TaskPtr task(new SeededDummyTask(trajectory_bias,BIAS_THRESHOLD,STD_DEV));
+  Stomp stomp(config,task);
+  Trajectory optimized;
+  EXPECT_TRUE(stomp.solve(START_POS,END_POS,optimized));
+  EXPECT_TRUE(compareDiff(optimized,trajectory_bias,BIAS_THRESHOLD));
+}
+
+/** @brief This tests the time and the number of calls of each phase reported after a solve */
+TEST(Stomp3DOF,solve_profile)
+{
+  Trajectory trajectory_bias;
+  interpolate(START_POS,END_POS,NUM_TIMESTEPS,trajectory_bias);
+  for(std::size_t t = 0u; t < NUM_TIMESTEPS; t++)
+  {
+    trajectory_bias.col(t).array() += 0.2*std::sin(M_PI*t/(NUM_TIMESTEPS - 1));
+  }
+
+  StompConfiguration config = create3DOFConfiguration();
+  config.num_iterations = 200;
+  config.num_iterations_after_valid = 5;
+  config.num_threads = 2;
+
+  TaskPtr task(new ProfiledDummyTask(trajectory_bias,BIAS_THRESHOLD,STD_DEV));
+  Stomp stomp(config,task);
+  Trajectory optimized;
+  EXPECT_TRUE(stomp.solve(START_POS,END_POS,optimized));
+
+  ProfileReport profile;
+  stomp.getProfile(profile);
+  ASSERT_EQ(profile.entries.size(),SolvePhases::NUM_SOLVE_PHASES + 1);
+  EXPECT_EQ(profile.entries[SolvePhases::ITERATION].name,"iteration");
+  EXPECT_EQ(profile.entries.back().name,"task_costs");
+
+  // every iteration ran each phase once, the initial cost is computed before the first iteration
+  const ProfileEntry* iteration = profile.find("iteration");
+  ASSERT_TRUE(iteration != nullptr);
+  EXPECT_GT(iteration->calls,0);
+  EXPECT_GT(iteration->total_time,0.0);
+  for(int p = SolvePhases::GENERATE_NOISY_ROLLOUTS; p < SolvePhases::COMPUTE_OPTIMIZED_COST; p++)
+  {
+    EXPECT_EQ(profile.entries[p].calls,iteration->calls) << profile.entries[p].name;
+    EXPECT_LE(profile.entries[p].total_time,iteration->total_time) << profile.entries[p].name;
+  }
+  EXPECT_EQ(profile.entries[SolvePhases::COMPUTE_OPTIMIZED_COST].calls,iteration->calls + 1);
+  EXPECT_GE(profile.find("task_costs")->calls,iteration->calls);
+
+  // the counters restart with each solve
+  Trajectory resolved;
+  EXPECT_TRUE(stomp.solve(START_POS,END_POS,resolved));
+  ProfileReport second_profile;
+  stomp.getProfile(second_profile);
+  EXPECT_EQ(second_profile.find("iteration")->calls,iteration->calls);
+}
+
+/** @brief This tests that each convergence rule stops the solve early and reports its stop reason */
+TEST(Stomp3DOF,solve_convergence)
+{
+  Trajectory trajectory_bias;
+  interpolate(START_POS,END_POS,NUM_TIMESTEPS,trajectory_bias);
+  for(std::size_t t = 0u; t < NUM_TIMESTEPS; t++)
+  {
+    trajectory_bias.col(t).array() += 0.2*std::sin(M_PI*t/(NUM_TIMESTEPS - 1));
+  }
+
+  // without any rule the solve keeps iterating after the cost has flattened
+  StompConfiguration config = create3DOFConfiguration();
+  config.num_iterations = 300;
+  config.num_iterations_after_valid = 300;
+  config.random_seed = 7;
+
+  auto solve = [&](const StompConfiguration& config,int& iterations) -> StopReasons::StopReason
+  {
+    TaskPtr task(new SeededDummyTask(trajectory_bias,BIAS_THRESHOLD,STD_DEV));
+    Stomp stomp(config,task);
+    EXPECT_EQ(stomp.getStopReason(),StopReasons::NONE);
+
+    Trajectory optimized;
+    stomp.solve(START_POS,END_POS,optimized);
+
+    ProfileReport profile;
+    stomp.getProfile(profile);
+    iterations = profile.find("iteration")->calls;
+    return stomp.getStopReason();
+  };
+
+  int max_iterations;
+  EXPECT_EQ(solve(config,max_iterations),StopReasons::MAX_ITERATIONS);
+  EXPECT_EQ(max_iterations,config.num_iterations);
+
+  int iterations;
+  StompConfiguration cost_config = config;
+  cost_config.convergence_window = 10;
+  cost_config.convergence_cost_tolerance = 1e-3;
+  EXPECT_EQ(solve(cost_config,iterations),StopReasons::COST_CONVERGED);
+  EXPECT_GE(iterations,cost_config.convergence_window);
+  EXPECT_LT(iterations,max_iterations);
+
+  StompConfiguration stagnation_config = config;
+  stagnation_config.max_stagnant_iterations = 5;
+  EXPECT_EQ(solve(stagnation_config,iterations),StopReasons::STAGNATED);
+  EXPECT_GE(iterations,stagnation_config.max_stagnant_iterations);
+  EXPECT_LT(iterations,max_iterations);
+
+  StompConfiguration update_config = config;
+  update_config.convergence_update_tolerance = 0.05;
+  EXPECT_EQ(solve(update_config,iterations),StopReasons::UPDATE_CONVERGED);
+  EXPECT_LT(iterations,max_iterations);
+
+  StompConfiguration valid_config = config;
+  valid_config.num_iterations_after_valid = 0;
+  EXPECT_EQ(solve(valid_config,iterations),StopReasons::VALID_ITERATIONS);
+
+  EXPECT_STREQ(toString(StopReasons::COST_CONVERGED),"cost_converged");
+}
+
+/** @brief This tests that a coarse-to-fine solve optimizes each level and ends at the full resolution */
+TEST(Stomp3DOF,solve_coarse_to_fine)
+{
+  Trajectory trajectory_bias;
+  interpolate(START_POS,END_POS,NUM_TIMESTEPS,trajectory_bias);
+  for(std::size_t t = 0u; t < NUM_TIMESTEPS; t++)
+  {
+    trajectory_bias.col(t).array() += 0.2*std::sin(M_PI*t/(NUM_TIMESTEPS - 1));
+  }
+
+  StompConfiguration config = create3DOFConfiguration();
+  config.num_iterations = 1000;
+  config.num_iterations_after_valid = 5;
+  config.coarse_timesteps = {8,14};
+  config.coarse_iterations = {20,20};
+
+  const std::vector<double> std_dev = {0.5, 0.5, 0.5};
+  auto task = std::make_shared<MultiResolutionDummyTask>(trajectory_bias,BIAS_THRESHOLD,std_dev);
+  Stomp stomp(config,task);
+  Trajectory optimized;
+  EXPECT_TRUE(stomp.solve(START_POS,END_POS,optimized));
+  EXPECT_EQ(optimized.cols(),NUM_TIMESTEPS);
+  EXPECT_TRUE(compareDiff(optimized,trajectory_bias,BIAS_THRESHOLD));
+  EXPECT_EQ(task->resolutions,std::vector<int>({8,14,NUM_TIMESTEPS}));
+
+  Trajectory best_parameters;
+  double best_cost;
+  EXPECT_TRUE(stomp.getBestSolution(best_parameters,best_cost));
+  EXPECT_EQ(best_parameters.cols(),NUM_TIMESTEPS);
+
+  // a task without multi resolution support is solved at the full resolution
+  TaskPtr single_task(new SeededDummyTask(trajectory_bias,BIAS_THRESHOLD,STD_DEV));
+  Stomp single_stomp(config,single_task);
+  EXPECT_TRUE(single_stomp.solve(START_POS,END_POS,optimized));
+  EXPECT_TRUE(compareDiff(optimized,trajectory_bias,BIAS_THRESHOLD));
+
+  // the levels must increase and stay below the full resolution
+  config.coarse_timesteps = {14,8};
+  Stomp invalid_stomp(config,task);
+  EXPECT_FALSE(invalid_stomp.solve(START_POS,END_POS,optimized));
+}
@@ -0,0 +1,281 @@
+/**
+ * @file stomp_allocations.cpp
+ * @brief This contains tests checking that the stomp iterations do not allocate memory
+ *
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <Eigen/Dense>
+#include <gtest/gtest.h>
+#include "stomp_core/stomp.h"
+#include "stomp_core/task.h"
+
+using namespace stomp_core;
+
+static std::atomic<bool> count_allocations(false);   /**< Whether heap allocations are being counted */
+static std::atomic<long> num_allocations(0);         /**< The number of heap allocations counted */
+
+#ifdef __GLIBC__
+
+/*
+ * Counting allocator hook: every heap allocation, including those made by operator new and by Eigen, goes through
+ * these functions which forward to the glibc implementation.
+ */
+extern "C"
+{
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t num, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+
+void* malloc(size_t size)
+{
+  if(count_allocations)
+  {
+    num_allocations++;
+  }
+  return __libc_malloc(size);
+}
+
+void* calloc(size_t num, size_t size)
+{
+  if(count_allocations)
+  {
+    num_allocations++;
+  }
+  return __libc_calloc(num,size);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+  if(count_allocations)
+  {
+    num_allocations++;
+  }
+  return __libc_realloc(ptr,size);
+}
+}
+
+static const bool ALLOCATION_HOOK_AVAILABLE = true;   /**< Whether heap allocations can be counted on this platform */
+#else
+static const bool ALLOCATION_HOOK_AVAILABLE = false;  /**< Whether heap allocations can be counted on this platform */
+#endif
+
+const std::size_t NUM_DIMENSIONS = 3;                 /**< Number of parameters to optimize */
+const std::size_t NUM_TIMESTEPS = 40;                 /**< Number of timesteps */
+const double DELTA_T = 0.1;                           /**< Timestep in seconds */
+const double STD_DEV = 0.5;                           /**< Noise amplitude */
+const int NUM_MEASURED_ITERATIONS = 10;               /**< Number of iterations during which allocations are counted */
+
+/** @brief A task that does not allocate memory once constructed */
+class AllocationFreeTask: public Task
+{
+public:
+
+  /**
+   * @brief Constructor
+   * @param batched Whether the rollouts are evaluated in batches
+   */
+  explicit AllocationFreeTask(bool batched = false):
+    batched_(batched)
+  {
+    generateSmoothingMatrix(NUM_TIMESTEPS,1.0,smoothing_M_);
+    smoothed_update_.resize(NUM_TIMESTEPS);
+  }
+
+  bool supportsConcurrentRollouts() const override
+  {
+    return true;
+  }
+
+  bool supportsBatchedCosts() const override
+  {
+    return batched_;
+  }
+
+  /** @brief Generates deterministic pseudo random noise from the iteration and rollout numbers */
+  bool generateNoisyParameters(const Eigen::MatrixXd& parameters,
+                               std::size_t start_timestep,
+                               std::size_t num_timesteps,
+                               int iteration_number,
+                               int rollout_number,
+                               Eigen::MatrixXd& parameters_noise,
+                               Eigen::MatrixXd& noise) override
+  {
+    for(auto d = 0u; d < parameters.rows(); d++)
+    {
+      for(auto t = 0u; t < parameters.cols(); t++)
+      {
+        noise(d,t) = STD_DEV * std::sin(12.9898*iteration_number + 78.233*rollout_number + 37.719*d + 0.5*t);
+      }
+    }
+
+    parameters_noise = parameters + noise;
+    return true;
+  }
+
+  bool computeCosts(const Eigen::MatrixXd& parameters,
+                    std::size_t start_timestep,
+                    std::size_t num_timesteps,
+                    int iteration_number,
+                    Eigen::VectorXd& costs,
+                    bool& validity) override
+  {
+    return computeNoisyCosts(parameters,start_timestep,num_timesteps,iteration_number,-1,costs,validity);
+  }
+
+  /** @brief Penalizes the squared distance to the origin */
+  bool computeNoisyCosts(const Eigen::MatrixXd& parameters,
+                         std::size_t start_timestep,
+                         std::size_t num_timesteps,
+                         int iteration_number,
+                         int rollout_number,
+                         Eigen::VectorXd& costs,
+                         bool& validity) override
+  {
+    costs = parameters.colwise().squaredNorm().transpose();
+    validity = false;
+    return true;
+  }
+
+  bool filterParameterUpdates(std::size_t start_timestep,
+                              std::size_t num_timesteps,
+                              int iteration_number,
+                              const Eigen::MatrixXd& parameters,
+                              Eigen::MatrixXd& updates) override
+  {
+    for(auto d = 0u; d < updates.rows(); d++)
+    {
+      smoothed_update_.noalias() = smoothing_M_ * updates.row(d).transpose();
+      updates.row(d) = smoothed_update_.transpose();
+    }
+    return true;
+  }
+
+protected:
+
+  bool batched_;                      /**< Whether the rollouts are evaluated in batches */
+  Eigen::MatrixXd smoothing_M_;       /**< Matrix used for smoothing the updates */
+  Eigen::VectorXd smoothed_update_;   /**< Preallocated smoothing result */
+};
+
+/** @brief Exposes the single iteration step of Stomp */
+class SteppedStomp: public Stomp
+{
+public:
+  using Stomp::Stomp;
+  using Stomp::runSingleIteration;
+};
+
+/**
+ * @brief Creates the configuration used by the allocation tests
+ * @param num_threads The number of threads used to process the rollouts
+ * @param kernel_precision The precision of the probability and update kernels
+ * @return The configuration
+ */
+StompConfiguration createAllocationTestConfiguration(int num_threads,int kernel_precision)
+{
+  StompConfiguration c;
+  c.num_timesteps = NUM_TIMESTEPS;
+  c.num_iterations = 10;
+  c.num_dimensions = NUM_DIMENSIONS;
+  c.delta_t = DELTA_T;
+  c.control_cost_weight = 0.1;
+  c.initialization_method = TrajectoryInitializations::LINEAR_INTERPOLATION;
+  c.num_iterations_after_valid = 0;
+  c.num_rollouts = 10;
+  c.max_rollouts = 25;
+  c.num_threads = num_threads;
+  c.kernel_precision = kernel_precision;
+
+  return c;
+}
+
+/**
+ * @brief Counts the heap allocations made while running iterations past the warm up phase
+ * @param num_threads The number of threads used to process the rollouts
+ * @param batched     Whether the rollouts are evaluated in batches
+ * @param kernel_precision The precision of the probability and update kernels
+ * @return The number of allocations
+ */
+long countIterationAllocations(int num_threads,bool batched = false,int kernel_precision = KernelPrecisions::DOUBLE)
+{
+  TaskPtr task(new AllocationFreeTask(batched));
+  SteppedStomp stomp(createAllocationTestConfiguration(num_threads,kernel_precision),task);
+
+  // the warm up iterations fill up the reused rollouts
+  Eigen::MatrixXd parameters;
+  stomp.solve(std::vector<double>(NUM_DIMENSIONS,1.0),std::vector<double>(NUM_DIMENSIONS,-1.0),parameters);
+
+  num_allocations = 0;
+  count_allocations = true;
+  for(int i = 0; i < NUM_MEASURED_ITERATIONS; i++)
+  {
+    stomp.runSingleIteration();
+  }
+  count_allocations = false;
+
+  return num_allocations;
+}
+
+/** @brief This tests that an iteration does not allocate once Stomp and the task have been set up */
+TEST(StompAllocations,iteration_serial)
+{
+  if(!ALLOCATION_HOOK_AVAILABLE)
+  {
+    return;
+  }
+
+  EXPECT_EQ(countIterationAllocations(1),0);
+}
+
+/** @brief This tests that an iteration does not allocate when the rollouts are processed by the thread pool */
+TEST(StompAllocations,iteration_parallel)
+{
+  if(!ALLOCATION_HOOK_AVAILABLE)
+  {
+    return;
+  }
+
+  EXPECT_EQ(countIterationAllocations(4),0);
+}
+
+/** @brief This tests that an iteration does not allocate when the rollouts costs are evaluated in batches */
+TEST(StompAllocations,iteration_batched)
+{
+  if(!ALLOCATION_HOOK_AVAILABLE)
+  {
+    return;
+  }
+
+  EXPECT_EQ(countIterationAllocations(1,true),0);
+}
+
+/** @brief This tests that an iteration does not allocate with the single precision kernels */
+TEST(StompAllocations,iteration_float_kernels)
+{
+  if(!ALLOCATION_HOOK_AVAILABLE)
+  {
+    return;
+  }
+
+  EXPECT_EQ(countIterationAllocations(1,false,KernelPrecisions::FLOAT),0);
+}
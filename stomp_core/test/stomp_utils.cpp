@@ -0,0 +1,501 @@
+/**
+ * @file stomp_utils.cpp
+ * @brief This contains gtest code for the stomp utilities
+ *
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <Eigen/Dense>
+#include <gtest/gtest.h>
+#include "stomp_core/utils.h"
+#include "stomp_core/banded_matrix.h"
+#include "stomp_core/matrix_cache.h"
+#include "stomp_core/profiler.h"
+#include "stomp_core/random_stream.h"
+#include "stomp_core/rollout_arrays.h"
+#include "stomp_core/stomp.h"
+
+using namespace stomp_core;
+
+static const double TOLERANCE = 1e-8;  /**< Maximum allowed difference between dense and banded results */
+
+/**
+ * @brief Computes the control cost matrix R = dt * A_transpose * A using dense matrices
+ * @param num_timesteps The number of timesteps
+ * @param dt            The timestep in seconds
+ * @return The dense control cost matrix
+ */
+Eigen::MatrixXd computeDenseControlCostMatrix(int num_timesteps,double dt)
+{
+  Eigen::MatrixXd A;
+  generateFiniteDifferenceMatrix(num_timesteps,DerivativeOrders::STOMP_ACCELERATION,dt,A);
+  return dt * A.transpose() * A;
+}
+
+/** @brief This tests that the banded control cost matrix matches its dense counterpart */
+TEST(StompUtils,banded_control_cost_matrix)
+{
+  int num_timesteps = 32;
+  double dt = 0.1;
+  Eigen::MatrixXd dense = computeDenseControlCostMatrix(num_timesteps,dt);
+
+  SymmetricBandedMatrix banded;
+  generateControlCostMatrix(num_timesteps,dt,banded);
+
+  EXPECT_EQ(banded.size(),num_timesteps);
+  EXPECT_LT((banded.toDense() - dense).cwiseAbs().maxCoeff(),TOLERANCE * dense.cwiseAbs().maxCoeff());
+
+  Eigen::RowVectorXd x = Eigen::RowVectorXd::Random(num_timesteps);
+  double expected = x * dense * x.transpose();
+  EXPECT_NEAR(banded.quadraticForm(x),expected,TOLERANCE * std::abs(expected));
+}
+
+/** @brief This tests the fixed and dynamic size quadratic forms of all the rows against the single row version */
+TEST(StompUtils,banded_quadratic_forms)
+{
+  int num_timesteps = 32;
+  SymmetricBandedMatrix banded;
+  generateControlCostMatrix(num_timesteps,0.1,banded);
+
+  auto check = [&](const Eigen::MatrixXd& x,const Eigen::VectorXd& forms)
+  {
+    for(auto d = 0u; d < x.rows(); d++)
+    {
+      double expected = banded.quadraticForm(x.row(d));
+      EXPECT_NEAR(forms(d),expected,TOLERANCE * std::abs(expected));
+    }
+  };
+
+  Eigen::MatrixXd x = Eigen::MatrixXd::Random(7,num_timesteps);
+  Eigen::VectorXd forms(7);
+  banded.quadraticForms<7>(x,forms);
+  check(x,forms);
+  banded.quadraticForms<Eigen::Dynamic>(x,forms);
+  check(x,forms);
+
+  x = Eigen::MatrixXd::Random(6,num_timesteps);
+  forms.resize(6);
+  banded.quadraticForms<6>(x,forms);
+  check(x,forms);
+
+  x = Eigen::MatrixXd::Random(3,num_timesteps);
+  forms.resize(3);
+  banded.quadraticForms<Eigen::Dynamic>(x,forms);
+  check(x,forms);
+}
+
+/** @brief This tests the banded solve and inverse diagonal against a dense inverse */
+TEST(StompUtils,banded_factorization)
+{
+  int num_timesteps = 40;
+  int padding = FINITE_DIFF_RULE_LENGTH - 1;
+  SymmetricBandedMatrix padded;
+  generateControlCostMatrix(num_timesteps + 2*padding,1.0,padded);
+  SymmetricBandedMatrix banded = padded.block(padding,num_timesteps);
+  ASSERT_TRUE(banded.factorize());
+
+  Eigen::MatrixXd dense = banded.toDense();
+  Eigen::MatrixXd dense_inverse = dense.fullPivLu().inverse();
+
+  Eigen::VectorXd b = Eigen::VectorXd::Random(num_timesteps);
+  Eigen::VectorXd x = b;
+  banded.solveInPlace(x);
+  EXPECT_LT((dense * x - b).cwiseAbs().maxCoeff(),1e-6);
+
+  Eigen::VectorXd inverse_diagonal;
+  banded.inverseDiagonal(inverse_diagonal);
+  double scale = dense_inverse.cwiseAbs().maxCoeff();
+  EXPECT_LT((inverse_diagonal - dense_inverse.diagonal()).cwiseAbs().maxCoeff(),1e-6 * scale);
+  EXPECT_NEAR(inverse_diagonal.maxCoeff(),dense_inverse.maxCoeff(),1e-6 * scale);
+}
+
+/** @brief This tests that the cache hands out the same instance for the same arguments */
+TEST(StompUtils,matrix_cache_reuse)
+{
+  MatrixCache& cache = MatrixCache::instance();
+  cache.clear();
+
+  ControlCostMatricesConstPtr first = cache.getControlCostMatrices(20,0.1);
+  ASSERT_TRUE(bool(first));
+  EXPECT_TRUE(first->R.isFactorized());
+  EXPECT_EQ(first,cache.getControlCostMatrices(20,0.1));
+  EXPECT_NE(first,cache.getControlCostMatrices(20,0.2));
+  EXPECT_NE(first,cache.getControlCostMatrices(21,0.1));
+  EXPECT_EQ(cache.getSmoothingMatrix(20,0.1),cache.getSmoothingMatrix(20,0.1));
+  EXPECT_EQ(cache.getFiniteDifferenceMatrix(20,DerivativeOrders::STOMP_VELOCITY,0.1),
+            cache.getFiniteDifferenceMatrix(20,DerivativeOrders::STOMP_VELOCITY,0.1));
+  EXPECT_NE(cache.getFiniteDifferenceMatrix(20,DerivativeOrders::STOMP_VELOCITY,0.1),
+            cache.getFiniteDifferenceMatrix(20,DerivativeOrders::STOMP_ACCELERATION,0.1));
+
+  // evicted entries remain valid
+  cache.clear();
+  EXPECT_EQ(cache.size(),0u);
+  EXPECT_EQ(first->R.size(),20);
+
+  // concurrent requests all receive the instance that was cached first
+  std::vector<MatrixConstPtr> results(4);
+  std::vector<std::thread> threads;
+  for(auto i = 0u; i < results.size(); i++)
+  {
+    threads.emplace_back([&results,i](){ results[i] = MatrixCache::instance().getSmoothingMatrix(30,0.1); });
+  }
+
+  for(auto& t : threads)
+  {
+    t.join();
+  }
+
+  for(auto& r : results)
+  {
+    EXPECT_EQ(r,cache.getSmoothingMatrix(30,0.1));
+  }
+}
+
+/** @brief This tests the cached matrices against their dense counterparts */
+TEST(StompUtils,matrix_cache_values)
+{
+  int num_timesteps = 30;
+  double dt = 0.1;
+  int padding = FINITE_DIFF_RULE_LENGTH - 1;
+  MatrixCache& cache = MatrixCache::instance();
+
+  // smoothing matrix
+  Eigen::MatrixXd R = computeDenseControlCostMatrix(num_timesteps + 2*padding,dt).block(
+      padding,padding,num_timesteps,num_timesteps);
+  Eigen::MatrixXd M = R.fullPivLu().inverse();
+  for(auto t = 0u; t < num_timesteps; t++)
+  {
+    M.col(t) *= 1.0/(num_timesteps*M(t,t));
+  }
+
+  MatrixConstPtr smoothing = cache.getSmoothingMatrix(num_timesteps,dt);
+  EXPECT_LT((*smoothing - M).cwiseAbs().maxCoeff(),1e-6 * M.cwiseAbs().maxCoeff());
+
+  // sampling covariance
+  Eigen::MatrixXd A;
+  generateFiniteDifferenceMatrix(num_timesteps,DerivativeOrders::STOMP_ACCELERATION,1.0,A);
+  Eigen::MatrixXd covariance = (A.transpose() * A).fullPivLu().inverse();
+  covariance /= covariance.cwiseAbs().maxCoeff();
+
+  SamplingCovarianceConstPtr sampling = cache.getSamplingCovariance(num_timesteps);
+  EXPECT_LT((sampling->covariance - covariance).cwiseAbs().maxCoeff(),1e-6);
+  EXPECT_LT((sampling->cholesky * sampling->cholesky.transpose() - sampling->covariance).cwiseAbs().maxCoeff(),1e-6);
+}
+
+/** @brief This tests that a random stream only depends on its seed, iteration and rollout */
+TEST(StompUtils,random_stream)
+{
+  RandomStream stream(7,3,5);
+  RandomStream same_stream(7,3,5);
+  RandomStream other_rollout(7,3,6);
+  RandomStream other_iteration(7,4,5);
+  RandomStream other_seed(8,3,5);
+
+  int num_samples = 10000;
+  double sum = 0.0, sum_squares = 0.0;
+  for(int i = 0; i < num_samples; i++)
+  {
+    auto value = stream();
+    EXPECT_EQ(value,same_stream());
+    EXPECT_NE(value,other_rollout());
+    EXPECT_NE(value,other_iteration());
+    EXPECT_NE(value,other_seed());
+
+    double u = stream.uniform();
+    EXPECT_GE(u,0.0);
+    EXPECT_LT(u,1.0);
+    same_stream.uniform();
+
+    double n = stream.normal();
+    EXPECT_EQ(n,same_stream.normal());
+    sum += n;
+    sum_squares += n*n;
+  }
+
+  // standard normal moments
+  double mean = sum/num_samples;
+  EXPECT_NEAR(mean,0.0,0.05);
+  EXPECT_NEAR(sum_squares/num_samples - mean*mean,1.0,0.05);
+
+  // restarting the stream replays the sequence
+  RandomStream replay(7,3,5);
+  auto first = replay();
+  replay.reset(7,3,5);
+  EXPECT_EQ(first,replay());
+}
+
+/** @brief This tests that the control costs specialized for 6 and 7 dimensions match the generic ones */
+TEST(StompUtils,control_costs_specializations)
+{
+  int num_timesteps = 32;
+  double dt = 0.1;
+  SymmetricBandedMatrix banded;
+  generateControlCostMatrix(num_timesteps,dt,banded);
+
+  // any size other than 6 and 7 selects the generic version
+  Stomp::ControlCostsFunction generic = Stomp::selectControlCostsFunction(3);
+  for(int num_dimensions : {6, 7})
+  {
+    Stomp::ControlCostsFunction specialized = Stomp::selectControlCostsFunction(num_dimensions);
+    EXPECT_NE(specialized,generic);
+
+    Eigen::MatrixXd parameters = Eigen::MatrixXd::Random(num_dimensions,num_timesteps);
+    Eigen::MatrixXd expected(num_dimensions,num_timesteps), control_costs(num_dimensions,num_timesteps);
+    generic(parameters,dt,0.5,banded,expected);
+    specialized(parameters,dt,0.5,banded,control_costs);
+    EXPECT_LT((control_costs - expected).cwiseAbs().maxCoeff(),TOLERANCE);
+  }
+}
+
+/**
+ * @brief Checks the double precision rollout arrays against a direct computation and the single precision ones
+ * against the double precision ones
+ * @param num_dimensions The number of dimensions
+ */
+void checkRolloutArrays(int num_dimensions)
+{
+  int num_timesteps = 20;
+  int num_rollouts = 30;
+  int num_entries = num_dimensions * num_timesteps;
+
+  RolloutArraysPtr double_arrays = RolloutArrays::create(KernelPrecisions::DOUBLE,num_dimensions);
+  RolloutArraysPtr float_arrays = RolloutArrays::create(KernelPrecisions::FLOAT,num_dimensions);
+  ASSERT_TRUE(bool(double_arrays));
+  ASSERT_TRUE(bool(float_arrays));
+  EXPECT_FALSE(bool(RolloutArrays::create(-1,num_dimensions)));
+  double_arrays->resize(num_entries,num_rollouts);
+  float_arrays->resize(num_entries,num_rollouts);
+
+  Eigen::MatrixXd control_costs(num_dimensions,num_timesteps);
+  Eigen::VectorXd state_costs(num_timesteps);
+  Eigen::MatrixXd noise(num_dimensions,num_timesteps);
+  Eigen::VectorXd last_entry_costs(num_rollouts);
+  for(int r = 0; r < num_rollouts; r++)
+  {
+    RandomStream stream(1,0,r);
+    for(int t = 0; t < num_timesteps; t++)
+    {
+      state_costs(t) = 10.0 * stream.uniform();
+      for(int d = 0; d < num_dimensions; d++)
+      {
+        control_costs(d,t) = stream.uniform();
+        noise(d,t) = stream.normal();
+      }
+    }
+
+    double_arrays->setRolloutCosts(r,control_costs,state_costs,1.0);
+    double_arrays->setRolloutNoise(r,noise);
+    float_arrays->setRolloutCosts(r,control_costs,state_costs,1.0);
+    float_arrays->setRolloutNoise(r,noise);
+    last_entry_costs(r) = control_costs(num_dimensions - 1,num_timesteps - 1) + state_costs(num_timesteps - 1);
+  }
+
+  double_arrays->computeProbabilities(num_rollouts,10.0);
+  float_arrays->computeProbabilities(num_rollouts,10.0);
+  for(int e = 0; e < num_entries; e++)
+  {
+    double sum = 0.0;
+    for(int r = 0; r < num_rollouts; r++)
+    {
+      EXPECT_NEAR(float_arrays->getProbability(e,r),double_arrays->getProbability(e,r),1e-5);
+      sum += double_arrays->getProbability(e,r);
+    }
+    EXPECT_NEAR(sum,1.0,1e-9);
+  }
+
+  Eigen::VectorXd expected_probabilities = ((last_entry_costs.array() - last_entry_costs.minCoeff()) /
+      (last_entry_costs.maxCoeff() - last_entry_costs.minCoeff()) * -10.0).exp();
+  expected_probabilities /= expected_probabilities.sum();
+  for(int r = 0; r < num_rollouts; r++)
+  {
+    EXPECT_NEAR(double_arrays->getProbability(num_entries - 1,r),expected_probabilities(r),1e-12);
+  }
+
+  Eigen::MatrixXd double_updates(num_dimensions,num_timesteps);
+  Eigen::MatrixXd float_updates(num_dimensions,num_timesteps);
+  double_arrays->computeUpdates(num_rollouts,double_updates);
+  float_arrays->computeUpdates(num_rollouts,float_updates);
+  EXPECT_LT((double_updates - float_updates).cwiseAbs().maxCoeff(),1e-5);
+}
+
+/** @brief This tests the generic and the fixed size rollout arrays in both precisions */
+TEST(StompUtils,rollout_arrays_precision)
+{
+  checkRolloutArrays(3);
+  checkRolloutArrays(6);
+  checkRolloutArrays(7);
+}
+
+/**
+ * @brief Checks the probabilities and the updates of the rollout arrays against a loop over the rollouts of each
+ * dimension and timestep, with importance weights, fewer active rollouts than columns and a timestep of equal costs.
+ * @param num_dimensions The number of dimensions
+ */
+void checkRolloutArraysReference(int num_dimensions)
+{
+  const int num_timesteps = 15;
+  const int max_rollouts = 25;
+  const int num_rollouts = 18;
+  const int num_entries = num_dimensions * num_timesteps;
+  const double h = 10.0;
+  const double min_cost_difference = 1e-8;
+
+  RolloutArraysPtr arrays = RolloutArrays::create(KernelPrecisions::DOUBLE,num_dimensions);
+  ASSERT_TRUE(bool(arrays));
+  arrays->resize(num_entries,max_rollouts);
+
+  std::vector<Eigen::MatrixXd> total_costs(max_rollouts,Eigen::MatrixXd(num_dimensions,num_timesteps));
+  std::vector<Eigen::MatrixXd> noise(max_rollouts,Eigen::MatrixXd(num_dimensions,num_timesteps));
+  std::vector<double> importance_weights(max_rollouts);
+  Eigen::MatrixXd control_costs(num_dimensions,num_timesteps);
+  Eigen::VectorXd state_costs(num_timesteps);
+  for(int r = 0; r < max_rollouts; r++)
+  {
+    RandomStream stream(2,0,r);
+    for(int t = 0; t < num_timesteps; t++)
+    {
+      // all the rollouts cost the same at the first timestep
+      state_costs(t) = t == 0 ? 1.0 : 10.0 * stream.uniform();
+      for(int d = 0; d < num_dimensions; d++)
+      {
+        control_costs(d,t) = t == 0 ? 0.0 : stream.uniform();
+        noise[r](d,t) = stream.normal();
+      }
+    }
+    importance_weights[r] = 0.5 + 0.5 * stream.uniform();
+
+    total_costs[r] = control_costs.rowwise() + state_costs.transpose();
+    arrays->setRolloutCosts(r,control_costs,state_costs,importance_weights[r]);
+    arrays->setRolloutNoise(r,noise[r]);
+  }
+
+  arrays->computeProbabilities(num_rollouts,h);
+  Eigen::MatrixXd updates(num_dimensions,num_timesteps);
+  arrays->computeUpdates(num_rollouts,updates);
+
+  for(int d = 0; d < num_dimensions; d++)
+  {
+    for(int t = 0; t < num_timesteps; t++)
+    {
+      double min_cost = total_costs[0](d,t);
+      double max_cost = min_cost;
+      for(int r = 0; r < num_rollouts; r++)
+      {
+        min_cost = std::min(min_cost,total_costs[r](d,t));
+        max_cost = std::max(max_cost,total_costs[r](d,t));
+      }
+      double denom = std::max(max_cost - min_cost,min_cost_difference);
+
+      std::vector<double> probabilities(num_rollouts);
+      double probability_sum = 0.0;
+      for(int r = 0; r < num_rollouts; r++)
+      {
+        probabilities[r] = importance_weights[r] * std::exp(-h * (total_costs[r](d,t) - min_cost) / denom);
+        probability_sum += probabilities[r];
+      }
+
+      double update = 0.0;
+      for(int r = 0; r < num_rollouts; r++)
+      {
+        probabilities[r] /= probability_sum;
+        update += probabilities[r] * noise[r](d,t);
+        EXPECT_NEAR(arrays->getProbability(d + t * num_dimensions,r),probabilities[r],1e-12);
+      }
+      EXPECT_NEAR(updates(d,t),update,1e-12);
+    }
+  }
+}
+
+/** @brief This tests the array based probabilities and updates against a per rollout computation */
+TEST(StompUtils,rollout_arrays_reference)
+{
+  checkRolloutArraysReference(3);
+  checkRolloutArraysReference(6);
+  checkRolloutArraysReference(7);
+}
+
+/** @brief This tests the profiler counters and the csv and json formats of the report */
+TEST(StompUtils,profiler_report)
+{
+  Profiler profiler;
+  int first = profiler.addCounter("first");
+  int second = profiler.addCounter("second");
+  EXPECT_EQ(profiler.size(),2);
+
+  profiler.record(first,std::chrono::milliseconds(250));
+  profiler.record(first,std::chrono::milliseconds(250));
+  profiler.record(second,std::chrono::seconds(2));
+  {
+    Profiler::ScopedTimer timer(profiler,second);
+  }
+
+  ProfileReport report;
+  profiler.getReport(report);
+  ASSERT_EQ(report.entries.size(),2);
+  EXPECT_EQ(report.entries[0].calls,2);
+  EXPECT_DOUBLE_EQ(report.entries[0].total_time,0.5);
+  EXPECT_EQ(report.entries[1].calls,2);
+  EXPECT_GE(report.entries[1].total_time,2.0);
+  EXPECT_TRUE(report.find("missing") == nullptr);
+
+  profiler.reset();
+  profiler.record(second,std::chrono::seconds(2));
+  report.entries.clear();
+  profiler.getReport(report);
+  EXPECT_EQ(report.toCsvHeader(),"first.calls,first.time,second.calls,second.time");
+  EXPECT_EQ(report.toCsv(),"0,0,1,2");
+  EXPECT_EQ(report.toJson(),"{\"first\":{\"calls\":0,\"time\":0},\"second\":{\"calls\":1,\"time\":2}}");
+}
+
+/** @brief This tests the cubic resampling of a trajectory */
+TEST(StompUtils,resample_cubic)
+{
+  // a line is resampled exactly
+  Eigen::MatrixXd line(2,5);
+  line.row(0).setLinSpaced(5,0.0,1.0);
+  line.row(1).setLinSpaced(5,2.0,-2.0);
+
+  Eigen::MatrixXd resampled;
+  resampleCubic(line,9,resampled);
+  ASSERT_EQ(resampled.rows(),2);
+  ASSERT_EQ(resampled.cols(),9);
+  EXPECT_TRUE(resampled.row(0).isApprox(Eigen::RowVectorXd::LinSpaced(9,0.0,1.0)));
+  EXPECT_TRUE(resampled.row(1).isApprox(Eigen::RowVectorXd::LinSpaced(9,2.0,-2.0)));
+
+  // a smooth curve is approximated and its end points are kept
+  Eigen::MatrixXd coarse(1,11);
+  for(int t = 0; t < coarse.cols(); t++)
+  {
+    coarse(0,t) = std::sin(M_PI*t/10.0);
+  }
+  resampleCubic(coarse,41,resampled);
+  for(int t = 0; t < resampled.cols(); t++)
+  {
+    EXPECT_NEAR(resampled(0,t),std::sin(M_PI*t/40.0),1e-3);
+  }
+  EXPECT_EQ(resampled(0,0),coarse(0,0));
+  EXPECT_EQ(resampled(0,40),coarse(0,10));
+
+  // resampling at the same number of timesteps returns the knots
+  resampleCubic(coarse,11,resampled);
+  EXPECT_TRUE(resampled.isApprox(coarse,1e-12));
+}
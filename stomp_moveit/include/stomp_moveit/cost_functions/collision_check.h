@@ -29,6 +29,7 @@
 #include <Eigen/Sparse>
 #include <moveit/robot_model/robot_model.h>
 #include "stomp_moveit/cost_functions/stomp_cost_function.h"
+#include "stomp_moveit/utils/start_state_snapshot.h"
 
 namespace stomp_moveit
 {
@@ -65,6 +66,9 @@ public:
    */
   virtual bool configure(const XmlRpc::XmlRpcValue& config) override;
 
+  /** @brief see base class for documentation*/
+  virtual StompCostFunctionPtr clone() const override;
+
   /**
    * @brief Stores the planning details which will be used during the costs calculations.
    * @param planning_scene      A smart pointer to the planning scene
@@ -78,6 +82,9 @@ public:
                    const stomp_core::StompConfiguration &config,
                    moveit_msgs::MoveItErrorCodes& error_code) override;
 
+  /** @brief see base class for documentation*/
+  virtual void releaseMotionPlanRequest() override;
+
 
   /**
    * @brief computes the state costs by checking whether the robot is in collision at each time step.
@@ -98,6 +105,29 @@ public:
                             Eigen::VectorXd& costs,
                             bool& validity) override;
 
+  /**
+   * @brief checks only the states and the segments to the neighboring states that have changed when the last optimized
+   *        parameters were collision free, otherwise the costs are computed for the whole trajectory since the kernel
+   *        smoothing spreads the cost of a collision across timesteps.
+   * @param parameters        The parameter values to evaluate for state costs [num_dimensions x num_parameters]
+   * @param start_timestep    start index into the 'parameters' array, usually 0.
+   * @param num_timesteps     number of elements to use from 'parameters' starting from 'start_timestep'   *
+   * @param iteration_number  The current iteration count in the optimization loop
+   * @param rollout_number    index of the noisy trajectory whose cost is being evaluated.   *
+   * @param changed_timesteps mask [num_parameters] of the timesteps that differ from the last optimized parameters
+   * @param costs             vector containing the state costs per timestep.  Sets '0' to all collision-free states.
+   * @param validity          whether or not the trajectory is valid.
+   * @return false if there was an irrecoverable failure, true otherwise.
+   */
+  virtual bool computeChangedCosts(const Eigen::MatrixXd& parameters,
+                                   std::size_t start_timestep,
+                                   std::size_t num_timesteps,
+                                   int iteration_number,
+                                   int rollout_number,
+                                   const stomp_core::TimestepMask& changed_timesteps,
+                                   Eigen::VectorXd& costs,
+                                   bool& validity) override;
+
   virtual std::string getGroupName() const override
   {
     return group_name_;
@@ -123,6 +153,13 @@ protected:
    */
   bool checkIntermediateCollisions(const Eigen::VectorXd& start, const Eigen::VectorXd& end,double longest_valid_joint_move);
 
+  /**
+   * @brief Checks the robot against the world and itself at a single joint pose.
+   * @param joint_pose  The joint pose to check
+   * @return  True if the robot is in collision, false otherwise.
+   */
+  bool checkStateCollision(const Eigen::VectorXd& joint_pose);
+
   std::string name_;
 
   // robot details
@@ -133,6 +170,7 @@ protected:
   // planning context information
   planning_scene::PlanningSceneConstPtr planning_scene_;
   moveit_msgs::MotionPlanRequest plan_request_;
+  utils::StartStateSnapshot start_state_snapshot_;  /**< @brief The start state the robot states were set up for */
 
   // parameters
   double collision_penalty_;            /**< @brief The value assigned to a collision state */
@@ -28,6 +28,7 @@
 #define INDUSTRIAL_MOVEIT_STOMP_MOVEIT_INCLUDE_STOMP_MOVEIT_COST_FUNCTIONS_OBSTACLE_DISTANCE_GRADIENT_H_
 
 #include <stomp_moveit/cost_functions/stomp_cost_function.h>
+#include <stomp_moveit/utils/start_state_snapshot.h>
 #include <array>
 
 namespace stomp_moveit
@@ -64,6 +65,9 @@ public:
    */
   virtual bool configure(const XmlRpc::XmlRpcValue& config) override;
 
+  /** @brief see base class for documentation*/
+  virtual StompCostFunctionPtr clone() const override;
+
 
   /**
    * @brief Stores the planning details which will be used during the costs calculations.
@@ -78,6 +82,9 @@ public:
                                     const stomp_core::StompConfiguration &config,
                                     moveit_msgs::MoveItErrorCodes& error_code) override;
 
+  /** @brief see base class for documentation*/
+  virtual void releaseMotionPlanRequest() override;
+
   /**
    * @brief computes the state costs by calculating the minimum distance between the robot and an obstacle.
    * @param parameters        The parameter values to evaluate for state costs [num_dimensions x num_parameters]
@@ -132,6 +139,7 @@ protected:
   // planning context information
   planning_scene::PlanningSceneConstPtr planning_scene_;
   moveit_msgs::MotionPlanRequest plan_request_;
+  utils::StartStateSnapshot start_state_snapshot_;  /**< @brief The start state the robot states were set up for */
 
   // distance and collision check
   collision_detection::CollisionRequest collision_request_;
@@ -78,6 +78,16 @@ public:
    */
   virtual bool configure(const XmlRpc::XmlRpcValue& config) = 0;
 
+  /**
+   * @brief Creates an initialized and configured copy of this plugin without loading it again, the copy shares no
+   * mutable state with this plugin and setMotionPlanRequest() must be called on it before planning.
+   * @return  The copy, or null if the plugin does not support cloning.
+   */
+  virtual StompCostFunctionPtr clone() const
+  {
+    return StompCostFunctionPtr();
+  }
+
   /**
    * @brief Stores the planning details which will be used during the costs calculations.
    * @param planning_scene  A smart pointer to the planning scene
@@ -91,6 +101,11 @@ public:
                    const stomp_core::StompConfiguration &config,
                    moveit_msgs::MoveItErrorCodes& error_code) = 0;
 
+  /**
+   * @brief Releases what is kept of the last motion plan request, such as the planning scene.  setMotionPlanRequest()
+   * is called again before the plugin is used.
+   */
+  virtual void releaseMotionPlanRequest(){}
 
   /**
    * @brief computes the state costs as a function of the parameters for each time step.
@@ -111,6 +126,77 @@ public:
                             Eigen::VectorXd& costs,
                             bool& validity) = 0 ;
 
+  /**
+   * @brief computes the state costs of parameters that only differ at some of the timesteps from the optimized parameters
+   *        this plugin evaluated last.  On entry 'costs' and 'validity' hold the results of that evaluation so a plugin
+   *        may only re-evaluate the timesteps flagged in 'changed_timesteps'.  The default implementation calls computeCosts().
+   * @param parameters        The parameter values to evaluate for state costs [num_dimensions x num_parameters]
+   * @param start_timestep    start index into the 'parameters' array, usually 0.
+   * @param num_timesteps     number of elements to use from 'parameters' starting from 'start_timestep'   *
+   * @param iteration_number  The current iteration count in the optimization loop
+   * @param rollout_number    index of the noisy trajectory whose cost is being evaluated.   *
+   * @param changed_timesteps mask [num_parameters] of the timesteps that differ from the last optimized parameters
+   * @param costs             vector containing the state costs per timestep.
+   * @param validity          whether or not the trajectory is valid
+   * @return false if there was an irrecoverable failure, true otherwise.
+   */
+  virtual bool computeChangedCosts(const Eigen::MatrixXd& parameters,
+                                   std::size_t start_timestep,
+                                   std::size_t num_timesteps,
+                                   int iteration_number,
+                                   int rollout_number,
+                                   const stomp_core::TimestepMask& changed_timesteps,
+                                   Eigen::VectorXd& costs,
+                                   bool& validity)
+  {
+    return computeCosts(parameters,start_timestep,num_timesteps,iteration_number,rollout_number,costs,validity);
+  }
+
+  /**
+   * @brief Whether this plugin implements computeCostsBatch() to share its setup work among several rollouts.
+   * @return true if it evaluates rollouts in batches, false otherwise.
+   */
+  virtual bool supportsBatchedCosts() const
+  {
+    return false;
+  }
+
+  /**
+   * @brief computes the state costs of several noisy trajectories in one call.  Entry 'r' of each vector belongs to the rollout
+   *        number 'r'.  As in computeChangedCosts(), on entry 'costs[r]' and 'validity[r]' hold the results of the last optimized
+   *        parameters; when there are none every timestep is flagged and the validity is false.  The default implementation
+   *        calls computeChangedCosts() for each rollout.
+   * @param parameters        The parameter values of each rollout [num_dimensions x num_parameters]
+   * @param start_timestep    start index into the 'parameters' arrays, usually 0.
+   * @param num_timesteps     number of elements to use from 'parameters' starting from 'start_timestep'
+   * @param iteration_number  The current iteration count in the optimization loop
+   * @param changed_timesteps mask [num_parameters] of the timesteps at which each rollout differs from the last optimized parameters
+   * @param costs             vector containing the state costs per timestep of each rollout.
+   * @param validity          whether or not each trajectory is valid
+   * @return false if there was an irrecoverable failure, true otherwise.
+   */
+  virtual bool computeCostsBatch(const std::vector<Eigen::MatrixXd>& parameters,
+                                 std::size_t start_timestep,
+                                 std::size_t num_timesteps,
+                                 int iteration_number,
+                                 const std::vector<stomp_core::TimestepMask>& changed_timesteps,
+                                 std::vector<Eigen::VectorXd>& costs,
+                                 std::vector<bool>& validity)
+  {
+    for(auto r = 0u; r < parameters.size(); r++)
+    {
+      bool valid = validity[r];
+      if(!computeChangedCosts(parameters[r],start_timestep,num_timesteps,iteration_number,r,changed_timesteps[r],
+                              costs[r],valid))
+      {
+        return false;
+      }
+      validity[r] = valid;
+    }
+
+    return true;
+  }
+
   /**
    * @brief Called by STOMP at the end of each iteration.
    * @param start_timestep    The start index into the 'parameters' array, usually 0.
@@ -55,6 +55,9 @@ public:
   /** @brief see base class for documentation*/
   virtual bool configure(const XmlRpc::XmlRpcValue& config) override;
 
+  /** @brief see base class for documentation*/
+  virtual StompNoiseGeneratorPtr clone() const override;
+
   /** @brief see base class for documentation*/
   virtual bool setMotionPlanRequest(const planning_scene::PlanningSceneConstPtr& planning_scene,
                    const moveit_msgs::MotionPlanRequest &req,
@@ -80,6 +83,21 @@ public:
                                        Eigen::MatrixXd& parameters_noise,
                                        Eigen::MatrixXd& noise) override;
 
+  /**
+   * @brief Replaces the 'stddev' of each joint with a joint space covariance, the correlation between timesteps is kept.
+   * @param covariance  The covariance [num_dimensions x num_dimensions] of the noise averaged over the timesteps, empty to
+   *                    restore the 'stddev'.
+   */
+  virtual void setNoiseCovariance(const Eigen::MatrixXd& covariance) override;
+
+  /**
+   * @brief Computes the log density of the noise under the scaled normal distribution of each joint
+   * @param noise       The noise [num_dimensions x num_timesteps]
+   * @param log_density The log density of the noise without the constant terms
+   * @return false if the noise does not match the preallocated generators, true otherwise.
+   */
+  virtual bool computeNoiseLogDensity(const Eigen::MatrixXd& noise,double& log_density) const override;
+
   /**
    * @brief Called by the Stomp at the end of the optimization process
    *
@@ -110,9 +128,13 @@ protected:
 
   // random noise generation
   std::vector<utils::MultivariateGaussianPtr> rand_generators_;
-  Eigen::VectorXd raw_noise_;
   std::vector<double> stddev_;
 
+  // adapted covariance
+  Eigen::MatrixXd covariance_cholesky_;   /**< @brief Lower Cholesky factor of the joint space covariance, empty when not adapted */
+  double covariance_log_determinant_;     /**< @brief Log determinant of the Cholesky factor */
+  double timestep_scale_;                 /**< @brief Scales the unit covariance between timesteps to unit mean variance */
+
 };
 
 } /* namespace noise_generators */
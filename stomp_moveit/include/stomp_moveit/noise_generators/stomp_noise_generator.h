@@ -53,7 +53,13 @@ typedef std::shared_ptr<StompNoiseGenerator> StompNoiseGeneratorPtr;
 class StompNoiseGenerator
 {
 public:
-  StompNoiseGenerator(){}
+  StompNoiseGenerator():
+    noise_scale_(1.0),
+    random_seed_(0)
+  {
+
+  }
+
   virtual ~StompNoiseGenerator(){}
 
   /**
@@ -73,6 +79,16 @@ public:
    */
   virtual bool configure(const XmlRpc::XmlRpcValue& config) = 0;
 
+  /**
+   * @brief Creates an initialized and configured copy of this plugin without loading it again, the copy shares no
+   * mutable state with this plugin and setMotionPlanRequest() must be called on it before planning.
+   * @return  The copy, or null if the plugin does not support cloning.
+   */
+  virtual StompNoiseGeneratorPtr clone() const
+  {
+    return StompNoiseGeneratorPtr();
+  }
+
   /**
    * @brief Stores the planning details.
    * @param planning_scene      A smart pointer to the planning scene
@@ -105,6 +121,50 @@ public:
                                        Eigen::MatrixXd& parameters_noise,
                                        Eigen::MatrixXd& noise) = 0;
 
+  /**
+   * @brief Sets the factor that the noise magnitude is multiplied by, STOMP decays it as the cost converges.
+   * @param scale The noise scale in (0,1]
+   */
+  virtual void setNoiseScale(double scale)
+  {
+    noise_scale_ = scale;
+  }
+
+  virtual double getNoiseScale() const
+  {
+    return noise_scale_;
+  }
+
+  /**
+   * @brief Sets the joint space covariance that replaces the 'stddev' of the noise when STOMP adapts it, the noise scale
+   * still applies on top of it.  See stomp_core::Task::setNoiseCovariance().
+   * @param covariance  The covariance [num_dimensions x num_dimensions] of the noise averaged over the timesteps, empty to
+   *                    restore the configured noise.
+   */
+  virtual void setNoiseCovariance(const Eigen::MatrixXd& covariance){}
+
+  /**
+   * @brief Computes the log density of the noise under the distribution currently sampled by generateNoise(), STOMP
+   * uses it to weight the rollouts reused from previous iterations.  See stomp_core::Task::computeNoiseLogDensity().
+   * @param noise       The noise [num_dimensions x num_timesteps]
+   * @param log_density The log density of the noise, constant terms that do not change during a solve may be omitted.
+   * @return false if the density is not known, true otherwise.
+   */
+  virtual bool computeNoiseLogDensity(const Eigen::MatrixXd& noise,double& log_density) const
+  {
+    return false;
+  }
+
+  /**
+   * @brief Sets the master seed, the noise of each rollout should be drawn from a stomp_core::RandomStream constructed
+   * from this seed, the iteration number and the rollout number so that it does not depend on the thread that generates it.
+   * @param seed The master seed
+   */
+  virtual void setRandomSeed(std::uint64_t seed)
+  {
+    random_seed_ = seed;
+  }
+
   /**
    * @brief Called by STOMP at the end of each iteration.
    * @param start_timestep    The start index into the 'parameters' array, usually 0.
@@ -137,6 +197,11 @@ public:
   {
     return "Not implemented";
   }
+
+protected:
+
+  double noise_scale_;      /**< @brief The factor applied to the noise magnitude */
+  std::uint64_t random_seed_; /**< @brief The master seed of the random streams */
 };
 
 } /* namespace noise_generators */
@@ -26,6 +26,7 @@
 #ifndef INDUSTRIAL_MOVEIT_STOMP_MOVEIT_INCLUDE_STOMP_MOVEIT_NOISY_FILTERS_MULTI_TRAJECTORY_VISUALIZATION_H_
 #define INDUSTRIAL_MOVEIT_STOMP_MOVEIT_INCLUDE_STOMP_MOVEIT_NOISY_FILTERS_MULTI_TRAJECTORY_VISUALIZATION_H_
 
+#include <mutex>
 #include <ros/node_handle.h>
 #include <ros/publisher.h>
 #include <Eigen/Core>
@@ -42,6 +43,9 @@ namespace noisy_filters
  * @class stomp_moveit::noisy_filters::MultiTrajectoryVisualization
  * @brief Publishes rviz markers to visualize the noisy trajectories
  *
+ * The markers of the rollouts filtered during an iteration are published once at the end of it.  The copies created by
+ * cloneForRollouts() fill the same markers so the noisy rollouts processed concurrently are published together.
+ *
  * @par Examples:
  * All examples are located here @ref stomp_moveit_examples
  *
@@ -59,6 +63,14 @@ public:
   /** @brief see base class for documentation*/
   virtual bool configure(const XmlRpc::XmlRpcValue& config) override;
 
+  /** @brief see base class for documentation*/
+  virtual StompNoisyFilterPtr clone() const override;
+
+  /**
+   * @brief Creates a copy that shares the markers with this plugin, see base class for documentation
+   */
+  virtual StompNoisyFilterPtr cloneForRollouts() const override;
+
   /** @brief see base class for documentation*/
   virtual bool setMotionPlanRequest(const planning_scene::PlanningSceneConstPtr& planning_scene,
                    const moveit_msgs::MotionPlanRequest &req,
@@ -83,6 +95,20 @@ public:
                       Eigen::MatrixXd& parameters,
                       bool& filtered) override;
 
+  /**
+   * @brief Publishes the markers of the rollouts filtered during the iteration, the copies sharing the markers publish
+   * them only once.
+   *
+   * @param start_timestep    The start index into the 'parameters' array, usually 0.
+   * @param num_timesteps     The number of elements to use from 'parameters' starting from 'start_timestep'
+   * @param iteration_number  The current iteration count in the optimization loop
+   * @param cost              The cost value for the current parameters.
+   * @param parameters        The value of the parameters at the end of the current iteration [num_dimensions x num_timesteps].
+   */
+  virtual void postIteration(std::size_t start_timestep,
+                             std::size_t num_timesteps,int iteration_number,double cost,
+                             const Eigen::MatrixXd& parameters) override;
+
 
   virtual std::string getName() const override
   {
@@ -114,11 +140,21 @@ protected:
   std::string marker_topic_;
   std::string marker_namespace_;
 
+  /**
+   * @brief The markers of the rollouts, shared with the copies that filter rollouts concurrently
+   */
+  struct RolloutMarkers
+  {
+    std::mutex mutex;
+    bool updated = false;                                   /**< Whether rollouts were filtered since the last publication */
+    visualization_msgs::MarkerArray tool_traj_markers;
+    visualization_msgs::MarkerArray tool_points_markers;
+  };
+
   // tool trajectory
   std::size_t traj_total_;
   Eigen::MatrixXd tool_traj_line_;
-  visualization_msgs::MarkerArray tool_traj_markers_;
-  visualization_msgs::MarkerArray tool_points_markers_;
+  std::shared_ptr<RolloutMarkers> markers_;
 };
 
 } /* namespace filters */
@@ -74,6 +74,27 @@ public:
    */
   virtual bool configure(const XmlRpc::XmlRpcValue& config) = 0;
 
+  /**
+   * @brief Creates an initialized and configured copy of this plugin without loading it again, the copy shares no
+   * mutable state with this plugin and setMotionPlanRequest() must be called on it before planning.
+   * @return  The copy, or null if the plugin does not support cloning.
+   */
+  virtual StompNoisyFilterPtr clone() const
+  {
+    return StompNoisyFilterPtr();
+  }
+
+  /**
+   * @brief Creates the copy that filters noisy rollouts concurrently with this plugin during the same solve, see
+   * StompOptimizationTask::supportsConcurrentRollouts().  Unlike clone() the copy may share the state that collects the
+   * rollouts of an iteration with this plugin.
+   * @return  The copy, or null if the plugin does not support cloning.
+   */
+  virtual StompNoisyFilterPtr cloneForRollouts() const
+  {
+    return clone();
+  }
+
   /**
    * @brief Stores the planning details.
    * @param planning_scene      A smart pointer to the planning scene
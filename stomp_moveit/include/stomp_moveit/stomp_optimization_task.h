@@ -26,10 +26,13 @@
 #ifndef INDUSTRIAL_MOVEIT_STOMP_MOVEIT_INCLUDE_STOMP_MOVEIT_STOMP_OPTIMIZATION_TASK_H_
 #define INDUSTRIAL_MOVEIT_STOMP_MOVEIT_INCLUDE_STOMP_MOVEIT_STOMP_OPTIMIZATION_TASK_H_
 
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 #include <moveit_msgs/MotionPlanRequest.h>
 #include <moveit/robot_model/robot_model.h>
 #include <stomp_core/task.h>
+#include <stomp_core/thread_pool.h>
 #include <stomp_moveit/cost_functions/stomp_cost_function.h>
 #include <XmlRpcValue.h>
 #include <pluginlib/class_loader.h>
@@ -72,6 +75,14 @@ public:
                         const XmlRpc::XmlRpcValue& config);
   virtual ~StompOptimizationTask();
 
+  /**
+   * @brief Creates a task with copies of the loaded plugins without loading or configuring them again, the plugin
+   * libraries stay loaded while any of the copies exist.  setMotionPlanRequest() must be called on the copy before
+   * planning.
+   * @return  The copy, or null if any of the loaded plugins does not support cloning.
+   */
+  std::shared_ptr<StompOptimizationTask> clone() const;
+
   /**
    * @brief Passes the planning details down to each loaded plugin
    * @param planning_scene  A smart pointer to the planning scene
@@ -85,6 +96,71 @@ public:
                    const stomp_core::StompConfiguration &config,
                    moveit_msgs::MoveItErrorCodes& error_code);
 
+  /**
+   * @brief Releases the planning scene and the request of the last motion plan request in the task and the cost
+   * function plugins.  setMotionPlanRequest() must be called again before planning.
+   */
+  void releaseMotionPlanRequest();
+
+  /**
+   * @brief Passes the noise scale down to the loaded Noise Generator plugins.
+   * @param scale The noise scale in (0,1]
+   */
+  virtual void setNoiseScale(double scale) override;
+
+  /**
+   * @brief Passes the master seed down to the loaded Noise Generator plugins.
+   * @param seed The master seed
+   */
+  virtual void setRandomSeed(std::uint64_t seed) override;
+
+  /**
+   * @brief Passes the adapted noise covariance down to the loaded Noise Generator plugins.
+   * @param covariance The joint space covariance of the noise, empty to restore the configured noise
+   */
+  virtual void setNoiseCovariance(const Eigen::MatrixXd& covariance) override;
+
+  /**
+   * @brief Computes the density of the noise with the Noise Generator plugin that generates it.
+   * @param noise       The noise [num_dimensions x num_timesteps]
+   * @param log_density The log density of the noise
+   * @return  true if the plugin knows the density, false otherwise.
+   */
+  virtual bool computeNoiseLogDensity(const Eigen::MatrixXd& noise,double& log_density) const override;
+
+  /**
+   * @brief The noisy rollouts can be processed concurrently once the last motion plan request has been set up with
+   * more than one thread and all the cost function, noise generator and noisy filter plugins support cloning.
+   * @return  true if more than one rollout worker is available, false otherwise.
+   */
+  virtual bool supportsConcurrentRollouts() const override;
+
+  /**
+   * @brief The plugins can always be set up again for a different number of timesteps.
+   * @return  true
+   */
+  virtual bool supportsMultiResolution() const override;
+
+  /**
+   * @brief Passes the planning details of the last motion plan request down to each loaded plugin again with the
+   * number of timesteps of a coarse-to-fine level.
+   * @param config  The Stomp configuration of the level
+   * @return  true if succeeded,false otherwise.
+   */
+  virtual bool setResolution(const stomp_core::StompConfiguration& config) override;
+
+  /**
+   * @brief Zeros the plugin timers.
+   */
+  virtual void resetProfile() override;
+
+  /**
+   * @brief Appends one entry per loaded plugin, named '<plugin type>/<plugin name>', with the time spent in its
+   * noise generation, cost or filter method.
+   * @param report The report to append to
+   */
+  virtual void getProfile(stomp_core::ProfileReport& report) const override;
+
   /**
    * @brief Generates a noisy trajectory from the parameters by calling the active Noise Generator plugin.
    * @param parameters        [num_dimensions] x [num_parameters] the current value of the optimized parameters
@@ -123,6 +199,54 @@ public:
                        Eigen::VectorXd& costs,
                        bool& validity) override;
 
+  /**
+   * @brief computes the state costs of noisy parameters that only differ from the optimized parameters at some of the timesteps.
+   * The loaded Cost Function plugins receive the costs they computed for the last optimized parameters along with the timesteps that differ from them.
+   * @param parameters [num_dimensions] num_parameters - policy parameters to execute
+   * @param start_timestep    start index into the 'parameters' array, usually 0.
+   * @param num_timesteps     number of elements to use from 'parameters' starting from 'start_timestep'
+   * @param iteration_number  The current iteration count in the optimization loop
+   * @param rollout_number index of the noisy trajectory whose cost is being evaluated.
+   * @param changed_timesteps mask [num_parameters] of the timesteps that differ from the optimized parameters
+   * @param costs vector containing the state costs per timestep.
+   * @param validity whether or not the trajectory is valid
+   * @return  false if there was an irrecoverable failure, true otherwise.
+   */
+  virtual bool computeChangedNoisyCosts(const Eigen::MatrixXd& parameters,
+                       std::size_t start_timestep,
+                       std::size_t num_timesteps,
+                       int iteration_number,
+                       int rollout_number,
+                       const stomp_core::TimestepMask& changed_timesteps,
+                       Eigen::VectorXd& costs,
+                       bool& validity) override;
+
+  /**
+   * @brief Whether any of the loaded Cost Function plugins evaluates rollouts in batches.
+   * @return  true if a plugin supports batches, false otherwise.
+   */
+  virtual bool supportsBatchedCosts() const override;
+
+  /**
+   * @brief computes the state costs of all the noisy trajectories of an iteration by passing them to each of the loaded Cost Function
+   * plugins in a single call.
+   * @param parameters        The [num_dimensions] x [num_parameters] policy parameters of each rollout
+   * @param start_timestep    start index into the 'parameters' arrays, usually 0.
+   * @param num_timesteps     number of elements to use from 'parameters' starting from 'start_timestep'
+   * @param iteration_number  The current iteration count in the optimization loop
+   * @param changed_timesteps mask [num_parameters] of the timesteps at which each rollout differs from the optimized parameters
+   * @param costs             vector containing the state costs per timestep of each rollout.
+   * @param validity          whether or not each trajectory is valid
+   * @return  false if there was an irrecoverable failure, true otherwise.
+   */
+  virtual bool computeNoisyCostsBatch(const std::vector<Eigen::MatrixXd>& parameters,
+                       std::size_t start_timestep,
+                       std::size_t num_timesteps,
+                       int iteration_number,
+                       const std::vector<stomp_core::TimestepMask>& changed_timesteps,
+                       std::vector<Eigen::VectorXd>& costs,
+                       std::vector<bool>& validity) override;
+
   /**
    * @brief computes the state costs as a function of the optimized parameters for each time step. It does this by calling the loaded Cost Function plugins
    * @param parameters        [num_dimensions] num_parameters - policy parameters to execute
@@ -140,6 +264,26 @@ public:
                        Eigen::VectorXd& costs,
                        bool& validity) override;
 
+  /**
+   * @brief computes the state costs of the optimized parameters after an update that only changed some of the timesteps.
+   * The loaded Cost Function plugins receive the costs they computed for the last optimized parameters along with the timesteps that differ from them.
+   * @param parameters        [num_dimensions] num_parameters - policy parameters to execute
+   * @param start_timestep    start index into the 'parameters' array, usually 0.
+   * @param num_timesteps     number of elements to use from 'parameters' starting from 'start_timestep'
+   * @param iteration_number  The current iteration count in the optimization loop
+   * @param changed_timesteps mask [num_parameters] of the timesteps changed by the update
+   * @param costs             vector containing the state costs per timestep.
+   * @param validity          whether or not the trajectory is valid
+   * @return  false if there was an irrecoverable failure, true otherwise.
+   */
+  virtual bool computeChangedCosts(const Eigen::MatrixXd& parameters,
+                       std::size_t start_timestep,
+                       std::size_t num_timesteps,
+                       int iteration_number,
+                       const stomp_core::TimestepMask& changed_timesteps,
+                       Eigen::VectorXd& costs,
+                       bool& validity) override;
+
   /**
    * @brief Filters the given noisy parameters which is applied after noisy trajectory generation. It could be used for clipping
    * of joint limits or projecting into the null space of the Jacobian.  It accomplishes this by calling the loaded Noisy Filter plugins.
@@ -197,12 +341,122 @@ public:
    */
   virtual void done(bool success,int total_iterations,double final_cost,const Eigen::MatrixXd& parameters) override;
 
+protected:
+
+  /**
+   * @brief Constructor of a task without plugins, used by clone()
+   * @param robot_model_ptr A pointer to the robot model
+   * @param group_name      The planning group name
+   */
+  StompOptimizationTask(moveit::core::RobotModelConstPtr robot_model_ptr, std::string group_name);
+
+  /**
+   * @brief Adds a profiler timer for each loaded plugin
+   */
+  void addPluginTimers();
+
+  /**
+   * @brief The plugins and preallocated buffers used to process one noisy rollout at a time.  The first worker holds
+   * the loaded plugins and the others hold copies of them.
+   */
+  struct RolloutWorker
+  {
+    std::vector<cost_functions::StompCostFunctionPtr> cost_functions;
+    std::vector<noise_generators::StompNoiseGeneratorPtr> noise_generators;
+    std::vector<noisy_filters::StompNoisyFilterPtr> noisy_filters;
+
+    /**< Preallocated buffers receiving the results of each cost function for a single rollout >*/
+    std::vector<Eigen::VectorXd> plugin_costs;               /**< [num_cost_functions] x [num_timesteps] */
+    Eigen::Array<bool,Eigen::Dynamic,1> plugin_validity;     /**< [num_cost_functions] */
+    Eigen::Array<bool,Eigen::Dynamic,1> plugin_computed;     /**< [num_cost_functions] */
+    stomp_core::TimestepMask changed_timesteps;              /**< [num_timesteps] */
+  };
+
+  /**
+   * @brief Hands out an idle rollout worker for the duration of a concurrent call and returns it when destroyed.
+   */
+  class RolloutWorkerLease;
+
+  /**
+   * @brief Clones the plugins into additional rollout workers until there is one worker per thread.
+   * @param num_threads The number of threads processing the noisy rollouts
+   */
+  void createRolloutWorkers(int num_threads);
+
+  /**
+   * @brief Reads the cost function evaluation options from the task configuration.
+   * @param config  The configuration parameter data
+   */
+  void parseCostFunctionOptions(XmlRpc::XmlRpcValue config);
+
+  /**
+   * @brief Finds the cost function named by 'gate_cost_function_' and creates the thread pool that evaluates the
+   * cost functions concurrently.
+   */
+  void setupCostFunctionEvaluation();
+
+  /**
+   * @brief Evaluates a single Cost Function plugin into its column of the preallocated plugin cost buffer.
+   * @param worker            The rollout worker whose plugin and buffers are used
+   * @param i                 index of the cost function
+   * @param parameters        [num_dimensions] num_parameters - policy parameters to execute
+   * @param start_timestep    start index into the 'parameters' array, usually 0.
+   * @param num_timesteps     number of elements to use from 'parameters' starting from 'start_timestep'
+   * @param iteration_number  The current iteration count in the optimization loop
+   * @param rollout_number    index of the noisy trajectory, ignored for the optimized parameters
+   * @param optimized         whether these are the optimized parameters
+   * @param changed_timesteps mask of the timesteps that differ from the cached parameters, null to evaluate every timestep
+   */
+  void computeCostFunction(RolloutWorker& worker,
+                           std::size_t i,
+                           const Eigen::MatrixXd& parameters,
+                           std::size_t start_timestep,
+                           std::size_t num_timesteps,
+                           int iteration_number,
+                           int rollout_number,
+                           bool optimized,
+                           const stomp_core::TimestepMask* changed_timesteps);
+
+  /**
+   * @brief Evaluates all the loaded Cost Function plugins and combines their weighted costs.
+   * @param worker            The rollout worker whose plugins and buffers are used
+   * @param parameters        [num_dimensions] num_parameters - policy parameters to execute
+   * @param start_timestep    start index into the 'parameters' array, usually 0.
+   * @param num_timesteps     number of elements to use from 'parameters' starting from 'start_timestep'
+   * @param iteration_number  The current iteration count in the optimization loop
+   * @param rollout_number    index of the noisy trajectory, ignored for the optimized parameters
+   * @param optimized         whether these are the optimized parameters, their plugin costs are cached for later evaluations
+   * @param changed_timesteps mask of the timesteps that differ from the cached parameters, null to evaluate every timestep
+   * @param costs             vector containing the state costs per timestep.
+   * @param validity          whether or not the trajectory is valid
+   * @return  false if there was an irrecoverable failure, true otherwise.
+   */
+  bool computePluginCosts(RolloutWorker& worker,
+                          const Eigen::MatrixXd& parameters,
+                          std::size_t start_timestep,
+                          std::size_t num_timesteps,
+                          int iteration_number,
+                          int rollout_number,
+                          bool optimized,
+                          const stomp_core::TimestepMask* changed_timesteps,
+                          Eigen::VectorXd& costs,
+                          bool& validity);
+
+  /**
+   * @brief Flags the timesteps at which the parameters differ from the ones the cached plugin costs were computed for.
+   * @param parameters        [num_dimensions] num_parameters - policy parameters to execute
+   * @param changed_timesteps mask [num_parameters] of the timesteps that differ
+   * @return  false if there are no cached plugin costs that apply to these parameters, true otherwise.
+   */
+  bool updateChangedTimesteps(const Eigen::MatrixXd& parameters,stomp_core::TimestepMask& changed_timesteps);
+
 protected:
 
   // robot environment
   std::string group_name_;
   moveit::core::RobotModelConstPtr robot_model_ptr_;
   planning_scene::PlanningSceneConstPtr planning_scene_ptr_;
+  moveit_msgs::MotionPlanRequest plan_request_;
 
   /**< The plugin loaders for each type of plugin supported>*/
   CostFuctionLoaderPtr cost_function_loader_;
@@ -215,6 +469,41 @@ protected:
   std::vector<noisy_filters::StompNoisyFilterPtr> noisy_filters_;
   std::vector<update_filters::StompUpdateFilterPtr> update_filters_;
   std::vector<noise_generators::StompNoiseGeneratorPtr> noise_generators_;
+
+  /**< Plugin timers, the counter index of each loaded plugin >*/
+  stomp_core::Profiler profiler_;
+  std::vector<int> cost_function_timers_;
+  std::vector<int> noisy_filter_timers_;
+  std::vector<int> update_filter_timers_;
+  int noise_generator_timer_;
+
+  /**< Rollout workers, the first one is also used for the optimized parameters >*/
+  std::vector<RolloutWorker> rollout_workers_;
+  std::vector<int> idle_rollout_workers_;                   /**< Indices of the workers not in use */
+  std::mutex rollout_workers_mutex_;
+  std::condition_variable rollout_workers_condition_;
+  bool rollout_workers_cloneable_;                          /**< False once a plugin failed to be cloned */
+
+  /**< Cost function evaluation options >*/
+  int cost_function_threads_;                 /**< Threads evaluating the cost functions of a rollout, 1 is sequential */
+  std::string gate_cost_function_;            /**< Name of the cost function evaluated first, empty for none */
+  double gate_saturation_cost_;               /**< Gate cost at or above which an invalid rollout skips the others */
+  int gate_index_;                            /**< Index of the gate cost function, -1 for none */
+  stomp_core::ThreadPoolPtr cost_function_pool_;  /**< Only used by the first rollout worker */
+
+  /**< Per cost function results for the last optimized parameters, reused for the timesteps that have not changed >*/
+  bool reference_available_;
+  Eigen::MatrixXd reference_parameters_;                    /**< [num_dimensions] x [num_timesteps] */
+  Eigen::MatrixXd reference_costs_;                         /**< [num_timesteps] x [num_cost_functions] */
+  Eigen::Array<bool,Eigen::Dynamic,1> reference_validity_;  /**< [num_cost_functions] */
+
+  /**< Preallocated buffers [num_rollouts] used by the batched cost evaluation >*/
+  std::vector<stomp_core::TimestepMask> batch_changed_timesteps_;
+  std::vector<Eigen::VectorXd> batch_plugin_costs_;
+  std::vector<bool> batch_plugin_validity_;
+  std::vector<Eigen::VectorXd> batch_gate_costs_;
+  std::vector<bool> batch_gate_validity_;
+  std::vector<bool> batch_gate_closed_;
 };
 
 
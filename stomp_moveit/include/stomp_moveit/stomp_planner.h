@@ -30,6 +30,7 @@
 #include <stomp_core/stomp.h>
 #include <stomp_moveit/stomp_optimization_task.h>
 #include <boost/thread.hpp>
+#include <atomic>
 #include <ros/ros.h>
 
 namespace stomp_moveit
@@ -56,6 +57,13 @@ public:
   StompPlanner(const std::string& group,const XmlRpc::XmlRpcValue& config,const moveit::core::RobotModelConstPtr& model);
   virtual ~StompPlanner();
 
+  /**
+   * @brief Creates a planner for the same group and configuration that shares no state with this one.  The plugins are
+   * cloned from this planner when all of them support it, otherwise they are loaded again.
+   * @return The new planner, may throw a std::logic_error if the plugins fail to load.
+   */
+  std::shared_ptr<StompPlanner> clone() const;
+
   /**
    * @brief Solve the motion planning problem as defined in the motion request passed before hand.
    * @param res Contains the solved planned path.
@@ -72,15 +80,23 @@ public:
 
   /**
    * @brief Thread-safe method that request early termination, if a solve() function is currently computing plans.
+   *
+   * The request is kept until clear() is called, so a solve() that starts after it returns immediately.
    * @return true if succeeded, false otherwise.
    */
   virtual bool terminate() override;
 
   /**
-   * @brief Clears results from previous plan.
+   * @brief Clears results from previous plan and any pending termination request.
    */
   virtual void clear() override;
 
+  /**
+   * @brief Clears the planner and releases the planning scene and the request it was set up with, setPlanningScene()
+   * and setMotionPlanRequest() must be called again before solving.
+   */
+  void releaseMotionPlanRequest();
+
   /**
    * @brief Convenience method to load extract the parameters for each supported planning group.
    * @param nh      A ros node handle.
@@ -108,7 +124,17 @@ public:
 protected:
 
   /**
-   * @brief planner setup
+   * @brief StompPlanner constructor that uses an already loaded task.
+   * @param group   The planning group for which this instance will plan.
+   * @param config  The parameter containing the configuration data for this planning group.
+   * @param model   A pointer to the robot model.
+   * @param task    The task with the plugins of this planning group.
+   */
+  StompPlanner(const std::string& group,const XmlRpc::XmlRpcValue& config,const moveit::core::RobotModelConstPtr& model,
+               StompOptimizationTaskPtr task);
+
+  /**
+   * @brief planner setup, the task is only created when none was given
    */
   void setup();
 
@@ -155,6 +181,11 @@ protected:
    */
   bool extractSeedTrajectory(const moveit_msgs::MotionPlanRequest& req, trajectory_msgs::JointTrajectory& seed) const;
 
+  /**
+   * @brief Cancels the STOMP optimization again after its configuration was set when terminate() was called since the last clear().
+   */
+  void restoreTermination();
+
 protected:
 
   // stomp optimization
@@ -162,6 +193,8 @@ protected:
   StompOptimizationTaskPtr task_;
   XmlRpc::XmlRpcValue config_;
   stomp_core::StompConfiguration stomp_config_;
+  std::string profile_output_;          /**< @brief Format of the profile logged after each solve, 'csv', 'json' or empty */
+  std::atomic<bool> terminated_;        /**< @brief Set by terminate() and reset by clear() */
 
   // robot environment
   moveit::core::RobotModelConstPtr robot_model_;
@@ -28,13 +28,27 @@
 
 #include <moveit/planning_interface/planning_interface.h>
 #include <ros/node_handle.h>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 namespace stomp_moveit
 {
+
+class StompPlanner;
+
 /**
  * @class stomp_moveit::StompPlannerManager
  * @brief The PlannerManager implementation that loads STOMP into moveit
  *
+ * Each planning group has a pool of independent planning contexts.  Every call to getPlanningContext() hands out an
+ * idle context, or clones a new one from the planner loaded at initialization when all of them are in use, and the
+ * context returns to the pool once the caller releases it.  Concurrent requests for the same group therefore plan in parallel without sharing any state.
+ *
+ * A returned context releases its planning scene and request.  Each pool keeps at most 'max_idle_planning_contexts'
+ * idle contexts, a parameter in the namespace of the manager that defaults to the number of hardware threads, the
+ * contexts returned while the pool is full are destroyed.
+ *
  * @par Examples:
  * All examples are located here @ref stomp_moveit_examples
  *
@@ -86,7 +100,8 @@ public:
   void setPlannerConfigurations(const planning_interface::PlannerConfigurationMap &pcs) override;
 
   /**
-   * @brief Provides a planning context that matches the desired plan requests specifications
+   * @brief Provides a planning context that matches the desired plan requests specifications, the context is not
+   * handed out again until the returned pointer and all of its copies are released. (Thread-Safe)
    * @param planning_scene  A pointer to the planning scene
    * @param req             The motion plan request
    * @param error_code      Error code, will be set to moveit_msgs::MoveItErrorCodes::SUCCESS if it succeeded
@@ -98,11 +113,36 @@ public:
       moveit_msgs::MoveItErrorCodes &error_code) const override;
 
 
+protected:
+
+  /**
+   * @brief The idle planning contexts of a planning group
+   */
+  struct PlannerPool
+  {
+    std::string group;                                /**< The planning group */
+    std::shared_ptr<StompPlanner> prototype;          /**< The planner the new contexts are cloned from, never handed out */
+    std::mutex mutex;                                 /**< Guards the idle planners */
+    std::vector<std::shared_ptr<StompPlanner> > idle; /**< The planners that are not in use */
+    std::size_t max_idle;                             /**< The most idle planners that are kept */
+  };
+  typedef std::shared_ptr<PlannerPool> PlannerPoolPtr;
+
+  /**
+   * @brief Takes an idle planner from the pool or clones a new one when there is none. (Thread-Safe)
+   * @param pool  The pool of the planning group
+   * @return The planner, it returns to the pool once released or is destroyed if the pool is full or no longer exists.
+   */
+  std::shared_ptr<StompPlanner> checkoutPlanner(const PlannerPoolPtr& pool) const;
+
 protected:
   ros::NodeHandle nh_;
 
 
-  std::map< std::string, planning_interface::PlanningContextPtr> planners_; /**< The planners for each planning group */
+  std::map< std::string, planning_interface::PlanningContextPtr> planners_; /**< The planners for each planning group,
+                                                                                 only used to query the requests */
+  std::map< std::string, PlannerPoolPtr> planner_pools_;                    /**< The planning contexts of each planning group */
+  mutable std::mutex creation_mutex_;                                       /**< Serializes the creation of new planners */
 
   // the robot model
   moveit::core::RobotModelConstPtr robot_model_;
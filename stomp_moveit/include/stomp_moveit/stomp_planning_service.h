@@ -0,0 +1,241 @@
+/**
+ * @file stomp_planning_service.h
+ * @brief This defines an asynchronous front-end that plans queued motion plan requests with STOMP
+ *
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef STOMP_MOVEIT_STOMP_PLANNING_SERVICE_H_
+#define STOMP_MOVEIT_STOMP_PLANNING_SERVICE_H_
+
+#include <moveit/planning_interface/planning_interface.h>
+#include <XmlRpcValue.h>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace stomp_moveit
+{
+
+class StompPlanner;
+
+/**
+ * @class stomp_moveit::StompPlanningService
+ * @brief Plans motion plan requests asynchronously on a fixed number of worker threads.
+ *
+ * Each submitted request is queued with a priority and a deadline and a future of its response is returned right away.
+ * The workers take the request with the highest priority first, requests of equal priority are planned in the order
+ * they were submitted.  A request whose deadline passes while it is queued is answered with TIMED_OUT without
+ * planning, otherwise STOMP is given the time left until the deadline.
+ *
+ * Requests can be planned in batches, a worker then takes up to the batch size of the requests at the front of the
+ * queue as long as they are for the same planning group and planning scene and plans them one after the other with the
+ * same planner.  Batching trades the concurrency of such requests for reusing the planner setup between them.
+ *
+ * Every worker keeps one planner per planning group and reuses it for all the requests of that group, the planners are
+ * cloned from the one loaded at initialization so the plugins are not loaded again and the matrices that only depend
+ * on the configuration are shared by all of them.
+ *
+ */
+class StompPlanningService
+{
+public:
+
+  typedef std::chrono::steady_clock Clock;
+  typedef std::future<planning_interface::MotionPlanResponse> ResponseFuture;
+  typedef std::function<void (const planning_interface::MotionPlanRequest& req)> JobCallback;
+
+  /**
+   * @brief Constructor
+   * @param num_workers     The number of requests that are planned concurrently
+   * @param max_batch_size  The most requests a worker takes from the queue at once, 1 disables batching
+   */
+  explicit StompPlanningService(int num_workers,int max_batch_size = 1);
+
+  /**
+   * @brief Stops the workers, see shutdown()
+   */
+  virtual ~StompPlanningService();
+
+  /**
+   * @brief Loads a planner for each planning group and starts the workers.
+   * @param model   The robot model
+   * @param config  The configuration data of each planning group, see StompPlanner::getConfigData()
+   * @return  True if at least one planning group was loaded, False otherwise
+   */
+  bool initialize(const moveit::core::RobotModelConstPtr& model,const std::map<std::string, XmlRpc::XmlRpcValue>& config);
+
+  /**
+   * @brief Sets a function that a worker calls with each request it takes, before the request is planned.  It runs on
+   * the worker thread and delays the request until it returns.
+   * @param callback  The function called for each request
+   * @return  True if succeeded, False if the service has already been initialized
+   */
+  bool setJobCallback(JobCallback callback);
+
+  /**
+   * @brief Checks if the request can be planned for.
+   * @param req The motion plan request
+   * @return True if succeeded, False otherwise
+   */
+  bool canServiceRequest(const moveit_msgs::MotionPlanRequest& req) const;
+
+  /**
+   * @brief Queues a request, its deadline is the allowed planning time of the request counted from now, or none when
+   * it is not set. (Thread-Safe)
+   * @param planning_scene  The planning scene, it must not be modified until the request has been planned
+   * @param req             The motion plan request
+   * @param priority        Requests with a higher priority are planned first
+   * @return  The future response of the request
+   */
+  ResponseFuture submit(const planning_scene::PlanningSceneConstPtr& planning_scene,
+                        const planning_interface::MotionPlanRequest& req,
+                        int priority = 0);
+
+  /**
+   * @brief Queues a request that must be planned by the given deadline. (Thread-Safe)
+   * @param planning_scene  The planning scene, it must not be modified until the request has been planned
+   * @param req             The motion plan request
+   * @param priority        Requests with a higher priority are planned first
+   * @param deadline        The time by which the response is needed
+   * @return  The future response of the request
+   */
+  ResponseFuture submit(const planning_scene::PlanningSceneConstPtr& planning_scene,
+                        const planning_interface::MotionPlanRequest& req,
+                        int priority,
+                        Clock::time_point deadline);
+
+  /**
+   * @brief The number of requests waiting for a worker. (Thread-Safe)
+   * @return The number of queued requests
+   */
+  std::size_t getNumPending() const;
+
+  /**
+   * @brief The number of requests that are planned concurrently
+   * @return The number of workers
+   */
+  int getNumWorkers() const;
+
+  /**
+   * @brief The most requests a worker takes from the queue at once
+   * @return The batch size
+   */
+  int getMaxBatchSize() const;
+
+  /**
+   * @brief Terminates the requests being planned, waits for the workers to finish and answers the terminated and the
+   * queued requests with PREEMPTED.  No request is accepted afterwards. (Thread-Safe)
+   */
+  void shutdown();
+
+protected:
+
+  /**
+   * @brief A queued motion plan request
+   */
+  struct Job
+  {
+    planning_scene::PlanningSceneConstPtr planning_scene;                         /**< The planning scene */
+    planning_interface::MotionPlanRequest request;                                /**< The motion plan request */
+    int priority;                                                                 /**< Higher is planned first */
+    unsigned long sequence;                                                       /**< The submission order */
+    Clock::time_point deadline;                                                   /**< The time by which the response is needed */
+    std::promise<planning_interface::MotionPlanResponse> response;                /**< The promised response */
+  };
+  typedef std::shared_ptr<Job> JobPtr;
+
+  /**
+   * @brief Orders the queue so that its top is the job with the highest priority that was submitted first
+   */
+  struct JobOrder
+  {
+    bool operator()(const JobPtr& lhs,const JobPtr& rhs) const
+    {
+      return lhs->priority < rhs->priority || (lhs->priority == rhs->priority && lhs->sequence > rhs->sequence);
+    }
+  };
+
+  /**
+   * @brief Takes the queued jobs until the service shuts down
+   * @param worker The index of the worker
+   */
+  void workerLoop(int worker);
+
+  /**
+   * @brief Checks if a job can be planned in the same batch as another one
+   * @param first The first job of the batch
+   * @param job   The job
+   * @return True if both are for the same planning group and planning scene, False otherwise
+   */
+  static bool canBatch(const Job& first,const Job& job);
+
+  /**
+   * @brief Plans a job and fulfills its response
+   * @param worker  The index of the worker
+   * @param job     The job
+   */
+  void runJob(int worker,Job& job);
+
+  /**
+   * @brief Gets the planner of the worker for a planning group, it is cloned the first time.
+   * @param worker  The index of the worker
+   * @param group   The planning group
+   * @return The planner, null if it could not be created
+   */
+  std::shared_ptr<StompPlanner> getPlanner(int worker,const std::string& group);
+
+  /**
+   * @brief Answers a job without planning
+   * @param job         The job
+   * @param error_code  The error code of the response
+   */
+  static void reject(Job& job,int error_code);
+
+protected:
+
+  int num_workers_;
+  int max_batch_size_;
+  JobCallback job_callback_;                                                           /**< Called with each request taken, may be empty */
+  moveit::core::RobotModelConstPtr robot_model_;
+
+  std::map<std::string, std::shared_ptr<StompPlanner> > prototypes_;                   /**< The planners loaded for each planning group,
+                                                                                            never used for planning */
+  std::vector<std::map<std::string, std::shared_ptr<StompPlanner> > > worker_planners_; /**< The planners of each worker */
+  std::vector<std::shared_ptr<StompPlanner> > active_planners_;                        /**< The planner each worker is running, if any */
+  std::mutex creation_mutex_;                                                          /**< Serializes the creation of new planners */
+
+  mutable std::mutex mutex_;                                                           /**< Guards the queue and the active planners */
+  std::condition_variable condition_;
+  std::priority_queue<JobPtr,std::vector<JobPtr>,JobOrder> jobs_;
+  unsigned long next_sequence_;
+  bool stop_;
+  std::vector<std::thread> threads_;
+};
+
+} /* namespace stomp_moveit */
+
+#endif /* STOMP_MOVEIT_STOMP_PLANNING_SERVICE_H_ */
@@ -58,6 +58,9 @@ public:
   /** @brief see base class for documentation*/
   virtual bool configure(const XmlRpc::XmlRpcValue& config) override;
 
+  /** @brief see base class for documentation*/
+  virtual StompUpdateFilterPtr clone() const override;
+
   /** @brief see base class for documentation*/
   virtual bool setMotionPlanRequest(const planning_scene::PlanningSceneConstPtr& planning_scene,
                    const moveit_msgs::MotionPlanRequest &req,
@@ -104,6 +107,7 @@ protected:
   // smoothing matrix
   int num_timesteps_;
   Eigen::MatrixXd projection_matrix_M_;
+  Eigen::VectorXd projected_update_;    /**< @brief Preallocated projection of a single row of the updates */
 
 };
 
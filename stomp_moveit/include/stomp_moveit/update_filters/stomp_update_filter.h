@@ -75,6 +75,16 @@ public:
    */
   virtual bool configure(const XmlRpc::XmlRpcValue& config) = 0;
 
+  /**
+   * @brief Creates an initialized and configured copy of this plugin without loading it again, the copy shares no
+   * mutable state with this plugin and setMotionPlanRequest() must be called on it before planning.
+   * @return  The copy, or null if the plugin does not support cloning.
+   */
+  virtual StompUpdateFilterPtr clone() const
+  {
+    return StompUpdateFilterPtr();
+  }
+
   /**
    * @brief Stores the planning details.
    * @param planning_scene      A smart pointer to the planning scene
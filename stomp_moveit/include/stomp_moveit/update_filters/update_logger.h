@@ -27,6 +27,7 @@
 #define INDUSTRIAL_MOVEIT_STOMP_MOVEIT_INCLUDE_STOMP_MOVEIT_UPDATE_FILTERS_UPDATE_LOGGER_H_
 
 #include <stomp_moveit/update_filters/stomp_update_filter.h>
+#include <atomic>
 #include <fstream>
 
 namespace stomp_moveit
@@ -40,6 +41,9 @@ namespace update_filters
  *  library and can be loaded into a numpy array by running.
  *    'numpy.loadtxt(file_name)'
  *
+ * The copies made by clone() can plan concurrently, so each one logs to the configured file name with its copy number
+ * appended, e.g. 'update_log_2.txt'.
+ *
  * @par Examples:
  * All examples are located here @ref stomp_moveit_examples
  *
@@ -57,6 +61,9 @@ public:
   /** @brief see base class for documentation*/
   virtual bool configure(const XmlRpc::XmlRpcValue& config);
 
+  /** @brief see base class for documentation*/
+  virtual StompUpdateFilterPtr clone() const;
+
   /** @brief see base class for documentation*/
   virtual bool setMotionPlanRequest(const planning_scene::PlanningSceneConstPtr& planning_scene,
                    const moveit_msgs::MotionPlanRequest &req,
@@ -102,6 +109,8 @@ protected:
   std::string filename_;
   std::string package_;
   std::string directory_;
+  int clone_index_;                                 /**< The copy number appended to the file name, 0 if not a copy */
+  std::shared_ptr<std::atomic<int> > num_clones_;   /**< The number of copies made, shared with the copies */
 
   // config
   stomp_core::StompConfiguration stomp_config_;
@@ -44,6 +44,7 @@
 #include <boost/random/mersenne_twister.hpp>
 #include <boost/shared_ptr.hpp>
 #include <cstdlib>
+#include <stomp_core/random_stream.h>
 
 namespace stomp_moveit
 {
@@ -63,6 +64,23 @@ public:
   template <typename Derived1, typename Derived2>
   MultivariateGaussian(const Eigen::MatrixBase<Derived1>& mean, const Eigen::MatrixBase<Derived2>& covariance);
 
+  /**
+   * @brief Constructor that skips the Cholesky decomposition
+   * @param mean                The mean of the distribution
+   * @param covariance          The covariance of the distribution
+   * @param covariance_cholesky The lower triangular Cholesky factor L of the covariance (LL^T)
+   */
+  MultivariateGaussian(const Eigen::VectorXd& mean, const Eigen::MatrixXd& covariance,
+                       const Eigen::MatrixXd& covariance_cholesky);
+
+  /**
+   * @brief Copy constructor, the copy continues from the same generator state but does not share it
+   * @param other The distribution to copy
+   */
+  MultivariateGaussian(const MultivariateGaussian& other);
+
+  MultivariateGaussian& operator=(const MultivariateGaussian& other) = delete;
+
   /**
    * @brief generates random values using a normal distribution.
    * @param output          The random values
@@ -71,6 +89,29 @@ public:
   template <typename Derived>
   void sample(Eigen::MatrixBase<Derived>& output,bool use_covariance = true);
 
+  /**
+   * @brief generates random values drawing the normal samples from the given stream instead of the internal generator,
+   * the output only depends on the state of the stream.
+   * @param output          The random values
+   * @param stream          The random stream
+   * @param use_covariance  True to apply the covariance matrix onto the random values, false otherwise
+   */
+  template <typename Derived>
+  void sample(Eigen::MatrixBase<Derived>& output,stomp_core::RandomStream& stream,bool use_covariance = true);
+
+  /**
+   * @brief computes the log density of a value without the normalizing constant, which only depends on the covariance.
+   * @param value The value
+   * @return  -0.5 * (value - mean)^T * covariance^-1 * (value - mean)
+   */
+  template <typename Derived>
+  double logDensity(const Eigen::MatrixBase<Derived>& value) const;
+
+private:
+
+  template <typename Derived>
+  void transform(Eigen::MatrixBase<Derived>& output,bool use_covariance);
+
 private:
   Eigen::VectorXd mean_;                /**< Mean of the gaussian distribution */
   Eigen::MatrixXd covariance_;          /**< Covariance of the gaussian distribution */
@@ -97,12 +138,59 @@ MultivariateGaussian::MultivariateGaussian(const Eigen::MatrixBase<Derived1>& me
   gaussian_.reset(new boost::variate_generator<boost::mt19937, boost::normal_distribution<> >(rng_, normal_dist_));
 }
 
+inline MultivariateGaussian::MultivariateGaussian(const Eigen::VectorXd& mean, const Eigen::MatrixXd& covariance,
+                                                  const Eigen::MatrixXd& covariance_cholesky):
+  mean_(mean),
+  covariance_(covariance),
+  covariance_cholesky_(covariance_cholesky),
+  normal_dist_(0.0,1.0)
+{
+
+  rng_.seed(rand());
+  size_ = mean.rows();
+  gaussian_.reset(new boost::variate_generator<boost::mt19937, boost::normal_distribution<> >(rng_, normal_dist_));
+}
+
+inline MultivariateGaussian::MultivariateGaussian(const MultivariateGaussian& other):
+  mean_(other.mean_),
+  covariance_(other.covariance_),
+  covariance_cholesky_(other.covariance_cholesky_),
+  size_(other.size_),
+  rng_(other.rng_),
+  normal_dist_(other.normal_dist_)
+{
+  gaussian_.reset(new boost::variate_generator<boost::mt19937, boost::normal_distribution<> >(*other.gaussian_));
+}
+
 template <typename Derived>
 void MultivariateGaussian::sample(Eigen::MatrixBase<Derived>& output,bool use_covariance)
 {
   for (int i=0; i<size_; ++i)
     output(i) = (*gaussian_)();
 
+  transform(output,use_covariance);
+}
+
+template <typename Derived>
+void MultivariateGaussian::sample(Eigen::MatrixBase<Derived>& output,stomp_core::RandomStream& stream,bool use_covariance)
+{
+  for (int i=0; i<size_; ++i)
+    output(i) = stream.normal();
+
+  transform(output,use_covariance);
+}
+
+template <typename Derived>
+double MultivariateGaussian::logDensity(const Eigen::MatrixBase<Derived>& value) const
+{
+  // (x - mean)^T (LL^T)^-1 (x - mean) = |L^-1 (x - mean)|^2
+  Eigen::VectorXd whitened = covariance_cholesky_.triangularView<Eigen::Lower>().solve(value - mean_);
+  return -0.5 * whitened.squaredNorm();
+}
+
+template <typename Derived>
+void MultivariateGaussian::transform(Eigen::MatrixBase<Derived>& output,bool use_covariance)
+{
   if(use_covariance)
   {
     output = mean_ + covariance_cholesky_*output;
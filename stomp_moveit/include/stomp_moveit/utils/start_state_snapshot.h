@@ -0,0 +1,131 @@
+/**
+ * @file start_state_snapshot.h
+ * @brief This defines a snapshot of the start state used to detect consecutive requests from the same state.
+ *
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef INDUSTRIAL_MOVEIT_STOMP_MOVEIT_INCLUDE_STOMP_MOVEIT_UTILS_START_STATE_SNAPSHOT_H_
+#define INDUSTRIAL_MOVEIT_STOMP_MOVEIT_INCLUDE_STOMP_MOVEIT_UTILS_START_STATE_SNAPSHOT_H_
+
+#include <moveit_msgs/RobotState.h>
+
+namespace stomp_moveit
+{
+namespace utils
+{
+
+/**
+ * @class stomp_moveit::utils::StartStateSnapshot
+ * @brief Records the start state of a motion plan request so that a plugin can tell whether a new request starts
+ * from the same state as the previous one and keep the robot states it built from it.
+ *
+ * Only the joint values and the multi-dof joint transforms are compared, the header stamps are ignored.  A start
+ * state with attached objects is never considered unchanged since comparing their geometry costs as much as
+ * rebuilding the robot state.
+ */
+class StartStateSnapshot
+{
+public:
+
+  StartStateSnapshot():
+    valid_(false)
+  {
+
+  }
+
+  /**
+   * @brief Replaces the snapshot with the given start state.
+   * @param start_state The start state of the motion plan request
+   * @return  true if it is the same as in the previous snapshot, false otherwise.
+   */
+  bool update(const moveit_msgs::RobotState& start_state)
+  {
+    bool comparable = start_state.attached_collision_objects.empty();
+    if(valid_ && comparable && equals(start_state))
+    {
+      return true;
+    }
+
+    // the previous messages keep their capacity so an unchanged layout is copied without allocating
+    start_state_.is_diff = start_state.is_diff;
+    start_state_.joint_state.name = start_state.joint_state.name;
+    start_state_.joint_state.position = start_state.joint_state.position;
+    start_state_.joint_state.velocity = start_state.joint_state.velocity;
+    start_state_.joint_state.effort = start_state.joint_state.effort;
+    start_state_.multi_dof_joint_state.joint_names = start_state.multi_dof_joint_state.joint_names;
+    start_state_.multi_dof_joint_state.transforms = start_state.multi_dof_joint_state.transforms;
+    valid_ = comparable;
+    return false;
+  }
+
+  /**
+   * @brief Discards the snapshot, the next update will report a change.
+   */
+  void clear()
+  {
+    valid_ = false;
+  }
+
+protected:
+
+  bool equals(const moveit_msgs::RobotState& start_state) const
+  {
+    if(start_state.is_diff != start_state_.is_diff ||
+        start_state.joint_state.name != start_state_.joint_state.name ||
+        start_state.joint_state.position != start_state_.joint_state.position ||
+        start_state.joint_state.velocity != start_state_.joint_state.velocity ||
+        start_state.joint_state.effort != start_state_.joint_state.effort ||
+        start_state.multi_dof_joint_state.joint_names != start_state_.multi_dof_joint_state.joint_names)
+    {
+      return false;
+    }
+
+    const auto& transforms = start_state.multi_dof_joint_state.transforms;
+    const auto& recorded = start_state_.multi_dof_joint_state.transforms;
+    if(transforms.size() != recorded.size())
+    {
+      return false;
+    }
+
+    for(auto i = 0u; i < transforms.size(); i++)
+    {
+      const auto& t = transforms[i];
+      const auto& r = recorded[i];
+      if(t.translation.x != r.translation.x || t.translation.y != r.translation.y ||
+          t.translation.z != r.translation.z || t.rotation.x != r.rotation.x || t.rotation.y != r.rotation.y ||
+          t.rotation.z != r.rotation.z || t.rotation.w != r.rotation.w)
+      {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+protected:
+
+  bool valid_;
+  moveit_msgs::RobotState start_state_;   /**< The joint values of the recorded start state */
+};
+
+} // utils
+} // stomp_moveit
+
+#endif /* INDUSTRIAL_MOVEIT_STOMP_MOVEIT_INCLUDE_STOMP_MOVEIT_UTILS_START_STATE_SNAPSHOT_H_ */
@@ -168,18 +168,24 @@ bool CollisionCheck::setMotionPlanRequest(const planning_scene::PlanningSceneCon
   collision_robot_ = planning_scene->getCollisionRobot();
   collision_world_ = planning_scene->getCollisionWorld();
 
-  // storing robot state
-  robot_state_.reset(new RobotState(robot_model_ptr_));
-  if(!robotStateMsgToRobotState(req.start_state,*robot_state_,true))
+  // the robot states only depend on the start state so they are kept from the previous request when it has not
+  // changed, the group joints are always overwritten before a collision check
+  if(!start_state_snapshot_.update(req.start_state) || !robot_state_)
   {
-    ROS_ERROR("%s Failed to get current robot state from request",getName().c_str());
-    return false;
-  }
+    // storing robot state
+    robot_state_.reset(new RobotState(robot_model_ptr_));
+    if(!robotStateMsgToRobotState(req.start_state,*robot_state_,true))
+    {
+      ROS_ERROR("%s Failed to get current robot state from request",getName().c_str());
+      start_state_snapshot_.clear();
+      return false;
+    }
 
-  // copying into intermediate robot states
-  for(auto& rs : intermediate_coll_states_)
-  {
-    rs.reset(new RobotState(*robot_state_));
+    // copying into intermediate robot states
+    for(auto& rs : intermediate_coll_states_)
+    {
+      rs.reset(new RobotState(*robot_state_));
+    }
   }
 
   // allocating arrays
@@ -312,6 +318,70 @@ bool CollisionCheck::computeCosts(const Eigen::MatrixXd& parameters,
   return true;
 }
 
+bool CollisionCheck::computeChangedCosts(const Eigen::MatrixXd& parameters,
+                                         std::size_t start_timestep,
+                                         std::size_t num_timesteps,
+                                         int iteration_number,
+                                         int rollout_number,
+                                         const stomp_core::TimestepMask& changed_timesteps,
+                                         Eigen::VectorXd& costs,
+                                         bool& validity)
+{
+  // a collision free reference has zero costs, any collision requires the smoothed costs of the whole trajectory
+  if(!validity || !robot_state_ || parameters.cols() < (start_timestep + num_timesteps))
+  {
+    return computeCosts(parameters,start_timestep,num_timesteps,iteration_number,rollout_number,costs,validity);
+  }
+
+  std::size_t end_timestep = start_timestep + num_timesteps;
+  for (auto t=start_timestep; t<end_timestep; ++t)
+  {
+    bool segment_changed = changed_timesteps(t) || (t + 1 < end_timestep && changed_timesteps(t + 1));
+    if(!segment_changed)
+    {
+      continue;
+    }
+
+    if(changed_timesteps(t) && checkStateCollision(parameters.col(t)))
+    {
+      return computeCosts(parameters,start_timestep,num_timesteps,iteration_number,rollout_number,costs,validity);
+    }
+
+    if(t + 1 < end_timestep &&
+        !checkIntermediateCollisions(parameters.col(t),parameters.col(t+1),longest_valid_joint_move_))
+    {
+      return computeCosts(parameters,start_timestep,num_timesteps,iteration_number,rollout_number,costs,validity);
+    }
+  }
+
+  costs.setZero(num_timesteps);
+  validity = true;
+  return true;
+}
+
+bool CollisionCheck::checkStateCollision(const Eigen::VectorXd& joint_pose)
+{
+  robot_state_->setJointGroupPositions(group_name_,joint_pose);
+  robot_state_->update();
+
+  collision_detection::CollisionResult result_world_collision, result_robot_collision;
+  collision_world_->checkRobotCollision(collision_request_,
+                                        result_world_collision,
+                                        *collision_robot_,
+                                        *robot_state_,
+                                        planning_scene_->getAllowedCollisionMatrix());
+  if(result_world_collision.collision)
+  {
+    return true;
+  }
+
+  collision_robot_->checkSelfCollision(collision_request_,
+                                       result_robot_collision,
+                                       *robot_state_,
+                                       planning_scene_->getAllowedCollisionMatrix());
+  return result_robot_collision.collision;
+}
+
 bool CollisionCheck::checkIntermediateCollisions(const Eigen::VectorXd& start,
                                                            const Eigen::VectorXd& end,double longest_valid_joint_move)
 {
@@ -402,7 +472,36 @@ bool CollisionCheck::configure(const XmlRpc::XmlRpcValue& config)
 
 void CollisionCheck::done(bool success,int total_iterations,double final_cost,const Eigen::MatrixXd& parameters)
 {
-  robot_state_.reset();
+  // the robot states are kept for the next request
+}
+
+void CollisionCheck::releaseMotionPlanRequest()
+{
+  planning_scene_.reset();
+  plan_request_ = moveit_msgs::MotionPlanRequest();
+  collision_robot_.reset();
+  collision_world_.reset();
+}
+
+StompCostFunctionPtr CollisionCheck::clone() const
+{
+  std::shared_ptr<CollisionCheck> copy(new CollisionCheck(*this));
+
+  // the robot states are modified while planning
+  if(robot_state_)
+  {
+    copy->robot_state_.reset(new moveit::core::RobotState(*robot_state_));
+  }
+
+  for(auto& rs : copy->intermediate_coll_states_)
+  {
+    if(rs)
+    {
+      rs.reset(new moveit::core::RobotState(*rs));
+    }
+  }
+
+  return copy;
 }
 
 } /* namespace cost_functions */
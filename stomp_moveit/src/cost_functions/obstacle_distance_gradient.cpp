@@ -110,19 +110,25 @@ bool ObstacleDistanceGradient::setMotionPlanRequest(const planning_scene::Planni
   plan_request_ = req;
   error_code.val = moveit_msgs::MoveItErrorCodes::SUCCESS;
 
-  // storing robot state
-  robot_state_.reset(new RobotState(robot_model_ptr_));
-
-  if(!robotStateMsgToRobotState(req.start_state,*robot_state_,true))
+  // the robot states only depend on the start state so they are kept from the previous request when it has not
+  // changed, the group joints are always overwritten before a collision check
+  if(!start_state_snapshot_.update(req.start_state) || !robot_state_)
   {
-    ROS_ERROR("%s Failed to get current robot state from request",getName().c_str());
-    return false;
-  }
+    // storing robot state
+    robot_state_.reset(new RobotState(robot_model_ptr_));
 
-  // copying into intermediate robot states
-  for(auto& rs : intermediate_coll_states_)
-  {
-    rs.reset(new RobotState(*robot_state_));
+    if(!robotStateMsgToRobotState(req.start_state,*robot_state_,true))
+    {
+      ROS_ERROR("%s Failed to get current robot state from request",getName().c_str());
+      start_state_snapshot_.clear();
+      return false;
+    }
+
+    // copying into intermediate robot states
+    for(auto& rs : intermediate_coll_states_)
+    {
+      rs.reset(new RobotState(*robot_state_));
+    }
   }
 
   return true;
@@ -254,7 +260,34 @@ bool ObstacleDistanceGradient::checkIntermediateCollisions(const Eigen::VectorXd
 
 void ObstacleDistanceGradient::done(bool success,int total_iterations,double final_cost,const Eigen::MatrixXd& parameters)
 {
-  robot_state_.reset();
+  // the robot states are kept for the next request
+}
+
+void ObstacleDistanceGradient::releaseMotionPlanRequest()
+{
+  planning_scene_.reset();
+  plan_request_ = moveit_msgs::MotionPlanRequest();
+}
+
+StompCostFunctionPtr ObstacleDistanceGradient::clone() const
+{
+  std::shared_ptr<ObstacleDistanceGradient> copy(new ObstacleDistanceGradient(*this));
+
+  // the robot states are modified while planning
+  if(robot_state_)
+  {
+    copy->robot_state_.reset(new moveit::core::RobotState(*robot_state_));
+  }
+
+  for(auto& rs : copy->intermediate_coll_states_)
+  {
+    if(rs)
+    {
+      rs.reset(new moveit::core::RobotState(*rs));
+    }
+  }
+
+  return copy;
 }
 
 } /* namespace cost_functions */
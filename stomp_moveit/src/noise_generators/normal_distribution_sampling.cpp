@@ -25,18 +25,14 @@
  */
 #include <stomp_moveit/noise_generators/normal_distribution_sampling.h>
 #include <stomp_moveit/utils/multivariate_gaussian.h>
+#include <stomp_core/matrix_cache.h>
 #include <XmlRpcException.h>
 #include <pluginlib/class_list_macros.h>
 #include <ros/console.h>
+#include <cmath>
 
 PLUGINLIB_EXPORT_CLASS(stomp_moveit::noise_generators::NormalDistributionSampling,stomp_moveit::noise_generators::StompNoiseGenerator);
 
-/*
- * These coefficients correspond to the five point stencil method
- */
-static const std::vector<double> ACC_MATRIX_DIAGONAL_VALUES = {-1.0/12.0, 16.0/12.0, -30.0/12.0, 16.0/12.0, -1.0/12.0};
-static const std::vector<int> ACC_MATRIX_DIAGONAL_INDICES = {-2, -1, 0 ,1, 2};
-
 namespace stomp_moveit
 {
 
@@ -44,7 +40,9 @@ namespace noise_generators
 {
 
 NormalDistributionSampling::NormalDistributionSampling():
-    name_("NormalDistributionSampling")
+    name_("NormalDistributionSampling"),
+    covariance_log_determinant_(0.0),
+    timestep_scale_(1.0)
 {
   // TODO Auto-generated constructor stub
 
@@ -112,38 +110,19 @@ bool NormalDistributionSampling::setMotionPlanRequest(const planning_scene::Plan
 {
   using namespace Eigen;
 
-  auto fill_diagonal = [](Eigen::MatrixXd& m,double coeff,int diag_index)
-  {
-    std::size_t size = m.rows() - std::abs(diag_index);
-    m.diagonal(diag_index) = VectorXd::Constant(size,coeff);
-  };
-
-  // creating finite difference acceleration matrix
+  // the covariance (A^T * A)^-1 and its Cholesky factor only depend on the number of timesteps
   std::size_t num_timesteps = config.num_timesteps;
-  Eigen::MatrixXd A = MatrixXd::Zero(num_timesteps,num_timesteps);
-  int num_elements = (int((ACC_MATRIX_DIAGONAL_INDICES.size() -1)/2.0) + 1)* num_timesteps ;
-  for(auto i = 0u; i < ACC_MATRIX_DIAGONAL_INDICES.size() ; i++)
-  {
-    fill_diagonal(A,ACC_MATRIX_DIAGONAL_VALUES[i],ACC_MATRIX_DIAGONAL_INDICES[i]);
-  }
-
-  // create and scale covariance matrix
-  Eigen::MatrixXd covariance = MatrixXd::Identity(num_timesteps,num_timesteps);
-  covariance = A.transpose() * A;
-  covariance = covariance.fullPivLu().inverse();
-  double max_val = covariance.array().abs().matrix().maxCoeff();
-  covariance /= max_val;
+  stomp_core::SamplingCovarianceConstPtr sampling = stomp_core::MatrixCache::instance().getSamplingCovariance(num_timesteps);
 
   // create random generators
   rand_generators_.resize(stddev_.size());
   for(auto& r: rand_generators_)
   {
-    r.reset(new utils::MultivariateGaussian(VectorXd::Zero(num_timesteps),covariance));
+    r.reset(new utils::MultivariateGaussian(VectorXd::Zero(num_timesteps),sampling->covariance,sampling->cholesky));
   }
 
-  // preallocating noise data
-  raw_noise_.resize(config.num_timesteps);
-  raw_noise_.setZero();
+  // an adapted covariance is the variance averaged over the timesteps
+  timestep_scale_ = std::sqrt(num_timesteps/sampling->covariance.trace());
 
   return true;
 }
@@ -164,15 +143,91 @@ bool NormalDistributionSampling::generateNoise(const Eigen::MatrixXd& parameters
   }
 
 
+  // the noise only depends on the seed, the iteration and the rollout so the rollouts can be generated concurrently
+  stomp_core::RandomStream stream(random_seed_,iteration_number,rollout_number);
   for(auto d = 0u; d < parameters.rows() ; d++)
   {
-    rand_generators_[d]->sample(raw_noise_);
-    noise.row(d).transpose() = stddev_[d] * raw_noise_;
-    parameters_noise.row(d) = parameters.row(d) + noise.row(d);
+    auto noise_row = noise.row(d).transpose();
+    rand_generators_[d]->sample(noise_row,stream);
+    noise.row(d) *= covariance_cholesky_.size() > 0 ? noise_scale_ * timestep_scale_ : noise_scale_ * stddev_[d];
+  }
+
+  // mixing the joints with the adapted covariance
+  if(covariance_cholesky_.size() > 0)
+  {
+    noise = covariance_cholesky_.triangularView<Eigen::Lower>() * noise;
+  }
+
+  parameters_noise = parameters + noise;
+  return true;
+}
+
+void NormalDistributionSampling::setNoiseCovariance(const Eigen::MatrixXd& covariance)
+{
+  if(covariance.size() == 0)
+  {
+    covariance_cholesky_.resize(0,0);
+    covariance_log_determinant_ = 0.0;
+    return;
+  }
+
+  Eigen::LLT<Eigen::MatrixXd> llt(covariance);
+  if(llt.info() != Eigen::Success || covariance.rows() != stddev_.size())
+  {
+    ROS_WARN("%s ignored a noise covariance that is not positive definite",getName().c_str());
+    return;
+  }
+
+  covariance_cholesky_ = llt.matrixL();
+  covariance_log_determinant_ = covariance_cholesky_.diagonal().array().log().sum();
+}
+
+bool NormalDistributionSampling::computeNoiseLogDensity(const Eigen::MatrixXd& noise,double& log_density) const
+{
+  if(noise.rows() != rand_generators_.size())
+  {
+    return false;
+  }
+
+  log_density = 0.0;
+  if(covariance_cholesky_.size() > 0)
+  {
+    // the rows are mixed by the Cholesky factor of the adapted covariance after scaling
+    double sigma = noise_scale_ * timestep_scale_;
+    Eigen::MatrixXd unmixed = covariance_cholesky_.triangularView<Eigen::Lower>().solve(noise/sigma);
+    for(auto d = 0u; d < noise.rows(); d++)
+    {
+      log_density += rand_generators_[d]->logDensity(unmixed.row(d).transpose());
+    }
+    log_density -= noise.cols() * (covariance_log_determinant_ + noise.rows() * std::log(sigma));
+    return true;
+  }
+
+  // each row is sampled from the unit covariance scaled by (noise_scale * stddev)^2
+  for(auto d = 0u; d < noise.rows(); d++)
+  {
+    double sigma = noise_scale_ * stddev_[d];
+    log_density += rand_generators_[d]->logDensity(noise.row(d).transpose()/sigma) - noise.cols() * std::log(sigma);
   }
 
   return true;
 }
 
+StompNoiseGeneratorPtr NormalDistributionSampling::clone() const
+{
+  std::shared_ptr<NormalDistributionSampling> copy(new NormalDistributionSampling(*this));
+
+  // the random generators are modified while planning
+  for(auto& r : copy->rand_generators_)
+  {
+    if(r)
+    {
+      r.reset(new utils::MultivariateGaussian(*r));
+    }
+  }
+
+  return copy;
+}
+
 } /* namespace noise_generators */
 } /* namespace stomp_moveit */
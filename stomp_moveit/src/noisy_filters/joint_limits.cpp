@@ -196,5 +196,23 @@ bool JointLimits::filter(std::size_t start_timestep,std::size_t num_timesteps,
   return true;
 }
 
+StompNoisyFilterPtr JointLimits::clone() const
+{
+  std::shared_ptr<JointLimits> copy(new JointLimits(*this));
+
+  // the robot states are modified while planning
+  if(start_state_)
+  {
+    copy->start_state_.reset(new moveit::core::RobotState(*start_state_));
+  }
+
+  if(goal_state_)
+  {
+    copy->goal_state_.reset(new moveit::core::RobotState(*goal_state_));
+  }
+
+  return copy;
+}
+
 } /* namespace filters */
 } /* namespace stomp_moveit */
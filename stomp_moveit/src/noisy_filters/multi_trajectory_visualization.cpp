@@ -94,7 +94,8 @@ namespace noisy_filters
 MultiTrajectoryVisualization::MultiTrajectoryVisualization():
     name_("MultiTrajectoryVisualization"),
     line_width_(0.01),
-    traj_total_(0)
+    traj_total_(0),
+    markers_(new RolloutMarkers())
 {
   // TODO Auto-generated constructor stub
 
@@ -179,20 +180,24 @@ bool MultiTrajectoryVisualization::setMotionPlanRequest(const planning_scene::Pl
   tool_traj_line_ = Eigen::MatrixXd::Zero(3,config.num_timesteps);
   Eigen::Vector3d tool_point;
 
-  // initializing marker array
+  // initializing marker array, the copies sharing it initialize it the same way
   traj_total_ = config.num_rollouts;
-  tool_traj_markers_.markers.resize(traj_total_);
-  tool_points_markers_.markers.resize(traj_total_);
-  for(auto r = 0u; r < config.num_rollouts; r++)
   {
-    createToolPathMarker(tool_traj_line_,
-                         r+1,robot_model_->getRootLinkName(),
-                         rgb_,line_width_,
-                         marker_namespace_,tool_traj_markers_.markers[r]);
-    createSphereMarker(tool_point,
-                         r+1,robot_model_->getRootLinkName(),
-                         rgb_,line_width_,
-                         marker_namespace_ + "/goal",tool_points_markers_.markers[r]);
+    std::lock_guard<std::mutex> lock(markers_->mutex);
+    markers_->updated = false;
+    markers_->tool_traj_markers.markers.resize(traj_total_);
+    markers_->tool_points_markers.markers.resize(traj_total_);
+    for(auto r = 0u; r < config.num_rollouts; r++)
+    {
+      createToolPathMarker(tool_traj_line_,
+                           r+1,robot_model_->getRootLinkName(),
+                           rgb_,line_width_,
+                           marker_namespace_,markers_->tool_traj_markers.markers[r]);
+      createSphereMarker(tool_point,
+                           r+1,robot_model_->getRootLinkName(),
+                           rgb_,line_width_,
+                           marker_namespace_ + "/goal",markers_->tool_points_markers.markers[r]);
+    }
   }
 
 
@@ -244,19 +249,54 @@ bool MultiTrajectoryVisualization::filter(std::size_t start_timestep,
     tool_traj_line_(2,t) = tool_pos.translation()(2);
   }
 
-  // storing into marker
-  eigenToPointsMsgs(tool_traj_line_,tool_traj_markers_.markers[rollout_number].points);
+  // storing into marker, published after collecting all rollouts
   Eigen::Vector3d goal_tool_point = tool_traj_line_.rightCols(1);
-  tf::pointEigenToMsg(goal_tool_point, tool_points_markers_.markers[rollout_number].pose.position);
+  std::lock_guard<std::mutex> lock(markers_->mutex);
+  eigenToPointsMsgs(tool_traj_line_,markers_->tool_traj_markers.markers[rollout_number].points);
+  tf::pointEigenToMsg(goal_tool_point, markers_->tool_points_markers.markers[rollout_number].pose.position);
+  markers_->updated = true;
+
+  return true;
+}
 
-  // publish after collecting all rollouts
-  if(rollout_number == traj_total_ - 1)
+void MultiTrajectoryVisualization::postIteration(std::size_t /*start_timestep*/,
+                                                 std::size_t /*num_timesteps*/,int /*iteration_number*/,double /*cost*/,
+                                                 const Eigen::MatrixXd& /*parameters*/)
+{
+  std::lock_guard<std::mutex> lock(markers_->mutex);
+  if(markers_->updated)
   {
-    viz_pub_.publish(tool_traj_markers_);
-    viz_pub_.publish(tool_points_markers_);
+    viz_pub_.publish(markers_->tool_traj_markers);
+    viz_pub_.publish(markers_->tool_points_markers);
+    markers_->updated = false;
   }
+}
 
-  return true;
+StompNoisyFilterPtr MultiTrajectoryVisualization::clone() const
+{
+  std::shared_ptr<MultiTrajectoryVisualization> copy(new MultiTrajectoryVisualization(*this));
+
+  // the robot states are modified while planning
+  if(state_)
+  {
+    copy->state_.reset(new moveit::core::RobotState(*state_));
+  }
+
+  // the copy plans on its own, setMotionPlanRequest() sets up its markers
+  copy->markers_.reset(new RolloutMarkers());
+
+  return copy;
+}
+
+StompNoisyFilterPtr MultiTrajectoryVisualization::cloneForRollouts() const
+{
+  std::shared_ptr<MultiTrajectoryVisualization> copy(new MultiTrajectoryVisualization(*this));
+  if(state_)
+  {
+    copy->state_.reset(new moveit::core::RobotState(*state_));
+  }
+
+  return copy;
 }
 
 } /* namespace filters */
@@ -23,6 +23,9 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include <stdexcept>
 #include "stomp_moveit/stomp_optimization_task.h"
 
@@ -32,6 +35,9 @@ static const std::string COST_FUNCTIONS_FIELD = "cost_functions";
 static const std::string NOISY_FILTERS_FIELD = "noisy_filters";
 static const std::string UPDATE_FILTERS_FIELD = "update_filters";
 static const std::string NOISE_GENERATOR_FIELD = "noise_generator";
+static const std::string COST_FUNCTION_THREADS_FIELD = "cost_function_threads";
+static const std::string GATE_COST_FUNCTION_FIELD = "gate_cost_function";
+static const std::string GATE_SATURATION_COST_FIELD = "gate_saturation_cost";
 
 /**
  * @brief Convenience method to load an array of STOMP plugins
@@ -174,15 +180,82 @@ bool loadPlugins(const PluginData plugin_data,
   return true;
 }
 
+/**
+ * @brief Copies each plugin with a clone function
+ * @param plugin_array  The plugins
+ * @param cloned_array  The copies
+ * @param clone         Creates the copy of a plugin, null if it can not be copied
+ * @return  False if any of the plugins could not be copied, otherwise true.
+ */
+template <typename PluginPtr,typename CloneFunction>
+bool clonePlugins(const std::vector<PluginPtr>& plugin_array,std::vector<PluginPtr>& cloned_array,CloneFunction clone)
+{
+  cloned_array.clear();
+  for(auto& plugin : plugin_array)
+  {
+    PluginPtr cloned = clone(plugin);
+    if(!cloned)
+    {
+      ROS_DEBUG("Plugin '%s' does not support cloning",plugin->getName().c_str());
+      return false;
+    }
+    cloned_array.push_back(cloned);
+  }
+
+  return true;
+}
+
+template <typename PluginPtr>
+bool clonePlugins(const std::vector<PluginPtr>& plugin_array,std::vector<PluginPtr>& cloned_array)
+{
+  return clonePlugins(plugin_array,cloned_array,[](const PluginPtr& plugin){ return plugin->clone(); });
+}
+
 namespace stomp_moveit
 {
 
+class StompOptimizationTask::RolloutWorkerLease
+{
+public:
+  RolloutWorkerLease(StompOptimizationTask& task):
+    task_(task)
+  {
+    std::unique_lock<std::mutex> lock(task_.rollout_workers_mutex_);
+    task_.rollout_workers_condition_.wait(lock,[this](){ return !task_.idle_rollout_workers_.empty(); });
+    index_ = task_.idle_rollout_workers_.back();
+    task_.idle_rollout_workers_.pop_back();
+  }
+
+  ~RolloutWorkerLease()
+  {
+    {
+      std::lock_guard<std::mutex> lock(task_.rollout_workers_mutex_);
+      task_.idle_rollout_workers_.push_back(index_);
+    }
+    task_.rollout_workers_condition_.notify_one();
+  }
+
+  RolloutWorker& worker()
+  {
+    return task_.rollout_workers_[index_];
+  }
+
+private:
+  StompOptimizationTask& task_;
+  int index_;
+};
+
 StompOptimizationTask::StompOptimizationTask(
     moveit::core::RobotModelConstPtr robot_model_ptr,
     std::string group_name,
     const XmlRpc::XmlRpcValue& config):
         robot_model_ptr_(robot_model_ptr),
-        group_name_(group_name)
+        group_name_(group_name),
+        rollout_workers_cloneable_(true),
+        cost_function_threads_(1),
+        gate_saturation_cost_(std::numeric_limits<double>::infinity()),
+        gate_index_(-1),
+        reference_available_(false)
 {
   // initializing plugin loaders
   cost_function_loader_.reset(new CostFunctionLoader("stomp_moveit", "stomp_moveit::cost_functions::StompCostFunction"));
@@ -238,6 +311,194 @@ StompOptimizationTask::StompOptimizationTask(
   {
     ROS_WARN("StompOptimizationTask/%s failed to load '%s' plugins from yaml",group_name.c_str(),UPDATE_FILTERS_FIELD.c_str());
   }
+
+  addPluginTimers();
+
+  parseCostFunctionOptions(config);
+  setupCostFunctionEvaluation();
+}
+
+StompOptimizationTask::StompOptimizationTask(
+    moveit::core::RobotModelConstPtr robot_model_ptr,
+    std::string group_name):
+        robot_model_ptr_(robot_model_ptr),
+        group_name_(group_name),
+        rollout_workers_cloneable_(true),
+        cost_function_threads_(1),
+        gate_saturation_cost_(std::numeric_limits<double>::infinity()),
+        gate_index_(-1),
+        reference_available_(false)
+{
+
+}
+
+std::shared_ptr<StompOptimizationTask> StompOptimizationTask::clone() const
+{
+  std::shared_ptr<StompOptimizationTask> task(new StompOptimizationTask(robot_model_ptr_,group_name_));
+
+  // sharing the loaders keeps the plugin libraries loaded
+  task->cost_function_loader_ = cost_function_loader_;
+  task->noise_generator_loader_ = noise_generator_loader_;
+  task->noisy_filter_loader_ = noisy_filter_loader_;
+  task->update_filter_loader_ = update_filter_loader_;
+
+  if(!clonePlugins(cost_functions_,task->cost_functions_) ||
+      !clonePlugins(noise_generators_,task->noise_generators_) ||
+      !clonePlugins(noisy_filters_,task->noisy_filters_) ||
+      !clonePlugins(update_filters_,task->update_filters_))
+  {
+    ROS_DEBUG("StompOptimizationTask/%s has plugins that can not be cloned",group_name_.c_str());
+    return std::shared_ptr<StompOptimizationTask>();
+  }
+
+  task->planning_scene_ptr_ = planning_scene_ptr_;
+  task->plan_request_ = plan_request_;
+  task->addPluginTimers();
+
+  task->cost_function_threads_ = cost_function_threads_;
+  task->gate_cost_function_ = gate_cost_function_;
+  task->gate_saturation_cost_ = gate_saturation_cost_;
+  task->setupCostFunctionEvaluation();
+  return task;
+}
+
+void StompOptimizationTask::addPluginTimers()
+{
+  // one timer per plugin
+  for(auto& p : cost_functions_)
+  {
+    cost_function_timers_.push_back(profiler_.addCounter("CostFunction/" + p->getName()));
+  }
+
+  noise_generator_timer_ = profiler_.addCounter("NoiseGenerator/" + noise_generators_.back()->getName());
+
+  for(auto& p : noisy_filters_)
+  {
+    noisy_filter_timers_.push_back(profiler_.addCounter("NoisyFilter/" + p->getName()));
+  }
+
+  for(auto& p : update_filters_)
+  {
+    update_filter_timers_.push_back(profiler_.addCounter("UpdateFilter/" + p->getName()));
+  }
+}
+
+void StompOptimizationTask::parseCostFunctionOptions(XmlRpc::XmlRpcValue config)
+{
+  if(config.hasMember(COST_FUNCTION_THREADS_FIELD) &&
+      (config[COST_FUNCTION_THREADS_FIELD].getType() == XmlRpc::XmlRpcValue::TypeInt))
+  {
+    cost_function_threads_ = static_cast<int>(config[COST_FUNCTION_THREADS_FIELD]);
+  }
+
+  if(config.hasMember(GATE_COST_FUNCTION_FIELD) &&
+      (config[GATE_COST_FUNCTION_FIELD].getType() == XmlRpc::XmlRpcValue::TypeString))
+  {
+    gate_cost_function_ = static_cast<std::string>(config[GATE_COST_FUNCTION_FIELD]);
+  }
+
+  if(config.hasMember(GATE_SATURATION_COST_FIELD))
+  {
+    XmlRpc::XmlRpcValue& value = config[GATE_SATURATION_COST_FIELD];
+    if(value.getType() == XmlRpc::XmlRpcValue::TypeDouble)
+    {
+      gate_saturation_cost_ = static_cast<double>(value);
+    }
+    else if(value.getType() == XmlRpc::XmlRpcValue::TypeInt)
+    {
+      gate_saturation_cost_ = static_cast<int>(value);
+    }
+  }
+}
+
+void StompOptimizationTask::setupCostFunctionEvaluation()
+{
+  // the gate can be named with or without the planning group suffix, e.g. "CollisionCheck" or "CollisionCheck/arm"
+  gate_index_ = -1;
+  if(!gate_cost_function_.empty())
+  {
+    for(auto i = 0u; i < cost_functions_.size(); i++)
+    {
+      std::string name = cost_functions_[i]->getName();
+      if(name == gate_cost_function_ || name.compare(0,gate_cost_function_.size() + 1,gate_cost_function_ + "/") == 0)
+      {
+        gate_index_ = i;
+        break;
+      }
+    }
+
+    if(gate_index_ < 0)
+    {
+      ROS_WARN("StompOptimizationTask/%s the gate cost function '%s' is not loaded, ignoring it",group_name_.c_str(),
+               gate_cost_function_.c_str());
+    }
+    else if(!std::isfinite(gate_saturation_cost_))
+    {
+      ROS_WARN("StompOptimizationTask/%s the gate cost function '%s' requires a '%s' entry, ignoring it",
+               group_name_.c_str(),gate_cost_function_.c_str(),GATE_SATURATION_COST_FIELD.c_str());
+      gate_index_ = -1;
+    }
+  }
+
+  // the gate is always evaluated on its own so it does not count towards the concurrent cost functions
+  int num_concurrent = cost_functions_.size() - (gate_index_ < 0 ? 0 : 1);
+  cost_function_pool_.reset();
+  if(cost_function_threads_ > 1 && num_concurrent > 1)
+  {
+    cost_function_pool_ = std::make_shared<stomp_core::ThreadPool>(std::min(cost_function_threads_,num_concurrent));
+    if(supportsBatchedCosts())
+    {
+      ROS_WARN("StompOptimizationTask/%s evaluates the noisy rollouts in batches, '%s' only applies to the optimized "
+               "parameters",group_name_.c_str(),COST_FUNCTION_THREADS_FIELD.c_str());
+    }
+  }
+
+  // the first rollout worker uses the loaded plugins, the copies are made once a request asks for more threads
+  rollout_workers_.resize(1);
+  RolloutWorker& worker = rollout_workers_.front();
+  worker.cost_functions = cost_functions_;
+  worker.noise_generators = noise_generators_;
+  worker.noisy_filters = noisy_filters_;
+  worker.plugin_costs.resize(cost_functions_.size());
+  worker.plugin_validity.resize(cost_functions_.size());
+  worker.plugin_computed.resize(cost_functions_.size());
+  idle_rollout_workers_.assign(1,0);
+}
+
+void StompOptimizationTask::createRolloutWorkers(int num_threads)
+{
+  while(rollout_workers_cloneable_ && static_cast<int>(rollout_workers_.size()) < num_threads)
+  {
+    RolloutWorker worker;
+    if(!clonePlugins(cost_functions_,worker.cost_functions) ||
+        !clonePlugins(noise_generators_,worker.noise_generators) ||
+        !clonePlugins(noisy_filters_,worker.noisy_filters,
+                      [](const noisy_filters::StompNoisyFilterPtr& p){ return p->cloneForRollouts(); }))
+    {
+      ROS_WARN("StompOptimizationTask/%s has plugins that can not be cloned, the noisy rollouts will be processed serially",
+               group_name_.c_str());
+      rollout_workers_cloneable_ = false;
+      rollout_workers_.resize(1);
+      break;
+    }
+
+    worker.plugin_costs.resize(cost_functions_.size());
+    worker.plugin_validity.resize(cost_functions_.size());
+    worker.plugin_computed.resize(cost_functions_.size());
+    rollout_workers_.push_back(worker);
+  }
+
+  // the first worker is handed out first so a serial solve always uses the loaded plugins
+  idle_rollout_workers_.clear();
+  for(int w = rollout_workers_.size() - 1; w >= 0; w--)
+  {
+    idle_rollout_workers_.push_back(w);
+  }
+}
+
+bool StompOptimizationTask::supportsConcurrentRollouts() const
+{
+  return rollout_workers_.size() > 1;
 }
 
 StompOptimizationTask::~StompOptimizationTask()
@@ -253,8 +514,75 @@ bool StompOptimizationTask::generateNoisyParameters(const Eigen::MatrixXd& param
                                      Eigen::MatrixXd& parameters_noise,
                                      Eigen::MatrixXd& noise)
 {
-  return noise_generators_.back()->generateNoise(parameters,start_timestep,num_timesteps,iteration_number,rollout_number,
-                                                 parameters_noise,noise);
+  RolloutWorkerLease lease(*this);
+  stomp_core::Profiler::ScopedTimer timer(profiler_,noise_generator_timer_);
+  return lease.worker().noise_generators.back()->generateNoise(parameters,start_timestep,num_timesteps,
+                                                               iteration_number,rollout_number,parameters_noise,noise);
+}
+
+void StompOptimizationTask::setNoiseScale(double scale)
+{
+  for(auto& w : rollout_workers_)
+  {
+    for(auto& p: w.noise_generators)
+    {
+      p->setNoiseScale(scale);
+    }
+  }
+}
+
+void StompOptimizationTask::setRandomSeed(std::uint64_t seed)
+{
+  for(auto& w : rollout_workers_)
+  {
+    for(auto& p: w.noise_generators)
+    {
+      p->setRandomSeed(seed);
+    }
+  }
+}
+
+void StompOptimizationTask::setNoiseCovariance(const Eigen::MatrixXd& covariance)
+{
+  for(auto& w : rollout_workers_)
+  {
+    for(auto& p: w.noise_generators)
+    {
+      p->setNoiseCovariance(covariance);
+    }
+  }
+}
+
+bool StompOptimizationTask::computeNoiseLogDensity(const Eigen::MatrixXd& noise,double& log_density) const
+{
+  return noise_generators_.back()->computeNoiseLogDensity(noise,log_density);
+}
+
+bool StompOptimizationTask::supportsMultiResolution() const
+{
+  return true;
+}
+
+bool StompOptimizationTask::setResolution(const stomp_core::StompConfiguration& config)
+{
+  if(!planning_scene_ptr_)
+  {
+    ROS_ERROR("The resolution can not be changed before a motion plan request is set");
+    return false;
+  }
+
+  moveit_msgs::MoveItErrorCodes error_code;
+  return setMotionPlanRequest(planning_scene_ptr_,plan_request_,config,error_code);
+}
+
+void StompOptimizationTask::resetProfile()
+{
+  profiler_.reset();
+}
+
+void StompOptimizationTask::getProfile(stomp_core::ProfileReport& report) const
+{
+  profiler_.getReport(report);
 }
 
 bool StompOptimizationTask::computeNoisyCosts(const Eigen::MatrixXd& parameters,
@@ -265,84 +593,393 @@ bool StompOptimizationTask::computeNoisyCosts(const Eigen::MatrixXd& parameters,
                                          Eigen::VectorXd& costs,
                                          bool& validity)
 {
-  Eigen::MatrixXd cost_matrix = Eigen::MatrixXd::Zero(num_timesteps,cost_functions_.size());
-  Eigen::VectorXd state_costs = Eigen::VectorXd::Zero(num_timesteps);
-  validity = true;
-  for(auto i = 0u; i < cost_functions_.size(); i++ )
+  RolloutWorkerLease lease(*this);
+  return computePluginCosts(lease.worker(),parameters,start_timestep,num_timesteps,iteration_number,rollout_number,
+                            false,nullptr,costs,validity);
+}
+
+bool StompOptimizationTask::computeChangedNoisyCosts(const Eigen::MatrixXd& parameters,
+                                                     std::size_t start_timestep,
+                                                     std::size_t num_timesteps,
+                                                     int iteration_number,
+                                                     int rollout_number,
+                                                     const stomp_core::TimestepMask& changed_timesteps,
+                                                     Eigen::VectorXd& costs,
+                                                     bool& validity)
+{
+  RolloutWorkerLease lease(*this);
+  RolloutWorker& worker = lease.worker();
+  const stomp_core::TimestepMask* mask = nullptr;
+  if(updateChangedTimesteps(parameters,worker.changed_timesteps))
   {
-    bool valid;
-    auto cf = cost_functions_[i];
+    mask = &worker.changed_timesteps;
+  }
+
+  return computePluginCosts(worker,parameters,start_timestep,num_timesteps,iteration_number,rollout_number,false,
+                            mask,costs,validity);
+}
 
-    if(!cf->computeCosts(parameters,start_timestep,num_timesteps,iteration_number,rollout_number,state_costs,valid))
+bool StompOptimizationTask::computeCosts(const Eigen::MatrixXd& parameters,
+                                         std::size_t start_timestep,
+                                         std::size_t num_timesteps,
+                                         int iteration_number,
+                                         Eigen::VectorXd& costs,
+                                         bool& validity)
+{
+  // the optimized parameters are never evaluated concurrently with the rollouts
+  return computePluginCosts(rollout_workers_.front(),parameters,start_timestep,num_timesteps,iteration_number,-1,true,
+                            nullptr,costs,validity);
+}
+
+bool StompOptimizationTask::computeChangedCosts(const Eigen::MatrixXd& parameters,
+                                                std::size_t start_timestep,
+                                                std::size_t num_timesteps,
+                                                int iteration_number,
+                                                const stomp_core::TimestepMask& changed_timesteps,
+                                                Eigen::VectorXd& costs,
+                                                bool& validity)
+{
+  RolloutWorker& worker = rollout_workers_.front();
+  if(!updateChangedTimesteps(parameters,worker.changed_timesteps))
+  {
+    return computeCosts(parameters,start_timestep,num_timesteps,iteration_number,costs,validity);
+  }
+
+  return computePluginCosts(worker,parameters,start_timestep,num_timesteps,iteration_number,-1,true,
+                            &worker.changed_timesteps,costs,validity);
+}
+
+bool StompOptimizationTask::updateChangedTimesteps(const Eigen::MatrixXd& parameters,
+                                                   stomp_core::TimestepMask& changed_timesteps)
+{
+  /*
+   * The mask passed by Stomp is relative to its optimized parameters, these may have been reverted since the plugins
+   * last evaluated them, so the mask is recomputed against the parameters the cached plugin costs belong to.
+   */
+  if(!reference_available_ || reference_parameters_.rows() != parameters.rows() ||
+      reference_parameters_.cols() != parameters.cols())
+  {
+    return false;
+  }
+
+  changed_timesteps.resize(parameters.cols());
+  stomp_core::computeChangedTimesteps(parameters,reference_parameters_,changed_timesteps);
+  return true;
+}
+
+bool StompOptimizationTask::supportsBatchedCosts() const
+{
+  for(const auto& cf : cost_functions_)
+  {
+    if(cf->supportsBatchedCosts())
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool StompOptimizationTask::computeNoisyCostsBatch(const std::vector<Eigen::MatrixXd>& parameters,
+                                                   std::size_t start_timestep,
+                                                   std::size_t num_timesteps,
+                                                   int iteration_number,
+                                                   const std::vector<stomp_core::TimestepMask>& changed_timesteps,
+                                                   std::vector<Eigen::VectorXd>& costs,
+                                                   std::vector<bool>& validity)
+{
+  // the buffers keep their size between calls so no memory is allocated here
+  std::size_t num_rollouts = parameters.size();
+  batch_changed_timesteps_.resize(num_rollouts);
+  batch_plugin_costs_.resize(num_rollouts);
+  batch_plugin_validity_.resize(num_rollouts);
+
+  // without cached plugin costs every timestep is flagged and the validity is unknown
+  bool reference_available = true;
+  for(auto r = 0u; r < num_rollouts; r++)
+  {
+    costs[r].setZero(num_timesteps);
+    validity[r] = true;
+    if(!updateChangedTimesteps(parameters[r],batch_changed_timesteps_[r]))
+    {
+      reference_available = false;
+    }
+  }
+
+  if(!reference_available)
+  {
+    for(auto& mask : batch_changed_timesteps_)
+    {
+      mask.setConstant(num_timesteps,true);
+    }
+  }
+
+  auto compute_batch = [&](std::size_t i,std::vector<Eigen::VectorXd>& plugin_costs,
+                           std::vector<bool>& plugin_validity)
+  {
+    for(auto r = 0u; r < num_rollouts; r++)
+    {
+      if(reference_available)
+      {
+        plugin_costs[r] = reference_costs_.col(i);
+        plugin_validity[r] = reference_validity_(i);
+      }
+      else
+      {
+        plugin_costs[r].setZero(num_timesteps);
+        plugin_validity[r] = false;
+      }
+    }
+
+    stomp_core::Profiler::ScopedTimer timer(profiler_,cost_function_timers_[i]);
+    return cost_functions_[i]->computeCostsBatch(parameters,start_timestep,num_timesteps,iteration_number,
+                                                 batch_changed_timesteps_,plugin_costs,plugin_validity);
+  };
+
+  // the other cost functions see no changed timesteps in the rollouts closed by the gate so they can skip them
+  batch_gate_closed_.assign(num_rollouts,false);
+  if(gate_index_ >= 0)
+  {
+    batch_gate_costs_.resize(num_rollouts);
+    batch_gate_validity_.resize(num_rollouts);
+    if(!compute_batch(gate_index_,batch_gate_costs_,batch_gate_validity_))
     {
       return false;
     }
 
-    validity &= valid;
+    for(auto r = 0u; r < num_rollouts; r++)
+    {
+      if(!batch_gate_validity_[r] && batch_gate_costs_[r].maxCoeff() >= gate_saturation_cost_)
+      {
+        batch_gate_closed_[r] = true;
+        batch_changed_timesteps_[r].setConstant(false);
+      }
+    }
+  }
 
-    cost_matrix.col(i) = state_costs * cf->getWeight();
+  for(auto i = 0u; i < cost_functions_.size(); i++ )
+  {
+    bool gate = static_cast<int>(i) == gate_index_;
+    if(!gate && !compute_batch(i,batch_plugin_costs_,batch_plugin_validity_))
+    {
+      return false;
+    }
+
+    std::vector<Eigen::VectorXd>& plugin_costs = gate ? batch_gate_costs_ : batch_plugin_costs_;
+    std::vector<bool>& plugin_validity = gate ? batch_gate_validity_ : batch_plugin_validity_;
+    for(auto r = 0u; r < num_rollouts; r++)
+    {
+      if(!gate && batch_gate_closed_[r])
+      {
+        plugin_costs[r].setConstant(num_timesteps,gate_saturation_cost_);
+        plugin_validity[r] = false;
+      }
+
+      costs[r] += plugin_costs[r] * cost_functions_[i]->getWeight();
+      validity[r] = validity[r] && plugin_validity[r];
+    }
   }
-  costs = cost_matrix.rowwise().sum();
+
   return true;
 }
 
-bool StompOptimizationTask::computeCosts(const Eigen::MatrixXd& parameters,
-                                         std::size_t start_timestep,
-                                         std::size_t num_timesteps,
-                                         int iteration_number,
-                                         Eigen::VectorXd& costs,
-                                         bool& validity)
+bool StompOptimizationTask::computePluginCosts(RolloutWorker& worker,
+                                               const Eigen::MatrixXd& parameters,
+                                               std::size_t start_timestep,
+                                               std::size_t num_timesteps,
+                                               int iteration_number,
+                                               int rollout_number,
+                                               bool optimized,
+                                               const stomp_core::TimestepMask* changed_timesteps,
+                                               Eigen::VectorXd& costs,
+                                               bool& validity)
 {
-  Eigen::MatrixXd cost_matrix = Eigen::MatrixXd::Zero(num_timesteps,cost_functions_.size());
-  Eigen::VectorXd state_costs = Eigen::VectorXd::Zero(num_timesteps);
+  // the buffers keep their size between calls so no memory is allocated here
+  std::size_t num_cost_functions = cost_functions_.size();
+  costs.setZero(num_timesteps);
   validity = true;
-  for(auto i = 0u; i < cost_functions_.size(); i++ )
+  worker.plugin_computed.setConstant(false);
+  if(optimized && (static_cast<std::size_t>(reference_costs_.rows()) != num_timesteps ||
+      static_cast<std::size_t>(reference_costs_.cols()) != num_cost_functions))
+  {
+    reference_costs_.resize(num_timesteps,num_cost_functions);
+    reference_validity_.resize(num_cost_functions);
+  }
+
+  /*
+   * A noisy rollout that the gate finds invalid with a saturated cost skips the remaining cost functions, the
+   * optimized parameters are always fully evaluated since their costs are cached per cost function.
+   */
+  bool gate_closed = false;
+  if(gate_index_ >= 0)
   {
-    bool valid;
-    auto cf = cost_functions_[i];
+    computeCostFunction(worker,gate_index_,parameters,start_timestep,num_timesteps,iteration_number,rollout_number,
+                        optimized,changed_timesteps);
+    gate_closed = !optimized && worker.plugin_computed(gate_index_) && !worker.plugin_validity(gate_index_) &&
+        worker.plugin_costs[gate_index_].maxCoeff() >= gate_saturation_cost_;
+  }
 
-    if(!cf->computeCosts(parameters,start_timestep,num_timesteps,iteration_number,cf->getOptimizedIndex(),state_costs,valid))
+  if(gate_closed)
+  {
+    // the skipped cost functions are charged the saturated cost at every timestep so the rollout is not favored
+    for(auto i = 0u; i < num_cost_functions; i++)
     {
+      if(static_cast<int>(i) == gate_index_)
+      {
+        continue;
+      }
+
+      worker.plugin_costs[i].setConstant(num_timesteps,gate_saturation_cost_);
+      worker.plugin_validity(i) = false;
+      worker.plugin_computed(i) = true;
+    }
+  }
+  else if(cost_function_pool_ && &worker == &rollout_workers_.front())
+  {
+    auto run_cost_function = [&](int i)
+    {
+      if(i != gate_index_)
+      {
+        computeCostFunction(worker,i,parameters,start_timestep,num_timesteps,iteration_number,rollout_number,
+                            optimized,changed_timesteps);
+      }
+    };
+
+    // capturing a single reference keeps the job within the small buffer of std::function so it is not heap allocated
+    cost_function_pool_->parallelFor(num_cost_functions,[&run_cost_function](int i, int thread)
+    {
+      run_cost_function(i);
+    });
+  }
+  else
+  {
+    for(auto i = 0u; i < num_cost_functions; i++)
+    {
+      if(static_cast<int>(i) == gate_index_)
+      {
+        continue;
+      }
+
+      computeCostFunction(worker,i,parameters,start_timestep,num_timesteps,iteration_number,rollout_number,
+                          optimized,changed_timesteps);
+      if(!worker.plugin_computed(i))
+      {
+        break;
+      }
+    }
+  }
+
+  // combining in the order the plugins were loaded so the result does not depend on the number of threads
+  for(auto i = 0u; i < num_cost_functions; i++)
+  {
+    if(!worker.plugin_computed(i))
+    {
+      if(optimized)
+      {
+        reference_available_ = false;
+      }
       return false;
     }
 
-    validity &= valid;
+    if(optimized)
+    {
+      reference_costs_.col(i) = worker.plugin_costs[i];
+      reference_validity_(i) = worker.plugin_validity(i);
+    }
+
+    validity &= worker.plugin_validity(i);
 
-    cost_matrix.col(i) = state_costs * cf->getWeight();
+    costs += worker.plugin_costs[i] * worker.cost_functions[i]->getWeight();
+  }
+
+  if(optimized)
+  {
+    reference_parameters_ = parameters;
+    reference_available_ = true;
   }
-  costs = cost_matrix.rowwise().sum();
+
   return true;
 }
 
+void StompOptimizationTask::computeCostFunction(RolloutWorker& worker,
+                                                std::size_t i,
+                                                const Eigen::MatrixXd& parameters,
+                                                std::size_t start_timestep,
+                                                std::size_t num_timesteps,
+                                                int iteration_number,
+                                                int rollout_number,
+                                                bool optimized,
+                                                const stomp_core::TimestepMask* changed_timesteps)
+{
+  auto& cf = worker.cost_functions[i];
+  int index = optimized ? cf->getOptimizedIndex() : rollout_number;
+  stomp_core::Profiler::ScopedTimer timer(profiler_,cost_function_timers_[i]);
+
+  if(changed_timesteps)
+  {
+    // starting from this plugin's results for the last optimized parameters
+    worker.plugin_costs[i] = reference_costs_.col(i);
+    worker.plugin_validity(i) = reference_validity_(i);
+    worker.plugin_computed(i) = cf->computeChangedCosts(parameters,start_timestep,num_timesteps,iteration_number,index,
+                                                        *changed_timesteps,worker.plugin_costs[i],
+                                                        worker.plugin_validity(i));
+  }
+  else
+  {
+    worker.plugin_costs[i].setZero(num_timesteps);
+    worker.plugin_computed(i) = cf->computeCosts(parameters,start_timestep,num_timesteps,iteration_number,index,
+                                                 worker.plugin_costs[i],worker.plugin_validity(i));
+  }
+}
+
 bool StompOptimizationTask::setMotionPlanRequest(const planning_scene::PlanningSceneConstPtr& planning_scene,
                                         const moveit_msgs::MotionPlanRequest &req,
                                         const stomp_core::StompConfiguration &config,
                                         moveit_msgs::MoveItErrorCodes& error_code)
 {
-  for(auto p: noise_generators_)
+  // kept for setting up the plugins again at a different resolution
+  planning_scene_ptr_ = planning_scene;
+  plan_request_ = req;
+
+  // one rollout worker per thread, the copies are set up below along with the loaded plugins
+  createRolloutWorkers(config.num_threads);
+
+  for(auto& w : rollout_workers_)
   {
-    if(!p->setMotionPlanRequest(planning_scene,req,config,error_code))
+    for(auto p: w.noise_generators)
     {
-      ROS_ERROR("Failed to set Plan Request on noise generator %s",p->getName().c_str());
-      return false;
+      if(!p->setMotionPlanRequest(planning_scene,req,config,error_code))
+      {
+        ROS_ERROR("Failed to set Plan Request on noise generator %s",p->getName().c_str());
+        return false;
+      }
     }
   }
 
-  for(auto p : cost_functions_)
+  // the cached plugin costs belong to the previous request
+  reference_available_ = false;
+
+  for(auto& w : rollout_workers_)
   {
-    if(!p->setMotionPlanRequest(planning_scene,req,config,error_code))
+    for(auto p : w.cost_functions)
     {
-      ROS_ERROR("Failed to set Plan Request on cost function %s",p->getName().c_str());
-      return false;
+      if(!p->setMotionPlanRequest(planning_scene,req,config,error_code))
+      {
+        ROS_ERROR("Failed to set Plan Request on cost function %s",p->getName().c_str());
+        return false;
+      }
     }
   }
 
-  for(auto p: noisy_filters_)
+  for(auto& w : rollout_workers_)
   {
-    if(!p->setMotionPlanRequest(planning_scene,req,config,error_code))
+    for(auto p: w.noisy_filters)
     {
-      ROS_ERROR("Failed to set Plan Request on noisy filter %s",p->getName().c_str());
-      return false;
+      if(!p->setMotionPlanRequest(planning_scene,req,config,error_code))
+      {
+        ROS_ERROR("Failed to set Plan Request on noisy filter %s",p->getName().c_str());
+        return false;
+      }
     }
   }
 
@@ -358,16 +995,35 @@ bool StompOptimizationTask::setMotionPlanRequest(const planning_scene::PlanningS
   return true;
 }
 
+void StompOptimizationTask::releaseMotionPlanRequest()
+{
+  planning_scene_ptr_.reset();
+  plan_request_ = moveit_msgs::MotionPlanRequest();
+  reference_available_ = false;
+
+  for(auto& w : rollout_workers_)
+  {
+    for(auto p : w.cost_functions)
+    {
+      p->releaseMotionPlanRequest();
+    }
+  }
+}
+
 bool StompOptimizationTask::filterNoisyParameters(std::size_t start_timestep,
                                                   std::size_t num_timesteps,
                                                   int iteration_number,
                                                   int rollout_number,
                                                   Eigen::MatrixXd& parameters,bool& filtered)
 {
+  RolloutWorkerLease lease(*this);
+  auto& filters = lease.worker().noisy_filters;
   filtered = false;
   bool temp;
-  for(auto& f: noisy_filters_)
+  for(auto i = 0u; i < filters.size(); i++)
   {
+    auto& f = filters[i];
+    stomp_core::Profiler::ScopedTimer timer(profiler_,noisy_filter_timers_[i]);
     if(f->filter(start_timestep,num_timesteps,iteration_number,rollout_number,parameters,temp))
     {
       filtered |= temp;
@@ -388,8 +1044,10 @@ bool StompOptimizationTask::filterParameterUpdates(std::size_t start_timestep,
 {
   bool filtered = false;
   bool temp;
-  for(auto& f: update_filters_)
+  for(auto i = 0u; i < update_filters_.size(); i++)
   {
+    auto& f = update_filters_[i];
+    stomp_core::Profiler::ScopedTimer timer(profiler_,update_filter_timers_[i]);
     if(f->filter(start_timestep,num_timesteps,iteration_number,parameters,updates,temp))
     {
       filtered |= temp;
@@ -405,19 +1063,22 @@ bool StompOptimizationTask::filterParameterUpdates(std::size_t start_timestep,
 void StompOptimizationTask::postIteration(std::size_t start_timestep,
                                 std::size_t num_timesteps,int iteration_number,double cost,const Eigen::MatrixXd& parameters)
 {
-  for(auto p : noise_generators_)
+  for(auto& w : rollout_workers_)
   {
-    p->postIteration(start_timestep,num_timesteps,iteration_number,cost,parameters);
-  }
+    for(auto p : w.noise_generators)
+    {
+      p->postIteration(start_timestep,num_timesteps,iteration_number,cost,parameters);
+    }
 
-  for(auto p : cost_functions_)
-  {
-    p->postIteration(start_timestep,num_timesteps,iteration_number,cost,parameters);
-  }
+    for(auto p : w.cost_functions)
+    {
+      p->postIteration(start_timestep,num_timesteps,iteration_number,cost,parameters);
+    }
 
-  for(auto p: noisy_filters_)
-  {
-    p->postIteration(start_timestep,num_timesteps,iteration_number,cost,parameters);
+    for(auto p: w.noisy_filters)
+    {
+      p->postIteration(start_timestep,num_timesteps,iteration_number,cost,parameters);
+    }
   }
 
   for(auto p: update_filters_)
@@ -428,20 +1089,22 @@ void StompOptimizationTask::postIteration(std::size_t start_timestep,
 
 void StompOptimizationTask::done(bool success,int total_iterations,double final_cost,const Eigen::MatrixXd& parameters)
 {
-  for(auto p : noise_generators_)
+  for(auto& w : rollout_workers_)
   {
-    p->done(success,total_iterations,final_cost,parameters);
-  }
-
+    for(auto p : w.noise_generators)
+    {
+      p->done(success,total_iterations,final_cost,parameters);
+    }
 
-  for(auto p : cost_functions_)
-  {
-    p->done(success,total_iterations,final_cost,parameters);
-  }
+    for(auto p : w.cost_functions)
+    {
+      p->done(success,total_iterations,final_cost,parameters);
+    }
 
-  for(auto p: noisy_filters_)
-  {
-    p->done(success,total_iterations,final_cost,parameters);
+    for(auto p: w.noisy_filters)
+    {
+      p->done(success,total_iterations,final_cost,parameters);
+    }
   }
 
   for(auto p: update_filters_)
@@ -34,7 +34,6 @@
 
 
 static const std::string DESCRIPTION = "STOMP";
-static const double TIMEOUT_INTERVAL = 0.05;
 static int const IK_ATTEMPTS = 10;
 static int const IK_TIMEOUT = 0.05;
 const static double MAX_START_DISTANCE_THRESH = 0.5;
@@ -88,6 +87,69 @@ bool parseConfig(XmlRpc::XmlRpcValue config,const moveit::core::JointModelGroup*
   if (config.hasMember("exponentiated_cost_sensitivity"))
     stomp_config.exponentiated_cost_sensitivity = static_cast<int>(config["exponentiated_cost_sensitivity"]);
 
+  if (config.hasMember("num_threads"))
+    stomp_config.num_threads = static_cast<int>(config["num_threads"]);
+
+  if (config.hasMember("min_rollouts"))
+    stomp_config.min_rollouts = static_cast<int>(config["min_rollouts"]);
+
+  if (config.hasMember("noise_decay"))
+    stomp_config.noise_decay = static_cast<double>(config["noise_decay"]);
+
+  if (config.hasMember("noise_decay_improvement"))
+    stomp_config.noise_decay_improvement = static_cast<double>(config["noise_decay_improvement"]);
+
+  if (config.hasMember("min_noise_scale"))
+    stomp_config.min_noise_scale = static_cast<double>(config["min_noise_scale"]);
+
+  if (config.hasMember("covariance_adaptation_rate"))
+    stomp_config.covariance_adaptation_rate = static_cast<double>(config["covariance_adaptation_rate"]);
+
+  if (config.hasMember("adapt_cross_covariance"))
+    stomp_config.adapt_cross_covariance = static_cast<bool>(config["adapt_cross_covariance"]);
+
+  if (config.hasMember("convergence_window"))
+    stomp_config.convergence_window = static_cast<int>(config["convergence_window"]);
+
+  if (config.hasMember("convergence_cost_tolerance"))
+    stomp_config.convergence_cost_tolerance = static_cast<double>(config["convergence_cost_tolerance"]);
+
+  if (config.hasMember("convergence_update_tolerance"))
+    stomp_config.convergence_update_tolerance = static_cast<double>(config["convergence_update_tolerance"]);
+
+  if (config.hasMember("max_stagnant_iterations"))
+    stomp_config.max_stagnant_iterations = static_cast<int>(config["max_stagnant_iterations"]);
+
+  if (config.hasMember("coarse_timesteps") && config.hasMember("coarse_iterations"))
+  {
+    XmlRpcValue& timesteps = config["coarse_timesteps"];
+    XmlRpcValue& iterations = config["coarse_iterations"];
+    for(int l = 0; l < timesteps.size(); l++)
+    {
+      stomp_config.coarse_timesteps.push_back(static_cast<int>(timesteps[l]));
+    }
+
+    for(int l = 0; l < iterations.size(); l++)
+    {
+      stomp_config.coarse_iterations.push_back(static_cast<int>(iterations[l]));
+    }
+  }
+
+  if (config.hasMember("kernel_precision"))
+    stomp_config.kernel_precision = static_cast<int>(config["kernel_precision"]);
+
+  if (config.hasMember("random_seed"))
+  {
+    // XmlRpc integers are 32 bit signed, so the configurable seeds are the non negative ones below 2^31
+    int random_seed = static_cast<int>(config["random_seed"]);
+    if(random_seed < 0)
+    {
+      ROS_ERROR("The STOMP 'random_seed' parameter %i must not be negative",random_seed);
+      return false;
+    }
+    stomp_config.random_seed = static_cast<std::uint64_t>(random_seed);
+  }
+
   // getting number of joints
   stomp_config.num_dimensions = group->getActiveJointModels().size();
   if(stomp_config.num_dimensions == 0)
@@ -106,6 +168,19 @@ StompPlanner::StompPlanner(const std::string& group,const XmlRpc::XmlRpcValue& c
                            const moveit::core::RobotModelConstPtr& model):
     PlanningContext(DESCRIPTION,group),
     config_(config),
+    terminated_(false),
+    robot_model_(model),
+    ph_(new ros::NodeHandle("~"))
+{
+  setup();
+}
+
+StompPlanner::StompPlanner(const std::string& group,const XmlRpc::XmlRpcValue& config,
+                           const moveit::core::RobotModelConstPtr& model,StompOptimizationTaskPtr task):
+    PlanningContext(DESCRIPTION,group),
+    task_(task),
+    config_(config),
+    terminated_(false),
     robot_model_(model),
     ph_(new ros::NodeHandle("~"))
 {
@@ -116,6 +191,17 @@ StompPlanner::~StompPlanner()
 {
 }
 
+std::shared_ptr<StompPlanner> StompPlanner::clone() const
+{
+  StompOptimizationTaskPtr task = task_->clone();
+  if(!task)
+  {
+    return std::make_shared<StompPlanner>(group_,config_,robot_model_);
+  }
+
+  return std::shared_ptr<StompPlanner>(new StompPlanner(group_,config_,robot_model_,task));
+}
+
 void StompPlanner::setup()
 {
   if(!getPlanningScene())
@@ -129,7 +215,10 @@ void StompPlanner::setup()
     // creating tasks
     XmlRpc::XmlRpcValue task_config;
     task_config = config_["task"];
-    task_.reset(new StompOptimizationTask(robot_model_,group_,task_config));
+    if(!task_)
+    {
+      task_.reset(new StompOptimizationTask(robot_model_,group_,task_config));
+    }
 
     if(!robot_model_->hasJointModelGroup(group_))
     {
@@ -147,6 +236,25 @@ void StompPlanner::setup()
     }
 
     stomp_.reset(new stomp_core::Stomp(stomp_config_,task_));
+
+    // optional profile of each solve, the csv columns depend on the loaded plugins so the header is printed once here
+    XmlRpc::XmlRpcValue& optimization_config = config_["optimization"];
+    if(optimization_config.hasMember("profile_output"))
+    {
+      profile_output_ = static_cast<std::string>(optimization_config["profile_output"]);
+    }
+
+    if(profile_output_ == "csv")
+    {
+      stomp_core::ProfileReport profile;
+      stomp_->getProfile(profile);
+      ROS_INFO("%s profile: %s",getName().c_str(),profile.toCsvHeader().c_str());
+    }
+    else if(!profile_output_.empty() && profile_output_ != "json")
+    {
+      ROS_WARN("%s profile_output '%s' is not supported, use 'csv' or 'json'",getName().c_str(),profile_output_.c_str());
+      profile_output_.clear();
+    }
   }
   catch(XmlRpc::XmlRpcException& e)
   {
@@ -196,20 +304,17 @@ bool StompPlanner::solve(planning_interface::MotionPlanDetailedResponse &res)
   bool use_seed = getSeedParameters(initial_parameters);
 
 
-  // create timeout timer
-  ros::WallDuration allowed_time(request_.allowed_planning_time);
-  ROS_WARN_COND(TIMEOUT_INTERVAL > request_.allowed_planning_time,
-                "%s allowed planning time %f is less than the minimum planning time value of %f",
-                getName().c_str(),request_.allowed_planning_time,TIMEOUT_INTERVAL);
-  ros::Timer timeout_timer = ph_->createTimer(ros::Duration(TIMEOUT_INTERVAL), [&](const ros::TimerEvent& evnt)
+  // stomp stops at the deadline and returns the best valid solution found by then
+  if(request_.allowed_planning_time > 0)
   {
-    if((ros::WallTime::now() - start_time) > allowed_time)
-    {
-      ROS_ERROR("%s exceeded allowed time of %f , terminating",getName().c_str(),allowed_time.toSec());
-      this->terminate();
-    }
-
-  },false);
+    using namespace std::chrono;
+    stomp_->setDeadline(steady_clock::now() +
+                        duration_cast<steady_clock::duration>(duration<double>(request_.allowed_planning_time)));
+  }
+  else
+  {
+    stomp_->clearDeadline();
+  }
 
 
   if (use_seed)
@@ -227,6 +332,7 @@ bool StompPlanner::solve(planning_interface::MotionPlanDetailedResponse &res)
     }
 
     stomp_->setConfig(config_copy);
+    restoreTermination();
     planning_success = stomp_->solve(initial_parameters, parameters);
   }
   else
@@ -249,11 +355,17 @@ bool StompPlanner::solve(planning_interface::MotionPlanDetailedResponse &res)
     }
 
     stomp_->setConfig(config_copy);
+    restoreTermination();
     planning_success = stomp_->solve(start,goal,parameters);
   }
 
-  // stopping timer
-  timeout_timer.stop();
+  if(!profile_output_.empty())
+  {
+    stomp_core::ProfileReport profile;
+    stomp_->getProfile(profile);
+    std::string line = profile_output_ == "csv" ? profile.toCsv() : profile.toJson();
+    ROS_INFO("%s profile: %s",getName().c_str(),line.c_str());
+  }
 
   // Handle results
   if(planning_success)
@@ -698,6 +810,7 @@ bool StompPlanner::canServiceRequest(const moveit_msgs::MotionPlanRequest &req)
 
 bool StompPlanner::terminate()
 {
+  terminated_ = true;
   if(stomp_)
   {
     if(!stomp_->cancel())
@@ -711,9 +824,27 @@ bool StompPlanner::terminate()
 
 void StompPlanner::clear()
 {
+  terminated_ = false;
   stomp_->clear();
 }
 
+void StompPlanner::releaseMotionPlanRequest()
+{
+  clear();
+  setPlanningScene(planning_scene::PlanningSceneConstPtr());
+  setMotionPlanRequest(planning_interface::MotionPlanRequest());
+  task_->releaseMotionPlanRequest();
+}
+
+void StompPlanner::restoreTermination()
+{
+  // Stomp::setConfig() re-enables the optimization, this cancels it again when terminate() was called before solving started
+  if(terminated_)
+  {
+    stomp_->cancel();
+  }
+}
+
 bool StompPlanner::getConfigData(ros::NodeHandle &nh, std::map<std::string, XmlRpc::XmlRpcValue> &config, std::string param)
 {
   // Create a stomp planner for each group
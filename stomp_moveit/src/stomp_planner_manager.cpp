@@ -26,6 +26,8 @@
 #include <class_loader/class_loader.h>
 #include <stomp_moveit/stomp_planner_manager.h>
 #include <stomp_moveit/stomp_planner.h>
+#include <algorithm>
+#include <thread>
 
 namespace stomp_moveit
 {
@@ -51,6 +53,14 @@ bool StompPlannerManager::initialize(const robot_model::RobotModelConstPtr &mode
 
   robot_model_ = model;
 
+  int max_idle = std::max<int>(std::thread::hardware_concurrency(),1);
+  nh_.param("max_idle_planning_contexts",max_idle,max_idle);
+  if(max_idle < 0)
+  {
+    ROS_ERROR("The 'max_idle_planning_contexts' parameter %i must not be negative",max_idle);
+    return false;
+  }
+
   // each element under 'stomp' should be a group name
   std::map<std::string, XmlRpc::XmlRpcValue> group_config;
 
@@ -70,6 +80,13 @@ bool StompPlannerManager::initialize(const robot_model::RobotModelConstPtr &mode
 
     std::shared_ptr<StompPlanner> planner(new StompPlanner(v->first, v->second, robot_model_));
     planners_.insert(std::make_pair(v->first, planner));
+
+    // the planning contexts are cloned from this planner on demand
+    PlannerPoolPtr pool(new PlannerPool());
+    pool->group = v->first;
+    pool->prototype = planner;
+    pool->max_idle = static_cast<std::size_t>(max_idle);
+    planner_pools_.insert(std::make_pair(v->first, pool));
   }
 
   if(planners_.empty())
@@ -134,10 +151,15 @@ planning_interface::PlanningContextPtr StompPlannerManager::getPlanningContext(c
     return planning_interface::PlanningContextPtr();
   }
 
-  // Get planner
-  std::shared_ptr<StompPlanner> planner = std::static_pointer_cast<StompPlanner>(planners_.at(req.group_name));
+  if(!planners_.at(req.group_name)->canServiceRequest(req))
+  {
+    error_code.val = moveit_msgs::MoveItErrorCodes::FAILURE;
+    return planning_interface::PlanningContextPtr();
+  }
 
-  if(!planner->canServiceRequest(req))
+  // Get an idle planner
+  std::shared_ptr<StompPlanner> planner = checkoutPlanner(planner_pools_.at(req.group_name));
+  if(!planner)
   {
     error_code.val = moveit_msgs::MoveItErrorCodes::FAILURE;
     return planning_interface::PlanningContextPtr();
@@ -152,6 +174,53 @@ planning_interface::PlanningContextPtr StompPlannerManager::getPlanningContext(c
   return planner;
 }
 
+std::shared_ptr<StompPlanner> StompPlannerManager::checkoutPlanner(const PlannerPoolPtr& pool) const
+{
+  std::shared_ptr<StompPlanner> planner;
+  {
+    std::lock_guard<std::mutex> lock(pool->mutex);
+    if(!pool->idle.empty())
+    {
+      planner = pool->idle.back();
+      pool->idle.pop_back();
+    }
+  }
+
+  if(!planner)
+  {
+    std::lock_guard<std::mutex> lock(creation_mutex_);
+    try
+    {
+      planner = pool->prototype->clone();
+    }
+    catch(std::exception& e)
+    {
+      ROS_ERROR("Failed to create a STOMP planning context for group %s: %s",pool->group.c_str(),e.what());
+      return std::shared_ptr<StompPlanner>();
+    }
+    ROS_DEBUG("Created a new STOMP planning context for group %s",pool->group.c_str());
+  }
+
+  // the handed out pointer owns a reference to the pooled planner and gives it back once released
+  std::weak_ptr<PlannerPool> weak_pool = pool;
+  StompPlanner* raw_planner = planner.get();
+  return std::shared_ptr<StompPlanner>(raw_planner,[weak_pool,planner](StompPlanner*) mutable
+  {
+    // an idle planner keeps neither the planning scene nor the request of its last caller
+    planner->releaseMotionPlanRequest();
+
+    PlannerPoolPtr pool = weak_pool.lock();
+    if(pool)
+    {
+      std::lock_guard<std::mutex> lock(pool->mutex);
+      if(pool->idle.size() < pool->max_idle)
+      {
+        pool->idle.push_back(planner);
+      }
+    }
+    planner.reset();
+  });
+}
 
 } /* namespace stomp_moveit_interface */
 CLASS_LOADER_REGISTER_CLASS(stomp_moveit::StompPlannerManager, planning_interface::PlannerManager)
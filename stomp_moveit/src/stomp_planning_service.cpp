@@ -0,0 +1,355 @@
+/**
+ * @file stomp_planning_service.cpp
+ * @brief This defines an asynchronous front-end that plans queued motion plan requests with STOMP
+ *
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <ros/console.h>
+#include <stomp_moveit/stomp_planning_service.h>
+#include <stomp_moveit/stomp_planner.h>
+#include <algorithm>
+
+namespace stomp_moveit
+{
+
+StompPlanningService::StompPlanningService(int num_workers,int max_batch_size):
+    num_workers_(std::max(num_workers,1)),
+    max_batch_size_(std::max(max_batch_size,1)),
+    next_sequence_(0),
+    stop_(false)
+{
+
+}
+
+StompPlanningService::~StompPlanningService()
+{
+  shutdown();
+}
+
+bool StompPlanningService::initialize(const moveit::core::RobotModelConstPtr& model,
+                                      const std::map<std::string, XmlRpc::XmlRpcValue>& config)
+{
+  if(!threads_.empty())
+  {
+    ROS_ERROR("The STOMP planning service has already been initialized");
+    return false;
+  }
+
+  robot_model_ = model;
+  for(const auto& v : config)
+  {
+    if(!model->hasJointModelGroup(v.first))
+    {
+      ROS_WARN("The robot model does not support the planning group '%s' in the STOMP configuration, skipping STOMP setup for this group",
+                v.first.c_str());
+      continue;
+    }
+
+    try
+    {
+      prototypes_[v.first].reset(new StompPlanner(v.first,v.second,robot_model_));
+    }
+    catch(std::exception& e)
+    {
+      ROS_ERROR("Failed to load the STOMP planner for group %s: %s",v.first.c_str(),e.what());
+    }
+  }
+
+  if(prototypes_.empty())
+  {
+    ROS_ERROR("All planning groups are invalid, the STOMP planning service could not be configured");
+    return false;
+  }
+
+  worker_planners_.resize(num_workers_);
+  active_planners_.resize(num_workers_);
+  for(int w = 0; w < num_workers_; w++)
+  {
+    threads_.emplace_back(&StompPlanningService::workerLoop,this,w);
+  }
+
+  return true;
+}
+
+bool StompPlanningService::setJobCallback(JobCallback callback)
+{
+  if(!threads_.empty())
+  {
+    ROS_ERROR("The job callback of the STOMP planning service can only be set before it is initialized");
+    return false;
+  }
+
+  job_callback_ = callback;
+  return true;
+}
+
+bool StompPlanningService::canServiceRequest(const moveit_msgs::MotionPlanRequest& req) const
+{
+  auto p = prototypes_.find(req.group_name);
+  return p != prototypes_.end() && p->second->canServiceRequest(req);
+}
+
+StompPlanningService::ResponseFuture StompPlanningService::submit(
+    const planning_scene::PlanningSceneConstPtr& planning_scene,
+    const planning_interface::MotionPlanRequest& req,
+    int priority)
+{
+  using namespace std::chrono;
+
+  Clock::time_point deadline = Clock::time_point::max();
+  if(req.allowed_planning_time > 0)
+  {
+    deadline = Clock::now() + duration_cast<Clock::duration>(duration<double>(req.allowed_planning_time));
+  }
+
+  return submit(planning_scene,req,priority,deadline);
+}
+
+StompPlanningService::ResponseFuture StompPlanningService::submit(
+    const planning_scene::PlanningSceneConstPtr& planning_scene,
+    const planning_interface::MotionPlanRequest& req,
+    int priority,
+    Clock::time_point deadline)
+{
+  JobPtr job(new Job());
+  job->planning_scene = planning_scene;
+  job->request = req;
+  job->priority = priority;
+  job->deadline = deadline;
+  ResponseFuture response = job->response.get_future();
+
+  if(!planning_scene)
+  {
+    ROS_ERROR("No planning scene supplied as input");
+    reject(*job,moveit_msgs::MoveItErrorCodes::FAILURE);
+    return response;
+  }
+
+  if(!canServiceRequest(req))
+  {
+    ROS_ERROR("STOMP can not plan the request for group '%s'",req.group_name.c_str());
+    reject(*job,moveit_msgs::MoveItErrorCodes::INVALID_GROUP_NAME);
+    return response;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(stop_ || threads_.empty())
+    {
+      reject(*job,moveit_msgs::MoveItErrorCodes::PREEMPTED);
+      return response;
+    }
+
+    job->sequence = next_sequence_++;
+    jobs_.push(job);
+  }
+  condition_.notify_one();
+
+  return response;
+}
+
+std::size_t StompPlanningService::getNumPending() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return jobs_.size();
+}
+
+int StompPlanningService::getNumWorkers() const
+{
+  return num_workers_;
+}
+
+int StompPlanningService::getMaxBatchSize() const
+{
+  return max_batch_size_;
+}
+
+void StompPlanningService::shutdown()
+{
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stop_ = true;
+    condition_.notify_all();
+
+    // a planner keeps its cancellation until it is cleared for its next request
+    for(auto& p : active_planners_)
+    {
+      if(p)
+      {
+        p->terminate();
+      }
+    }
+
+    auto is_active = [](const std::shared_ptr<StompPlanner>& p){ return static_cast<bool>(p); };
+    condition_.wait(lock,[this,&is_active](){
+      return std::none_of(active_planners_.begin(),active_planners_.end(),is_active);
+    });
+  }
+
+  for(auto& t : threads_)
+  {
+    if(t.joinable())
+    {
+      t.join();
+    }
+  }
+
+  // no worker is left to plan the queued requests
+  std::lock_guard<std::mutex> lock(mutex_);
+  while(!jobs_.empty())
+  {
+    reject(*jobs_.top(),moveit_msgs::MoveItErrorCodes::PREEMPTED);
+    jobs_.pop();
+  }
+}
+
+void StompPlanningService::workerLoop(int worker)
+{
+  std::vector<JobPtr> batch;
+  while(true)
+  {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      condition_.wait(lock,[this](){ return stop_ || !jobs_.empty(); });
+      if(stop_)
+      {
+        return;
+      }
+
+      batch.push_back(jobs_.top());
+      jobs_.pop();
+      while(static_cast<int>(batch.size()) < max_batch_size_ && !jobs_.empty() && canBatch(*batch.front(),*jobs_.top()))
+      {
+        batch.push_back(jobs_.top());
+        jobs_.pop();
+      }
+    }
+
+    // the jobs of a batch left after a shutdown are preempted by runJob()
+    for(auto& job : batch)
+    {
+      runJob(worker,*job);
+    }
+    batch.clear();
+  }
+}
+
+bool StompPlanningService::canBatch(const Job& first,const Job& job)
+{
+  return first.request.group_name == job.request.group_name && first.planning_scene == job.planning_scene;
+}
+
+void StompPlanningService::runJob(int worker,Job& job)
+{
+  using namespace std::chrono;
+
+  if(job_callback_)
+  {
+    job_callback_(job.request);
+  }
+
+  // the planning time left is what STOMP gets
+  if(job.deadline != Clock::time_point::max())
+  {
+    double time_left = duration<double>(job.deadline - Clock::now()).count();
+    if(time_left <= 0.0)
+    {
+      ROS_WARN("The STOMP request for group '%s' reached its deadline while queued",job.request.group_name.c_str());
+      reject(job,moveit_msgs::MoveItErrorCodes::TIMED_OUT);
+      return;
+    }
+    job.request.allowed_planning_time = time_left;
+  }
+
+  std::shared_ptr<StompPlanner> planner = getPlanner(worker,job.request.group_name);
+  if(!planner)
+  {
+    reject(job,moveit_msgs::MoveItErrorCodes::FAILURE);
+    return;
+  }
+
+  // cleared before it is visible to shutdown() so that a termination is not reset
+  planner->clear();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(stop_)
+    {
+      reject(job,moveit_msgs::MoveItErrorCodes::PREEMPTED);
+      return;
+    }
+    active_planners_[worker] = planner;
+  }
+
+  planning_interface::MotionPlanResponse res;
+  try
+  {
+    planner->setPlanningScene(job.planning_scene);
+    planner->setMotionPlanRequest(job.request);
+    planner->solve(res);
+  }
+  catch(std::exception& e)
+  {
+    ROS_ERROR("STOMP failed to plan the request for group '%s': %s",job.request.group_name.c_str(),e.what());
+    res.error_code_.val = moveit_msgs::MoveItErrorCodes::FAILURE;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    active_planners_[worker].reset();
+    if(stop_ && res.error_code_.val != moveit_msgs::MoveItErrorCodes::SUCCESS)
+    {
+      res.error_code_.val = moveit_msgs::MoveItErrorCodes::PREEMPTED;
+    }
+  }
+  condition_.notify_all();
+
+  job.response.set_value(res);
+}
+
+std::shared_ptr<StompPlanner> StompPlanningService::getPlanner(int worker,const std::string& group)
+{
+  // only this worker uses its planners
+  std::shared_ptr<StompPlanner>& planner = worker_planners_[worker][group];
+  if(!planner)
+  {
+    std::lock_guard<std::mutex> lock(creation_mutex_);
+    try
+    {
+      planner = prototypes_.at(group)->clone();
+    }
+    catch(std::exception& e)
+    {
+      ROS_ERROR("Failed to create a STOMP planner for group %s: %s",group.c_str(),e.what());
+      worker_planners_[worker].erase(group);
+      return std::shared_ptr<StompPlanner>();
+    }
+  }
+
+  return planner;
+}
+
+void StompPlanningService::reject(Job& job,int error_code)
+{
+  planning_interface::MotionPlanResponse res;
+  res.error_code_.val = error_code;
+  job.response.set_value(res);
+}
+
+} /* namespace stomp_moveit */
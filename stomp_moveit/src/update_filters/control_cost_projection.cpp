@@ -79,6 +79,13 @@ bool ControlCostProjection::setMotionPlanRequest(const planning_scene::PlanningS
                  moveit_msgs::MoveItErrorCodes& error_code)
 {
 
+  // the projection matrix only depends on the number of timesteps
+  if(num_timesteps_ == config.num_timesteps)
+  {
+    error_code.val = error_code.SUCCESS;
+    return true;
+  }
+
   num_timesteps_ = config.num_timesteps;
   stomp_core::generateSmoothingMatrix(num_timesteps_,DEFAULT_TIME_STEP,projection_matrix_M_);
 
@@ -87,6 +94,7 @@ bool ControlCostProjection::setMotionPlanRequest(const planning_scene::PlanningS
   projection_matrix_M_(0,0) = 1.0;
   projection_matrix_M_.bottomRows(1) = Eigen::VectorXd::Zero(num_timesteps_).transpose();
   projection_matrix_M_(num_timesteps_ -1 ,num_timesteps_ -1 ) = 1;
+  projected_update_.resize(num_timesteps_);
 
   error_code.val = error_code.SUCCESS;
   return true;
@@ -100,7 +108,8 @@ bool ControlCostProjection::filter(std::size_t start_timestep,std::size_t num_ti
 
   for(auto d = 0u; d < updates.rows();d++)
   {
-    updates.row(d).transpose() = projection_matrix_M_ * (updates.row(d).transpose());
+    projected_update_.noalias() = projection_matrix_M_ * (updates.row(d).transpose());
+    updates.row(d) = projected_update_.transpose();
   }
 
   filtered = true;
@@ -108,5 +117,10 @@ bool ControlCostProjection::filter(std::size_t start_timestep,std::size_t num_ti
   return true;
 }
 
+StompUpdateFilterPtr ControlCostProjection::clone() const
+{
+  return StompUpdateFilterPtr(new ControlCostProjection(*this));
+}
+
 } /* namespace update_filters */
 } /* namespace stomp_moveit */
@@ -120,5 +120,10 @@ bool PolynomialSmoother::filter(std::size_t start_timestep,
 }
 
 
+StompUpdateFilterPtr PolynomialSmoother::clone() const
+{
+  return StompUpdateFilterPtr(new PolynomialSmoother(*this));
+}
+
 } /* namespace update_filters */
 } /* namespace stomp_moveit */
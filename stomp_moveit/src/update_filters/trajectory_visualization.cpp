@@ -254,5 +254,18 @@ void TrajectoryVisualization::done(bool success,int total_iterations,double fina
   viz_pub_.publish(tool_traj_marker_);
 }
 
+StompUpdateFilterPtr TrajectoryVisualization::clone() const
+{
+  std::shared_ptr<TrajectoryVisualization> copy(new TrajectoryVisualization(*this));
+
+  // the robot states are modified while planning
+  if(state_)
+  {
+    copy->state_.reset(new moveit::core::RobotState(*state_));
+  }
+
+  return copy;
+}
+
 } /* namespace updated_filters */
 } /* namespace stomp_moveit */
@@ -39,7 +39,9 @@ namespace update_filters
 {
 
 UpdateLogger::UpdateLogger():
-    name_("UpdateLogger")
+    name_("UpdateLogger"),
+    clone_index_(0),
+    num_clones_(std::make_shared<std::atomic<int> >(0))
 {
 
 }
@@ -97,6 +99,13 @@ bool UpdateLogger::setMotionPlanRequest(const planning_scene::PlanningSceneConst
 
   std::string full_dir_name = ros::package::getPath(package_) + "/" + directory_;
   full_file_name_ = full_dir_name + "/" + filename_;
+  if(clone_index_ > 0)
+  {
+    // a copy logs to its own file, "name.ext" becomes "name_<copy number>.ext"
+    path file_path(filename_);
+    full_file_name_ = full_dir_name + "/" + (file_path.parent_path() / (file_path.stem().string() + "_" +
+        std::to_string(clone_index_) + file_path.extension().string())).string();
+  }
   path dir_path(full_dir_name);
 
   if(!boost::filesystem::is_directory(dir_path))
@@ -160,7 +169,21 @@ void UpdateLogger::done(bool success, int total_iterations,double final_cost,con
   // clear
   stream_.str("");
 
-  ROS_INFO("Saved update log file %s, read with 'numpy.loadtxt(\"%s\")'",full_file_name_.c_str(),filename_.c_str());
+  ROS_INFO("Saved update log file %s, read with 'numpy.loadtxt(\"%s\")'",full_file_name_.c_str(),full_file_name_.c_str());
+}
+
+StompUpdateFilterPtr UpdateLogger::clone() const
+{
+  // the streams can not be copied, the log file is opened by setMotionPlanRequest()
+  std::shared_ptr<UpdateLogger> copy(new UpdateLogger());
+  copy->group_name_ = group_name_;
+  copy->filename_ = filename_;
+  copy->clone_index_ = ++(*num_clones_);
+  copy->num_clones_ = num_clones_;
+  copy->package_ = package_;
+  copy->directory_ = directory_;
+  copy->format_ = format_;
+  return copy;
 }
 
 } /* namespace smoothers */
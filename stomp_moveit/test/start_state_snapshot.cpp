@@ -0,0 +1,86 @@
+/**
+ * @file start_state_snapshot.cpp
+ * @brief This contains gtest code for the start state snapshot
+ *
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <gtest/gtest.h>
+#include "stomp_moveit/utils/start_state_snapshot.h"
+
+using namespace stomp_moveit::utils;
+
+/** @brief Creates a start state with two revolute joints and a floating joint */
+moveit_msgs::RobotState createStartState()
+{
+  moveit_msgs::RobotState start_state;
+  start_state.joint_state.name = {"joint_1","joint_2"};
+  start_state.joint_state.position = {0.1,-0.2};
+  start_state.multi_dof_joint_state.joint_names = {"base_joint"};
+  start_state.multi_dof_joint_state.transforms.resize(1);
+  start_state.multi_dof_joint_state.transforms[0].translation.x = 1.0;
+  start_state.multi_dof_joint_state.transforms[0].rotation.w = 1.0;
+  return start_state;
+}
+
+/** @brief This tests that only an identical start state is reported as unchanged */
+TEST(StartStateSnapshot,update)
+{
+  StartStateSnapshot snapshot;
+  moveit_msgs::RobotState start_state = createStartState();
+
+  // nothing to compare against yet
+  EXPECT_FALSE(snapshot.update(start_state));
+  EXPECT_TRUE(snapshot.update(start_state));
+
+  start_state.joint_state.position[1] += 1e-3;
+  EXPECT_FALSE(snapshot.update(start_state));
+  EXPECT_TRUE(snapshot.update(start_state));
+
+  start_state.joint_state.name[0] = "joint_0";
+  EXPECT_FALSE(snapshot.update(start_state));
+  EXPECT_TRUE(snapshot.update(start_state));
+
+  start_state.multi_dof_joint_state.transforms[0].rotation.z = 0.1;
+  EXPECT_FALSE(snapshot.update(start_state));
+  EXPECT_TRUE(snapshot.update(start_state));
+
+  start_state.is_diff = true;
+  EXPECT_FALSE(snapshot.update(start_state));
+  EXPECT_TRUE(snapshot.update(start_state));
+
+  snapshot.clear();
+  EXPECT_FALSE(snapshot.update(start_state));
+  EXPECT_TRUE(snapshot.update(start_state));
+}
+
+/** @brief This tests that a start state with attached objects is never reported as unchanged */
+TEST(StartStateSnapshot,attached_objects)
+{
+  StartStateSnapshot snapshot;
+  moveit_msgs::RobotState start_state = createStartState();
+  start_state.attached_collision_objects.resize(1);
+
+  EXPECT_FALSE(snapshot.update(start_state));
+  EXPECT_FALSE(snapshot.update(start_state));
+
+  start_state.attached_collision_objects.clear();
+  EXPECT_FALSE(snapshot.update(start_state));
+  EXPECT_TRUE(snapshot.update(start_state));
+}
@@ -0,0 +1,578 @@
+/**
+ * @file stomp_optimization_task.cpp
+ * @brief This contains gtest code for the cost function evaluation of the stomp optimization task
+ *
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <Eigen/Dense>
+#include <gtest/gtest.h>
+#include <stomp_core/thread_pool.h>
+#include "stomp_moveit/stomp_optimization_task.h"
+
+using namespace stomp_moveit;
+
+static const std::size_t NUM_DIMENSIONS = 2;
+static const std::size_t NUM_TIMESTEPS = 10;
+static const double SATURATION_COST = 1.0;
+static const double INVALID_COST = 0.5;
+static const double OTHER_COST = 0.25;
+
+/** @brief A cost function whose cost at each timestep is the first joint value, invalid at INVALID_COST or above */
+class JointCost: public cost_functions::StompCostFunction
+{
+public:
+  bool initialize(moveit::core::RobotModelConstPtr robot_model_ptr,
+                  const std::string& group_name,XmlRpc::XmlRpcValue& config) override
+  {
+    return true;
+  }
+
+  bool configure(const XmlRpc::XmlRpcValue& config) override
+  {
+    return true;
+  }
+
+  cost_functions::StompCostFunctionPtr clone() const override
+  {
+    return std::make_shared<JointCost>(*this);
+  }
+
+  bool setMotionPlanRequest(const planning_scene::PlanningSceneConstPtr& planning_scene,
+                   const moveit_msgs::MotionPlanRequest &req,
+                   const stomp_core::StompConfiguration &config,
+                   moveit_msgs::MoveItErrorCodes& error_code) override
+  {
+    return true;
+  }
+
+  bool computeCosts(const Eigen::MatrixXd& parameters,
+                    std::size_t start_timestep,
+                    std::size_t num_timesteps,
+                    int iteration_number,
+                    int rollout_number,
+                    Eigen::VectorXd& costs,
+                    bool& validity) override
+  {
+    costs = parameters.row(0).segment(start_timestep,num_timesteps).transpose();
+    validity = costs.maxCoeff() < INVALID_COST;
+    return true;
+  }
+
+  std::string getName() const override
+  {
+    return "JointCost/manipulator";
+  }
+};
+
+/** @brief A JointCost that keeps the request until it is released, it counts the requests kept by all of its copies */
+class RequestKeepingCost: public JointCost
+{
+public:
+  RequestKeepingCost():
+    kept_(std::make_shared<std::atomic<int> >(0)),
+    keeping_(false)
+  {
+
+  }
+
+  cost_functions::StompCostFunctionPtr clone() const override
+  {
+    auto copy = std::make_shared<RequestKeepingCost>(*this);
+    copy->keeping_ = false;
+    return copy;
+  }
+
+  bool setMotionPlanRequest(const planning_scene::PlanningSceneConstPtr& planning_scene,
+                   const moveit_msgs::MotionPlanRequest &req,
+                   const stomp_core::StompConfiguration &config,
+                   moveit_msgs::MoveItErrorCodes& error_code) override
+  {
+    if(!keeping_)
+    {
+      keeping_ = true;
+      (*kept_)++;
+    }
+    return true;
+  }
+
+  void releaseMotionPlanRequest() override
+  {
+    if(keeping_)
+    {
+      keeping_ = false;
+      (*kept_)--;
+    }
+  }
+
+  std::shared_ptr<std::atomic<int> > kept_;
+  bool keeping_;
+};
+
+/** @brief A cost function with a constant cost that records the rollouts it evaluated */
+class ConstantCost: public cost_functions::StompCostFunction
+{
+public:
+  ConstantCost(bool batched = false,bool cloneable = true):
+    batched_(batched),
+    cloneable_(cloneable)
+  {
+
+  }
+
+  bool initialize(moveit::core::RobotModelConstPtr robot_model_ptr,
+                  const std::string& group_name,XmlRpc::XmlRpcValue& config) override
+  {
+    return true;
+  }
+
+  bool configure(const XmlRpc::XmlRpcValue& config) override
+  {
+    return true;
+  }
+
+  bool setMotionPlanRequest(const planning_scene::PlanningSceneConstPtr& planning_scene,
+                   const moveit_msgs::MotionPlanRequest &req,
+                   const stomp_core::StompConfiguration &config,
+                   moveit_msgs::MoveItErrorCodes& error_code) override
+  {
+    return true;
+  }
+
+  bool computeCosts(const Eigen::MatrixXd& parameters,
+                    std::size_t start_timestep,
+                    std::size_t num_timesteps,
+                    int iteration_number,
+                    int rollout_number,
+                    Eigen::VectorXd& costs,
+                    bool& validity) override
+  {
+    evaluated_.insert(rollout_number);
+    costs.setConstant(num_timesteps,OTHER_COST);
+    validity = true;
+    return true;
+  }
+
+  /** @brief Skips the rollouts without changed timesteps */
+  bool computeChangedCosts(const Eigen::MatrixXd& parameters,
+                           std::size_t start_timestep,
+                           std::size_t num_timesteps,
+                           int iteration_number,
+                           int rollout_number,
+                           const stomp_core::TimestepMask& changed_timesteps,
+                           Eigen::VectorXd& costs,
+                           bool& validity) override
+  {
+    if(!changed_timesteps.any())
+    {
+      return true;
+    }
+
+    return computeCosts(parameters,start_timestep,num_timesteps,iteration_number,rollout_number,costs,validity);
+  }
+
+  bool supportsBatchedCosts() const override
+  {
+    return batched_;
+  }
+
+  std::string getName() const override
+  {
+    return "ConstantCost/manipulator";
+  }
+
+  cost_functions::StompCostFunctionPtr clone() const override
+  {
+    if(!cloneable_)
+    {
+      return cost_functions::StompCostFunctionPtr();
+    }
+
+    auto copy = std::make_shared<ConstantCost>(*this);
+    copy->evaluated_.clear();
+    return copy;
+  }
+
+  bool batched_;
+  bool cloneable_;
+  std::set<int> evaluated_;
+};
+
+/** @brief A noise generator that does not apply any noise */
+class ZeroNoise: public noise_generators::StompNoiseGenerator
+{
+public:
+  bool initialize(moveit::core::RobotModelConstPtr robot_model_ptr,
+                  const std::string& group_name,const XmlRpc::XmlRpcValue& config) override
+  {
+    return true;
+  }
+
+  bool configure(const XmlRpc::XmlRpcValue& config) override
+  {
+    return true;
+  }
+
+  noise_generators::StompNoiseGeneratorPtr clone() const override
+  {
+    return std::make_shared<ZeroNoise>(*this);
+  }
+
+  bool setMotionPlanRequest(const planning_scene::PlanningSceneConstPtr& planning_scene,
+                   const moveit_msgs::MotionPlanRequest &req,
+                   const stomp_core::StompConfiguration &config,
+                   moveit_msgs::MoveItErrorCodes& error_code) override
+  {
+    return true;
+  }
+
+  bool generateNoise(const Eigen::MatrixXd& parameters,
+                     std::size_t start_timestep,
+                     std::size_t num_timesteps,
+                     int iteration_number,
+                     int rollout_number,
+                     Eigen::MatrixXd& parameters_noise,
+                     Eigen::MatrixXd& noise) override
+  {
+    noise.setZero(parameters.rows(),parameters.cols());
+    parameters_noise = parameters;
+    return true;
+  }
+};
+
+/** @brief A noisy filter that records the rollouts it filtered, the copies for concurrent rollouts share the record */
+class RecordingFilter: public noisy_filters::StompNoisyFilter
+{
+public:
+  struct Record
+  {
+    std::mutex mutex;
+    std::set<int> rollouts;
+  };
+
+  RecordingFilter():
+    record_(std::make_shared<Record>())
+  {
+
+  }
+
+  bool initialize(moveit::core::RobotModelConstPtr robot_model_ptr,
+                  const std::string& group_name,const XmlRpc::XmlRpcValue& config) override
+  {
+    return true;
+  }
+
+  bool configure(const XmlRpc::XmlRpcValue& config) override
+  {
+    return true;
+  }
+
+  noisy_filters::StompNoisyFilterPtr clone() const override
+  {
+    return std::make_shared<RecordingFilter>();
+  }
+
+  noisy_filters::StompNoisyFilterPtr cloneForRollouts() const override
+  {
+    return std::make_shared<RecordingFilter>(*this);
+  }
+
+  bool setMotionPlanRequest(const planning_scene::PlanningSceneConstPtr& planning_scene,
+                   const moveit_msgs::MotionPlanRequest &req,
+                   const stomp_core::StompConfiguration &config,
+                   moveit_msgs::MoveItErrorCodes& error_code) override
+  {
+    return true;
+  }
+
+  bool filter(std::size_t start_timestep,
+              std::size_t num_timesteps,
+              int iteration_number,
+              int rollout_number,
+              Eigen::MatrixXd& parameters,
+              bool& filtered) override
+  {
+    std::lock_guard<std::mutex> lock(record_->mutex);
+    record_->rollouts.insert(rollout_number);
+    filtered = false;
+    return true;
+  }
+
+  std::shared_ptr<Record> record_;
+};
+
+/** @brief A task that uses the given cost functions and noisy filters instead of loading the plugins */
+class TestTask: public StompOptimizationTask
+{
+public:
+  TestTask(const std::vector<cost_functions::StompCostFunctionPtr>& cost_functions,XmlRpc::XmlRpcValue config,
+           const std::vector<noisy_filters::StompNoisyFilterPtr>& noisy_filters = {}):
+    StompOptimizationTask(moveit::core::RobotModelConstPtr(),"manipulator")
+  {
+    cost_functions_ = cost_functions;
+    noisy_filters_ = noisy_filters;
+    noise_generators_.push_back(std::make_shared<ZeroNoise>());
+    addPluginTimers();
+    parseCostFunctionOptions(config);
+    setupCostFunctionEvaluation();
+  }
+};
+
+/** @brief Creates the task configuration that uses the JointCost as the gate */
+XmlRpc::XmlRpcValue createGateConfiguration()
+{
+  XmlRpc::XmlRpcValue config;
+  config["gate_cost_function"] = std::string("JointCost");
+  config["gate_saturation_cost"] = SATURATION_COST;
+  return config;
+}
+
+/** @brief This tests that a rollout invalidated by the gate with a saturated cost skips the other cost functions */
+TEST(StompOptimizationTask,gate_closed)
+{
+  auto other = std::make_shared<ConstantCost>();
+  TestTask task({std::make_shared<JointCost>(),other},createGateConfiguration());
+
+  Eigen::MatrixXd parameters = Eigen::MatrixXd::Zero(NUM_DIMENSIONS,NUM_TIMESTEPS);
+  parameters(0,NUM_TIMESTEPS/2) = 2*SATURATION_COST;
+
+  Eigen::VectorXd costs;
+  bool validity;
+  EXPECT_TRUE(task.computeNoisyCosts(parameters,0,NUM_TIMESTEPS,0,3,costs,validity));
+  EXPECT_FALSE(validity);
+  EXPECT_TRUE(other->evaluated_.empty());
+
+  // the skipped cost function is charged the saturated cost, more than it would have computed
+  Eigen::VectorXd expected = parameters.row(0).transpose().array() + SATURATION_COST;
+  EXPECT_TRUE(costs.isApprox(expected));
+}
+
+/** @brief This tests that the other cost functions are evaluated when the gate is not saturated or valid */
+TEST(StompOptimizationTask,gate_open)
+{
+  auto other = std::make_shared<ConstantCost>();
+  TestTask task({std::make_shared<JointCost>(),other},createGateConfiguration());
+
+  Eigen::VectorXd costs;
+  bool validity;
+
+  // invalid below the saturation cost
+  Eigen::MatrixXd parameters = Eigen::MatrixXd::Zero(NUM_DIMENSIONS,NUM_TIMESTEPS);
+  parameters(0,NUM_TIMESTEPS/2) = 0.5*(INVALID_COST + SATURATION_COST);
+  EXPECT_TRUE(task.computeNoisyCosts(parameters,0,NUM_TIMESTEPS,0,1,costs,validity));
+  EXPECT_FALSE(validity);
+  EXPECT_EQ(other->evaluated_.count(1),1u);
+
+  Eigen::VectorXd expected = parameters.row(0).transpose().array() + OTHER_COST;
+  EXPECT_TRUE(costs.isApprox(expected));
+
+  // valid
+  parameters.setZero();
+  EXPECT_TRUE(task.computeNoisyCosts(parameters,0,NUM_TIMESTEPS,0,2,costs,validity));
+  EXPECT_TRUE(validity);
+  EXPECT_EQ(other->evaluated_.count(2),1u);
+  EXPECT_TRUE(costs.isApprox(Eigen::VectorXd::Constant(NUM_TIMESTEPS,OTHER_COST)));
+
+  // the optimized parameters are always fully evaluated
+  parameters(0,NUM_TIMESTEPS/2) = 2*SATURATION_COST;
+  EXPECT_TRUE(task.computeCosts(parameters,0,NUM_TIMESTEPS,0,costs,validity));
+  EXPECT_FALSE(validity);
+  EXPECT_EQ(other->evaluated_.count(-1),1u);
+}
+
+/** @brief This tests that the gate requires a saturation cost */
+TEST(StompOptimizationTask,gate_without_saturation_cost)
+{
+  auto other = std::make_shared<ConstantCost>();
+  XmlRpc::XmlRpcValue config;
+  config["gate_cost_function"] = std::string("JointCost");
+  TestTask task({std::make_shared<JointCost>(),other},config);
+
+  Eigen::MatrixXd parameters = Eigen::MatrixXd::Zero(NUM_DIMENSIONS,NUM_TIMESTEPS);
+  parameters(0,NUM_TIMESTEPS/2) = 2*SATURATION_COST;
+
+  Eigen::VectorXd costs;
+  bool validity;
+  EXPECT_TRUE(task.computeNoisyCosts(parameters,0,NUM_TIMESTEPS,0,0,costs,validity));
+  EXPECT_FALSE(validity);
+  EXPECT_EQ(other->evaluated_.count(0),1u);
+}
+
+/** @brief This tests that the batched evaluation applies the gate to each rollout */
+TEST(StompOptimizationTask,gate_batched)
+{
+  auto other = std::make_shared<ConstantCost>(true);
+  TestTask task({std::make_shared<JointCost>(),other},createGateConfiguration());
+  ASSERT_TRUE(task.supportsBatchedCosts());
+
+  // valid, invalid below the saturation cost and saturated
+  std::vector<double> joint_values = {0.0, 0.5*(INVALID_COST + SATURATION_COST), 2*SATURATION_COST};
+  std::vector<Eigen::MatrixXd> parameters;
+  for(auto v : joint_values)
+  {
+    parameters.push_back(Eigen::MatrixXd::Zero(NUM_DIMENSIONS,NUM_TIMESTEPS));
+    parameters.back()(0,NUM_TIMESTEPS/2) = v;
+  }
+
+  std::vector<stomp_core::TimestepMask> changed_timesteps(parameters.size(),
+                                                          stomp_core::TimestepMask::Constant(NUM_TIMESTEPS,true));
+  std::vector<Eigen::VectorXd> costs(parameters.size());
+  std::vector<bool> validity(parameters.size());
+  EXPECT_TRUE(task.computeNoisyCostsBatch(parameters,0,NUM_TIMESTEPS,0,changed_timesteps,costs,validity));
+
+  EXPECT_EQ(other->evaluated_,std::set<int>({0,1}));
+  EXPECT_EQ(validity,std::vector<bool>({true,false,false}));
+  for(auto r = 0u; r < parameters.size(); r++)
+  {
+    double other_cost = r == 2 ? SATURATION_COST : OTHER_COST;
+    Eigen::VectorXd expected = parameters[r].row(0).transpose().array() + other_cost;
+    EXPECT_TRUE(costs[r].isApprox(expected));
+  }
+}
+
+/** @brief This tests that evaluating the cost functions on a thread pool gives the same costs */
+TEST(StompOptimizationTask,cost_function_threads)
+{
+  XmlRpc::XmlRpcValue config = createGateConfiguration();
+  config["cost_function_threads"] = 2;
+  TestTask task({std::make_shared<JointCost>(),std::make_shared<ConstantCost>(),std::make_shared<ConstantCost>()},
+                config);
+
+  Eigen::MatrixXd parameters = Eigen::MatrixXd::Zero(NUM_DIMENSIONS,NUM_TIMESTEPS);
+  parameters(0,NUM_TIMESTEPS/2) = 0.5*INVALID_COST;
+
+  Eigen::VectorXd costs;
+  bool validity;
+  EXPECT_TRUE(task.computeNoisyCosts(parameters,0,NUM_TIMESTEPS,0,0,costs,validity));
+  EXPECT_TRUE(validity);
+
+  Eigen::VectorXd expected = parameters.row(0).transpose().array() + 2*OTHER_COST;
+  EXPECT_TRUE(costs.isApprox(expected));
+}
+
+/** @brief This tests that the noisy rollouts are evaluated concurrently on copies of the cost functions */
+TEST(StompOptimizationTask,concurrent_rollouts)
+{
+  static const int NUM_ROLLOUTS = 40;
+  auto other = std::make_shared<ConstantCost>();
+  TestTask task({std::make_shared<JointCost>(),other},createGateConfiguration());
+  EXPECT_FALSE(task.supportsConcurrentRollouts());
+
+  stomp_core::StompConfiguration config;
+  config.num_threads = 4;
+  moveit_msgs::MotionPlanRequest req;
+  moveit_msgs::MoveItErrorCodes error_code;
+  ASSERT_TRUE(task.setMotionPlanRequest(planning_scene::PlanningSceneConstPtr(),req,config,error_code));
+  EXPECT_TRUE(task.supportsConcurrentRollouts());
+
+  // rollouts alternate between valid and saturated
+  std::vector<Eigen::MatrixXd> parameters(NUM_ROLLOUTS,Eigen::MatrixXd::Zero(NUM_DIMENSIONS,NUM_TIMESTEPS));
+  std::vector<Eigen::VectorXd> costs(NUM_ROLLOUTS);
+  std::vector<int> validity(NUM_ROLLOUTS);
+  for(int r = 1; r < NUM_ROLLOUTS; r += 2)
+  {
+    parameters[r](0,NUM_TIMESTEPS/2) = 2*SATURATION_COST;
+  }
+
+  stomp_core::ThreadPool pool(config.num_threads);
+  pool.parallelFor(NUM_ROLLOUTS,[&](int r, int worker)
+  {
+    bool valid;
+    EXPECT_TRUE(task.computeNoisyCosts(parameters[r],0,NUM_TIMESTEPS,0,r,costs[r],valid));
+    validity[r] = valid;
+  });
+
+  for(int r = 0; r < NUM_ROLLOUTS; r++)
+  {
+    double other_cost = r % 2 ? SATURATION_COST : OTHER_COST;
+    Eigen::VectorXd expected = parameters[r].row(0).transpose().array() + other_cost;
+    EXPECT_TRUE(costs[r].isApprox(expected));
+    EXPECT_EQ(validity[r],r % 2 == 0);
+  }
+
+  // the loaded cost function never evaluated a rollout skipped by the gate
+  for(int r : other->evaluated_)
+  {
+    EXPECT_EQ(r % 2,0);
+  }
+
+  // a cost function that can not be copied keeps the rollouts serial
+  TestTask serial_task({std::make_shared<JointCost>(),std::make_shared<ConstantCost>(false,false)},
+                       createGateConfiguration());
+  ASSERT_TRUE(serial_task.setMotionPlanRequest(planning_scene::PlanningSceneConstPtr(),req,config,error_code));
+  EXPECT_FALSE(serial_task.supportsConcurrentRollouts());
+}
+
+/** @brief This tests that the noisy filters of the concurrent rollouts are the copies made by cloneForRollouts() */
+TEST(StompOptimizationTask,concurrent_rollout_filters)
+{
+  static const int NUM_ROLLOUTS = 40;
+  auto filter = std::make_shared<RecordingFilter>();
+  TestTask task({std::make_shared<JointCost>()},XmlRpc::XmlRpcValue(),{filter});
+
+  stomp_core::StompConfiguration config;
+  config.num_threads = 4;
+  moveit_msgs::MotionPlanRequest req;
+  moveit_msgs::MoveItErrorCodes error_code;
+  ASSERT_TRUE(task.setMotionPlanRequest(planning_scene::PlanningSceneConstPtr(),req,config,error_code));
+  ASSERT_TRUE(task.supportsConcurrentRollouts());
+
+  std::vector<Eigen::MatrixXd> parameters(NUM_ROLLOUTS,Eigen::MatrixXd::Zero(NUM_DIMENSIONS,NUM_TIMESTEPS));
+  stomp_core::ThreadPool pool(config.num_threads);
+  pool.parallelFor(NUM_ROLLOUTS,[&](int r, int worker)
+  {
+    bool filtered;
+    EXPECT_TRUE(task.filterNoisyParameters(0,NUM_TIMESTEPS,0,r,parameters[r],filtered));
+  });
+
+  // every rollout reached the record of the loaded filter whichever copy filtered it
+  EXPECT_EQ(filter->record_->rollouts.size(),static_cast<std::size_t>(NUM_ROLLOUTS));
+
+  // a cloned task plans on its own and does not share it
+  auto cloned_task = task.clone();
+  ASSERT_TRUE(bool(cloned_task));
+  ASSERT_TRUE(cloned_task->setMotionPlanRequest(planning_scene::PlanningSceneConstPtr(),req,config,error_code));
+  bool filtered;
+  EXPECT_TRUE(cloned_task->filterNoisyParameters(0,NUM_TIMESTEPS,0,NUM_ROLLOUTS,parameters[0],filtered));
+  EXPECT_EQ(filter->record_->rollouts.count(NUM_ROLLOUTS),0u);
+}
+
+/** @brief This tests that releasing the motion plan request reaches the cost functions of every rollout worker */
+TEST(StompOptimizationTask,release_motion_plan_request)
+{
+  auto cost = std::make_shared<RequestKeepingCost>();
+  TestTask task({cost},XmlRpc::XmlRpcValue());
+
+  stomp_core::StompConfiguration config;
+  config.num_threads = 4;
+  moveit_msgs::MotionPlanRequest req;
+  moveit_msgs::MoveItErrorCodes error_code;
+  ASSERT_TRUE(task.setMotionPlanRequest(planning_scene::PlanningSceneConstPtr(),req,config,error_code));
+  EXPECT_EQ(config.num_threads,cost->kept_->load());
+
+  task.releaseMotionPlanRequest();
+  EXPECT_EQ(0,cost->kept_->load());
+
+  // the released task is set up again by the next request
+  ASSERT_TRUE(task.setMotionPlanRequest(planning_scene::PlanningSceneConstPtr(),req,config,error_code));
+  EXPECT_EQ(config.num_threads,cost->kept_->load());
+}
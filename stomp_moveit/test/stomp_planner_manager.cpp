@@ -0,0 +1,237 @@
+/**
+ * @file stomp_planner_manager.cpp
+ * @brief This contains gtest code for the planning context pool of the stomp planner manager
+ *
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <thread>
+#include <gtest/gtest.h>
+#include <ros/ros.h>
+#include <moveit/robot_model_loader/robot_model_loader.h>
+#include <moveit/planning_scene/planning_scene.h>
+#include <moveit/kinematic_constraints/utils.h>
+#include <moveit/robot_state/conversions.h>
+#include "stomp_moveit/stomp_planner_manager.h"
+
+using namespace stomp_moveit;
+
+static const std::string ROBOT_DESCRIPTION_PARAM = "robot_description";
+static const std::string GROUP = "manipulator";
+static const std::vector<double> START_POSITIONS = {0.9795, -0.148, 0.8108, -0.1373, 0.5393, 0.0};
+static const std::vector<double> GOAL_POSITIONS = {2.3218, -0.5686, 0.3255, -1.6473, 0.4412, 0.0};
+static const std::size_t MAX_IDLE = 2;    /**< The 'max_idle_planning_contexts' of stomp_planner_manager.test */
+
+/** @brief Exposes the number of idle planning contexts of a planning group */
+class TestPlannerManager: public StompPlannerManager
+{
+public:
+
+  /**
+   * @brief The number of idle planning contexts
+   * @param group The planning group
+   * @return The number of contexts in the pool of the group
+   */
+  std::size_t getNumIdle(const std::string& group) const
+  {
+    const PlannerPoolPtr& pool = planner_pools_.at(group);
+    std::lock_guard<std::mutex> lock(pool->mutex);
+    return pool->idle.size();
+  }
+};
+
+/** @brief Hands out planning contexts for the test_kr210 robot in an in-process planning scene */
+class StompPlannerManagerTest: public testing::Test
+{
+protected:
+
+  void SetUp() override
+  {
+    loader_.reset(new robot_model_loader::RobotModelLoader(ROBOT_DESCRIPTION_PARAM));
+    robot_model_ = loader_->getModel();
+    ASSERT_TRUE(robot_model_ != nullptr);
+
+    planning_scene_.reset(new planning_scene::PlanningScene(robot_model_));
+
+    manager_.reset(new TestPlannerManager());
+    ASSERT_TRUE(manager_->initialize(robot_model_,"/"));
+  }
+
+  /**
+   * @brief Creates a joint goal request from START_POSITIONS to GOAL_POSITIONS
+   * @return The motion plan request
+   */
+  planning_interface::MotionPlanRequest createRequest() const
+  {
+    const moveit::core::JointModelGroup* joint_group = robot_model_->getJointModelGroup(GROUP);
+    moveit::core::RobotState state(robot_model_);
+    state.setToDefaultValues();
+
+    planning_interface::MotionPlanRequest req;
+    req.group_name = GROUP;
+    req.allowed_planning_time = 0.0;
+
+    state.setJointGroupPositions(joint_group,START_POSITIONS);
+    moveit::core::robotStateToRobotStateMsg(state,req.start_state);
+
+    state.setJointGroupPositions(joint_group,GOAL_POSITIONS);
+    req.goal_constraints.push_back(kinematic_constraints::constructGoalConstraints(state,joint_group));
+
+    return req;
+  }
+
+  /**
+   * @brief Gets a planning context for createRequest()
+   * @return The planning context, null if it failed
+   */
+  planning_interface::PlanningContextPtr getContext() const
+  {
+    moveit_msgs::MoveItErrorCodes error_code;
+    planning_interface::PlanningContextPtr context = manager_->getPlanningContext(planning_scene_,createRequest(),
+                                                                                  error_code);
+    EXPECT_EQ(moveit_msgs::MoveItErrorCodes::SUCCESS,error_code.val);
+    return context;
+  }
+
+  /**
+   * @brief Plans with a planning context
+   * @param context The planning context
+   * @return The error code of the response
+   */
+  static int solve(const planning_interface::PlanningContextPtr& context)
+  {
+    planning_interface::MotionPlanResponse res;
+    context->solve(res);
+    return res.error_code_.val;
+  }
+
+protected:
+
+  robot_model_loader::RobotModelLoaderPtr loader_;
+  moveit::core::RobotModelConstPtr robot_model_;
+  planning_scene::PlanningScenePtr planning_scene_;
+  std::shared_ptr<TestPlannerManager> manager_;
+};
+
+/** @brief This tests that a released context returns to the pool without its planning scene and is handed out again */
+TEST_F(StompPlannerManagerTest, checkout_and_return)
+{
+  using namespace moveit_msgs;
+
+  planning_interface::PlanningContextPtr first = getContext();
+  planning_interface::PlanningContextPtr second = getContext();
+  ASSERT_TRUE(first != nullptr);
+  ASSERT_TRUE(second != nullptr);
+  EXPECT_NE(first.get(),second.get());
+  EXPECT_EQ(0u,manager_->getNumIdle(GROUP));
+  EXPECT_EQ(MoveItErrorCodes::SUCCESS,solve(first));
+
+  planning_interface::PlanningContext* second_context = second.get();
+  first.reset();
+  EXPECT_EQ(1u,manager_->getNumIdle(GROUP));
+  second.reset();
+  EXPECT_EQ(2u,manager_->getNumIdle(GROUP));
+
+  // the idle contexts do not keep the planning scene alive
+  EXPECT_EQ(1,planning_scene_.use_count());
+
+  // the context returned last is handed out first
+  planning_interface::PlanningContextPtr reused = getContext();
+  ASSERT_TRUE(reused != nullptr);
+  EXPECT_EQ(second_context,reused.get());
+  EXPECT_EQ(1u,manager_->getNumIdle(GROUP));
+  EXPECT_EQ(MoveItErrorCodes::SUCCESS,solve(reused));
+}
+
+/** @brief This tests that the pool keeps at most 'max_idle_planning_contexts' idle contexts */
+TEST_F(StompPlannerManagerTest, idle_limit)
+{
+  std::vector<planning_interface::PlanningContextPtr> contexts;
+  for(std::size_t i = 0; i < MAX_IDLE + 2; i++)
+  {
+    contexts.push_back(getContext());
+    ASSERT_TRUE(contexts.back() != nullptr);
+  }
+
+  contexts.clear();
+  EXPECT_EQ(MAX_IDLE,manager_->getNumIdle(GROUP));
+  EXPECT_EQ(1,planning_scene_.use_count());
+}
+
+/** @brief This tests that concurrent requests for the same group get independent contexts that plan in parallel */
+TEST_F(StompPlannerManagerTest, concurrent_checkout)
+{
+  using namespace moveit_msgs;
+
+  const std::size_t num_requests = 4;
+  std::vector<planning_interface::PlanningContextPtr> contexts(num_requests);
+  std::vector<int> error_codes(num_requests,0);
+  std::vector<std::thread> threads;
+  for(std::size_t i = 0; i < num_requests; i++)
+  {
+    threads.emplace_back([&,i](){
+      contexts[i] = getContext();
+      if(contexts[i])
+      {
+        error_codes[i] = solve(contexts[i]);
+      }
+    });
+  }
+
+  for(auto& t : threads)
+  {
+    t.join();
+  }
+
+  for(std::size_t i = 0; i < num_requests; i++)
+  {
+    ASSERT_TRUE(contexts[i] != nullptr);
+    EXPECT_EQ(MoveItErrorCodes::SUCCESS,error_codes[i]);
+    for(std::size_t j = 0; j < i; j++)
+    {
+      EXPECT_NE(contexts[j].get(),contexts[i].get());
+    }
+  }
+
+  contexts.clear();
+  EXPECT_EQ(MAX_IDLE,manager_->getNumIdle(GROUP));
+}
+
+/** @brief This tests that a context can still be used and released after the manager has been destroyed */
+TEST_F(StompPlannerManagerTest, release_after_manager)
+{
+  using namespace moveit_msgs;
+
+  planning_interface::PlanningContextPtr context = getContext();
+  ASSERT_TRUE(context != nullptr);
+
+  manager_.reset();
+  EXPECT_EQ(MoveItErrorCodes::SUCCESS,solve(context));
+
+  context.reset();
+  EXPECT_EQ(1,planning_scene_.use_count());
+}
+
+/** @brief This executes the stomp planner manager tests, they need the parameters of stomp_planner_manager.test */
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  ros::init(argc, argv, "stomp_planner_manager_test");
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,391 @@
+/**
+ * @file stomp_planning_service.cpp
+ * @brief This contains gtest code for the stomp planning service
+ *
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <condition_variable>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <gtest/gtest.h>
+#include <ros/ros.h>
+#include <moveit/robot_model_loader/robot_model_loader.h>
+#include <moveit/planning_scene/planning_scene.h>
+#include <moveit/kinematic_constraints/utils.h>
+#include <moveit/robot_state/conversions.h>
+#include "stomp_moveit/stomp_planner.h"
+#include "stomp_moveit/stomp_planning_service.h"
+
+using namespace stomp_moveit;
+
+static const std::string ROBOT_DESCRIPTION_PARAM = "robot_description";
+static const std::string FAST_GROUP = "manipulator";        /**< Plans in a few iterations */
+static const std::string SLOW_GROUP = "manipulator_rail";   /**< Optimizes until it is terminated */
+static const std::vector<double> START_POSITIONS = {0.9795, -0.148, 0.8108, -0.1373, 0.5393, 0.0};
+static const std::vector<double> GOAL_POSITIONS = {2.3218, -0.5686, 0.3255, -1.6473, 0.4412, 0.0};
+static const std::chrono::seconds WAIT_TIMEOUT(30);
+
+/**
+ * @brief Records the order in which the jobs are taken by the workers of a planning service and can hold them before
+ * they are planned.
+ */
+class JobRecorder
+{
+public:
+  JobRecorder():
+    hold_from_(std::numeric_limits<std::size_t>::max())
+  {
+
+  }
+
+  /** @brief The jobs taken from now on wait for release() before they are planned */
+  void hold()
+  {
+    std::lock_guard<std::mutex> lock(record_mutex_);
+    hold_from_ = taken_.size();
+  }
+
+  /** @brief Lets the held jobs be planned */
+  void release()
+  {
+    releaseUntil(std::numeric_limits<std::size_t>::max());
+  }
+
+  /**
+   * @brief Lets the jobs taken before the given number of jobs be planned, the ones taken after it wait
+   * @param num_jobs  The number of jobs
+   */
+  void releaseUntil(std::size_t num_jobs)
+  {
+    {
+      std::lock_guard<std::mutex> lock(record_mutex_);
+      hold_from_ = num_jobs;
+    }
+    record_condition_.notify_all();
+  }
+
+  /**
+   * @brief Waits until the given number of jobs have been taken
+   * @param num_jobs  The number of jobs
+   * @return True if they were taken before the timeout, False otherwise
+   */
+  bool waitForTaken(std::size_t num_jobs)
+  {
+    std::unique_lock<std::mutex> lock(record_mutex_);
+    return record_condition_.wait_for(lock,WAIT_TIMEOUT,[&](){ return taken_.size() >= num_jobs; });
+  }
+
+  /**
+   * @brief The jobs taken so far, identified by the planner_id of their requests
+   * @return The planner ids in the order they were taken
+   */
+  std::vector<std::string> getTaken()
+  {
+    std::lock_guard<std::mutex> lock(record_mutex_);
+    return taken_;
+  }
+
+  /**
+   * @brief The job callback of the planning service, it records the job and waits while it is held
+   * @param req The request of the job
+   */
+  void record(const planning_interface::MotionPlanRequest& req)
+  {
+    std::unique_lock<std::mutex> lock(record_mutex_);
+    std::size_t index = taken_.size();
+    taken_.push_back(req.planner_id);
+    record_condition_.notify_all();
+    record_condition_.wait(lock,[&](){ return index < hold_from_; });
+  }
+
+protected:
+
+  std::mutex record_mutex_;
+  std::condition_variable record_condition_;
+  std::size_t hold_from_;                     /**< The jobs taken from this index on are held */
+  std::vector<std::string> taken_;
+};
+
+/** @brief Plans on the test_kr210 robot in an in-process planning scene */
+class StompPlanningServiceTest: public testing::Test
+{
+protected:
+
+  void SetUp() override
+  {
+    loader_.reset(new robot_model_loader::RobotModelLoader(ROBOT_DESCRIPTION_PARAM));
+    robot_model_ = loader_->getModel();
+    ASSERT_TRUE(robot_model_ != nullptr);
+
+    planning_scene_.reset(new planning_scene::PlanningScene(robot_model_));
+
+    ros::NodeHandle nh;
+    ASSERT_TRUE(StompPlanner::getConfigData(nh,config_));
+
+    createService(1);
+  }
+
+  void TearDown() override
+  {
+    destroyService();
+  }
+
+  /**
+   * @brief Replaces the service by one with a single worker whose jobs are recorded by recorder_
+   * @param max_batch_size The batch size of the service
+   */
+  void createService(int max_batch_size)
+  {
+    destroyService();
+
+    std::shared_ptr<JobRecorder> recorder(new JobRecorder());
+    recorder_ = recorder;
+    service_.reset(new StompPlanningService(1,max_batch_size));
+    ASSERT_TRUE(service_->setJobCallback([recorder](const planning_interface::MotionPlanRequest& req){
+      recorder->record(req);
+    }));
+    ASSERT_TRUE(service_->initialize(robot_model_,config_));
+  }
+
+  /** @brief Shuts the service down, the held jobs are released first so that its workers can finish */
+  void destroyService()
+  {
+    if(recorder_)
+    {
+      recorder_->release();
+    }
+    service_.reset();
+  }
+
+  /**
+   * @brief Creates a joint goal request from START_POSITIONS to GOAL_POSITIONS without a deadline
+   * @param group The planning group, the rail of SLOW_GROUP stays at zero
+   * @param id    Identifies the request in the order the jobs are taken
+   * @return The motion plan request
+   */
+  planning_interface::MotionPlanRequest createRequest(const std::string& group,const std::string& id) const
+  {
+    std::vector<double> start = START_POSITIONS;
+    std::vector<double> goal = GOAL_POSITIONS;
+    if(group == SLOW_GROUP)
+    {
+      start.insert(start.begin(),0.0);
+      goal.insert(goal.begin(),0.0);
+    }
+
+    const moveit::core::JointModelGroup* joint_group = robot_model_->getJointModelGroup(group);
+    moveit::core::RobotState state(robot_model_);
+    state.setToDefaultValues();
+
+    planning_interface::MotionPlanRequest req;
+    req.group_name = group;
+    req.planner_id = id;
+    req.allowed_planning_time = 0.0;
+
+    state.setJointGroupPositions(joint_group,start);
+    moveit::core::robotStateToRobotStateMsg(state,req.start_state);
+
+    state.setJointGroupPositions(joint_group,goal);
+    req.goal_constraints.push_back(kinematic_constraints::constructGoalConstraints(state,joint_group));
+
+    return req;
+  }
+
+  /**
+   * @brief Waits for a response
+   * @param response  The future response
+   * @return The error code of the response, 0 if it is not ready before the timeout
+   */
+  static int getErrorCode(StompPlanningService::ResponseFuture& response)
+  {
+    if(response.wait_for(WAIT_TIMEOUT) != std::future_status::ready)
+    {
+      return 0;
+    }
+    return response.get().error_code_.val;
+  }
+
+protected:
+
+  robot_model_loader::RobotModelLoaderPtr loader_;
+  moveit::core::RobotModelConstPtr robot_model_;
+  planning_scene::PlanningSceneConstPtr planning_scene_;
+  std::map<std::string, XmlRpc::XmlRpcValue> config_;
+  std::shared_ptr<JobRecorder> recorder_;
+  std::shared_ptr<StompPlanningService> service_;
+};
+
+/** @brief This tests that a request is planned and that the requests STOMP can not plan are rejected */
+TEST_F(StompPlanningServiceTest, plan)
+{
+  using namespace moveit_msgs;
+
+  EXPECT_EQ(1,service_->getNumWorkers());
+  EXPECT_EQ(1,service_->getMaxBatchSize());
+
+  auto response = service_->submit(planning_scene_,createRequest(FAST_GROUP,"plan"),0);
+  ASSERT_EQ(std::future_status::ready,response.wait_for(WAIT_TIMEOUT));
+  planning_interface::MotionPlanResponse res = response.get();
+  EXPECT_EQ(MoveItErrorCodes::SUCCESS,res.error_code_.val);
+  ASSERT_TRUE(res.trajectory_ != nullptr);
+  EXPECT_GT(res.trajectory_->getWayPointCount(),0u);
+
+  planning_interface::MotionPlanRequest req = createRequest(FAST_GROUP,"invalid_group");
+  req.group_name = "eef";
+  auto invalid_group = service_->submit(planning_scene_,req,0);
+  EXPECT_EQ(MoveItErrorCodes::INVALID_GROUP_NAME,getErrorCode(invalid_group));
+
+  auto no_scene = service_->submit(planning_scene::PlanningSceneConstPtr(),createRequest(FAST_GROUP,"no_scene"),0);
+  EXPECT_EQ(MoveItErrorCodes::FAILURE,getErrorCode(no_scene));
+}
+
+/** @brief This tests that the queued requests are planned by priority and in submission order within a priority */
+TEST_F(StompPlanningServiceTest, priority_order)
+{
+  using namespace moveit_msgs;
+
+  // the worker holds the first request while the others are queued
+  recorder_->hold();
+  auto blocking = service_->submit(planning_scene_,createRequest(FAST_GROUP,"blocking"),0);
+  ASSERT_TRUE(recorder_->waitForTaken(1));
+
+  std::vector<StompPlanningService::ResponseFuture> responses;
+  responses.push_back(service_->submit(planning_scene_,createRequest(FAST_GROUP,"low"),-1));
+  responses.push_back(service_->submit(planning_scene_,createRequest(FAST_GROUP,"high_first"),2));
+  responses.push_back(service_->submit(planning_scene_,createRequest(FAST_GROUP,"default_first"),0));
+  responses.push_back(service_->submit(planning_scene_,createRequest(FAST_GROUP,"high_second"),2));
+  responses.push_back(service_->submit(planning_scene_,createRequest(FAST_GROUP,"default_second"),0));
+  EXPECT_EQ(5u,service_->getNumPending());
+
+  recorder_->release();
+  EXPECT_EQ(MoveItErrorCodes::SUCCESS,getErrorCode(blocking));
+  for(auto& r : responses)
+  {
+    EXPECT_EQ(MoveItErrorCodes::SUCCESS,getErrorCode(r));
+  }
+
+  std::vector<std::string> expected = {"blocking","high_first","high_second","default_first","default_second","low"};
+  EXPECT_EQ(expected,recorder_->getTaken());
+  EXPECT_EQ(0u,service_->getNumPending());
+}
+
+/** @brief This tests that a request whose deadline passes while it is queued is answered with TIMED_OUT */
+TEST_F(StompPlanningServiceTest, expired_in_queue)
+{
+  using namespace moveit_msgs;
+
+  recorder_->hold();
+  auto blocking = service_->submit(planning_scene_,createRequest(FAST_GROUP,"blocking"),0);
+  ASSERT_TRUE(recorder_->waitForTaken(1));
+
+  auto deadline = StompPlanningService::Clock::now() + std::chrono::milliseconds(10);
+  auto expired = service_->submit(planning_scene_,createRequest(FAST_GROUP,"expired"),1,deadline);
+  auto unbounded = service_->submit(planning_scene_,createRequest(FAST_GROUP,"unbounded"),0);
+  std::this_thread::sleep_until(deadline + std::chrono::milliseconds(100));
+  recorder_->release();
+
+  EXPECT_EQ(MoveItErrorCodes::SUCCESS,getErrorCode(blocking));
+  ASSERT_EQ(std::future_status::ready,expired.wait_for(WAIT_TIMEOUT));
+  planning_interface::MotionPlanResponse res = expired.get();
+  EXPECT_EQ(MoveItErrorCodes::TIMED_OUT,res.error_code_.val);
+  EXPECT_TRUE(res.trajectory_ == nullptr);
+  EXPECT_EQ(MoveItErrorCodes::SUCCESS,getErrorCode(unbounded));
+
+  std::vector<std::string> expected = {"blocking","expired","unbounded"};
+  EXPECT_EQ(expected,recorder_->getTaken());
+}
+
+/** @brief This tests that shutdown() preempts the running and the queued requests and rejects the new ones */
+TEST_F(StompPlanningServiceTest, shutdown)
+{
+  using namespace moveit_msgs;
+
+  auto running = service_->submit(planning_scene_,createRequest(SLOW_GROUP,"running"),0);
+  ASSERT_TRUE(recorder_->waitForTaken(1));
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+  auto queued_first = service_->submit(planning_scene_,createRequest(FAST_GROUP,"queued_first"),0);
+  auto queued_second = service_->submit(planning_scene_,createRequest(SLOW_GROUP,"queued_second"),1);
+  EXPECT_EQ(2u,service_->getNumPending());
+  EXPECT_EQ(std::future_status::timeout,running.wait_for(std::chrono::seconds(0)));
+
+  service_->shutdown();
+  EXPECT_EQ(std::future_status::ready,running.wait_for(std::chrono::seconds(0)));
+  EXPECT_EQ(MoveItErrorCodes::PREEMPTED,getErrorCode(running));
+  EXPECT_EQ(MoveItErrorCodes::PREEMPTED,getErrorCode(queued_first));
+  EXPECT_EQ(MoveItErrorCodes::PREEMPTED,getErrorCode(queued_second));
+  EXPECT_EQ(0u,service_->getNumPending());
+
+  std::vector<std::string> expected = {"running"};
+  EXPECT_EQ(expected,recorder_->getTaken());
+
+  auto rejected = service_->submit(planning_scene_,createRequest(FAST_GROUP,"rejected"),0);
+  EXPECT_EQ(MoveItErrorCodes::PREEMPTED,getErrorCode(rejected));
+}
+
+/**
+ * @brief This tests that a worker takes the queued requests for the same group and planning scene as one batch, up to
+ * the batch size and in queue order
+ */
+TEST_F(StompPlanningServiceTest, batching)
+{
+  using namespace moveit_msgs;
+
+  createService(3);
+  EXPECT_EQ(3,service_->getMaxBatchSize());
+
+  recorder_->hold();
+  auto blocking = service_->submit(planning_scene_,createRequest(FAST_GROUP,"blocking"),0);
+  ASSERT_TRUE(recorder_->waitForTaken(1));
+
+  planning_scene::PlanningSceneConstPtr other_scene(new planning_scene::PlanningScene(robot_model_));
+  std::vector<StompPlanningService::ResponseFuture> responses;
+  responses.push_back(service_->submit(planning_scene_,createRequest(FAST_GROUP,"first_batch_1"),0));
+  responses.push_back(service_->submit(planning_scene_,createRequest(FAST_GROUP,"first_batch_2"),0));
+  responses.push_back(service_->submit(planning_scene_,createRequest(FAST_GROUP,"first_batch_3"),0));
+  responses.push_back(service_->submit(planning_scene_,createRequest(FAST_GROUP,"second_batch"),0));
+  responses.push_back(service_->submit(other_scene,createRequest(FAST_GROUP,"other_scene"),0));
+  EXPECT_EQ(5u,service_->getNumPending());
+
+  // the worker holds the first job of the next batch, the rest of that batch has left the queue as well
+  recorder_->releaseUntil(2);
+  ASSERT_TRUE(recorder_->waitForTaken(2));
+  EXPECT_EQ(2u,service_->getNumPending());
+
+  recorder_->release();
+  EXPECT_EQ(MoveItErrorCodes::SUCCESS,getErrorCode(blocking));
+  for(auto& r : responses)
+  {
+    EXPECT_EQ(MoveItErrorCodes::SUCCESS,getErrorCode(r));
+  }
+
+  std::vector<std::string> expected = {"blocking","first_batch_1","first_batch_2","first_batch_3","second_batch",
+                                       "other_scene"};
+  EXPECT_EQ(expected,recorder_->getTaken());
+}
+
+/** @brief This executes the stomp planning service tests, they need the parameters of stomp_planning_service.test */
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  ros::init(argc, argv, "stomp_planning_service_test");
+  return RUN_ALL_TESTS();
+}
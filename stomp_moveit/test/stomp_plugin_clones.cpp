@@ -0,0 +1,318 @@
+/**
+ * @file stomp_plugin_clones.cpp
+ * @brief This contains gtest code for the copies made by clone() of the stomp_moveit plugins
+ *
+ * @version TODO
+ * @bug No known bugs
+ *
+ * @copyright Copyright (c) 2016, Southwest Research Institute
+ *
+ * @par License
+ * Software License Agreement (Apache License)
+ * @par
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * @par
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <fstream>
+#include <sstream>
+#include <gtest/gtest.h>
+#include <ros/ros.h>
+#include <ros/package.h>
+#include <boost/filesystem.hpp>
+#include <moveit/robot_model_loader/robot_model_loader.h>
+#include <moveit/planning_scene/planning_scene.h>
+#include <moveit/kinematic_constraints/utils.h>
+#include <moveit/robot_state/conversions.h>
+#include "stomp_moveit/cost_functions/collision_check.h"
+#include "stomp_moveit/cost_functions/obstacle_distance_gradient.h"
+#include "stomp_moveit/noise_generators/normal_distribution_sampling.h"
+#include "stomp_moveit/update_filters/update_logger.h"
+
+using namespace stomp_moveit;
+
+static const std::string ROBOT_DESCRIPTION_PARAM = "robot_description";
+static const std::string GROUP = "manipulator";
+static const std::vector<double> START_POSITIONS = {0.9795, -0.148, 0.8108, -0.1373, 0.5393, 0.0};
+static const std::vector<double> GOAL_POSITIONS = {2.3218, -0.5686, 0.3255, -1.6473, 0.4412, 0.0};
+static const int NUM_TIMESTEPS = 20;
+
+/**
+ * @brief Reads the robot states of a collision cost function.  The copies made by clone() are of the plugin class, so
+ * its protected members are reached through member pointers named in a derived class.
+ */
+template <typename CostFunction>
+struct CostFunctionAccess: public CostFunction
+{
+  static std::vector<moveit::core::RobotStatePtr> getRobotStates(CostFunction& plugin)
+  {
+    std::vector<moveit::core::RobotStatePtr> states = {plugin.*(&CostFunctionAccess::robot_state_)};
+    for(const auto& rs : plugin.*(&CostFunctionAccess::intermediate_coll_states_))
+    {
+      states.push_back(rs);
+    }
+    return states;
+  }
+};
+
+/** @brief Reads the random generators of the NormalDistributionSampling, see CostFunctionAccess */
+struct NoiseGeneratorAccess: public noise_generators::NormalDistributionSampling
+{
+  static std::vector<utils::MultivariateGaussianPtr>& getGenerators(noise_generators::NormalDistributionSampling& plugin)
+  {
+    return plugin.*(&NoiseGeneratorAccess::rand_generators_);
+  }
+};
+
+/** @brief Sets up the plugins for the test_kr210 robot in an in-process planning scene */
+class StompPluginClonesTest: public testing::Test
+{
+protected:
+
+  void SetUp() override
+  {
+    loader_.reset(new robot_model_loader::RobotModelLoader(ROBOT_DESCRIPTION_PARAM));
+    robot_model_ = loader_->getModel();
+    ASSERT_TRUE(robot_model_ != nullptr);
+
+    planning_scene_.reset(new planning_scene::PlanningScene(robot_model_));
+
+    config_.num_timesteps = NUM_TIMESTEPS;
+    config_.num_dimensions = START_POSITIONS.size();
+  }
+
+  /**
+   * @brief Creates a joint goal request from START_POSITIONS to GOAL_POSITIONS
+   * @return The motion plan request
+   */
+  moveit_msgs::MotionPlanRequest createRequest() const
+  {
+    const moveit::core::JointModelGroup* joint_group = robot_model_->getJointModelGroup(GROUP);
+    moveit::core::RobotState state(robot_model_);
+    state.setToDefaultValues();
+
+    moveit_msgs::MotionPlanRequest req;
+    req.group_name = GROUP;
+
+    state.setJointGroupPositions(joint_group,START_POSITIONS);
+    moveit::core::robotStateToRobotStateMsg(state,req.start_state);
+
+    state.setJointGroupPositions(joint_group,GOAL_POSITIONS);
+    req.goal_constraints.push_back(kinematic_constraints::constructGoalConstraints(state,joint_group));
+
+    return req;
+  }
+
+  /**
+   * @brief Checks that two robot states are distinct objects and that changing the second one leaves the first as is
+   * @param original  The state of the loaded plugin
+   * @param copy      The state of the copy
+   */
+  static void expectIndependent(const moveit::core::RobotStatePtr& original,const moveit::core::RobotStatePtr& copy)
+  {
+    ASSERT_TRUE(original != nullptr);
+    ASSERT_TRUE(copy != nullptr);
+    EXPECT_NE(original.get(),copy.get());
+
+    std::vector<double> before, after;
+    original->copyJointGroupPositions(GROUP,before);
+    copy->setJointGroupPositions(GROUP,GOAL_POSITIONS);
+    original->copyJointGroupPositions(GROUP,after);
+    EXPECT_EQ(before,after);
+  }
+
+  /**
+   * @brief Sets up a plugin and checks that its copy has its own robot states
+   * @param plugin  The plugin, it is initialized with the given configuration
+   * @param config  The plugin configuration
+   */
+  template <typename CostFunction>
+  void checkCostFunctionClone(const std::shared_ptr<CostFunction>& plugin,XmlRpc::XmlRpcValue config)
+  {
+    moveit_msgs::MoveItErrorCodes error_code;
+    ASSERT_TRUE(plugin->initialize(robot_model_,GROUP,config));
+    ASSERT_TRUE(plugin->setMotionPlanRequest(planning_scene_,createRequest(),config_,error_code));
+
+    std::shared_ptr<CostFunction> copy = std::dynamic_pointer_cast<CostFunction>(plugin->clone());
+    ASSERT_TRUE(copy != nullptr);
+
+    std::vector<moveit::core::RobotStatePtr> original_states = CostFunctionAccess<CostFunction>::getRobotStates(*plugin);
+    std::vector<moveit::core::RobotStatePtr> copied_states = CostFunctionAccess<CostFunction>::getRobotStates(*copy);
+    ASSERT_EQ(original_states.size(),copied_states.size());
+    for(auto i = 0u; i < original_states.size(); i++)
+    {
+      expectIndependent(original_states[i],copied_states[i]);
+    }
+
+    // both evaluate the same trajectory alike
+    Eigen::MatrixXd parameters(START_POSITIONS.size(),NUM_TIMESTEPS);
+    for(int t = 0; t < NUM_TIMESTEPS; t++)
+    {
+      double s = static_cast<double>(t)/(NUM_TIMESTEPS - 1);
+      for(auto d = 0u; d < START_POSITIONS.size(); d++)
+      {
+        parameters(d,t) = (1.0 - s)*START_POSITIONS[d] + s*GOAL_POSITIONS[d];
+      }
+    }
+
+    Eigen::VectorXd original_costs, copied_costs;
+    bool original_validity, copied_validity;
+    ASSERT_TRUE(plugin->computeCosts(parameters,0,NUM_TIMESTEPS,0,0,original_costs,original_validity));
+    ASSERT_TRUE(copy->computeCosts(parameters,0,NUM_TIMESTEPS,0,0,copied_costs,copied_validity));
+    EXPECT_EQ(original_validity,copied_validity);
+    EXPECT_TRUE(original_costs.isApprox(copied_costs));
+  }
+
+protected:
+
+  robot_model_loader::RobotModelLoaderPtr loader_;
+  moveit::core::RobotModelConstPtr robot_model_;
+  planning_scene::PlanningSceneConstPtr planning_scene_;
+  stomp_core::StompConfiguration config_;
+};
+
+/** @brief This tests that a copy of the CollisionCheck has its own robot states */
+TEST_F(StompPluginClonesTest, collision_check)
+{
+  XmlRpc::XmlRpcValue config;
+  config["cost_weight"] = 1.0;
+  config["collision_penalty"] = 1.0;
+  config["kernel_window_percentage"] = 0.2;
+  config["longest_valid_joint_move"] = 0.05;
+  checkCostFunctionClone(std::make_shared<cost_functions::CollisionCheck>(),config);
+}
+
+/** @brief This tests that a copy of the ObstacleDistanceGradient has its own robot states */
+TEST_F(StompPluginClonesTest, obstacle_distance_gradient)
+{
+  XmlRpc::XmlRpcValue config;
+  config["cost_weight"] = 1.0;
+  config["max_distance"] = 0.2;
+  config["longest_valid_joint_move"] = 0.05;
+  checkCostFunctionClone(std::make_shared<cost_functions::ObstacleDistanceGradient>(),config);
+}
+
+/** @brief This tests that a copy of the NormalDistributionSampling has its own random generators */
+TEST_F(StompPluginClonesTest, normal_distribution_sampling)
+{
+  XmlRpc::XmlRpcValue config;
+  for(int d = 0; d < static_cast<int>(START_POSITIONS.size()); d++)
+  {
+    config["stddev"][d] = 0.1;
+  }
+
+  auto plugin = std::make_shared<noise_generators::NormalDistributionSampling>();
+  moveit_msgs::MoveItErrorCodes error_code;
+  ASSERT_TRUE(plugin->initialize(robot_model_,GROUP,config));
+  ASSERT_TRUE(plugin->setMotionPlanRequest(planning_scene_,createRequest(),config_,error_code));
+
+  auto copy = std::dynamic_pointer_cast<noise_generators::NormalDistributionSampling>(plugin->clone());
+  ASSERT_TRUE(copy != nullptr);
+
+  std::vector<utils::MultivariateGaussianPtr>& original_generators = NoiseGeneratorAccess::getGenerators(*plugin);
+  std::vector<utils::MultivariateGaussianPtr>& copied_generators = NoiseGeneratorAccess::getGenerators(*copy);
+  ASSERT_EQ(original_generators.size(),copied_generators.size());
+  for(auto d = 0u; d < original_generators.size(); d++)
+  {
+    ASSERT_TRUE(original_generators[d] != nullptr);
+    ASSERT_TRUE(copied_generators[d] != nullptr);
+    EXPECT_NE(original_generators[d].get(),copied_generators[d].get());
+
+    // both continue from the same generator state without advancing each other
+    Eigen::VectorXd original_sample(NUM_TIMESTEPS), copied_sample(NUM_TIMESTEPS);
+    copied_generators[d]->sample(copied_sample);
+    original_generators[d]->sample(original_sample);
+    EXPECT_TRUE(original_sample.isApprox(copied_sample));
+  }
+
+  // the same seed, iteration and rollout give the same noise
+  Eigen::MatrixXd parameters = Eigen::MatrixXd::Zero(START_POSITIONS.size(),NUM_TIMESTEPS);
+  Eigen::MatrixXd original_noise(parameters.rows(),parameters.cols()), copied_noise(parameters.rows(),parameters.cols());
+  Eigen::MatrixXd parameters_noise;
+  ASSERT_TRUE(plugin->generateNoise(parameters,0,NUM_TIMESTEPS,1,2,parameters_noise,original_noise));
+  ASSERT_TRUE(copy->generateNoise(parameters,0,NUM_TIMESTEPS,1,2,parameters_noise,copied_noise));
+  EXPECT_TRUE(original_noise.isApprox(copied_noise));
+}
+
+/** @brief This tests that the copies of the UpdateLogger open their own streams and log to their own files */
+TEST_F(StompPluginClonesTest, update_logger)
+{
+  const std::string directory = "test_log";
+  const std::string log_dir = ros::package::getPath("stomp_moveit") + "/" + directory;
+  XmlRpc::XmlRpcValue config;
+  config["package"] = std::string("stomp_moveit");
+  config["directory"] = directory;
+  config["filename"] = std::string("update_log.txt");
+
+  auto plugin = std::make_shared<update_filters::UpdateLogger>();
+  moveit_msgs::MoveItErrorCodes error_code;
+  ASSERT_TRUE(plugin->initialize(robot_model_,GROUP,config));
+  update_filters::StompUpdateFilterPtr first_copy = plugin->clone();
+  update_filters::StompUpdateFilterPtr second_copy = first_copy->clone();
+  ASSERT_TRUE(first_copy != nullptr);
+  ASSERT_TRUE(second_copy != nullptr);
+
+  // both copies log one update of their own at the same time
+  std::vector<update_filters::StompUpdateFilterPtr> copies = {first_copy,second_copy};
+  for(auto& c : copies)
+  {
+    ASSERT_TRUE(c->setMotionPlanRequest(planning_scene_,createRequest(),config_,error_code));
+  }
+
+  Eigen::MatrixXd parameters = Eigen::MatrixXd::Zero(START_POSITIONS.size(),NUM_TIMESTEPS);
+  for(auto i = 0u; i < copies.size(); i++)
+  {
+    Eigen::MatrixXd updates = Eigen::MatrixXd::Constant(START_POSITIONS.size(),NUM_TIMESTEPS,i + 1.0);
+    bool filtered;
+    ASSERT_TRUE(copies[i]->filter(0,NUM_TIMESTEPS,0,parameters,updates,filtered));
+  }
+
+  for(auto& c : copies)
+  {
+    c->done(true,1,0.0,parameters);
+  }
+
+  for(auto i = 0u; i < copies.size(); i++)
+  {
+    std::string file_name = log_dir + "/update_log_" + std::to_string(i + 1) + ".txt";
+    std::ifstream file(file_name);
+    ASSERT_TRUE(file.is_open()) << file_name;
+
+    // the header is followed by the rows of the update logged by this copy only
+    std::string line;
+    int num_rows = 0;
+    while(std::getline(file,line))
+    {
+      if(line.empty() || line[0] == '#')
+      {
+        continue;
+      }
+
+      std::istringstream row(line);
+      double value;
+      while(row >> value)
+      {
+        EXPECT_EQ(i + 1.0,value);
+      }
+      num_rows++;
+    }
+    EXPECT_EQ(static_cast<int>(START_POSITIONS.size()),num_rows);
+  }
+
+  boost::filesystem::remove_all(log_dir);
+}
+
+/** @brief This executes the stomp plugin clone tests, they need the parameters of stomp_plugin_clones.test */
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  ros::init(argc, argv, "stomp_plugin_clones_test");
+  return RUN_ALL_TESTS();
+}
@@ -31,6 +31,7 @@
 #include <moveit/collision_detection_fcl/collision_world_fcl.h>
 #include <moveit/collision_detection_fcl/collision_robot_fcl.h>
 #include "stomp_moveit/cost_functions/stomp_cost_function.h"
+#include "stomp_moveit/utils/start_state_snapshot.h"
 
 namespace stomp_moveit
 {
@@ -42,6 +43,9 @@ namespace cost_functions
  * @brief Evaluates the cost of the goal pose by determining how far the Cartesian tool pose
  *        is from the desired under-constrained task manifold
  *
+ * The robot state and the goal pose computed from a joint goal are kept between requests, FK is only computed again
+ * when the start state or the goal joint values change.
+ *
  * @par Examples:
  * All examples are located here @ref stomp_plugins_examples
  */
@@ -68,6 +72,9 @@ public:
    */
   virtual bool configure(const XmlRpc::XmlRpcValue& config) override;
 
+  /** @brief see base class for documentation*/
+  virtual StompCostFunctionPtr clone() const override;
+
   /**
    * @brief Stores the planning details which will be used during the costs calculations.
    * @param planning_scene  A smart pointer to the planning scene
@@ -81,6 +88,9 @@ public:
                    const stomp_core::StompConfiguration &config,
                    moveit_msgs::MoveItErrorCodes& error_code) override;
 
+  /** @brief see base class for documentation*/
+  virtual void releaseMotionPlanRequest() override;
+
 
   /**
    * @brief computes the goal state costs as a function of the distance from the desired task manifold.
@@ -101,6 +111,27 @@ public:
                             Eigen::VectorXd& costs,
                             bool& validity) override;
 
+  /**
+   * @brief the goal cost only depends on the last state so the previous costs are kept unless the last timestep changed.
+   * @param parameters        The parameter values to evaluate for state costs [num_dimensions x num_parameters]
+   * @param start_timestep    start index into the 'parameters' array, usually 0.
+   * @param num_timesteps     number of elements to use from 'parameters' starting from 'start_timestep'   *
+   * @param iteration_number  The current iteration count in the optimization loop
+   * @param rollout_number    index of the noisy trajectory whose cost is being evaluated.   *
+   * @param changed_timesteps mask [num_parameters] of the timesteps that differ from the last optimized parameters
+   * @param costs             vector containing the state costs per timestep.  Only the array's last entry is set. [num_parameters x 1]
+   * @param validity          whether or not the trajectory is valid
+   * @return true if cost were properly computed
+   */
+  virtual bool computeChangedCosts(const Eigen::MatrixXd& parameters,
+                                   std::size_t start_timestep,
+                                   std::size_t num_timesteps,
+                                   int iteration_number,
+                                   int rollout_number,
+                                   const stomp_core::TimestepMask& changed_timesteps,
+                                   Eigen::VectorXd& costs,
+                                   bool& validity) override;
+
   virtual std::string getGroupName() const override
   {
     return group_name_;
@@ -135,9 +166,12 @@ protected:
   // planning context information
   planning_scene::PlanningSceneConstPtr planning_scene_;
   moveit_msgs::MotionPlanRequest plan_request_;
+  utils::StartStateSnapshot start_state_snapshot_;    /**< @brief The start state the robot state was set up for */
 
   // goal pose
   Eigen::Affine3d tool_goal_pose_;                    /**< @brief The desired goal pose for the active plan request **/
+  std::vector<moveit_msgs::JointConstraint> state_goal_joints_; /**< @brief The goal joint values set in the robot state, empty if none **/
+  Eigen::Affine3d state_goal_pose_;                   /**< @brief The tool pose computed from state_goal_joints_ **/
 
   // ros parameters
   Eigen::ArrayXi dof_nullity_;                        /**< @brief Indicates which cartesian DOF's are unconstrained (0) and fully constrained (1)*/
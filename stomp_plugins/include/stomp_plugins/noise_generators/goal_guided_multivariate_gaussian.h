@@ -71,6 +71,9 @@ public:
    */
   virtual bool configure(const XmlRpc::XmlRpcValue& config) override;
 
+  /** @brief see base class for documentation*/
+  virtual StompNoiseGeneratorPtr clone() const override;
+
   /**
    * @brief Stores the planning details.
    * @param planning_scene      A smart pointer to the planning scene
@@ -137,7 +140,7 @@ protected:
                    const stomp_core::StompConfiguration &config,
                    moveit_msgs::MoveItErrorCodes& error_code);
 
-  virtual bool generateRandomGoal(const Eigen::VectorXd& seed,Eigen::VectorXd& goal_joint_pose);
+  virtual bool generateRandomGoal(const Eigen::VectorXd& seed,stomp_core::RandomStream& stream,Eigen::VectorXd& goal_joint_pose);
 
 protected:
 
@@ -157,9 +160,6 @@ protected:
   std::vector<double> stddev_;                                        /**< @brief The standard deviations applied to each joint, [num_dimensions x 1 **/
   std::vector<double> goal_stddev_;                                   /**< @brief The standard deviations applied to each cartesian dimension at the goal, [6 x 1] **/
 
-  // random goal generation
-  boost::shared_ptr<RandomGenerator> goal_rand_generator_;            /**< @brief Random generator for the tool goal pose **/
-
   // robot
   moveit::core::RobotModelConstPtr robot_model_;
   moveit::core::RobotStatePtr state_;
@@ -66,6 +66,9 @@ public:
    */
   virtual bool configure(const XmlRpc::XmlRpcValue& config) override;
 
+  /** @brief see base class for documentation*/
+  virtual StompUpdateFilterPtr clone() const override;
+
   /**
    * @brief Stores the planning details.
    * @param planning_scene      A smart pointer to the planning scene
@@ -38,6 +38,31 @@ namespace stomp_moveit
 namespace cost_functions
 {
 
+/**
+ * @brief Checks if two joint goals have the same joint names and values
+ * @param lhs The first joint goal
+ * @param rhs The second joint goal
+ * @return  True if they are equal, False otherwise
+ */
+static bool equalJointGoals(const std::vector<moveit_msgs::JointConstraint>& lhs,
+                            const std::vector<moveit_msgs::JointConstraint>& rhs)
+{
+  if(lhs.size() != rhs.size())
+  {
+    return false;
+  }
+
+  for(auto i = 0u; i < lhs.size(); i++)
+  {
+    if(lhs[i].joint_name != rhs[i].joint_name || lhs[i].position != rhs[i].position)
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
 ToolGoalPose::ToolGoalPose():
     name_("ToolGoalPose")
 {
@@ -119,8 +144,25 @@ bool ToolGoalPose::setMotionPlanRequest(const planning_scene::PlanningSceneConst
   const JointModelGroup* joint_group = robot_model_->getJointModelGroup(group_name_);
   int num_joints = joint_group->getActiveJointModels().size();
   tool_link_ = joint_group->getLinkModelNames().back();
-  state_.reset(new RobotState(robot_model_));
-  robotStateMsgToRobotState(req.start_state,*state_);
+
+  // the robot state is kept from the previous request when its start state has not changed, the group joints are
+  // always overwritten before computing the costs
+  bool start_unchanged = start_state_snapshot_.update(req.start_state) && state_;
+  if(!state_)
+  {
+    state_.reset(new RobotState(robot_model_));
+  }
+
+  auto reset_state = [&]()
+  {
+    robotStateMsgToRobotState(req.start_state,*state_);
+    state_goal_joints_.clear();
+  };
+
+  if(!start_unchanged)
+  {
+    reset_state();
+  }
 
   const std::vector<moveit_msgs::Constraints>& goals = req.goal_constraints;
   if(goals.empty())
@@ -146,6 +188,12 @@ bool ToolGoalPose::setMotionPlanRequest(const planning_scene::PlanningSceneConst
       pose.orientation = orient_constraint.orientation;
       tf::poseMsgToEigen(pose,tool_goal_pose_);
       found_goal = true;
+
+      // the goal joints of a previous request do not belong in the state
+      if(!state_goal_joints_.empty())
+      {
+        reset_state();
+      }
       break;
 
     }
@@ -166,6 +214,19 @@ bool ToolGoalPose::setMotionPlanRequest(const planning_scene::PlanningSceneConst
       // compute FK to obtain tool pose
       const std::vector<moveit_msgs::JointConstraint>& joint_constraints = g.joint_constraints;
 
+      // the state already holds this goal, its pose is kept from the previous request
+      if(!state_goal_joints_.empty() && equalJointGoals(state_goal_joints_,joint_constraints))
+      {
+        tool_goal_pose_ = state_goal_pose_;
+        found_goal = true;
+        break;
+      }
+
+      if(!state_goal_joints_.empty())
+      {
+        reset_state();
+      }
+
       // copying goal values into state
       for(auto& jc: joint_constraints)
       {
@@ -175,6 +236,8 @@ bool ToolGoalPose::setMotionPlanRequest(const planning_scene::PlanningSceneConst
       // storing reference goal position tool and pose
       state_->update(true);
       tool_goal_pose_ = state_->getGlobalLinkTransform(tool_link_);
+      state_goal_joints_ = joint_constraints;
+      state_goal_pose_ = tool_goal_pose_;
       found_goal = true;
       break;
     }
@@ -245,5 +308,41 @@ bool ToolGoalPose::computeCosts(const Eigen::MatrixXd& parameters,
   return true;
 }
 
+bool ToolGoalPose::computeChangedCosts(const Eigen::MatrixXd& parameters,
+                          std::size_t start_timestep,
+                          std::size_t num_timesteps,
+                          int iteration_number,
+                          int rollout_number,
+                          const stomp_core::TimestepMask& changed_timesteps,
+                          Eigen::VectorXd& costs,
+                          bool& validity)
+{
+  if(costs.size() == parameters.cols() && !changed_timesteps(parameters.cols() - 1))
+  {
+    return true;
+  }
+
+  return computeCosts(parameters,start_timestep,num_timesteps,iteration_number,rollout_number,costs,validity);
+}
+
+void ToolGoalPose::releaseMotionPlanRequest()
+{
+  planning_scene_.reset();
+  plan_request_ = moveit_msgs::MotionPlanRequest();
+}
+
+StompCostFunctionPtr ToolGoalPose::clone() const
+{
+  std::shared_ptr<ToolGoalPose> copy(new ToolGoalPose(*this));
+
+  // the robot state is modified while planning
+  if(state_)
+  {
+    copy->state_.reset(new moveit::core::RobotState(*state_));
+  }
+
+  return copy;
+}
+
 } /* namespace cost_functions */
 } /* namespace stomp_moveit */
@@ -26,6 +26,7 @@
 
 #include "stomp_plugins/noise_generators/goal_guided_multivariate_gaussian.h"
 #include <stomp_moveit/utils/multivariate_gaussian.h>
+#include <stomp_core/matrix_cache.h>
 #include <XmlRpcException.h>
 #include <pluginlib/class_list_macros.h>
 #include <ros/package.h>
@@ -40,8 +41,6 @@ static int const IK_ITERATIONS = 40;
 static double const JOINT_UPDATE_RATE = 0.5f;
 static double const CARTESIAN_POS_CONVERGENCE = 0.01;
 static double const CARTESIAN_ROT_CONVERGENCE = 0.01;
-static const std::vector<double> ACC_MATRIX_DIAGONAL_VALUES = {-1.0/12.0, 16.0/12.0, -30.0/12.0, 16.0/12.0, -1.0/12.0};
-static const std::vector<int> ACC_MATRIX_DIAGONAL_INDICES = {-2, -1, 0 ,1, 2};
 static const int CARTESIAN_DOF_SIZE = 6;
 
 
@@ -51,8 +50,7 @@ namespace noise_generators
 {
 
 GoalGuidedMultivariateGaussian::GoalGuidedMultivariateGaussian():
-  name_("GoalGuidedMultivariateGaussian"),
-  goal_rand_generator_(new RandomGenerator(RGNType(),boost::uniform_real<>(-1,1)))
+  name_("GoalGuidedMultivariateGaussian")
 {
 
 }
@@ -172,34 +170,15 @@ bool GoalGuidedMultivariateGaussian::setNoiseGeneration(const planning_scene::Pl
 {
   using namespace Eigen;
 
-  // convenience lambda function to fill matrix
-  auto fill_diagonal = [](Eigen::MatrixXd& m,double coeff,int diag_index)
-  {
-    std::size_t size = m.rows() - std::abs(diag_index);
-    m.diagonal(diag_index) = VectorXd::Constant(size,coeff);
-  };
-
-  // creating finite difference acceleration matrix
+  // the covariance (A^T * A)^-1 and its Cholesky factor only depend on the number of timesteps
   std::size_t num_timesteps = config.num_timesteps;
-  Eigen::MatrixXd A = MatrixXd::Zero(num_timesteps,num_timesteps);
-  int num_elements = (int((ACC_MATRIX_DIAGONAL_INDICES.size() -1)/2.0) + 1)* num_timesteps ;
-  for(auto i = 0u; i < ACC_MATRIX_DIAGONAL_INDICES.size() ; i++)
-  {
-    fill_diagonal(A,ACC_MATRIX_DIAGONAL_VALUES[i],ACC_MATRIX_DIAGONAL_INDICES[i]);
-  }
-
-  // create and scale covariance matrix
-  Eigen::MatrixXd covariance = MatrixXd::Identity(num_timesteps,num_timesteps);
-  covariance = A.transpose() * A;
-  covariance = covariance.fullPivLu().inverse();
-  double max_val = covariance.array().abs().matrix().maxCoeff();
-  covariance /= max_val;
+  stomp_core::SamplingCovarianceConstPtr sampling = stomp_core::MatrixCache::instance().getSamplingCovariance(num_timesteps);
 
   // create random generators
   traj_noise_generators_.resize(stddev_.size());
   for(auto& r: traj_noise_generators_)
   {
-    r.reset(new utils::MultivariateGaussian(VectorXd::Zero(num_timesteps),covariance));
+    r.reset(new utils::MultivariateGaussian(VectorXd::Zero(num_timesteps),sampling->covariance,sampling->cholesky));
   }
 
   // preallocating noise data
@@ -251,7 +230,9 @@ bool GoalGuidedMultivariateGaussian::generateNoise(const Eigen::MatrixXd& parame
     return false;
   }
 
-  if(generateRandomGoal(parameters.rightCols(1),goal_joint_pose))
+  // the noise only depends on the seed, the iteration and the rollout
+  stomp_core::RandomStream stream(random_seed_,iteration_number,rollout_number);
+  if(generateRandomGoal(parameters.rightCols(1),stream,goal_joint_pose))
   {
     goal_joint_noise = goal_joint_pose - parameters.rightCols(1);
   }
@@ -265,11 +246,11 @@ bool GoalGuidedMultivariateGaussian::generateNoise(const Eigen::MatrixXd& parame
   int sign;
   for(auto d = 0u; d < parameters.rows() ; d++)
   {
-    traj_noise_generators_[d]->sample(raw_noise_,true);
+    traj_noise_generators_[d]->sample(raw_noise_,stream,true);
 
     // shifting data towards goal
     sign = goal_joint_noise(d) > 0 ? 1 : -1;
-    noise.row(d).transpose() = stddev_[d] * raw_noise_+ sign*Eigen::VectorXd::LinSpaced(
+    noise.row(d).transpose() = noise_scale_ * stddev_[d] * raw_noise_+ sign*Eigen::VectorXd::LinSpaced(
         raw_noise_.size(),0,std::abs(goal_joint_noise(d)));
   }
 
@@ -278,7 +259,8 @@ bool GoalGuidedMultivariateGaussian::generateNoise(const Eigen::MatrixXd& parame
   return true;
 }
 
-bool GoalGuidedMultivariateGaussian::generateRandomGoal(const Eigen::VectorXd& seed_joint_pose,Eigen::VectorXd& goal_joint_pose)
+bool GoalGuidedMultivariateGaussian::generateRandomGoal(const Eigen::VectorXd& seed_joint_pose,stomp_core::RandomStream& stream,
+                                                        Eigen::VectorXd& goal_joint_pose)
 {
   using namespace Eigen;
   using namespace moveit::core;
@@ -288,7 +270,7 @@ bool GoalGuidedMultivariateGaussian::generateRandomGoal(const Eigen::VectorXd& s
   Eigen::VectorXd noise = Eigen::VectorXd::Zero(CARTESIAN_DOF_SIZE);
   for(auto d = 0u; d < noise.size(); d++)
   {
-    noise(d) = goal_stddev_[d]*(*goal_rand_generator_)();
+    noise(d) = noise_scale_ * goal_stddev_[d]*(2.0 * stream.uniform() - 1.0);
   }
 
   // applying noise onto tool pose
@@ -310,6 +292,26 @@ bool GoalGuidedMultivariateGaussian::generateRandomGoal(const Eigen::VectorXd& s
   return true;
 }
 
+StompNoiseGeneratorPtr GoalGuidedMultivariateGaussian::clone() const
+{
+  std::shared_ptr<GoalGuidedMultivariateGaussian> copy(new GoalGuidedMultivariateGaussian(*this));
+
+  // the robot state and the random generators are modified while planning
+  if(state_)
+  {
+    copy->state_.reset(new moveit::core::RobotState(*state_));
+  }
+
+  for(auto& r : copy->traj_noise_generators_)
+  {
+    if(r)
+    {
+      r.reset(new utils::MultivariateGaussian(*r));
+    }
+  }
+
+  return copy;
+}
 
 } /* namespace noise_generators */
 } /* namespace stomp_moveit */
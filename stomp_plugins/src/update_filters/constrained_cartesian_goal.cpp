@@ -250,5 +250,18 @@ bool ConstrainedCartesianGoal::filter(std::size_t start_timestep,
   return true;
 }
 
+StompUpdateFilterPtr ConstrainedCartesianGoal::clone() const
+{
+  std::shared_ptr<ConstrainedCartesianGoal> copy(new ConstrainedCartesianGoal(*this));
+
+  // the robot state is modified while planning
+  if(state_)
+  {
+    copy->state_.reset(new moveit::core::RobotState(*state_));
+  }
+
+  return copy;
+}
+
 } /* namespace update_filters */
 } /* namespace stomp_moveit */